@@ -0,0 +1,357 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#include "autosaver.h"
+
+#include "documentviewmanager.h"
+#include "global.h"
+#include "iview.h"
+#include "messagewidget.h"
+#include "settings.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTimer>
+#include <QUndoCommand>
+#include <QUndoStack>
+#include <QtConcurrent>
+
+namespace Caneda
+{
+    /*!
+     * \brief Serializes a document snapshot and writes it into a file.
+     *
+     * This method is run in a worker thread, and must not access any object
+     * living in the GUI thread. QSaveFile writes into a temporary file and on
+     * commit() flushes it to disk and renames it into its final location.
+     *
+     * \param fileName File to be written.
+     * \param snapshot Snapshot of the document to be written.
+     * \return An empty string on success, the error message otherwise.
+     */
+    static QString writeSnapshot(const QString &fileName, const DocumentSnapshotPtr &snapshot)
+    {
+        QString text = snapshot->toText();
+
+        QSaveFile file(fileName);
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            return file.errorString();
+        }
+
+        file.write(text.toUtf8());
+        if(!file.commit()) {
+            return file.errorString();
+        }
+
+        return QString();
+    }
+
+    //! \brief Constructor.
+    AutoSaver::AutoSaver(QObject *parent) : QObject(parent)
+    {
+        m_timer = new QTimer(this);
+        connect(m_timer, SIGNAL(timeout()), this, SLOT(autoSave()));
+
+        updateSettingsChanges();
+    }
+
+    //! \brief Destructor.
+    AutoSaver::~AutoSaver()
+    {
+        waitForPendingWrites();
+    }
+
+    //! \copydoc MainWindow::instance()
+    AutoSaver* AutoSaver::instance()
+    {
+        static AutoSaver *instance = 0;
+        if(!instance) {
+            instance = new AutoSaver();
+        }
+        return instance;
+    }
+
+    /*!
+     * \brief Returns the backup file name used for a given document.
+     *
+     * The file suffix is preserved, so that the backup can be opened directly
+     * by the corresponding context in case of recovery.
+     *
+     * Backup files opened as documents have no backup of their own, as it
+     * would be named as themselves.
+     *
+     * \param fileName File name of the document.
+     * \return Backup file name, for example "amplifier.autosave.xsch" for
+     * "amplifier.xsch", or an empty string if \a fileName is a backup file.
+     */
+    QString AutoSaver::autoSaveFileName(const QString &fileName)
+    {
+        QFileInfo info(fileName);
+        if(info.completeBaseName().endsWith(".autosave")) {
+            return QString();
+        }
+
+        return info.absolutePath() + "/" + info.completeBaseName() +
+            ".autosave." + info.suffix();
+    }
+
+    /*!
+     * \brief Returns true if a backup of a document, newer than the
+     * document itself, was left behind.
+     *
+     * Backups are removed when their document is saved or closed, so such a
+     * backup holds the changes not saved before a crash.
+     *
+     * \param fileName File name of the document.
+     */
+    bool AutoSaver::hasRecoverableBackup(const QString &fileName)
+    {
+        QString backupFileName = autoSaveFileName(fileName);
+        if(backupFileName.isEmpty()) {
+            return false;
+        }
+
+        QFileInfo backup(backupFileName);
+        QFileInfo file(fileName);
+
+        return backup.exists() && (!file.exists() || backup.lastModified() > file.lastModified());
+    }
+
+    /*!
+     * \brief Marks a document as modified, even if its undo stack is clean.
+     *
+     * An empty command is pushed into the undo stack of the document, so
+     * that its contents are not considered saved. This is used when the
+     * contents differ from the file, for example after recovering a backup.
+     *
+     * \param document Document to be marked.
+     * \param reason Text of the command shown in the undo history.
+     */
+    void AutoSaver::markModified(IDocument *document, const QString &reason)
+    {
+        QUndoStack *stack = document->undoStack();
+        if(stack) {
+            stack->push(new QUndoCommand(reason));
+        }
+    }
+
+    /*!
+     * \brief Updates the autosave interval from the current settings.
+     *
+     * An interval of zero minutes disables the autosave.
+     */
+    void AutoSaver::updateSettingsChanges()
+    {
+        int minutes = Settings::instance()->currentValue("gui/autoSaveInterval").toInt();
+
+        if(minutes > 0) {
+            m_timer->start(minutes * 60 * 1000);
+        }
+        else {
+            m_timer->stop();
+        }
+    }
+
+    /*!
+     * \brief Saves a backup copy of all modified documents.
+     *
+     * The snapshot of each document is taken here, in the GUI thread, while
+     * the serialization and writing are performed by a worker thread. If a
+     * previous backup of the same document is still being written, the
+     * document is kept as modified and saved in the next round.
+     */
+    void AutoSaver::autoSave()
+    {
+        foreach(IDocument *document, DocumentViewManager::instance()->documents()) {
+
+            QUndoStack *stack = document->undoStack();
+            QString fileName = autoSaveFileName(document->fileName());
+            if(!stack || document->fileName().isEmpty() || fileName.isEmpty()) {
+                continue;
+            }
+
+            // Start tracking new documents. Changes made before tracking
+            // started are unknown, so the document is considered modified.
+            if(!m_autoSaveFiles.contains(stack)) {
+                connect(stack, SIGNAL(indexChanged(int)), this, SLOT(onUndoStackChanged()));
+                connect(stack, SIGNAL(cleanChanged(bool)), this, SLOT(onUndoStackCleanChanged(bool)));
+                connect(stack, SIGNAL(destroyed(QObject*)), this, SLOT(onUndoStackDestroyed(QObject*)));
+                m_dirtyStacks << stack;
+            }
+
+            // The document may have been renamed (save as) since last backup
+            if(m_autoSaveFiles.value(stack, fileName) != fileName) {
+                removeAutoSaveFile(m_autoSaveFiles.value(stack));
+            }
+            m_autoSaveFiles[stack] = fileName;
+
+            // Skip documents already saved or unchanged since the last backup
+            if(stack->isClean() || !m_dirtyStacks.contains(stack)) {
+                continue;
+            }
+
+            // Skip documents whose previous backup is still being written
+            if(m_pendingWrites.contains(fileName)) {
+                continue;
+            }
+
+            DocumentSnapshotPtr snapshot = document->snapshot();
+            if(!snapshot) {
+                continue;
+            }
+
+            write(fileName, snapshot);
+            m_dirtyStacks.remove(stack);
+        }
+    }
+
+    /*!
+     * \brief Blocks until a pending write on a file has finished.
+     *
+     * This is used before removing or writing the file again.
+     *
+     * \return False if the write failed, true otherwise.
+     */
+    bool AutoSaver::waitForPendingWrite(const QString &fileName)
+    {
+        if(!m_pendingWrites.contains(fileName)) {
+            return true;
+        }
+
+        m_pendingWrites.value(fileName).watcher->waitForFinished();
+        return finishWrite(fileName);
+    }
+
+    /*!
+     * \brief Blocks until all pending writes have finished.
+     *
+     * This is used before quitting the application.
+     */
+    void AutoSaver::waitForPendingWrites()
+    {
+        foreach(const QString &fileName, m_pendingWrites.keys()) {
+            waitForPendingWrite(fileName);
+        }
+    }
+
+    //! \brief Marks the sending undo stack as modified since its last backup.
+    void AutoSaver::onUndoStackChanged()
+    {
+        QUndoStack *stack = qobject_cast<QUndoStack*>(sender());
+        if(stack) {
+            m_dirtyStacks << stack;
+        }
+    }
+
+    /*!
+     * \brief Removes the backup of a document once it is saved.
+     *
+     * When the undo stack becomes clean the file on disk is up to date, and
+     * the backup is no longer needed.
+     */
+    void AutoSaver::onUndoStackCleanChanged(bool clean)
+    {
+        QUndoStack *stack = qobject_cast<QUndoStack*>(sender());
+        if(stack && clean) {
+            removeAutoSaveFile(m_autoSaveFiles.value(stack));
+            m_dirtyStacks.remove(stack);
+        }
+    }
+
+    /*!
+     * \brief Removes the backup of a document when the document is closed.
+     *
+     * At this point the document was either saved or its changes were
+     * explicitly discarded by the user, in both cases the backup is no longer
+     * needed.
+     */
+    void AutoSaver::onUndoStackDestroyed(QObject *object)
+    {
+        QUndoStack *stack = static_cast<QUndoStack*>(object);
+
+        removeAutoSaveFile(m_autoSaveFiles.take(stack));
+        m_dirtyStacks.remove(stack);
+    }
+
+    //! \brief Reports the result of the write finished by a worker thread.
+    void AutoSaver::onWriteFinished()
+    {
+        QHash<QString, QFutureWatcher<QString>*>::const_iterator it;
+        for(it = m_pendingWrites.constBegin(); it != m_pendingWrites.constEnd(); ++it) {
+            if(it.value() == sender()) {
+                finishWrite(it.key());
+                return;
+            }
+        }
+    }
+
+    //! \brief Starts writing \a snapshot into \a fileName in a worker thread.
+    void AutoSaver::write(const QString &fileName, const DocumentSnapshotPtr &snapshot)
+    {
+        QFutureWatcher<QString> *watcher = new QFutureWatcher<QString>(this);
+        connect(watcher, SIGNAL(finished()), this, SLOT(onWriteFinished()));
+
+        m_pendingWrites.insert(fileName, watcher);
+        watcher->setFuture(QtConcurrent::run(writeSnapshot, fileName, snapshot));
+    }
+
+    /*!
+     * \brief Forgets a finished write, reporting any error to the user.
+     *
+     * A failed backup is shown in the current view, as it is not caused by
+     * any user action.
+     *
+     * \return False if the write failed, true otherwise.
+     */
+    bool AutoSaver::finishWrite(const QString &fileName)
+    {
+        QFutureWatcher<QString> *watcher = m_pendingWrites.take(fileName);
+        QString errorMessage = watcher->result();
+        watcher->deleteLater();
+
+        if(errorMessage.isEmpty()) {
+            return true;
+        }
+
+        IView *view = DocumentViewManager::instance()->currentView();
+        if(view) {
+            MessageWidget *dialog = new MessageWidget(tr("Could not write the backup file %1: %2")
+                                                      .arg(fileName).arg(errorMessage),
+                                                      view->toWidget());
+            dialog->setMessageType(MessageWidget::Warning);
+            dialog->setIcon(Caneda::icon("dialog-warning"));
+            dialog->show();
+        }
+        return false;
+    }
+
+    //! \brief Removes a backup file, waiting for any pending write on it.
+    void AutoSaver::removeAutoSaveFile(const QString &fileName)
+    {
+        if(fileName.isEmpty()) {
+            return;
+        }
+
+        waitForPendingWrite(fileName);
+        QFile::remove(fileName);
+    }
+
+} // namespace Caneda
@@ -0,0 +1,114 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#ifndef AUTOSAVER_H
+#define AUTOSAVER_H
+
+#include "idocument.h"
+
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+
+// Forward declarations
+class QTimer;
+class QUndoStack;
+
+namespace Caneda
+{
+    /*!
+     * \brief This class periodically saves a backup copy of all modified
+     * documents in worker threads.
+     *
+     * Every "gui/autoSaveInterval" minutes, each open document whose undo
+     * stack is not clean and has changed since the last backup is saved into
+     * a sibling file (see autoSaveFileName()). The work is split in two
+     * steps:
+     * \li A snapshot of the document is taken in the GUI thread by means of
+     * IDocument::snapshot(). This only copies values and implicitly shared
+     * data, so it is much cheaper than the serialization.
+     * \li The snapshot is serialized, encoded and written to disk in a
+     * worker thread. The file is written through a QSaveFile, which syncs
+     * the data to disk and atomically renames the temporary file into place
+     * on commit(), so a crash in the middle of a write never leaves a
+     * truncated file behind.
+     *
+     * Write errors are reported to the user once the worker finishes.
+     * Explicit saves are not done here, but synchronously by the documents,
+     * so that their undo stack is only cleared once the file is written.
+     *
+     * Documents whose undo stack is clean are skipped, and their backup file
+     * is removed, as the file on disk is already up to date. Backup files are
+     * also removed when a document is closed. A backup left behind by a crash
+     * is offered for recovery when its document is opened again (see
+     * hasRecoverableBackup()).
+     *
+     * This class is a singleton class and its only static instance (returned
+     * by instance()) is to be used.
+     *
+     * \sa IDocument::snapshot(), IDocument::undoStack()
+     */
+    class AutoSaver : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        static AutoSaver* instance();
+        ~AutoSaver();
+
+        static QString autoSaveFileName(const QString &fileName);
+        static bool hasRecoverableBackup(const QString &fileName);
+        static void markModified(IDocument *document, const QString &reason);
+
+        bool waitForPendingWrite(const QString &fileName);
+        void waitForPendingWrites();
+
+        void updateSettingsChanges();
+
+    public Q_SLOTS:
+        void autoSave();
+
+    private Q_SLOTS:
+        void onUndoStackChanged();
+        void onUndoStackCleanChanged(bool clean);
+        void onUndoStackDestroyed(QObject *object);
+        void onWriteFinished();
+
+    private:
+        explicit AutoSaver(QObject *parent = 0);
+
+        void write(const QString &fileName, const DocumentSnapshotPtr &snapshot);
+        bool finishWrite(const QString &fileName);
+        void removeAutoSaveFile(const QString &fileName);
+
+        QTimer *m_timer;
+
+        //! \brief Backup file name of each undo stack being tracked.
+        QHash<QUndoStack*, QString> m_autoSaveFiles;
+        //! \brief Undo stacks modified since their last backup.
+        QSet<QUndoStack*> m_dirtyStacks;
+        //! \brief Files being written by the worker threads.
+        QHash<QString, QFutureWatcher<QString>*> m_pendingWrites;
+    };
+
+} // namespace Caneda
+
+#endif //AUTOSAVER_H
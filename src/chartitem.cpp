@@ -19,15 +19,650 @@
 
 #include "chartitem.h"
 
+#include <QtMath>
+
+#include <algorithm>
+
 namespace Caneda
 {
+    /*************************************************************************
+     *                          ComplexSeriesData                            *
+     *************************************************************************/
+    /*!
+     * \brief Constructor
+     *
+     * \param frequency Frequency of each sample.
+     * \param real Real part of each sample.
+     * \param imaginary Imaginary part of each sample.
+     * \param component Component of the complex data represented.
+     */
+    ComplexSeriesData::ComplexSeriesData(const QVector<double> &frequency,
+                                         const QVector<double> &real,
+                                         const QVector<double> &imaginary,
+                                         Component component) :
+        m_frequency(frequency),
+        m_real(real),
+        m_imaginary(imaginary),
+        m_component(component),
+        m_evaluated(false)
+    {
+    }
+
+    /*!
+     * \brief Returns new data with another \a component of the same
+     * waveform.
+     *
+     * The raw data is implicitly shared with this object, so only the
+     * values of the new component are computed (when first requested).
+     */
+    ComplexSeriesData* ComplexSeriesData::component(Component component) const
+    {
+        return new ComplexSeriesData(m_frequency, m_real, m_imaginary, component);
+    }
+
+    QPointF ComplexSeriesData::sample(size_t i) const
+    {
+        const int index = static_cast<int>(i);
+        return QPointF(m_frequency.at(index), yData().at(index));
+    }
+
+    QRectF ComplexSeriesData::boundingRect() const
+    {
+        if(d_boundingRect.width() < 0.0) {
+            d_boundingRect = qwtBoundingRect(*this);
+        }
+
+        return d_boundingRect;
+    }
+
+    //! \brief Returns the values of the component, computing them if needed.
+    const QVector<double>& ComplexSeriesData::yData() const
+    {
+        if(m_component == Real) {
+            return m_real;
+        }
+        if(m_component == Imaginary) {
+            return m_imaginary;
+        }
+
+        evaluate();
+        return m_values;
+    }
+
+    /*!
+     * \brief Computes the values of the component.
+     *
+     * Each component is computed with a single loop over the raw arrays,
+     * without branches in the common cases, allowing the compiler to
+     * vectorize it.
+     */
+    void ComplexSeriesData::evaluate() const
+    {
+        if(m_evaluated) {
+            return;
+        }
+
+        const int size = m_frequency.size();
+        const double *re = m_real.constData();
+        const double *im = m_imaginary.constData();
+
+        m_values.resize(size);
+        double *y = m_values.data();
+
+        switch(m_component) {
+
+        case Magnitude:
+            for(int i = 0; i < size; ++i) {
+                y[i] = qSqrt(re[i] * re[i] + im[i] * im[i]);
+            }
+            break;
+
+        case MagnitudeDb:
+            // 20*log10(sqrt(x)) = 10*log10(x), avoiding the square root
+            for(int i = 0; i < size; ++i) {
+                y[i] = 10 * log10(re[i] * re[i] + im[i] * im[i]);
+            }
+            break;
+
+        case Phase:
+            for(int i = 0; i < size; ++i) {
+                y[i] = atan2(im[i], re[i]) * (180 / M_PI);
+            }
+            break;
+
+        case UnwrappedPhase:
+        case GroupDelay:
+        {
+            // Unwrapped phase, in radians
+            double offset = 0;
+            double previous = 0;
+            for(int i = 0; i < size; ++i) {
+                const double phase = atan2(im[i], re[i]);
+                if(i > 0) {
+                    const double jump = phase - previous;
+                    if(jump > M_PI) {
+                        offset -= 2 * M_PI;
+                    }
+                    else if(jump < -M_PI) {
+                        offset += 2 * M_PI;
+                    }
+                }
+                previous = phase;
+                y[i] = phase + offset;
+            }
+
+            if(m_component == UnwrappedPhase) {
+                for(int i = 0; i < size; ++i) {
+                    y[i] *= 180 / M_PI;
+                }
+            }
+            else {
+                // Group delay = -d(phase)/d(omega), with backward
+                // differences computed in place from the last sample.
+                const double *f = m_frequency.constData();
+                for(int i = size - 1; i > 0; --i) {
+                    const double dw = 2 * M_PI * (f[i] - f[i - 1]);
+                    y[i] = dw != 0 ? -(y[i] - y[i - 1]) / dw : 0;
+                }
+                if(size > 1) {
+                    y[0] = y[1];
+                }
+                else if(size == 1) {
+                    y[0] = 0;
+                }
+            }
+            break;
+        }
+
+        default:
+            break;
+        }
+
+        m_evaluated = true;
+    }
+
+
+    /*************************************************************************
+     *                          ChartSampleBuffer                            *
+     *************************************************************************/
+    //! \brief Constructor
+    ChartSampleBuffer::ChartSampleBuffer() :
+        m_size(0)
+    {
+    }
+
+    //! \brief Destructor
+    ChartSampleBuffer::~ChartSampleBuffer()
+    {
+        foreach(double *chunk, m_chunks) {
+            delete[] chunk;
+        }
+    }
+
+    //! \brief Appends a sample, allocating a new chunk when needed.
+    void ChartSampleBuffer::append(double value)
+    {
+        if((m_size & (ChunkSize - 1)) == 0) {
+            m_chunks.append(new double[ChunkSize]);
+        }
+
+        m_chunks.last()[m_size & (ChunkSize - 1)] = value;
+        ++m_size;
+    }
+
+    //! \brief Returns a contiguous copy of the samples.
+    QVector<double> ChartSampleBuffer::toVector() const
+    {
+        QVector<double> values(m_size);
+        for(int c = 0; c < m_chunks.size(); ++c) {
+            const int first = c * ChunkSize;
+            std::copy(m_chunks.at(c), m_chunks.at(c) + qMin(ChunkSize, m_size - first),
+                      values.data() + first);
+        }
+
+        return values;
+    }
+
+    /*************************************************************************
+     *                         StreamingSeriesData                           *
+     *************************************************************************/
+    /*!
+     * \brief Constructor
+     *
+     * \param x Buffer with the abscissa of the samples, usually shared by
+     * all the waveforms of the simulation.
+     * \param y Buffer with the values of the samples.
+     */
+    StreamingSeriesData::StreamingSeriesData(QSharedPointer<ChartSampleBuffer> x,
+                                             QSharedPointer<ChartSampleBuffer> y) :
+        m_x(x),
+        m_y(y),
+        m_size(0)
+    {
+        d_boundingRect = QRectF(0.0, 0.0, -1.0, -1.0);  // Invalid until the first sample
+    }
+
+    QPointF StreamingSeriesData::sample(size_t i) const
+    {
+        return QPointF(m_x->at(static_cast<int>(i)), m_y->at(static_cast<int>(i)));
+    }
+
+    /*!
+     * \brief Publishes the samples appended to the buffers since the last
+     * update, extending the bounding rectangle with them.
+     */
+    void StreamingSeriesData::update()
+    {
+        const int size = qMin(m_x->size(), m_y->size());
+        if(size <= m_size) {
+            return;
+        }
+
+        double left = m_x->at(m_size);
+        double right = left;
+        double top = m_y->at(m_size);
+        double bottom = top;
+
+        if(d_boundingRect.width() >= 0.0) {
+            left = d_boundingRect.left();
+            right = d_boundingRect.right();
+            top = d_boundingRect.top();
+            bottom = d_boundingRect.bottom();
+        }
+
+        for(int i = m_size; i < size; ++i) {
+            const double x = m_x->at(i);
+            const double y = m_y->at(i);
+            left = qMin(left, x);
+            right = qMax(right, x);
+            top = qMin(top, y);
+            bottom = qMax(bottom, y);
+        }
+
+        d_boundingRect.setCoords(left, top, right, bottom);
+        m_size = size;
+    }
+
+    /*************************************************************************
+     *                             ChartSeries                               *
+     *************************************************************************/
     /*!
      * \brief Constructor
      *
      * \param title Title of the curve
      */
-    ChartSeries::ChartSeries(const QString &title) : QwtPlotCurve(title)
+    ChartSeries::ChartSeries(const QString &title) :
+        QwtPlotCurve(title),
+        m_family(-1)
+    {
+    }
+
+    /*!
+     * \brief Discards the lookup tables used for range statistics.
+     *
+     * This method must be called once the samples of the curve are set (for
+     * example, after loading a simulation). It only allocates an empty,
+     * shareable index; the tables themselves are built by the first range
+     * query (see builtIndex()), so loading a simulation does not compute
+     * (nor keep in memory) tables for waveforms that are never measured.
+     * This also avoids computing the hidden components of complex
+     * waveforms at load time.
+     *
+     * \sa ChartSeriesIndex, statistics()
+     */
+    void ChartSeries::updateIndex()
+    {
+        m_index = QExplicitlySharedDataPointer<ChartSeriesIndex>(new ChartSeriesIndex);
+    }
+
+    /*!
+     * \brief Discards the lookup tables of several curves.
+     *
+     * \sa updateIndex()
+     */
+    void ChartSeries::updateIndexes(QList<ChartSeries*> curves)
+    {
+        foreach(ChartSeries *curve, curves) {
+            curve->updateIndex();
+        }
+    }
+
+    /*!
+     * \brief Returns the lookup tables of the curve, building them if needed.
+     *
+     * The tables are built in linear time by the first caller, and shared
+     * with every curve holding the same index (for example, the curves of
+     * split views). Returns 0 if the curve has no index, in which case range
+     * queries scan the samples.
+     *
+     * \sa updateIndex(), ChartSeriesIndex
+     */
+    ChartSeriesIndex* ChartSeries::builtIndex() const
+    {
+        ChartSeriesIndex *index = m_index.data();
+        if(!index) {
+            return 0;
+        }
+
+        QMutexLocker locker(&index->mutex);
+        if(index->built) {
+            return index;
+        }
+
+        const QwtSeriesData<QPointF> *series = data();
+        const int size = static_cast<int>(series->size());
+
+        // Running trapezoidal integrals of y and y^2
+        index->integral.resize(size);
+        index->integralSquares.resize(size);
+
+        double sum = 0;
+        double sumSquares = 0;
+        QPointF previous = size > 0 ? series->sample(0) : QPointF();
+
+        for(int i = 0; i < size; ++i) {
+            const QPointF current = series->sample(i);
+            const double dx = current.x() - previous.x();
+
+            sum += 0.5 * (previous.y() + current.y()) * dx;
+            sumSquares += 0.5 * (previous.y() * previous.y() + current.y() * current.y()) * dx;
+
+            index->integral[i] = sum;
+            index->integralSquares[i] = sumSquares;
+            previous = current;
+        }
+
+        // First level of the sparse tables: extremes of each block
+        const int blocks = (size + ChartSeriesIndex::BlockSize - 1) / ChartSeriesIndex::BlockSize;
+        QVector<double> blockMinimum(blocks);
+        QVector<double> blockMaximum(blocks);
+
+        for(int b = 0; b < blocks; ++b) {
+            const int first = b * ChartSeriesIndex::BlockSize;
+            const int last = qMin(first + ChartSeriesIndex::BlockSize, size);
+
+            double minimum = series->sample(first).y();
+            double maximum = minimum;
+            for(int i = first + 1; i < last; ++i) {
+                const double y = series->sample(i).y();
+                minimum = qMin(minimum, y);
+                maximum = qMax(maximum, y);
+            }
+
+            blockMinimum[b] = minimum;
+            blockMaximum[b] = maximum;
+        }
+
+        index->minimum.append(blockMinimum);
+        index->maximum.append(blockMaximum);
+
+        // Each following level covers twice the number of blocks
+        for(int span = 2; span <= blocks; span *= 2) {
+            const QVector<double> &lowerMinimum = index->minimum.last();
+            const QVector<double> &lowerMaximum = index->maximum.last();
+            const int count = blocks - span + 1;
+
+            QVector<double> levelMinimum(count);
+            QVector<double> levelMaximum(count);
+            for(int b = 0; b < count; ++b) {
+                levelMinimum[b] = qMin(lowerMinimum[b], lowerMinimum[b + span/2]);
+                levelMaximum[b] = qMax(lowerMaximum[b], lowerMaximum[b + span/2]);
+            }
+
+            index->minimum.append(levelMinimum);
+            index->maximum.append(levelMaximum);
+        }
+
+        index->built = true;
+        return index;
+    }
+
+    /*!
+     * \brief Returns the samples of the curve as separate arrays.
+     *
+     * When the curve holds its samples in arrays (as waveforms loaded from
+     * simulations do), the arrays are shared instead of copied.
+     */
+    void ChartSeries::samples(QVector<double> *x, QVector<double> *y) const
+    {
+        const QwtPointArrayData *arrayData = dynamic_cast<const QwtPointArrayData*>(data());
+        if(arrayData) {
+            *x = arrayData->xData();
+            *y = arrayData->yData();
+            return;
+        }
+
+        const ComplexSeriesData *complexData = dynamic_cast<const ComplexSeriesData*>(data());
+        if(complexData) {
+            *x = complexData->xData();
+            *y = complexData->yData();
+            return;
+        }
+
+        const int size = static_cast<int>(dataSize());
+        x->resize(size);
+        y->resize(size);
+        for(int i = 0; i < size; ++i) {
+            const QPointF point = sample(i);
+            (*x)[i] = point.x();
+            (*y)[i] = point.y();
+        }
+    }
+
+    /*!
+     * \brief Returns the index of the first sample whose abscissa is not
+     * less than \a x, or the number of samples if there is no such sample.
+     *
+     * The lookup is a binary search over the (monotonic) abscissa, so its
+     * cost is logarithmic in the number of samples.
+     */
+    int ChartSeries::lowerBound(double x) const
+    {
+        const QwtSeriesData<QPointF> *series = data();
+
+        int first = 0;
+        int count = static_cast<int>(series->size());
+
+        while(count > 0) {
+            const int step = count / 2;
+            const int middle = first + step;
+
+            if(series->sample(middle).x() < x) {
+                first = middle + 1;
+                count -= step + 1;
+            }
+            else {
+                count = step;
+            }
+        }
+
+        return first;
+    }
+
+    /*!
+     * \brief Returns the value of the curve at abscissa \a x.
+     *
+     * The value is linearly interpolated between the two nearest samples.
+     * Outside the range of the curve the first or last value is returned.
+     */
+    double ChartSeries::valueAt(double x) const
+    {
+        const QwtSeriesData<QPointF> *series = data();
+        const int size = static_cast<int>(series->size());
+
+        if(size == 0) {
+            return 0;
+        }
+
+        const int i = lowerBound(x);
+        if(i == 0) {
+            return series->sample(0).y();
+        }
+        if(i == size) {
+            return series->sample(size - 1).y();
+        }
+
+        const QPointF p1 = series->sample(i - 1);
+        const QPointF p2 = series->sample(i);
+        if(p2.x() == p1.x()) {
+            return p2.y();
+        }
+
+        return p1.y() + (p2.y() - p1.y()) * (x - p1.x()) / (p2.x() - p1.x());
+    }
+
+    /*!
+     * \brief Returns the minimum, maximum, mean and rms values of the curve
+     * between abscissas \a x1 and \a x2.
+     *
+     * The mean and rms values are integrals over the abscissa (and not plain
+     * sample averages), to avoid biasing the results towards the regions
+     * where the simulator took smaller time steps. The range is clipped to
+     * the extent of the curve, and values at the range ends are
+     * interpolated.
+     *
+     * The first call builds the index of the curve (see builtIndex()), in
+     * linear time. From then on the cost of this method is logarithmic in
+     * the number of samples, due to the lookup of the range ends. Without
+     * an index the samples in the range are scanned.
+     */
+    ChartSeriesStatistics ChartSeries::statistics(double x1, double x2) const
     {
+        ChartSeriesStatistics result;
+        result.minimum = result.maximum = result.average = result.rms = 0;
+
+        const QwtSeriesData<QPointF> *series = data();
+        const int size = static_cast<int>(series->size());
+        if(size == 0) {
+            return result;
+        }
+
+        // Clip and order the range
+        const double xMin = series->sample(0).x();
+        const double xMax = series->sample(size - 1).x();
+        if(x1 > x2) {
+            qSwap(x1, x2);
+        }
+        x1 = qBound(xMin, x1, xMax);
+        x2 = qBound(xMin, x2, xMax);
+
+        const double v1 = valueAt(x1);
+        const double v2 = valueAt(x2);
+
+        // Samples strictly inside the range
+        const int first = lowerBound(x1);
+        int last = lowerBound(x2) - 1;
+        if(last + 1 < size && series->sample(last + 1).x() == x2) {
+            ++last;
+        }
+
+        result.minimum = qMin(v1, v2);
+        result.maximum = qMax(v1, v2);
+
+        double sum = 0;
+        double sumSquares = 0;
+
+        if(first > last) {
+            // Both range ends fall between the same two samples
+            sum = 0.5 * (v1 + v2) * (x2 - x1);
+            sumSquares = 0.5 * (v1 * v1 + v2 * v2) * (x2 - x1);
+        }
+        else {
+            const QPointF p1 = series->sample(first);
+            const QPointF p2 = series->sample(last);
+
+            const ChartSeriesIndex *index = builtIndex();
+
+            double minimum, maximum;
+            rangeExtremes(first, last, &minimum, &maximum);
+            result.minimum = qMin(result.minimum, minimum);
+            result.maximum = qMax(result.maximum, maximum);
+
+            // Partial intervals at both ends of the range
+            sum = 0.5 * (v1 + p1.y()) * (p1.x() - x1) +
+                  0.5 * (p2.y() + v2) * (x2 - p2.x());
+            sumSquares = 0.5 * (v1 * v1 + p1.y() * p1.y()) * (p1.x() - x1) +
+                         0.5 * (p2.y() * p2.y() + v2 * v2) * (x2 - p2.x());
+
+            if(index) {
+                sum += index->integral[last] - index->integral[first];
+                sumSquares += index->integralSquares[last] - index->integralSquares[first];
+            }
+            else {
+                for(int i = first + 1; i <= last; ++i) {
+                    const QPointF a = series->sample(i - 1);
+                    const QPointF b = series->sample(i);
+                    sum += 0.5 * (a.y() + b.y()) * (b.x() - a.x());
+                    sumSquares += 0.5 * (a.y() * a.y() + b.y() * b.y()) * (b.x() - a.x());
+                }
+            }
+        }
+
+        if(x2 > x1) {
+            result.average = sum / (x2 - x1);
+            result.rms = qSqrt(qMax(0.0, sumSquares / (x2 - x1)));
+        }
+        else {
+            result.average = v1;
+            result.rms = qAbs(v1);
+        }
+
+        return result;
+    }
+
+    /*!
+     * \brief Computes the extreme values of the samples \a first to \a last
+     * (both included).
+     *
+     * Only the partial blocks at both ends are scanned, the whole blocks in
+     * between are looked up in the sparse tables of the index.
+     */
+    void ChartSeries::rangeExtremes(int first, int last, double *minimum, double *maximum) const
+    {
+        const QwtSeriesData<QPointF> *series = data();
+        const int blockSize = ChartSeriesIndex::BlockSize;
+
+        *minimum = *maximum = series->sample(first).y();
+
+        int firstBlock = first / blockSize + 1;  // First whole block
+        int lastBlock = last / blockSize - 1;    // Last whole block
+        if(last % blockSize == blockSize - 1 || last == static_cast<int>(series->size()) - 1) {
+            ++lastBlock;
+        }
+        if(first % blockSize == 0) {
+            --firstBlock;
+        }
+
+        if(!m_index || !m_index->built || firstBlock > lastBlock) {
+            for(int i = first + 1; i <= last; ++i) {
+                const double y = series->sample(i).y();
+                *minimum = qMin(*minimum, y);
+                *maximum = qMax(*maximum, y);
+            }
+            return;
+        }
+
+        // Partial blocks at both ends
+        for(int i = first + 1; i < firstBlock * blockSize; ++i) {
+            const double y = series->sample(i).y();
+            *minimum = qMin(*minimum, y);
+            *maximum = qMax(*maximum, y);
+        }
+        for(int i = (lastBlock + 1) * blockSize; i <= last; ++i) {
+            const double y = series->sample(i).y();
+            *minimum = qMin(*minimum, y);
+            *maximum = qMax(*maximum, y);
+        }
+
+        // Whole blocks, covered by two (possibly overlapping) table entries
+        int level = 0;
+        while((2 << level) <= lastBlock - firstBlock + 1) {
+            ++level;
+        }
+        const int second = lastBlock - (1 << level) + 1;
+
+        *minimum = qMin(*minimum, qMin(m_index->minimum[level][firstBlock], m_index->minimum[level][second]));
+        *maximum = qMax(*maximum, qMax(m_index->maximum[level][firstBlock], m_index->maximum[level][second]));
     }
 
 } // namespace Caneda
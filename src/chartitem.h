@@ -20,17 +20,194 @@
 #ifndef CHART_ITEM_H
 #define CHART_ITEM_H
 
+#include <QExplicitlySharedDataPointer>
+#include <QMutex>
+#include <QSharedData>
+#include <QSharedPointer>
 #include <QString>
+#include <QVector>
 
 #include <qwt_plot_curve.h>
 
 namespace Caneda
 {
+    /*!
+     * \brief Statistics of a waveform between two abscissa values.
+     *
+     * \sa ChartSeries::statistics()
+     */
+    struct ChartSeriesStatistics
+    {
+        double minimum;  //! \brief Minimum value in the range
+        double maximum;  //! \brief Maximum value in the range
+        double average;  //! \brief Mean value in the range (integral / span)
+        double rms;      //! \brief Root mean square value in the range
+    };
+
+    /*!
+     * \brief Lookup tables built once per waveform to answer range queries.
+     *
+     * The running integrals hold the trapezoidal integral of y and y^2 from
+     * the first sample up to each sample, so the mean and rms value between
+     * any two samples are obtained with a subtraction. Minimum and maximum
+     * values are kept per block of samples, with a sparse table on top of
+     * the blocks, so a range query only scans the two partial blocks at its
+     * ends.
+     *
+     * The index is shared among all the curves created from the same
+     * waveform (for example in split views). It is created empty when the
+     * samples are set, and the tables are filled by the first range query
+     * on any of those curves, so waveforms that are never measured do not
+     * pay for them. The tables are never modified once built.
+     *
+     * \sa ChartSeries::updateIndex(), ChartSeries::statistics()
+     */
+    class ChartSeriesIndex : public QSharedData
+    {
+    public:
+        ChartSeriesIndex() : built(false) {}
+
+        //! \brief Number of samples summarized by each min/max block
+        static const int BlockSize = 1024;
+
+        bool built;    //! \brief True once the tables below are filled
+        QMutex mutex;  //! \brief Serializes the build of the tables
+
+        QVector<double> integral;         //! \brief Running integral of y
+        QVector<double> integralSquares;  //! \brief Running integral of y^2
+        QVector<QVector<double> > minimum;  //! \brief Sparse table of block minimums
+        QVector<QVector<double> > maximum;  //! \brief Sparse table of block maximums
+    };
+
+    /*!
+     * \brief Series data of one component of a complex (AC) waveform.
+     *
+     * AC simulations produce complex values, from which several traces may
+     * be plotted: magnitude, phase, group delay, etc. The raw real and
+     * imaginary parts are stored once per waveform, implicitly shared among
+     * all its components, and each component is computed only when first
+     * requested (usually, when the trace is shown for the first time). The
+     * real and imaginary components use the raw data directly.
+     *
+     * \sa ChartSeries, FormatRawSimulation
+     */
+    class ComplexSeriesData : public QwtSeriesData<QPointF>
+    {
+    public:
+        //! \brief Components of the complex waveform
+        enum Component {
+            Magnitude,       //! \brief Linear magnitude
+            MagnitudeDb,     //! \brief Magnitude in dB (20*log10)
+            Phase,           //! \brief Phase in degrees (-180, 180]
+            UnwrappedPhase,  //! \brief Continuous phase in degrees
+            GroupDelay,      //! \brief Group delay in seconds
+            Real,            //! \brief Real part
+            Imaginary        //! \brief Imaginary part
+        };
+
+        ComplexSeriesData(const QVector<double> &frequency,
+                          const QVector<double> &real,
+                          const QVector<double> &imaginary,
+                          Component component);
+
+        virtual size_t size() const { return m_frequency.size(); }
+        virtual QPointF sample(size_t i) const;
+        virtual QRectF boundingRect() const;
+
+        //! \brief Returns the frequency of each sample
+        const QVector<double>& xData() const { return m_frequency; }
+        const QVector<double>& yData() const;
+
+        ComplexSeriesData* component(Component component) const;
+
+    private:
+        void evaluate() const;
+
+        QVector<double> m_frequency;
+        QVector<double> m_real;
+        QVector<double> m_imaginary;
+        Component m_component;
+
+        mutable bool m_evaluated;
+        mutable QVector<double> m_values;  //! \brief Computed component values
+    };
+
+    /*!
+     * \brief Append-only storage of the samples of a growing waveform.
+     *
+     * Samples are stored in fixed size chunks, so appending a sample never
+     * moves the samples already stored: the cost of an append is constant
+     * (only the small table of chunks is occasionally reallocated), and
+     * memory grows smoothly while a simulation is running.
+     *
+     * \sa StreamingSeriesData, SimulationStream
+     */
+    class ChartSampleBuffer
+    {
+    public:
+        ChartSampleBuffer();
+        ~ChartSampleBuffer();
+
+        //! \brief Returns the number of samples stored
+        int size() const { return m_size; }
+        //! \brief Returns the sample at position \a i
+        double at(int i) const { return m_chunks.at(i >> ChunkBits)[i & (ChunkSize - 1)]; }
+        void append(double value);
+
+        QVector<double> toVector() const;
+
+    private:
+        Q_DISABLE_COPY(ChartSampleBuffer)
+
+        static const int ChunkBits = 12;
+        static const int ChunkSize = 1 << ChunkBits;
+
+        QVector<double*> m_chunks;
+        int m_size;
+    };
+
+    /*!
+     * \brief Series data of a waveform being received from a running
+     * simulation.
+     *
+     * Samples are appended to the (shared) buffers by the simulation
+     * stream, and made visible to the plot with update(). The bounding
+     * rectangle is extended only with the new samples, so the cost of an
+     * update is proportional to the number of samples added.
+     *
+     * \sa ChartSampleBuffer, ChartView::appendSamples()
+     */
+    class StreamingSeriesData : public QwtSeriesData<QPointF>
+    {
+    public:
+        StreamingSeriesData(QSharedPointer<ChartSampleBuffer> x,
+                            QSharedPointer<ChartSampleBuffer> y);
+
+        virtual size_t size() const { return m_size; }
+        virtual QPointF sample(size_t i) const;
+        virtual QRectF boundingRect() const { return d_boundingRect; }
+
+        void update();
+
+    private:
+        QSharedPointer<ChartSampleBuffer> m_x;
+        QSharedPointer<ChartSampleBuffer> m_y;
+        int m_size;  //! \brief Number of samples published to the plot
+    };
+
     /*!
      * \brief This class extends the QwtPlotCurve class, providing some
      * special properties needed for Caneda.
      *
-     * \sa QwtPlotCurve
+     * Besides the type of curve, waveforms provide sample lookup and range
+     * statistics used by the measurement cursors. The abscissa (time or
+     * frequency) is assumed to be monotonically increasing, as it is in
+     * simulation results, which allows using binary searches.
+     *
+     * The runs of a parameter sweep are plotted as families of curves (see
+     * family()), drawn with one shared translucent color per family.
+     *
+     * \sa QwtPlotCurve, ChartSeriesIndex
      */
     class ChartSeries : public QwtPlotCurve
     {
@@ -42,8 +219,31 @@ namespace Caneda
         //! \brief Sets the type of curve
         void setType(const QString& type) { m_type = type; }
 
+        //! \brief Returns the family (parameter sweep output) of the curve, or -1
+        int family() const { return m_family; }
+        //! \brief Groups the curve with the other runs of a parameter sweep
+        void setFamily(int family) { m_family = family; }
+
+        void updateIndex();
+        static void updateIndexes(QList<ChartSeries*> curves);
+        //! \brief Returns the lookup tables of this curve
+        QExplicitlySharedDataPointer<ChartSeriesIndex> index() const { return m_index; }
+        //! \brief Shares the lookup tables of another curve with the same data
+        void setIndex(QExplicitlySharedDataPointer<ChartSeriesIndex> index) { m_index = index; }
+
+        void samples(QVector<double> *x, QVector<double> *y) const;
+
+        int lowerBound(double x) const;
+        double valueAt(double x) const;
+        ChartSeriesStatistics statistics(double x1, double x2) const;
+
     private:
+        ChartSeriesIndex* builtIndex() const;
+        void rangeExtremes(int first, int last, double *minimum, double *maximum) const;
+
         QString m_type;  //! \brief Type of curve (voltage, current, etc)
+        int m_family;    //! \brief Sweep family of the curve, -1 if none
+        QExplicitlySharedDataPointer<ChartSeriesIndex> m_index;  //! \brief Range query tables
     };
 
 } // namespace Caneda
@@ -39,4 +39,13 @@ namespace Caneda
         m_items.append(item);
     }
 
+    /*!
+     * \brief Removes the item from this scene. The ownership of the item is
+     * passed on to the caller.
+     */
+    void ChartScene::removeItem(ChartSeries *item)
+    {
+        m_items.removeAll(item);
+    }
+
 } // namespace Caneda
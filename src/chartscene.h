@@ -48,6 +48,7 @@ namespace Caneda
         //! \brief Returns a list of all items in the scene in descending stacking
         QList<ChartSeries*> items() const { return m_items; }
         void addItem(ChartSeries *item);
+        void removeItem(ChartSeries *item);
 
     private:
         QList<ChartSeries*> m_items;  //! \brief Items available in the scene (curves, markers, etc)
@@ -20,16 +20,23 @@
 #include "chartview.h"
 
 #include "actionmanager.h"
+#include "chartitem.h"
 #include "chartsdialog.h"
 #include "chartscene.h"
 #include "settings.h"
+#include "waveformexpression.h"
 
+#include <QHash>
 #include <QMenu>
 #include <QMouseEvent>
+#include <QPainter>
+#include <QRegularExpression>
+#include <QTimer>
 
 #include <qwt_legend.h>
 #include <qwt_plot_canvas.h>
 #include <qwt_plot_curve.h>
+#include <qwt_plot_directpainter.h>
 #include <qwt_plot_grid.h>
 #include <qwt_plot_panner.h>
 #include <qwt_plot_renderer.h>
@@ -38,6 +45,9 @@
 
 namespace Caneda
 {
+    //! \brief Maximum frame rate of the waveforms of a running simulation
+    static const int maxFrameRate = 25;
+
     /*************************************************************************
      *                           CPlotMagnifier                              *
      *************************************************************************/
@@ -60,6 +70,57 @@ namespace Caneda
     }
 
 
+    /*************************************************************************
+     *                          PlotCursorOverlay                            *
+     *************************************************************************/
+    //! \brief Constructor
+    PlotCursorOverlay::PlotCursorOverlay(ChartView *view, QWidget *canvas) :
+        QwtWidgetOverlay(canvas),
+        m_view(view)
+    {
+    }
+
+    //! \brief Draws the visible cursors as vertical lines with their names.
+    void PlotCursorOverlay::drawOverlay(QPainter *painter) const
+    {
+        QColor foregroundColor = Settings::instance()->currentValue("gui/foregroundColor").value<QColor>();
+        painter->setPen(QPen(foregroundColor, 1, Qt::DashLine));
+
+        for(int i = ChartView::CursorA; i <= ChartView::CursorB; ++i) {
+            ChartView::Cursor cursor = static_cast<ChartView::Cursor>(i);
+            if(!m_view->isCursorVisible(cursor)) {
+                continue;
+            }
+
+            int x = qRound(m_view->transform(QwtPlot::xBottom, m_view->cursorPosition(cursor)));
+            painter->drawLine(x, 0, x, height());
+            painter->drawText(x + 3, fontMetrics().ascent() + 2,
+                              cursor == ChartView::CursorA ? "A" : "B");
+        }
+    }
+
+    //! \brief Restricts the overlay to the cursor lines and labels.
+    QRegion PlotCursorOverlay::maskHint() const
+    {
+        QRegion region;
+        int labelWidth = fontMetrics().width("B") + 4;
+        int labelHeight = fontMetrics().height() + 4;
+
+        for(int i = ChartView::CursorA; i <= ChartView::CursorB; ++i) {
+            ChartView::Cursor cursor = static_cast<ChartView::Cursor>(i);
+            if(!m_view->isCursorVisible(cursor)) {
+                continue;
+            }
+
+            int x = qRound(m_view->transform(QwtPlot::xBottom, m_view->cursorPosition(cursor)));
+            region += QRect(x - 1, 0, 3, height());
+            region += QRect(x, 0, labelWidth + 3, labelHeight);
+        }
+
+        return region;
+    }
+
+
     /*************************************************************************
      *                              ChartView                                *
      *************************************************************************/
@@ -72,6 +133,9 @@ namespace Caneda
     ChartView::ChartView(ChartScene *scene, QWidget *parent) :
         QwtPlot(parent),
         m_chartScene(scene),
+        m_replotPending(false),
+        m_framePending(false),
+        m_drawnSamples(0),
         m_logXaxis(false),
         m_logYleftAxis(false),
         m_logYrightAxis(false)
@@ -81,6 +145,21 @@ namespace Caneda
         m_canvas->setFrameStyle(QFrame::StyledPanel | QFrame::Plain);
         setCanvas(m_canvas);
 
+        // Measurement cursors overlay
+        m_cursorVisible[CursorA] = m_cursorVisible[CursorB] = false;
+        m_cursorPosition[CursorA] = m_cursorPosition[CursorB] = 0;
+        m_cursorOverlay = new PlotCursorOverlay(this, m_canvas);
+
+        // Painter used to draw single waveforms without a full replot
+        m_directPainter = new QwtPlotDirectPainter(this);
+        m_directPainter->setAttribute(QwtPlotDirectPainter::CopyBackingStore, true);
+
+        // Frame rate limit of the waveforms received from a running simulation
+        m_frameTimer = new QTimer(this);
+        m_frameTimer->setSingleShot(true);
+        m_frameTimer->setInterval(1000 / maxFrameRate);
+        connect(m_frameTimer, SIGNAL(timeout()), this, SLOT(drawAppendedSamples()));
+
         // Panning with the middle mouse button
         QwtPlotPanner *panner = new QwtPlotPanner(m_canvas);
         panner->setMouseButton(Qt::MidButton);
@@ -96,6 +175,10 @@ namespace Caneda
         m_zoomer->setMousePattern(QwtEventPattern::MouseSelect2, Qt::NoButton); // Disable default right button action
         m_zoomer->setMousePattern(QwtEventPattern::MouseSelect3, Qt::NoButton); // Disable default middle button action
 
+        // Measurement cursors with Ctrl/Shift + left button. The filter is
+        // installed last to see the canvas events before the zoomer.
+        m_canvas->installEventFilter(this);
+
         // Grid
         m_grid = new QwtPlotGrid();
         m_grid->enableXMin(true);
@@ -136,6 +219,23 @@ namespace Caneda
         m_zoomer->zoom(0);
     }
 
+    //! \brief Selects the color of the next curve, changing from curve to curve.
+    static void nextColor(int *colorIndex, int *valueIndex)
+    {
+        if(*colorIndex < 300) {  // Avoid 360, as it equals 0
+            *colorIndex += 60;
+        }
+        else {
+            *colorIndex = 0;
+            if(*valueIndex == 255) {
+                *valueIndex = 100;
+            }
+            else {
+                *valueIndex = 255;
+            }
+        }
+    }
+
     //! \brief Adds all items available in the scene to the plot widget.
     void ChartView::populate()
     {
@@ -144,19 +244,31 @@ namespace Caneda
         QColor color = QColor(0, 0, 0);
         int colorIndex= 0;
         int valueIndex = 255;
+        int family = -1;
 
         // Attach the items to the plot
         foreach(ChartSeries *item, m_items) {
-            // Recreate the curve to be able to attach
-            // the same curve to different views
-            ChartSeries *newCurve = new ChartSeries();
-            newCurve->setData(item->data());
-            newCurve->setTitle(item->title());
-            newCurve->attach(this);
-
-            // Set the correct axis depending on the curve magnitude
-            if(item->type() == "current" || item->type() == "phase") {
-                newCurve->setYAxis(yRight);
+            ChartSeries *newCurve = createCurve(item);
+
+            // The runs of a sweep share one translucent color, without
+            // antialiasing as there may be hundreds of them overlaid. Only
+            // the first run of each family is shown in the legend.
+            if(item->family() >= 0) {
+                if(family >= 0 && item->family() != family) {
+                    nextColor(&colorIndex, &valueIndex);
+                }
+                if(item->family() == family) {
+                    newCurve->setItemAttribute(QwtPlotItem::Legend, false);
+                }
+                family = item->family();
+
+                color.setHsv(colorIndex , 200, valueIndex, 96);
+                newCurve->setPen(QPen(color));
+                continue;
+            }
+            if(family >= 0) {
+                nextColor(&colorIndex, &valueIndex);
+                family = -1;
             }
 
             // Select the style and color of the new curve
@@ -178,18 +290,7 @@ namespace Caneda
 
             // Set the next color to be used (to change colors
             // from curve to curve.
-            if(colorIndex < 300) {  // Avoid 360, as it equals 0
-                colorIndex += 60;
-            }
-            else {
-                colorIndex = 0;
-                if(valueIndex == 255) {
-                    valueIndex = 100;
-                }
-                else {
-                    valueIndex = 255;
-                }
-            }
+            nextColor(&colorIndex, &valueIndex);
         }
 
         // Set different axis titles depending on the type of simulation,
@@ -217,6 +318,258 @@ namespace Caneda
         m_zoomer->setZoomBase();
     }
 
+    /*!
+     * \brief Updates the curves of this view after the scene was reloaded.
+     *
+     * The curves keep their pen, visibility and axis, and only the series
+     * data they display is swapped for the reloaded one. Curves whose data
+     * was not reloaded are removed, and curves added to the scene are
+     * attached. The derived traces are compiled again over the new data.
+     *
+     * The zoom and the measurement cursors are kept. If the view shows the
+     * complete waveforms (the axes are autoscaled), the zoom base is set to
+     * the new waveforms extent.
+     *
+     * \param replaced Scene curves holding new data, by their previous data.
+     * \param added Curves added to the scene.
+     *
+     * \sa SimulationDocument::replaceCurves()
+     */
+    void ChartView::reloadCurves(const QHash<const QwtSeriesData<QPointF>*, ChartSeries*> &replaced,
+                                 const QList<ChartSeries*> &added)
+    {
+        QList<ChartSeries*> derivedTraces = m_derivedTraces.values();
+
+        QwtPlotItemList list = itemList(QwtPlotItem::Rtti_PlotCurve);
+        foreach(QwtPlotItem *item, list) {
+            ChartSeries *curve = static_cast<ChartSeries*>(item);
+            if(derivedTraces.contains(curve)) {
+                continue;
+            }
+
+            // The data is owned by the scene curves, and must not be
+            // deleted with the curves of the view
+            ChartSeries *sceneCurve = replaced.value(curve->data());
+            if(sceneCurve) {
+                curve->swapData(sceneCurve->data());
+                curve->setIndex(sceneCurve->index());
+            }
+            else {
+                curve->swapData(0);
+                delete curve;
+            }
+        }
+
+        QColor color;
+        int colorIndex = list.size();
+        foreach(ChartSeries *item, added) {
+            ChartSeries *curve = createCurve(item);
+            curve->setRenderHint(ChartSeries::RenderAntialiased);
+            color.setHsv((60 * colorIndex++) % 360, 200, 255);
+            curve->setPen(QPen(color));
+        }
+
+        // Compile the derived traces again, as the waveforms they reference
+        // may have changed
+        compileDerivedTraces();
+
+        // The samples drawn by a previous stream are replaced
+        m_drawnSamples = 0;
+
+        bool zoomBase = m_zoomer->zoomRectIndex() == 0 && axisAutoScale(xBottom);
+
+        replot();
+
+        if(zoomBase) {
+            m_zoomer->setZoomBase();
+        }
+    }
+
+    /*!
+     * \brief Compiles the derived traces again over the current waveforms.
+     *
+     * Traces whose expression no longer compiles (for example, because a
+     * waveform they reference is gone) are removed.
+     *
+     * \sa addDerivedTrace()
+     */
+    void ChartView::compileDerivedTraces()
+    {
+        QList<ChartSeries*> curves = m_chartScene->items();
+        curves << m_derivedTraces.values();
+
+        QMap<QString, ChartSeries*>::iterator it = m_derivedTraces.begin();
+        while(it != m_derivedTraces.end()) {
+            QString type;
+            QwtSeriesData<QPointF> *data = complexComponentData(it.key(), &type);
+            if(!data) {
+                WaveformExpression *compiled = new WaveformExpression;
+                if(compiled->compile(it.key(), curves)) {
+                    data = new WaveformExpressionData(compiled);
+                }
+                else {
+                    delete compiled;
+                }
+            }
+
+            if(data) {
+                it.value()->setData(data);
+                ++it;
+            }
+            else {
+                delete it.value();
+                it = m_derivedTraces.erase(it);
+            }
+        }
+    }
+
+    /*!
+     * \brief Adds a trace computed from an expression over the waveforms.
+     *
+     * The expression is compiled here, but only evaluated the first time
+     * the trace is drawn. The result is then cached in the trace for the
+     * lifetime of this view, and adding the same expression again only
+     * shows the existing trace.
+     *
+     * The components of complex (ac) waveforms not loaded as curves are
+     * also plotted as derived traces, for example Re(v(out)) (see
+     * complexComponentData()).
+     *
+     * \param expression Expression to plot, for example v(out)-v(in).
+     * \param errorMessage If not null, set to a description of the error on
+     * failure.
+     * \return True on success, false if the expression is not valid.
+     *
+     * \sa WaveformExpression
+     */
+    bool ChartView::addDerivedTrace(const QString &expression, QString *errorMessage)
+    {
+        const QString key = expression.simplified();
+
+        if(m_derivedTraces.contains(key)) {
+            m_derivedTraces[key]->setVisible(true);
+            replot();
+            return true;
+        }
+
+        QString type;
+        QwtSeriesData<QPointF> *data = complexComponentData(key, &type);
+        if(!data) {
+            // Derived traces may reference previously derived traces too
+            QList<ChartSeries*> curves = m_chartScene->items();
+            curves << m_derivedTraces.values();
+
+            WaveformExpression *compiled = new WaveformExpression;
+            if(!compiled->compile(key, curves, errorMessage)) {
+                delete compiled;
+                return false;
+            }
+
+            type = compiled->type();
+            data = new WaveformExpressionData(compiled);
+        }
+
+        ChartSeries *curve = new ChartSeries(key);
+        curve->setType(type);
+        curve->setData(data);
+        curve->setRenderHint(ChartSeries::RenderAntialiased);
+
+        if(curve->type() == "current" || curve->type() == "phase") {
+            curve->setYAxis(yRight);
+        }
+
+        QColor color;
+        color.setHsv((30 + 60 * m_derivedTraces.size()) % 360, 255, 200);
+        curve->setPen(QPen(color, 0, Qt::DashDotLine));
+
+        curve->attach(this);
+        m_derivedTraces.insert(key, curve);
+
+        replot();
+        return true;
+    }
+
+    /*!
+     * \brief Creates the data of a component of a complex (ac) waveform.
+     *
+     * Only the magnitude and phase of complex waveforms are loaded as
+     * curves (see FormatRawSimulation::addComplexCurves()). The rest of
+     * their components are created here when plotted, sharing the raw data
+     * of the magnitude curve: Abs (linear magnitude), UPhase (unwrapped
+     * phase), GD (group delay), Re (real part) and Im (imaginary part).
+     *
+     * \param name Name of the component, for example Re(v(out)).
+     * \param type Set to the type of the new trace.
+     * \return The new data, or 0 if \a name is not a component of a complex
+     * waveform of the scene.
+     */
+    QwtSeriesData<QPointF>* ChartView::complexComponentData(const QString &name, QString *type) const
+    {
+        static const QRegularExpression re("^(abs|uphase|gd|re|im)\\((.+)\\)$",
+                                           QRegularExpression::CaseInsensitiveOption);
+
+        QRegularExpressionMatch match = re.match(name);
+        if(!match.hasMatch()) {
+            return 0;
+        }
+
+        const QString function = match.captured(1).toLower();
+        ComplexSeriesData::Component component = ComplexSeriesData::Magnitude;
+        if(function == "uphase") {
+            component = ComplexSeriesData::UnwrappedPhase;
+        }
+        else if(function == "gd") {
+            component = ComplexSeriesData::GroupDelay;
+        }
+        else if(function == "re") {
+            component = ComplexSeriesData::Real;
+        }
+        else if(function == "im") {
+            component = ComplexSeriesData::Imaginary;
+        }
+
+        const QString magnitude = "Mag(" + match.captured(2) + ")";
+        foreach(ChartSeries *curve, m_chartScene->items()) {
+            if(curve->title().text().compare(magnitude, Qt::CaseInsensitive) != 0) {
+                continue;
+            }
+
+            const ComplexSeriesData *data = dynamic_cast<const ComplexSeriesData*>(curve->data());
+            if(!data) {
+                return 0;
+            }
+
+            *type = (component == ComplexSeriesData::UnwrappedPhase) ? "phase" : "component";
+            return data->component(component);
+        }
+
+        return 0;
+    }
+
+    /*!
+     * \brief Attaches a copy of the scene curve \a item to this view.
+     *
+     * The curve is recreated to be able to attach the same curve to
+     * different views. The series data is shared with the scene curve.
+     */
+    ChartSeries* ChartView::createCurve(ChartSeries *item)
+    {
+        ChartSeries *newCurve = new ChartSeries();
+        newCurve->setData(item->data());
+        newCurve->setIndex(item->index());
+        newCurve->setTitle(item->title());
+        newCurve->setFamily(item->family());
+        newCurve->setVisible(item->isVisible());
+        newCurve->attach(this);
+
+        // Set the correct axis depending on the curve magnitude
+        if(item->type() == "current" || item->type() == "phase") {
+            newCurve->setYAxis(yRight);
+        }
+
+        return newCurve;
+    }
+
     /*!
      * \brief Set axis scale logarithmic state.
      *
@@ -309,6 +662,241 @@ namespace Caneda
         renderer.renderTo(this, device);
     }
 
+    /*!
+     * \brief Places a measurement cursor.
+     *
+     * \param cursor Cursor to be placed.
+     * \param x Abscissa (time or frequency) of the cursor.
+     *
+     * \sa cursorPosition(), clearCursors()
+     */
+    void ChartView::setCursorPosition(Cursor cursor, double x)
+    {
+        m_cursorVisible[cursor] = true;
+        m_cursorPosition[cursor] = x;
+
+        m_cursorOverlay->updateOverlay();
+        emit cursorsChanged();
+    }
+
+    //! \brief Removes both measurement cursors from the plot.
+    void ChartView::clearCursors()
+    {
+        m_cursorVisible[CursorA] = m_cursorVisible[CursorB] = false;
+
+        m_cursorOverlay->updateOverlay();
+        emit cursorsChanged();
+    }
+
+    /*!
+     * \brief Shows or hides a single waveform.
+     *
+     * When showing a waveform that fits in the current axes, only that
+     * waveform is drawn on top of the canvas, avoiding the replot of all
+     * the other visible waveforms. Otherwise (hiding a waveform or
+     * rescaling the axes) a replot is scheduled.
+     *
+     * \sa scheduleReplot()
+     */
+    void ChartView::setCurveVisible(ChartSeries *curve, bool visible)
+    {
+        curve->setVisible(visible);
+
+        if(!visible || m_replotPending || curve->dataSize() == 0) {
+            scheduleReplot();
+            return;
+        }
+
+        const QRectF bounds = curve->boundingRect();
+        const QwtInterval xInterval = axisInterval(curve->xAxis());
+        const QwtInterval yInterval = axisInterval(curve->yAxis());
+
+        if(!xInterval.contains(bounds.left()) || !xInterval.contains(bounds.right()) ||
+                !yInterval.contains(bounds.top()) || !yInterval.contains(bounds.bottom())) {
+            scheduleReplot();
+            return;
+        }
+
+        m_directPainter->drawSeries(curve, 0, static_cast<int>(curve->dataSize()) - 1);
+        m_cursorOverlay->updateOverlay();
+    }
+
+    /*!
+     * \brief Draws the samples appended to the waveforms of a running
+     * simulation.
+     *
+     * Samples may arrive at any rate, but they are drawn at most
+     * maxFrameRate times per second: samples arriving during a frame are
+     * drawn together when it ends.
+     *
+     * \sa SimulationStream, finishStreaming()
+     */
+    void ChartView::appendSamples()
+    {
+        if(m_frameTimer->isActive()) {
+            m_framePending = true;
+            return;
+        }
+
+        m_framePending = true;
+        drawAppendedSamples();
+    }
+
+    /*!
+     * \brief Rescales the view to show the complete waveforms once the
+     * simulation finished.
+     *
+     * The lookup tables built by the stream are shared with the curves of
+     * this view, and the derived traces are computed again over the
+     * complete waveforms. Unless the user zoomed in, the view is rescaled
+     * and the current scale is set as the zoom base.
+     */
+    void ChartView::finishStreaming()
+    {
+        m_frameTimer->stop();
+        m_framePending = false;
+        m_drawnSamples = 0;
+
+        QHash<const QwtSeriesData<QPointF>*, ChartSeries*> sceneCurves;
+        foreach(ChartSeries *item, m_chartScene->items()) {
+            sceneCurves.insert(item->data(), item);
+        }
+
+        QwtPlotItemList list = itemList(QwtPlotItem::Rtti_PlotCurve);
+        foreach(QwtPlotItem *item, list) {
+            ChartSeries *curve = static_cast<ChartSeries*>(item);
+            ChartSeries *sceneCurve = sceneCurves.value(curve->data());
+            if(sceneCurve) {
+                curve->setIndex(sceneCurve->index());
+            }
+        }
+
+        compileDerivedTraces();
+
+        if(m_zoomer->zoomRectIndex() != 0) {
+            replot();
+            return;
+        }
+
+        setAxisAutoScale(xBottom);
+        setAxisAutoScale(yLeft);
+        setAxisAutoScale(yRight);
+        replot();
+        m_zoomer->setZoomBase();
+    }
+
+    /*!
+     * \brief Draws the streamed samples not drawn yet.
+     *
+     * Only the new segment of each visible waveform is drawn, on top of
+     * the canvas. When the new samples do not fit in the current scale the
+     * axes are extended with some headroom (doubling the time span), so the
+     * complete plot is only redrawn a logarithmic number of times.
+     */
+    void ChartView::drawAppendedSamples()
+    {
+        if(!m_framePending) {
+            return;
+        }
+        m_framePending = false;
+
+        QList<ChartSeries*> curves;
+        int size = 0;
+
+        QwtPlotItemList list = itemList(QwtPlotItem::Rtti_PlotCurve);
+        foreach(QwtPlotItem *item, list) {
+            ChartSeries *curve = static_cast<ChartSeries*>(item);
+            if(dynamic_cast<const StreamingSeriesData*>(curve->data())) {
+                size = qMax(size, static_cast<int>(curve->dataSize()));
+                if(curve->isVisible()) {
+                    curves << curve;
+                }
+            }
+        }
+
+        if(size <= m_drawnSamples) {
+            return;
+        }
+
+        // Check if the new samples fit in the current scale. The scale is
+        // kept if the user zoomed in.
+        QwtInterval bounds[axisCnt];
+        bool fits = true;
+        foreach(ChartSeries *curve, curves) {
+            const QRectF rect = curve->boundingRect();
+            const QwtInterval xInterval = axisInterval(curve->xAxis());
+            const QwtInterval yInterval = axisInterval(curve->yAxis());
+
+            fits = fits && xInterval.contains(rect.right()) &&
+                    yInterval.contains(rect.top()) && yInterval.contains(rect.bottom());
+
+            bounds[curve->xAxis()] |= QwtInterval(rect.left(), rect.right());
+            bounds[curve->yAxis()] |= QwtInterval(rect.top(), rect.bottom());
+        }
+
+        if(m_zoomer->zoomRectIndex() == 0 && (!fits || m_replotPending || m_drawnSamples == 0)) {
+            const QwtInterval &x = bounds[xBottom];
+            if(x.width() > 0) {
+                setAxisScale(xBottom, x.minValue(), x.minValue() + 2 * x.width());
+            }
+
+            QList<int> yAxes;
+            yAxes << yLeft << yRight;
+            foreach(int axis, yAxes) {
+                const QwtInterval &y = bounds[axis];
+                if(!y.isValid()) {
+                    continue;
+                }
+                double margin = 0.25 * y.width();
+                if(margin <= 0) {
+                    margin = qMax(qAbs(y.minValue()), 1.0);  // Constant waveforms
+                }
+                setAxisScale(axis, y.minValue() - margin, y.maxValue() + margin);
+            }
+
+            replot();
+        }
+        else {
+            foreach(ChartSeries *curve, curves) {
+                m_directPainter->drawSeries(curve, qMax(m_drawnSamples - 1, 0), size - 1);
+            }
+            m_cursorOverlay->updateOverlay();
+        }
+
+        m_drawnSamples = size;
+        m_frameTimer->start();
+    }
+
+    /*!
+     * \brief Replots the view once control returns to the event loop.
+     *
+     * Several calls are coalesced into a single replot, allowing changing
+     * the visibility of many waveforms at once.
+     */
+    void ChartView::scheduleReplot()
+    {
+        if(!m_replotPending) {
+            m_replotPending = true;
+            QTimer::singleShot(0, this, SLOT(replotPending()));
+        }
+    }
+
+    //! \brief Redraws the plot, keeping the cursors in place on the new scales.
+    void ChartView::replot()
+    {
+        m_replotPending = false;
+        QwtPlot::replot();
+        m_cursorOverlay->updateOverlay();
+    }
+
+    //! \brief Performs the replot requested by scheduleReplot().
+    void ChartView::replotPending()
+    {
+        if(m_replotPending) {
+            replot();
+        }
+    }
+
     //! \copydoc GraphicsItem::launchPropertiesDialog()
     void ChartView::launchPropertiesDialog()
     {
@@ -329,6 +917,11 @@ namespace Caneda
         _menu->addAction(am->actionForName("zoomIn"));
         _menu->addAction(am->actionForName("zoomOut"));
 
+        if(m_cursorVisible[CursorA] || m_cursorVisible[CursorB]) {
+            _menu->addSeparator();
+            _menu->addAction(tr("Clear measurement cursors"), this, SLOT(clearCursors()));
+        }
+
         _menu->addSeparator();
         _menu->addAction(am->actionForName("openSchematic"));
         _menu->addAction(am->actionForName("propertiesDialog"));
@@ -336,6 +929,40 @@ namespace Caneda
         _menu->exec(QCursor::pos());
     }
 
+    /*!
+     * \brief Places and drags the measurement cursors.
+     *
+     * Canvas mouse events with the left button and the Ctrl (cursor A) or
+     * Shift (cursor B) modifier move the corresponding cursor. These events
+     * are consumed here, to avoid starting a zoom rectangle.
+     */
+    bool ChartView::eventFilter(QObject *object, QEvent *event)
+    {
+        if(object == m_canvas &&
+                (event->type() == QEvent::MouseButtonPress || event->type() == QEvent::MouseMove)) {
+
+            QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(event);
+            bool leftButton = (event->type() == QEvent::MouseButtonPress) ?
+                        mouseEvent->button() == Qt::LeftButton :
+                        mouseEvent->buttons().testFlag(Qt::LeftButton);
+
+            if(leftButton) {
+                double x = invTransform(xBottom, mouseEvent->pos().x());
+
+                if(mouseEvent->modifiers() == Qt::ControlModifier) {
+                    setCursorPosition(CursorA, x);
+                    return true;
+                }
+                else if(mouseEvent->modifiers() == Qt::ShiftModifier) {
+                    setCursorPosition(CursorB, x);
+                    return true;
+                }
+            }
+        }
+
+        return QwtPlot::eventFilter(object, event);
+    }
+
     //! \brief Update the status bar with the plot coordinates on move event.
     void ChartView::mouseMoveEvent(QMouseEvent *event)
     {
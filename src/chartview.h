@@ -20,21 +20,29 @@
 #ifndef CHART_VIEW_H
 #define CHART_VIEW_H
 
+#include <QHash>
+#include <QMap>
 #include <QtPrintSupport/QPrinter>
 
 #include <qwt_plot.h>
 #include <qwt_plot_magnifier.h>
+#include <qwt_series_data.h>
+#include <qwt_widget_overlay.h>
 
 // Forward declations
 class QwtLegend;
 class QwtPlotCanvas;
+class QwtPlotDirectPainter;
 class QwtPlotGrid;
 class QwtPlotZoomer;
+class QTimer;
 
 namespace Caneda
 {
     // Forward declations
     class ChartScene;
+    class ChartSeries;
+    class ChartView;
 
     /*!
      * \brief Reimplementation of the QwtPlotMagnifier class to allow for the
@@ -56,6 +64,28 @@ namespace Caneda
         double m_zoomFactor;
     };
 
+    /*!
+     * \brief Overlay drawing the measurement cursors of a ChartView.
+     *
+     * Cursors are drawn on a transparent widget on top of the plot canvas,
+     * so that moving them only repaints the overlay and not the (possibly
+     * very large) waveforms underneath.
+     *
+     * \sa ChartView::setCursorPosition(), QwtWidgetOverlay
+     */
+    class PlotCursorOverlay : public QwtWidgetOverlay
+    {
+    public:
+        explicit PlotCursorOverlay(ChartView *view, QWidget *canvas);
+
+    protected:
+        virtual void drawOverlay(QPainter *painter) const;
+        virtual QRegion maskHint() const;
+
+    private:
+        ChartView *m_view;
+    };
+
     /*!
      * \brief This class provides a view for displaying ChartScenes
      * (several grouped simulation waveforms).
@@ -71,6 +101,17 @@ namespace Caneda
      * multiple views associated to it, allowing the user to look at the scene
      * for example, with multiple zoom levels.
      *
+     * Each view also provides two measurement cursors, placed and dragged
+     * with Ctrl + left button (cursor A) and Shift + left button (cursor B).
+     * Readings between the cursors are obtained from the waveforms with
+     * ChartSeries::valueAt() and ChartSeries::statistics().
+     *
+     * Derived traces (see addDerivedTrace()) belong to the view, and are
+     * not shared with other views of the same scene.
+     *
+     * While a simulation is running, new samples of the waveforms are
+     * drawn incrementally (see appendSamples()) at a limited frame rate.
+     *
      * \sa ChartScene
      */
     class ChartView : public QwtPlot
@@ -80,12 +121,24 @@ namespace Caneda
     public:
         explicit ChartView(ChartScene *scene, QWidget *parent = 0);
 
+        //! \brief Measurement cursors available in each view
+        enum Cursor {
+            CursorA = 0,
+            CursorB = 1
+        };
+
         virtual void zoomIn();
         virtual void zoomOut();
         virtual void zoomFitInBest();
         virtual void zoomOriginal();
 
         void populate();
+        void reloadCurves(const QHash<const QwtSeriesData<QPointF>*, ChartSeries*> &replaced,
+                          const QList<ChartSeries*> &added);
+        void setCurveVisible(ChartSeries *curve, bool visible);
+        void appendSamples();
+        void finishStreaming();
+        bool addDerivedTrace(const QString &expression, QString *errorMessage = 0);
         void setLogAxis(QwtPlot::Axis axis, bool logarithmic);
         bool isLogAxis(QwtPlot::Axis axis);
 
@@ -94,18 +147,37 @@ namespace Caneda
         void print(QPrinter *printer, bool fitInView);
         void exportImage(QPaintDevice &device);
 
+        //! \brief Returns true if the \a cursor was placed on the plot
+        bool isCursorVisible(Cursor cursor) const { return m_cursorVisible[cursor]; }
+        //! \brief Returns the abscissa of the \a cursor
+        double cursorPosition(Cursor cursor) const { return m_cursorPosition[cursor]; }
+        void setCursorPosition(Cursor cursor, double x);
+
     public Q_SLOTS:
         void launchPropertiesDialog();
         void contextMenuEvent(const QPoint &pos);
+        void clearCursors();
+        void scheduleReplot();
+        virtual void replot();
 
     Q_SIGNALS:
         void cursorPositionChanged(const QString& newPos);
+        void cursorsChanged();
 
     protected:
+        bool eventFilter(QObject *object, QEvent *event);
         void mouseMoveEvent(QMouseEvent *event);
         void mouseDoubleClickEvent(QMouseEvent * event);
 
+    private Q_SLOTS:
+        void replotPending();
+        void drawAppendedSamples();
+
     private:
+        ChartSeries* createCurve(ChartSeries *item);
+        void compileDerivedTraces();
+        QwtSeriesData<QPointF>* complexComponentData(const QString &name, QString *type) const;
+
         ChartScene *m_chartScene;
 
         QwtPlotCanvas *m_canvas;
@@ -113,6 +185,19 @@ namespace Caneda
         QwtLegend *m_legend;
         QwtPlotZoomer *m_zoomer;
         PlotMagnifier *m_magnifier;
+        PlotCursorOverlay *m_cursorOverlay;
+        QwtPlotDirectPainter *m_directPainter;
+        bool m_replotPending;
+
+        QTimer *m_frameTimer;   //! \brief Limits the frame rate of streamed waveforms
+        bool m_framePending;    //! \brief New samples arrived during the current frame
+        int m_drawnSamples;     //! \brief Streamed samples already drawn
+
+        //! \brief Derived traces of this view, by expression
+        QMap<QString, ChartSeries*> m_derivedTraces;
+
+        bool m_cursorVisible[2];
+        double m_cursorPosition[2];
 
         bool m_logXaxis, m_logYleftAxis, m_logYrightAxis;
     };
@@ -0,0 +1,238 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+#include "clipboarddata.h"
+
+#include "component.h"
+#include "global.h"
+#include "painting.h"
+#include "portsymbol.h"
+#include "wire.h"
+#include "xmlutilities.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QStringList>
+
+namespace Caneda
+{
+    //! \brief Magic number identifying Caneda binary clipboard data.
+    static const quint32 clipboardMagic = 0x43414e44;  // "CAND"
+    //! \brief Version of the binary clipboard data layout.
+    static const quint16 clipboardFormatVersion = 1;
+
+    /*!
+     * \brief Constructs the clipboard data, cloning the given items.
+     *
+     * The items are cloned so that later modifications (or deletion, for
+     * example in a cut action) of the original items do not affect the
+     * clipboard contents.
+     *
+     * \param items Items to be copied into the clipboard.
+     */
+    ClipboardData::ClipboardData(const QList<GraphicsItem*> &items) :
+        QMimeData()
+    {
+        foreach(GraphicsItem *item, items) {
+            m_items << item->copy();
+        }
+    }
+
+    //! \brief Destructor.
+    ClipboardData::~ClipboardData()
+    {
+        qDeleteAll(m_items);
+    }
+
+    //! \brief Returns the list of formats in which the items can be retrieved.
+    QStringList ClipboardData::formats() const
+    {
+        return QStringList() << mimeType() << "text/plain";
+    }
+
+    //! \brief Returns true if the data can be retrieved as \a mimeType.
+    bool ClipboardData::hasFormat(const QString &mimeType) const
+    {
+        return formats().contains(mimeType);
+    }
+
+    //! \brief Returns the mime type of Caneda binary clipboard data.
+    QString ClipboardData::mimeType()
+    {
+        return QString("application/x-caneda-items");
+    }
+
+    /*!
+     * \brief Creates new items from a clipboard content.
+     *
+     * If the data was copied in this same process the stored items are
+     * cloned directly. Otherwise the binary format is decoded, falling back
+     * to the xml text if no Caneda binary data is found.
+     *
+     * \param mimeData Clipboard content.
+     * \return New items, owned by the caller.
+     */
+    QList<GraphicsItem*> ClipboardData::items(const QMimeData *mimeData)
+    {
+        QList<GraphicsItem*> items;
+
+        if(!mimeData) {
+            return items;
+        }
+
+        // Same process, clone the items directly
+        const ClipboardData *clipboardData = qobject_cast<const ClipboardData*>(mimeData);
+        if(clipboardData) {
+            foreach(GraphicsItem *item, clipboardData->m_items) {
+                items << item->copy();
+            }
+            return items;
+        }
+
+        // Another Caneda instance, decode the binary data
+        if(mimeData->hasFormat(mimeType())) {
+            QByteArray data = mimeData->data(mimeType());
+            QDataStream stream(&data, QIODevice::ReadOnly);
+
+            quint32 magic;
+            quint16 formatVersion;
+            QByteArray compressedXml;
+            stream >> magic >> formatVersion >> compressedXml;
+
+            if(stream.status() == QDataStream::Ok && magic == clipboardMagic &&
+                    formatVersion == clipboardFormatVersion) {
+                return itemsFromXml(qUncompress(compressedXml));
+            }
+        }
+
+        // Fallback to the xml text
+        return itemsFromXml(mimeData->text().toUtf8());
+    }
+
+    /*!
+     * \brief Generates the requested format on demand.
+     *
+     * The binary and text formats are only generated when some other process
+     * actually requests them, avoiding the serialization cost when pasting in
+     * the same process.
+     */
+    QVariant ClipboardData::retrieveData(const QString &mimeType,
+                                         QVariant::Type type) const
+    {
+        if(mimeType == ClipboardData::mimeType()) {
+            QByteArray data;
+            QDataStream stream(&data, QIODevice::WriteOnly);
+            stream << clipboardMagic << clipboardFormatVersion
+                   << qCompress(itemsToXml(m_items, false).toUtf8());
+            return data;
+        }
+
+        if(mimeType == "text/plain") {
+            return itemsToXml(m_items, true);
+        }
+
+        return QMimeData::retrieveData(mimeType, type);
+    }
+
+    //! \brief Serializes a list of items into an xml string.
+    QString ClipboardData::itemsToXml(const QList<GraphicsItem*> &items,
+                                      bool autoFormatting)
+    {
+        QString text;
+        Caneda::XmlWriter writer(&text);
+        writer.setAutoFormatting(autoFormatting);
+        writer.writeStartDocument();
+        writer.writeDTD(QString("<!DOCTYPE caneda>"));
+        writer.writeStartElement("caneda");
+        writer.writeAttribute("version", Caneda::version());
+
+        foreach(GraphicsItem *item, items) {
+            item->saveData(&writer);
+        }
+
+        writer.writeEndDocument();
+
+        return text;
+    }
+
+    //! \brief Creates new items from an xml description.
+    QList<GraphicsItem*> ClipboardData::itemsFromXml(const QByteArray &data)
+    {
+        QList<GraphicsItem*> items;
+        Caneda::XmlReader reader(data);
+
+        while(!reader.atEnd()) {
+            reader.readNext();
+
+            if(reader.isStartElement() && reader.name() == "caneda") {
+                break;
+            }
+        }
+
+        if(reader.hasError() || !(reader.isStartElement() && reader.name() == "caneda")) {
+            return items;
+        }
+
+        if(!Caneda::checkVersion(reader.attributes().value("version").toString())) {
+            return items;
+        }
+
+        while(!reader.atEnd()) {
+            reader.readNext();
+
+            if(reader.isEndElement()) {
+                break;
+            }
+
+            if(reader.isStartElement()) {
+                GraphicsItem *readItem = 0;
+                if(reader.name() == "component") {
+                    readItem = new Component();
+                    readItem->loadData(&reader);
+                }
+                else if(reader.name() == "wire") {
+                    readItem = new Wire(QPointF(10,10), QPointF(50,50));
+                    readItem->loadData(&reader);
+                }
+                else if(reader.name() == "painting") {
+                    QString name = reader.attributes().value("name").toString();
+                    readItem = Painting::fromName(name);
+                    if(readItem) {
+                        readItem->loadData(&reader);
+                    }
+                    else {
+                        qWarning() << "Warning: Skipping unknown painting type" << name;
+                        reader.readUnknownElement();
+                    }
+                }
+                else if(reader.name() == "port") {
+                    readItem = new PortSymbol();
+                    readItem->loadData(&reader);
+                }
+
+                if(readItem) {
+                    items << readItem;
+                }
+            }
+        }
+
+        return items;
+    }
+
+} // namespace Caneda
@@ -0,0 +1,77 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+#ifndef CLIPBOARD_DATA_H
+#define CLIPBOARD_DATA_H
+
+#include <QMimeData>
+
+namespace Caneda
+{
+    // Forward declarations.
+    class GraphicsItem;
+
+    /*!
+     * \brief This class holds the items copied into the clipboard.
+     *
+     * Instead of serializing the copied items when the copy action is
+     * invoked, this class keeps a private clone of each item (created with
+     * GraphicsItem::copy()). Pasting inside the same Caneda process just
+     * clones those items again, without any serialization or parsing
+     * involved.
+     *
+     * Other processes may request the data in two formats, both generated
+     * lazily (only when actually requested) in retrieveData():
+     * \li mimeType(): a compact binary format to be used between different
+     * Caneda instances. It holds a format version and the zlib compressed,
+     * non indented, xml description of the items.
+     * \li "text/plain": the indented xml description of the items, used as
+     * the interoperable fallback (for example, pasting into a text editor).
+     *
+     * \sa GraphicsScene::copyItems(), StateHandler::paste()
+     */
+    class ClipboardData : public QMimeData
+    {
+        Q_OBJECT
+
+    public:
+        explicit ClipboardData(const QList<GraphicsItem*> &items);
+        ~ClipboardData();
+
+        virtual QStringList formats() const;
+        virtual bool hasFormat(const QString &mimeType) const;
+
+        static QString mimeType();
+        static QList<GraphicsItem*> items(const QMimeData *mimeData);
+
+    protected:
+        virtual QVariant retrieveData(const QString &mimeType,
+                                      QVariant::Type type) const;
+
+    private:
+        static QString itemsToXml(const QList<GraphicsItem*> &items,
+                                  bool autoFormatting);
+        static QList<GraphicsItem*> itemsFromXml(const QByteArray &data);
+
+        QList<GraphicsItem*> m_items;
+    };
+
+} // namespace Caneda
+
+#endif //CLIPBOARD_DATA_H
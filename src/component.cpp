@@ -36,9 +36,33 @@ namespace Caneda
     //! \brief Constructs default empty ComponentData.
     ComponentData::ComponentData()
     {
+        symbol = -1;
         properties = new PropertyGroup();
     }
 
+    //! \brief Copy constructor, copying the properties content.
+    ComponentData::ComponentData(const ComponentData &other) : QSharedData(other)
+    {
+        name = other.name;
+        filename = other.filename;
+        displayText = other.displayText;
+        labelPrefix = other.labelPrefix;
+        description = other.description;
+        library = other.library;
+        symbol = other.symbol;
+        ports = other.ports;
+        models = other.models;
+
+        properties = new PropertyGroup();
+        properties->setDefaultProperties(other.properties);
+    }
+
+    //! \brief Destructor.
+    ComponentData::~ComponentData()
+    {
+        delete properties;
+    }
+
     /*!
      * \brief Copy ComponentData from a ComponentDataPtr.
      *
@@ -48,6 +72,9 @@ namespace Caneda
      * copying the reference to the PropertyGroup (properties) and all
      * components would share only one reference, modifying only one set
      * of properties data.
+     *
+     * The properties of \a other become the defaults of this component, and
+     * are implicitly shared instead of copied into every instance.
      */
     void ComponentData::setData(const QSharedDataPointer<ComponentData> &other)
     {
@@ -58,11 +85,12 @@ namespace Caneda
         labelPrefix = other->labelPrefix;
         description = other->description;
         library = other->library;
+        symbol = other->symbol;
         ports = other->ports;
 
         // Recreate PropertyGroup (properties) as it is a pointer
         // and only internal data must be copied.
-        properties->setPropertyMap(other->properties->propertyMap());
+        properties->setDefaultProperties(other->properties);
 
         models = other->models;
     }
@@ -195,6 +223,9 @@ namespace Caneda
      * method also takes care of setting the correct global settings pen
      * according to its selection state.
      *
+     * Below the "gui/lodSymbolThreshold" zoom level, only the bounding box of
+     * the symbol is drawn.
+     *
      * \sa LibraryManager::registerComponent()
      */
     void Component::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
@@ -203,28 +234,46 @@ namespace Caneda
         // Paint the component symbol
         Settings *settings = Settings::instance();
         LibraryManager *libraryManager = LibraryManager::instance();
-        QPainterPath symbol = libraryManager->symbolCache(name(), library());
+        const SymbolGeometry &symbol = libraryManager->symbolCache(symbolHandle());
 
         // Save pen
         QPen savedPen = painter->pen();
 
+        qreal lod = option->levelOfDetailFromTransform(painter->worldTransform());
+        if(lod < settings->currentValue("gui/lodSymbolThreshold").toDouble()) {
+            // At very low zoom levels only the symbol box is drawn, with a
+            // single pixel pen and without ports
+            QColor color = (option->state & QStyle::State_Selected) ?
+                        settings->currentValue("gui/selectionColor").value<QColor>() :
+                        settings->currentValue("gui/lineColor").value<QColor>();
+
+            QBrush savedBrush = painter->brush();
+            painter->setPen(QPen(color, 0));
+            painter->setBrush(Qt::NoBrush);
+            painter->drawRect(symbol.boundingRect());
+
+            painter->setBrush(savedBrush);
+            painter->setPen(savedPen);
+            return;
+        }
+
         if(option->state & QStyle::State_Selected) {
             // If selected, the paint is performed without the pixmap cache
             painter->setPen(QPen(settings->currentValue("gui/selectionColor").value<QColor>(),
                                  settings->currentValue("gui/lineWidth").toInt()));
 
-            painter->drawPath(symbol);  // Draw symbol
+            symbol.draw(painter);  // Draw symbol
         }
         else if(painter->worldTransform().isScaling()) {
             // If zooming, the paint is performed without the pixmap cache
             painter->setPen(QPen(settings->currentValue("gui/lineColor").value<QColor>(),
                                  settings->currentValue("gui/lineWidth").toInt()));
 
-            painter->drawPath(symbol);  // Draw symbol
+            symbol.draw(painter);  // Draw symbol
         }
         else {
             // Else, a pixmap cached is used
-            QPixmap pix = libraryManager->pixmapCache(name(), library());
+            QPixmap pix = libraryManager->pixmapCache(symbolHandle());
             QRect rect =  symbol.boundingRect().toRect();
             rect.adjust(-1.0, -1.0, 1.0, 1.0);  // Adjust rect to avoid clipping when size = 1px in any dimension
             painter->drawPixmap(rect, pix);
@@ -232,6 +281,9 @@ namespace Caneda
 
         // Restore pen
         painter->setPen(savedPen);
+
+        // Draw the ports
+        paintPorts(painter);
     }
 
     //! \copydoc GraphicsItem::copy()
@@ -244,6 +296,23 @@ namespace Caneda
         return component;
     }
 
+    /*!
+     * \brief Returns a copy of the data saved by the component, to be written
+     * later, possibly from another thread.
+     *
+     * \sa saveData()
+     */
+    ComponentSnapshot Component::snapshot() const
+    {
+        ComponentSnapshot snapshot;
+        snapshot.name = name();
+        snapshot.library = library();
+        snapshot.pos = pos();
+        snapshot.transform = sceneTransform();
+        snapshot.properties = d->properties->snapshot();
+        return snapshot;
+    }
+
     /*!
      * \copydoc GraphicsItem::saveData()
      *
@@ -253,15 +322,21 @@ namespace Caneda
      * \sa loadData()
      */
     void Component::saveData(Caneda::XmlWriter *writer) const
+    {
+        snapshot().write(writer);
+    }
+
+    //! \brief Writes the component to xml, see Component::saveData().
+    void ComponentSnapshot::write(Caneda::XmlWriter *writer) const
     {
         writer->writeStartElement("component");
-        writer->writeAttribute("name", name());
-        writer->writeAttribute("library", library());
+        writer->writeAttribute("name", name);
+        writer->writeAttribute("library", library);
 
-        writer->writePointAttribute(pos(), "pos");
-        writer->writeTransformAttribute(sceneTransform());
+        writer->writePointAttribute(pos, "pos");
+        writer->writeTransformAttribute(transform);
 
-        d->properties->writeProperties(writer);
+        properties.write(writer);
 
         writer->writeEndElement();  //</component>
     }
@@ -339,7 +414,7 @@ namespace Caneda
     void Component::updateBoundingRect()
     {
         // Get the bounding rect of the symbol
-        QPainterPath symbol = LibraryManager::instance()->symbolCache(name(), library());
+        const SymbolGeometry &symbol = LibraryManager::instance()->symbolCache(symbolHandle());
 
         // Get an adjusted rect for accomodating extra stuff like ports.
         QRectF adjustedRect = adjustedBoundRect(symbol.boundingRect());
@@ -33,6 +33,8 @@ namespace Caneda
     struct ComponentData : public QSharedData
     {
         explicit ComponentData();
+        ComponentData(const ComponentData &other);
+        ~ComponentData();
 
         void setData(const QSharedDataPointer<ComponentData>& other);
 
@@ -44,10 +46,14 @@ namespace Caneda
         QString description;
         QString library;
 
+        //! Handle of the symbol registered in LibraryManager.
+        int symbol;
+
         /*!
          * Dynamic properties modifiable by the user (in the properties dialog).
          * Special care must be taken to copy the contents of this PropertyGroup
-         * and not the pointer itself.
+         * and not the pointer itself. The properties of a component instance
+         * only store the values differing from its library defaults.
          */
         PropertyGroup *properties;
 
@@ -60,6 +66,25 @@ namespace Caneda
 
     typedef QSharedDataPointer<ComponentData> ComponentDataPtr;
 
+    /*!
+     * \brief Copy of the data saved by a Component.
+     *
+     * A snapshot only holds values and implicitly shared data, so it is cheap
+     * to take and can be written from any thread.
+     *
+     * \sa Component::snapshot(), Component::saveData()
+     */
+    struct ComponentSnapshot
+    {
+        QString name;
+        QString library;
+        QPointF pos;
+        QTransform transform;
+        PropertySnapshot properties;
+
+        void write(Caneda::XmlWriter *writer) const;
+    };
+
     /*!
      * \brief The Component class forms part of one of the GraphicsItem
      * derived classes available on Caneda. It is the base class for all
@@ -104,6 +129,8 @@ namespace Caneda
 
         //! Returns the library to which this component belongs.
         QString library() const { return d->library; }
+        //! Returns the handle of the component symbol, see LibraryManager.
+        int symbolHandle() const { return d->symbol; }
 
         //! Returns the label of the component in the form {label_prefix}{number_suffix}
         QString label() const { return d->properties->propertyValue("label"); }
@@ -122,6 +149,7 @@ namespace Caneda
 
         Component* copy() const;
 
+        ComponentSnapshot snapshot() const;
         void saveData(Caneda::XmlWriter *writer) const;
         void loadData(Caneda::XmlReader *reader);
 
@@ -22,6 +22,7 @@
 #include "global.h"
 #include "idocument.h"
 #include "settings.h"
+#include "tiledrenderer.h"
 
 #include <QCompleter>
 #include <QDialogButtonBox>
@@ -83,7 +84,9 @@ namespace Caneda
         ui.comboFormat->addItem(tr("PNG (*.png)"), "PNG");
         ui.comboFormat->addItem(tr("JPEG (*.jpg)"), "JPG");
         ui.comboFormat->addItem(tr("Bitmap (*.bmp)"), "BMP");
+        ui.comboFormat->addItem(tr("TIFF (*.tif)"), "TIF");
         ui.comboFormat->addItem(tr("SVG (*.svg)"), "SVG");
+        ui.comboFormat->addItem(tr("PDF (*.pdf)"), "PDF");
         slotChangeFilesExtension();
 
         connect(ui.btnBrowse, SIGNAL(clicked()), SLOT(slotChooseDirectory()));
@@ -247,6 +250,14 @@ namespace Caneda
         if(acronym == "SVG") {
             generateSvg(file);
         }
+        else if(acronym == "PNG" || acronym == "TIF" || acronym == "PDF") {
+            if(!generateTiled(file, acronym)) {
+                QMessageBox::critical(this, tr("Could not write into file"),
+                                      QString(tr("An error occurred while exporting the file %1."))
+                                      .arg(filename),
+                                      QMessageBox::Ok);
+            }
+        }
         else {
             QImage image = generateImage();
             image.save(&file, acronym.toUtf8().data());
@@ -304,6 +315,44 @@ namespace Caneda
         saveReloadDiagramParameters(false);
     }
 
+    /*!
+     * \brief Exports the scene using the tiled renderer
+     *
+     * The scene is recorded region by region by the TiledRenderer while it
+     * renders the image tile by tile. This avoids allocating the complete
+     * raster image, allowing to export images of any size.
+     *
+     * \param file File where the image is being exported
+     * \param acronym Format to use (PNG, TIF or PDF)
+     * \return True on success, false otherwise
+     *
+     * \sa TiledRenderer
+     */
+    bool ExportDialog::generateTiled(QFile &file, const QString &acronym)
+    {
+        QSize size(ui.spinWidth->value(), ui.spinHeight->value());
+
+        saveReloadDiagramParameters(true);
+
+        // The regions are recorded while the image is written
+        TiledRenderer renderer(size);
+        m_document->exportTiles(&renderer);
+
+        bool ok = false;
+        if(acronym == "PDF") {
+            ok = renderer.writePdf(file.fileName());
+        }
+        else if(file.open(QIODevice::WriteOnly)) {
+            ok = (acronym == "TIF") ? renderer.writeTiff(&file) : renderer.writePng(&file);
+            file.close();
+            ok = ok && file.error() == QFileDevice::NoError;
+        }
+
+        saveReloadDiagramParameters(false);
+
+        return ok;
+    }
+
     /*!
      * \brief Saves or restores the parameters of the scene
      *
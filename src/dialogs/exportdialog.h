@@ -57,6 +57,7 @@ namespace Caneda
 
         QImage generateImage();
         void generateSvg(QFile &);
+        bool generateTiled(QFile &, const QString &acronym);
         void saveReloadDiagramParameters(bool = true);
 
         IDocument *m_document;
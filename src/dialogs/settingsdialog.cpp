@@ -56,6 +56,9 @@ namespace Caneda
         map["gui/lineColor"] = settings->currentValue("gui/lineColor");
         map["gui/selectionColor"] = settings->currentValue("gui/selectionColor");
         map["gui/lineWidth"] = settings->currentValue("gui/lineWidth");
+        map["gui/undoLimit"] = settings->currentValue("gui/undoLimit");
+        map["gui/lodDetailThreshold"] = settings->currentValue("gui/lodDetailThreshold");
+        map["gui/lodSymbolThreshold"] = settings->currentValue("gui/lodSymbolThreshold");
 
         // Libraries group of settings
         map["libraries/schematic"] = settings->currentValue("libraries/schematic");
@@ -65,6 +68,8 @@ namespace Caneda
         map["sim/simulationCommand"] = settings->currentValue("sim/simulationCommand");
         map["sim/simulationEngine"] = settings->currentValue("sim/simulationEngine");
         map["sim/outputFormat"] = settings->currentValue("sim/outputFormat");
+        map["sim/liveWaveforms"] = settings->currentValue("sim/liveWaveforms");
+        map["sim/ruleCheck"] = settings->currentValue("sim/ruleCheck");
 
         // Layout group of settings
         map["gui/layout/metal1"] = settings->currentValue("gui/layout/metal1");
@@ -110,6 +115,7 @@ namespace Caneda
 
         // Simulation group of settings
         connect(ui.radioNgspiceMode, SIGNAL(clicked()), SLOT(simulationEngineChanged()));
+        connect(ui.radioNgspiceSharedMode, SIGNAL(clicked()), SLOT(simulationEngineChanged()));
         connect(ui.radioCustomMode, SIGNAL(clicked()), SLOT(simulationEngineChanged()));
 
         // Layout group of settings
@@ -248,6 +254,9 @@ namespace Caneda
         map["gui/lineColor"] = settings->defaultValue("gui/lineColor");
         map["gui/selectionColor"] = settings->defaultValue("gui/selectionColor");
         map["gui/lineWidth"] = settings->defaultValue("gui/lineWidth");
+        map["gui/undoLimit"] = settings->defaultValue("gui/undoLimit");
+        map["gui/lodDetailThreshold"] = settings->defaultValue("gui/lodDetailThreshold");
+        map["gui/lodSymbolThreshold"] = settings->defaultValue("gui/lodSymbolThreshold");
 
         // Libraries group of settings
         map["libraries/schematic"] = settings->defaultValue("libraries/schematic");
@@ -257,6 +266,8 @@ namespace Caneda
         map["sim/simulationCommand"] = settings->defaultValue("sim/simulationCommand");
         map["sim/simulationEngine"] = settings->defaultValue("sim/simulationEngine");
         map["sim/outputFormat"] = settings->defaultValue("sim/outputFormat");
+        map["sim/liveWaveforms"] = settings->defaultValue("sim/liveWaveforms");
+        map["sim/ruleCheck"] = settings->defaultValue("sim/ruleCheck");
 
         // Layout group of settings
         map["gui/layout/metal1"] = settings->defaultValue("gui/layout/metal1");
@@ -296,6 +307,9 @@ namespace Caneda
         settings->setCurrentValue("gui/selectionColor", getButtonColor(ui.buttonSelection));
 
         settings->setCurrentValue("gui/lineWidth", ui.spinWidth->value());
+        settings->setCurrentValue("gui/undoLimit", ui.spinUndoLimit->value());
+        settings->setCurrentValue("gui/lodDetailThreshold", ui.spinLodDetail->value());
+        settings->setCurrentValue("gui/lodSymbolThreshold", ui.spinLodSymbol->value());
 
         // Libraries group of settings
         QStringList newLibraries;
@@ -317,6 +331,12 @@ namespace Caneda
             settings->setCurrentValue("sim/simulationEngine", QString("ngspice"));
             settings->setCurrentValue("sim/simulationCommand", QString("ngspice -b -r %filename.raw %filename.net"));
         }
+        else if(ui.radioNgspiceSharedMode->isChecked()) {
+            // If using the ngspice shared library, the netlist is simulated
+            // in process and the command is not used
+            settings->setCurrentValue("sim/simulationEngine", QString("ngspiceShared"));
+            settings->setCurrentValue("sim/simulationCommand", QString("ngspice -b -r %filename.raw %filename.net"));
+        }
         else if(ui.radioCustomMode->isChecked()) {
             // If using the custom simulator, take the user provided command
             settings->setCurrentValue("sim/simulationEngine", QString("custom"));
@@ -330,6 +350,9 @@ namespace Caneda
             settings->setCurrentValue("sim/outputFormat", QString("ascii"));
         }
 
+        settings->setCurrentValue("sim/liveWaveforms", ui.checkLiveWaveforms->isChecked());
+        settings->setCurrentValue("sim/ruleCheck", ui.checkRuleCheck->isChecked());
+
         // Layout group of settings
         settings->setCurrentValue("gui/layout/metal1", getButtonColor(ui.buttonMetal1));
         settings->setCurrentValue("gui/layout/metal2", getButtonColor(ui.buttonMetal2));
@@ -367,6 +390,9 @@ namespace Caneda
         setButtonColor(ui.buttonLine, map["gui/lineColor"].value<QColor>());
         setButtonColor(ui.buttonSelection, map["gui/selectionColor"].value<QColor>());
         ui.spinWidth->setValue(map["gui/lineWidth"].toInt());
+        ui.spinUndoLimit->setValue(map["gui/undoLimit"].toInt());
+        ui.spinLodDetail->setValue(map["gui/lodDetailThreshold"].toDouble());
+        ui.spinLodSymbol->setValue(map["gui/lodSymbolThreshold"].toDouble());
 
         // Libraries group of settings
         ui.listLibraries->clear();
@@ -392,6 +418,10 @@ namespace Caneda
             ui.radioNgspiceMode->setChecked(true);
             ui.lineSimulationCommand->setEnabled(false);
         }
+        else if(map["sim/simulationEngine"].toString() == "ngspiceShared") {
+            ui.radioNgspiceSharedMode->setChecked(true);
+            ui.lineSimulationCommand->setEnabled(false);
+        }
         else if(map["sim/simulationEngine"].toString() == "custom") {
             ui.radioCustomMode->setChecked(true);
         }
@@ -403,6 +433,9 @@ namespace Caneda
             ui.radioAsciiMode->setChecked(true);
         }
 
+        ui.checkLiveWaveforms->setChecked(map["sim/liveWaveforms"].value<bool>());
+        ui.checkRuleCheck->setChecked(map["sim/ruleCheck"].value<bool>());
+
         // Layout group of settings
         setButtonColor(ui.buttonMetal1, map["gui/layout/metal1"].value<QColor>());
         setButtonColor(ui.buttonMetal2, map["gui/layout/metal2"].value<QColor>());
@@ -0,0 +1,123 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+#include "spectrumdialog.h"
+
+#include "chartitem.h"
+#include "chartscene.h"
+#include "chartview.h"
+#include "documentviewmanager.h"
+#include "idocument.h"
+
+#include <QPushButton>
+
+namespace Caneda
+{
+    /*!
+     * \brief Constructor.
+     *
+     * \param view ChartView whose waveforms can be analyzed.
+     * \param parent Parent of this object.
+     */
+    SpectrumDialog::SpectrumDialog(ChartView *view, QWidget *parent) :
+        QDialog(parent),
+        m_chartView(view)
+    {
+        // Initialize designer dialog
+        ui.setupUi(this);
+
+        m_analyzeButton = ui.buttonBox->addButton(tr("Analyze"), QDialogButtonBox::ActionRole);
+        m_analyzeButton->setDefault(true);
+
+        // List the waveforms of the view
+        QwtPlotItemList list = view->itemList(QwtPlotItem::Rtti_PlotCurve);
+        foreach(QwtPlotItem *item, list) {
+            ui.comboWaveform->addItem(item->title().text());
+        }
+
+        connect(m_analyzeButton, SIGNAL(clicked()), this, SLOT(analyze()));
+        connect(&m_watcher, SIGNAL(finished()), this, SLOT(analysisFinished()));
+    }
+
+    //! \brief Starts the analysis of the selected waveform in background.
+    void SpectrumDialog::analyze()
+    {
+        if(!m_chartView || m_watcher.isRunning()) {
+            return;
+        }
+
+        // Find the selected waveform
+        ChartSeries *curve = 0;
+        QwtPlotItemList list = m_chartView->itemList(QwtPlotItem::Rtti_PlotCurve);
+        foreach(QwtPlotItem *item, list) {
+            if(item->title().text() == ui.comboWaveform->currentText()) {
+                curve = static_cast<ChartSeries*>(item);
+                break;
+            }
+        }
+
+        if(!curve) {
+            return;
+        }
+
+        // The samples are implicitly shared, the analysis does not access
+        // the curve itself.
+        QVector<double> time, values;
+        curve->samples(&time, &values);
+        m_waveformName = curve->title().text();
+
+        m_analyzeButton->setEnabled(false);
+        ui.labelResults->setText(tr("Computing spectrum..."));
+
+        m_watcher.setFuture(SpectrumAnalyzer::run(time, values,
+                    static_cast<SpectrumAnalyzer::Window>(ui.comboWindow->currentIndex()),
+                    ui.spinBoxPoints->value(), ui.spinBoxSegments->value()));
+    }
+
+    //! \brief Shows the distortion figures and opens the spectrum as a new chart.
+    void SpectrumDialog::analysisFinished()
+    {
+        m_analyzeButton->setEnabled(true);
+
+        SpectrumResult result = m_watcher.result();
+        if(result.frequency.isEmpty()) {
+            ui.labelResults->setText(tr("The waveform is too short for the selected settings."));
+            return;
+        }
+
+        ui.labelResults->setText(tr("Fundamental: %1 Hz\nTHD: %2 dB (%3 %)\nSNR: %4 dB\nSINAD: %5 dB\nSFDR: %6 dBc")
+                                 .arg(result.fundamental)
+                                 .arg(result.thd, 0, 'f', 2)
+                                 .arg(result.thdPercent, 0, 'g', 4)
+                                 .arg(result.snr, 0, 'f', 2)
+                                 .arg(result.sinad, 0, 'f', 2)
+                                 .arg(result.sfdr, 0, 'f', 2));
+
+        // Open the spectrum in a new chart
+        ChartSeries *curve = new ChartSeries(QString("FFT(%1)").arg(m_waveformName));
+        curve->setType("magnitude");
+        curve->setSamples(result.frequency, result.magnitude);
+        curve->updateIndex();
+
+        SimulationDocument *document = new SimulationDocument;
+        document->chartScene()->addItem(curve);
+        DocumentViewManager::instance()->addDocument(document);
+    }
+
+} // namespace Caneda
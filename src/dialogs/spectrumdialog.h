@@ -0,0 +1,72 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+#ifndef SPECTRUM_DIALOG_H
+#define SPECTRUM_DIALOG_H
+
+#include "ui_spectrumdialog.h"
+
+#include "spectrumanalyzer.h"
+
+#include <QFutureWatcher>
+#include <QPointer>
+
+// Forward declarations
+class QPushButton;
+
+namespace Caneda
+{
+    // Forward declations
+    class ChartView;
+
+    /*!
+     * \brief Dialog to compute the spectrum of a transient waveform.
+     *
+     * The user selects one of the waveforms of a ChartView and the FFT
+     * settings. The analysis runs in background threads (see
+     * SpectrumAnalyzer) while the user interface remains responsive, and
+     * the resulting spectrum opens as a new chart once finished. The
+     * distortion figures are shown in the dialog.
+     *
+     * \sa SpectrumAnalyzer, ChartView
+     */
+    class SpectrumDialog : public QDialog
+    {
+        Q_OBJECT
+
+    public:
+        explicit SpectrumDialog(ChartView *view, QWidget *parent = 0);
+
+    private Q_SLOTS:
+        void analyze();
+        void analysisFinished();
+
+    private:
+        QPointer<ChartView> m_chartView;
+        QPushButton *m_analyzeButton;
+
+        QFutureWatcher<SpectrumResult> m_watcher;
+        QString m_waveformName;  //! \brief Name of the waveform being analyzed
+
+        Ui::SpectrumDialog ui;
+    };
+
+} // namespace Caneda
+
+#endif //SPECTRUM_DIALOG_H
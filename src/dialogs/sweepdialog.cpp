@@ -0,0 +1,342 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#include "sweepdialog.h"
+
+#include "component.h"
+#include "documentviewmanager.h"
+#include "graphicsscene.h"
+#include "idocument.h"
+#include "sweeprunner.h"
+
+#include <QComboBox>
+#include <QMessageBox>
+#include <QPushButton>
+
+#include <qmath.h>
+#include <qwt_plot.h>
+#include <qwt_plot_histogram.h>
+
+namespace Caneda
+{
+    //! \brief Columns of the parameters table
+    enum ParameterColumn {
+        ComponentColumn,
+        PropertyColumn,
+        DistributionColumn,
+        FirstColumn,
+        SecondColumn,
+        PointsColumn
+    };
+
+    //! \brief Minimum interval between updates of the histogram, in milliseconds
+    static const int updateInterval = 250;
+
+    /*!
+     * \brief Constructor.
+     *
+     * \param document Schematic to be simulated.
+     * \param parent Parent of this object.
+     */
+    SweepDialog::SweepDialog(SchematicDocument *document, QWidget *parent) :
+        QDialog(parent),
+        m_document(document)
+    {
+        // Initialize designer dialog
+        ui.setupUi(this);
+        ui.editWaveforms->setPlaceholderText("v(out)");
+
+        m_runButton = ui.buttonBox->addButton(tr("Run"), QDialogButtonBox::ActionRole);
+        m_runButton->setDefault(true);
+        m_waveformsButton = ui.buttonBox->addButton(tr("Show Waveforms"), QDialogButtonBox::ActionRole);
+        m_waveformsButton->setEnabled(false);
+
+        // Properties of the components of the schematic
+        QList<QGraphicsItem*> items = document->graphicsScene()->items();
+        QList<Component*> components = filterItems<Component>(items);
+        foreach(Component *c, components) {
+            QStringList properties = c->properties()->propertyMap().keys();
+            properties.removeAll("label");
+            if(!properties.isEmpty()) {
+                m_properties.insert(c->label(), properties);
+            }
+        }
+
+        // Histogram of the measured values
+        m_histogramPlot = new QwtPlot(this);
+        m_histogramPlot->setMinimumHeight(160);
+        m_histogramPlot->setAxisTitle(QwtPlot::yLeft, tr("Runs"));
+        ui.layoutHistogram->addWidget(m_histogramPlot);
+
+        m_histogram = new QwtPlotHistogram;
+        m_histogram->setStyle(QwtPlotHistogram::Columns);
+        m_histogram->setBrush(QColor(0, 100, 200, 160));
+        m_histogram->attach(m_histogramPlot);
+
+        m_runner = new SweepRunner(document, this);
+
+        connect(ui.buttonAdd, SIGNAL(clicked()), this, SLOT(addParameter()));
+        connect(ui.buttonRemove, SIGNAL(clicked()), this, SLOT(removeParameter()));
+        connect(m_runButton, SIGNAL(clicked()), this, SLOT(run()));
+        connect(m_waveformsButton, SIGNAL(clicked()), this, SLOT(showWaveforms()));
+        connect(m_runner, SIGNAL(runFinished(int)), this, SLOT(runFinished()));
+        connect(m_runner, SIGNAL(finished()), this, SLOT(sweepFinished()));
+
+        addParameter();
+    }
+
+    //! \brief Stops the sweep before closing the dialog.
+    void SweepDialog::reject()
+    {
+        m_runner->cancel();
+        QDialog::reject();
+    }
+
+    //! \brief Adds a row to the parameters table.
+    void SweepDialog::addParameter()
+    {
+        const int row = ui.tableParameters->rowCount();
+        ui.tableParameters->insertRow(row);
+
+        QComboBox *component = new QComboBox;
+        component->addItems(m_properties.keys());
+        connect(component, SIGNAL(currentIndexChanged(int)), this, SLOT(componentChanged()));
+        ui.tableParameters->setCellWidget(row, ComponentColumn, component);
+
+        QComboBox *property = new QComboBox;
+        property->addItems(m_properties.value(component->currentText()));
+        ui.tableParameters->setCellWidget(row, PropertyColumn, property);
+
+        QComboBox *distribution = new QComboBox;
+        distribution->addItems(QStringList() << tr("Linear") << tr("Logarithmic")
+                               << tr("Uniform") << tr("Gaussian"));
+        ui.tableParameters->setCellWidget(row, DistributionColumn, distribution);
+
+        ui.tableParameters->setItem(row, FirstColumn, new QTableWidgetItem("1k"));
+        ui.tableParameters->setItem(row, SecondColumn, new QTableWidgetItem("10k"));
+        ui.tableParameters->setItem(row, PointsColumn, new QTableWidgetItem("5"));
+    }
+
+    //! \brief Removes the selected row of the parameters table.
+    void SweepDialog::removeParameter()
+    {
+        const int row = ui.tableParameters->currentRow();
+        if(row >= 0) {
+            ui.tableParameters->removeRow(row);
+        }
+    }
+
+    //! \brief Lists the properties of the component selected in a row.
+    void SweepDialog::componentChanged()
+    {
+        for(int row = 0; row < ui.tableParameters->rowCount(); ++row) {
+            QComboBox *component = static_cast<QComboBox*>(ui.tableParameters->cellWidget(row, ComponentColumn));
+            if(component == sender()) {
+                QComboBox *property = static_cast<QComboBox*>(ui.tableParameters->cellWidget(row, PropertyColumn));
+                property->clear();
+                property->addItems(m_properties.value(component->currentText()));
+                break;
+            }
+        }
+    }
+
+    //! \brief Starts the sweep, or cancels it if running.
+    void SweepDialog::run()
+    {
+        if(m_runner->isRunning()) {
+            m_runner->cancel();
+            sweepFinished();
+            return;
+        }
+
+        if(!m_document) {
+            return;
+        }
+
+        // Read the parameters
+        QList<SweepParameter> parameters;
+        for(int row = 0; row < ui.tableParameters->rowCount(); ++row) {
+            SweepParameter parameter;
+            parameter.component = static_cast<QComboBox*>(ui.tableParameters->cellWidget(row, ComponentColumn))->currentText();
+            parameter.property = static_cast<QComboBox*>(ui.tableParameters->cellWidget(row, PropertyColumn))->currentText();
+            parameter.distribution = static_cast<SweepParameter::Distribution>(
+                        static_cast<QComboBox*>(ui.tableParameters->cellWidget(row, DistributionColumn))->currentIndex());
+
+            bool firstOk = false, secondOk = false, pointsOk = false;
+            QTableWidgetItem *item = ui.tableParameters->item(row, FirstColumn);
+            parameter.first = SweepRunner::parseValue(item ? item->text() : QString(), &firstOk);
+            item = ui.tableParameters->item(row, SecondColumn);
+            parameter.second = SweepRunner::parseValue(item ? item->text() : QString(), &secondOk);
+            item = ui.tableParameters->item(row, PointsColumn);
+            parameter.points = item ? item->text().toInt(&pointsOk) : 0;
+
+            if(!firstOk || !secondOk || !pointsOk) {
+                QMessageBox::critical(this, tr("Error"),
+                                      tr("Invalid values in the row %1 of the parameters.").arg(row + 1));
+                return;
+            }
+
+            parameters << parameter;
+        }
+
+        QStringList outputs;
+        foreach(const QString &output, ui.editWaveforms->text().split(',', QString::SkipEmptyParts)) {
+            outputs << output.trimmed();
+        }
+        if(outputs.isEmpty()) {
+            QMessageBox::critical(this, tr("Error"), tr("Enter at least one waveform to be measured."));
+            return;
+        }
+
+        QString errorMessage;
+        if(!m_runner->prepare(parameters, ui.spinBoxRuns->value(), &errorMessage)) {
+            QMessageBox::critical(this, tr("Error"), errorMessage);
+            return;
+        }
+        m_runner->setOutputs(outputs, static_cast<SweepRunner::Measurement>(ui.comboMeasurement->currentIndex()));
+
+        ui.progressBar->setMaximum(m_runner->runCount());
+        ui.progressBar->setValue(0);
+        ui.groupBoxParameters->setEnabled(false);
+        ui.groupBoxOutputs->setEnabled(false);
+        m_waveformsButton->setEnabled(false);
+        m_runButton->setText(tr("Cancel"));
+
+        m_updateTimer.start();
+        m_runner->start();
+    }
+
+    //! \brief Updates the progress, and periodically the histogram.
+    void SweepDialog::runFinished()
+    {
+        ui.progressBar->setValue(m_runner->finishedCount());
+
+        if(m_updateTimer.elapsed() > updateInterval) {
+            updateResults();
+            m_updateTimer.restart();
+        }
+    }
+
+    //! \brief Shows the final results, and the waveforms of all the runs.
+    void SweepDialog::sweepFinished()
+    {
+        ui.groupBoxParameters->setEnabled(true);
+        ui.groupBoxOutputs->setEnabled(true);
+        m_runButton->setText(tr("Run"));
+
+        updateResults();
+
+        m_waveformsButton->setEnabled(m_runner->finishedCount() > 0);
+        if(!m_runner->isRunning() && m_runner->finishedCount() == m_runner->runCount()) {
+            showWaveforms();
+        }
+    }
+
+    //! \brief Opens the waveforms of the finished runs in a new chart.
+    void SweepDialog::showWaveforms()
+    {
+        SimulationDocument *document = m_runner->createDocument();
+        if(document) {
+            DocumentViewManager::instance()->addDocument(document);
+        }
+    }
+
+    /*!
+     * \brief Updates the histogram and the statistics of the measured
+     * values.
+     *
+     * The histogram shows the measurement of the first waveform, the
+     * statistics are shown for all of them.
+     */
+    void SweepDialog::updateResults()
+    {
+        const QStringList outputs = m_runner->outputs();
+        QStringList text;
+        int failed = 0;
+
+        for(int o = 0; o < outputs.size(); ++o) {
+            QVector<double> values;
+            for(int r = 0; r < m_runner->runCount(); ++r) {
+                const SweepRun &run = m_runner->run(r);
+                if(!run.valid) {
+                    // Runs not finished yet have no error
+                    if(o == 0 && !run.errorMessage.isEmpty()) {
+                        ++failed;
+                    }
+                    continue;
+                }
+                if(o < run.measurements.size() && !qIsNaN(run.measurements.at(o))) {
+                    values << run.measurements.at(o);
+                }
+            }
+
+            if(values.isEmpty()) {
+                text << tr("%1: not found in the results").arg(outputs.at(o));
+                continue;
+            }
+
+            double minimum = values.first();
+            double maximum = values.first();
+            double sum = 0, sumSquares = 0;
+            foreach(double value, values) {
+                minimum = qMin(minimum, value);
+                maximum = qMax(maximum, value);
+                sum += value;
+                sumSquares += value * value;
+            }
+            const double mean = sum / values.size();
+            const double deviation = qSqrt(qMax(0.0, sumSquares / values.size() - mean * mean));
+
+            text << tr("%1: mean %2, deviation %3, min %4, max %5")
+                    .arg(outputs.at(o))
+                    .arg(mean, 0, 'g', 5)
+                    .arg(deviation, 0, 'g', 5)
+                    .arg(minimum, 0, 'g', 5)
+                    .arg(maximum, 0, 'g', 5);
+
+            if(o != 0) {
+                continue;
+            }
+
+            // Square root choice of the number of bins
+            const int bins = qBound(5, int(qSqrt(values.size())), 50);
+            const double width = (maximum > minimum) ? (maximum - minimum) / bins : 1.0;
+            QVector<double> counts(bins, 0);
+            foreach(double value, values) {
+                counts[qMin(bins - 1, int((value - minimum) / width))] += 1;
+            }
+
+            QVector<QwtIntervalSample> samples;
+            for(int b = 0; b < bins; ++b) {
+                samples << QwtIntervalSample(counts.at(b), minimum + b * width, minimum + (b + 1) * width);
+            }
+            m_histogram->setSamples(samples);
+            m_histogramPlot->setAxisTitle(QwtPlot::xBottom, outputs.at(o));
+            m_histogramPlot->replot();
+        }
+
+        if(failed > 0) {
+            text << tr("%1 runs failed, see the logs in the sweep directory.").arg(failed);
+        }
+
+        ui.labelResults->setText(text.join("\n"));
+    }
+
+} // namespace Caneda
@@ -0,0 +1,96 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#ifndef SWEEP_DIALOG_H
+#define SWEEP_DIALOG_H
+
+#include "ui_sweepdialog.h"
+
+#include <QElapsedTimer>
+#include <QMap>
+#include <QPointer>
+#include <QStringList>
+
+// Forward declarations
+class QPushButton;
+class QwtPlot;
+class QwtPlotHistogram;
+
+namespace Caneda
+{
+    // Forward declations
+    class SchematicDocument;
+    class SweepRunner;
+
+    /*!
+     * \brief Dialog to run parameter sweeps and Monte Carlo analysis of a
+     * schematic.
+     *
+     * The user selects the properties to be varied and their ranges or
+     * distributions, and the waveforms to be measured. The runs are
+     * simulated in background (see SweepRunner) while the dialog shows the
+     * progress and a histogram of the measured values, updated as each
+     * run finishes. The waveforms of all runs open as families of curves
+     * once the sweep finishes.
+     *
+     * \sa SweepRunner
+     */
+    class SweepDialog : public QDialog
+    {
+        Q_OBJECT
+
+    public:
+        explicit SweepDialog(SchematicDocument *document, QWidget *parent = 0);
+
+    public Q_SLOTS:
+        void reject();
+
+    private Q_SLOTS:
+        void addParameter();
+        void removeParameter();
+        void componentChanged();
+
+        void run();
+        void runFinished();
+        void sweepFinished();
+        void showWaveforms();
+
+    private:
+        void updateResults();
+
+        QPointer<SchematicDocument> m_document;
+        SweepRunner *m_runner;
+
+        QPushButton *m_runButton;
+        QPushButton *m_waveformsButton;
+
+        QwtPlot *m_histogramPlot;
+        QwtPlotHistogram *m_histogram;
+        QElapsedTimer m_updateTimer;  //! \brief Limits the updates of the histogram
+
+        //! \brief Properties of each component, by label
+        QMap<QString, QStringList> m_properties;
+
+        Ui::SweepDialog ui;
+    };
+
+} // namespace Caneda
+
+#endif //SWEEP_DIALOG_H
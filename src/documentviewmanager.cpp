@@ -21,6 +21,7 @@
 #include "documentviewmanager.h"
 
 #include "actionmanager.h"
+#include "autosaver.h"
 #include "icontext.h"
 #include "idocument.h"
 #include "iview.h"
@@ -31,6 +32,7 @@
 #include "tabs.h"
 
 #include <QDebug>
+#include <QFile>
 #include <QFileInfo>
 #include <QMessageBox>
 #include <QPointer>
@@ -123,6 +125,19 @@ namespace Caneda
             return;
         }
 
+        addDocument(document);
+    }
+
+    /*!
+     * \brief Adds a document created by the application and shows it.
+     *
+     * This is used for documents not loaded from a file, for example new
+     * empty documents or charts computed from other documents.
+     *
+     * \param document Document to add. The manager takes its ownership.
+     */
+    void DocumentViewManager::addDocument(IDocument *document)
+    {
         DocumentData *data = new DocumentData;
         data->document = document;
 
@@ -143,6 +158,17 @@ namespace Caneda
 
         DocumentData *data = documentDataForFileName(fileName);
 
+        // Simulation results already opened are reloaded in place, keeping
+        // the views and their state (zoom, visible waveforms, etc).
+        if(data) {
+            SimulationDocument *simulation = qobject_cast<SimulationDocument*>(data->document);
+            if(simulation && simulation->reload()) {
+                addFileToRecentFiles(fileName);
+                highlightViewForDocument(data->document);
+                return true;
+            }
+        }
+
         // If the file is already opened, first close it to refresh the file
         // contents. This allows external programs to modify the data, and
         // refresh the data upon next opening. This is used, for example,
@@ -159,16 +185,41 @@ namespace Caneda
             data = documentDataForFileName(fileName);
         }
 
+        // Offer to recover the backup left behind by a crash, which is
+        // opened in place of the file
+        QString openedFileName = fileName;
+        if(!data && AutoSaver::hasRecoverableBackup(fileName)) {
+            QMessageBox::StandardButton answer =
+                QMessageBox::question(MainWindow::instance(), tr("Recover backup"),
+                                      tr("A backup of %1 more recent than the file was found, "
+                                         "probably left by a crash. Do you want to recover it?\n\n"
+                                         "If not, the backup will be deleted.").arg(fileName),
+                                      QMessageBox::Yes | QMessageBox::No);
+
+            if(answer == QMessageBox::Yes) {
+                openedFileName = AutoSaver::autoSaveFileName(fileName);
+            }
+            else {
+                QFile::remove(AutoSaver::autoSaveFileName(fileName));
+            }
+        }
+
         // Open the file which will create corresponding DocumentData
         if(!data) {
             QFileInfo fileInfo(fileName);
             foreach (IContext *context, m_contexts) {
                 if (context->canOpen(fileInfo)) {
-                    IDocument *document = context->open(fileName);
+                    IDocument *document = context->open(openedFileName);
                     if (!document) {
                         continue;
                     }
 
+                    // A recovered document keeps its name, and is not saved
+                    if(openedFileName != fileName) {
+                        document->setFileName(fileName);
+                        AutoSaver::markModified(document, tr("Recover backup"));
+                    }
+
                     data = new DocumentData;
                     data->document = document;
 
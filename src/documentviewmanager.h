@@ -54,6 +54,7 @@ namespace Caneda
         void highlightViewForDocument(IDocument *document);
 
         void newDocument(IContext *context);
+        void addDocument(IDocument *document);
         bool openFile(const QString &fileName);
         bool saveDocuments(const QList<IDocument*> &documents);
         bool closeDocuments(const QList<IDocument*> &documents, bool askForSave = true);
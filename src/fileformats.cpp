@@ -27,9 +27,11 @@
 #include "graphicsscene.h"
 #include "idocument.h"
 #include "library.h"
+#include "netlistcache.h"
 #include "painting.h"
 #include "port.h"
 #include "portsymbol.h"
+#include "symbolgeometry.h"
 #include "wire.h"
 #include "xmlutilities.h"
 
@@ -38,6 +40,8 @@
 #include <QFileInfo>
 #include <QMessageBox>
 #include <QRegularExpression>
+#include <QSaveFile>
+#include <QSet>
 #include <QString>
 
 namespace Caneda
@@ -59,6 +63,9 @@ namespace Caneda
      * user has the correct permissions to write it, and then calls the
      * saveText() method to generate the xml data to save.
      *
+     * The file is written through a QSaveFile, so a failed write never
+     * leaves a truncated schematic behind.
+     *
      * \sa saveText(), load()
      */
     bool FormatXmlSchematic::save() const
@@ -73,16 +80,19 @@ namespace Caneda
             qDebug() << "Looks buggy! Null data to save! Was this expected?";
         }
 
-        QFile file(fileName());
+        QSaveFile file(fileName());
         if(!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
             QMessageBox::critical(0, QObject::tr("Error"),
                     QObject::tr("Cannot save document!"));
             return false;
         }
 
-        QTextStream stream(&file);
-        stream << text;
-        file.close();
+        QByteArray data = text.toUtf8();
+        if(file.write(data) != data.size() || !file.commit()) {
+            QMessageBox::critical(0, QObject::tr("%1 : File save error").arg(fileName()),
+                    file.errorString());
+            return false;
+        }
 
         return true;
     }
@@ -122,139 +132,125 @@ namespace Caneda
      * from a scene and associated objects (componts, paintings, etc).
      *
      * This method is used to generate an xml file into a QString to be saved
-     * by the save() method. Not only scene sections are created (components,
-     * paintings, etc) but also file header information, for example document
-     * version and name. Each section is created, in its turn, by calling an
-     * appropiated method an thus improving source code readability by
-     * splitting the different actions.
+     * by the save() method. The scene contents are first copied by
+     * snapshot(), and then serialized by SchematicSnapshot::toText().
      *
      * \return QString containing xml data to be saved.
      *
-     * \sa save()
+     * \sa save(), snapshot()
      */
     QString FormatXmlSchematic::saveText() const
     {
-        QString retVal;
-        Caneda::XmlWriter *writer = new Caneda::XmlWriter(&retVal);
-        writer->setAutoFormatting(true);
-
-        // Fist we start the document and write current version
-        writer->writeStartDocument();
-        writer->writeDTD(QString("<!DOCTYPE caneda>"));
-        writer->writeStartElement("caneda");
-        writer->writeAttribute("version", Caneda::version());
-
-        // Now we copy all the elements and properties in the schematic
-        saveComponents(writer);
-        savePorts(writer);
-        saveWires(writer);
-        savePaintings(writer);
-
-        // Finally we finish the document
-        writer->writeEndDocument(); //</caneda>
-
-        delete writer;
-        return retVal;
+        return snapshot().toText();
     }
 
     /*!
-     * \brief Saves the scene components to an XmlWriter.
-     *
-     * This method saves all scene components to an XmlWriter. To do so, it
-     * takes each Component from the scene, and saves the data using the
-     * Component::saveData() method.
+     * \brief Copies the scene contents to be serialized later, possibly in a
+     * worker thread.
      *
-     * \param writer XmlWriter responsible for writing the xml data.
+     * Only the copy is done in the GUI thread, which is much cheaper than
+     * the serialization itself. The items are listed in the same order used
+     * by saveText().
      *
-     * \sa Component::saveData()
+     * \sa SchematicSnapshot
      */
-    void FormatXmlSchematic::saveComponents(Caneda::XmlWriter *writer) const
+    SchematicSnapshot FormatXmlSchematic::snapshot() const
     {
-        QList<QGraphicsItem*> items = graphicsScene()->items();
-        QList<Component*> components = filterItems<Component>(items);
+        SchematicSnapshot snapshot;
 
-        if(!components.isEmpty()) {
-            writer->writeStartElement("components");
-            foreach(Component *c, components) {
-                c->saveData(writer);
+        foreach(QGraphicsItem *item, graphicsScene()->items()) {
+            Component *component = canedaitem_cast<Component*>(item);
+            PortSymbol *portSymbol = canedaitem_cast<PortSymbol*>(item);
+            Wire *wire = canedaitem_cast<Wire*>(item);
+            Painting *painting = canedaitem_cast<Painting*>(item);
+
+            if(component) {
+                snapshot.components << component->snapshot();
+            }
+            else if(portSymbol) {
+                snapshot.ports << portSymbol->snapshot();
+            }
+            else if(wire) {
+                snapshot.wires << wire->snapshot();
+            }
+            else if(painting) {
+                QString fragment;
+                Caneda::XmlWriter writer(&fragment);
+                painting->saveData(&writer);
+                snapshot.paintings << fragment;
             }
-            writer->writeEndElement(); //</components>
         }
+
+        return snapshot;
     }
 
     /*!
-     * \brief Saves the scene ports to an XmlWriter.
-     *
-     * This method saves all scene ports to an XmlWriter. To do so, it takes
-     * each PortSymbol from the scene, and saves the data using the
-     * PortSymbol::saveData() method.
+     * \brief Serializes the snapshot, in the format used by
+     * FormatXmlSchematic::save().
      *
-     * \param writer XmlWriter responsible for writing the xml data.
-     *
-     * \sa PortSymbol::saveData()
+     * Not only scene sections are created (components, paintings, etc) but
+     * also file header information, for example document version and name.
+     * This method only uses the snapshot data, so it can run in any thread.
      */
-    void FormatXmlSchematic::savePorts(Caneda::XmlWriter *writer) const
+    QString SchematicSnapshot::toText() const
     {
-        QList<QGraphicsItem*> items = graphicsScene()->items();
-        QList<PortSymbol*> portSymbols = filterItems<PortSymbol>(items);
+        QString retVal;
+        Caneda::XmlWriter *writer = new Caneda::XmlWriter(&retVal);
+        writer->setAutoFormatting(true);
 
-        if(!portSymbols.isEmpty()) {
+        // Fist we start the document and write current version
+        writer->writeStartDocument();
+        writer->writeDTD(QString("<!DOCTYPE caneda>"));
+        writer->writeStartElement("caneda");
+        writer->writeAttribute("version", Caneda::version());
+
+        // Now we copy all the elements and properties in the schematic
+        if(!components.isEmpty()) {
+            writer->writeStartElement("components");
+            foreach(const ComponentSnapshot &c, components) {
+                c.write(writer);
+            }
+            writer->writeEndElement(); //</components>
+        }
+
+        if(!ports.isEmpty()) {
             writer->writeStartElement("ports");
-            foreach(PortSymbol *p, portSymbols) {
-                p->saveData(writer);
+            foreach(const PortSymbolSnapshot &p, ports) {
+                p.write(writer);
             }
             writer->writeEndElement(); //</ports>
         }
-    }
-
-    /*!
-     * \brief Saves the scene wires to an XmlWriter.
-     *
-     * This method saves all scene wires to an XmlWriter. To do so, it takes
-     * each Wire from the scene, and saves the data using the Wire::saveData()
-     * method.
-     *
-     * \param writer XmlWriter responsible for writing the xml data.
-     *
-     * \sa Wire::saveData()
-     */
-    void FormatXmlSchematic::saveWires(Caneda::XmlWriter *writer) const
-    {
-        QList<QGraphicsItem*> items = graphicsScene()->items();
-        QList<Wire*> wires = filterItems<Wire>(items);
 
         if(!wires.isEmpty()) {
             writer->writeStartElement("wires");
-            foreach(Wire *w, wires) {
-                w->saveData(writer);
+            foreach(const WireSnapshot &w, wires) {
+                w.write(writer);
             }
             writer->writeEndElement(); //</wires>
         }
-    }
-
-    /*!
-     * \brief Saves the scene paintings to an XmlWriter.
-     *
-     * This method saves all scene paintings to an XmlWriter. To do so, it
-     * takes each Painting from the scene, and saves the data using the
-     * GraphicsItem::saveData() method.
-     *
-     * \param writer XmlWriter responsible for writing the xml data.
-     *
-     * \sa GraphicsItem::saveData()
-     */
-    void FormatXmlSchematic::savePaintings(Caneda::XmlWriter *writer) const
-    {
-        QList<QGraphicsItem*> items = graphicsScene()->items();
-        QList<Painting*> paintings = filterItems<Painting>(items);
 
+        // The painting fragments are copied token by token, so that they
+        // are indented as the rest of the document
         if(!paintings.isEmpty()) {
             writer->writeStartElement("paintings");
-            foreach(Painting *p, paintings) {
-                p->saveData(writer);
+            foreach(const QString &fragment, paintings) {
+                QXmlStreamReader reader(fragment);
+                while(!reader.atEnd()) {
+                    reader.readNext();
+                    if(reader.isStartElement() || reader.isEndElement() ||
+                            reader.isCharacters()) {
+                        writer->writeCurrentToken(reader);
+                    }
+                }
             }
             writer->writeEndElement(); //</paintings>
         }
+
+        // Finally we finish the document
+        writer->writeEndDocument(); //</caneda>
+
+        delete writer;
+        return retVal;
     }
 
     /*!
@@ -898,7 +894,7 @@ namespace Caneda
      */
     void FormatXmlSymbol::loadSymbol(Caneda::XmlReader *reader) const
     {
-        QPainterPath data;
+        SymbolGeometry data;
 
         while(!reader->atEnd()) {
             reader->readNext();
@@ -918,25 +914,22 @@ namespace Caneda
                     graphicsScene()->addItem(painting);
                 }
                 else if(component()) {
-                    // We are opening the file as a component to include it in a library
-                    QString name = reader->attributes().value("name").toString();
-                    Painting *newSymbol = Painting::fromName(name);
-                    newSymbol->loadData(reader);
-
-                    QRectF rect = newSymbol->paintingRect();
-                    rect.moveTo(newSymbol->pos());
-                    data.addPath(newSymbol->shapeForRect(rect));
-
-                    delete newSymbol;
+                    // We are opening the file as a component to include it in a library.
+                    // Decode the geometry directly, without creating Painting items.
+                    data.loadPainting(reader);
                 }
 
             }
         }
 
-        // If we are opening the file as a component, register the recreated QPainterPath
+        // If we are opening the file as a component, register the compiled
+        // geometry. Component files are stored in the library directory.
         if(component()) {
             LibraryManager *libraryManager = LibraryManager::instance();
-            libraryManager->registerComponent(component()->name, component()->library, data);
+            component()->symbol = libraryManager->registerComponent(component()->name,
+                                                                    component()->library,
+                                                                    QFileInfo(m_fileName).absolutePath(),
+                                                                    data);
         }
     }
 
@@ -1333,6 +1326,22 @@ namespace Caneda
         return true;
     }
 
+    /*!
+     *  \brief Sets the value used in the netlist for a property
+     *
+     *  The netlists generated afterwards use \a value instead of the
+     *  current value of the \a property of \a component, which is not
+     *  modified. This allows, for example, generating the netlist template
+     *  of a parameter sweep without editing the schematic.
+     *
+     *  \sa SweepRunner::prepare()
+     */
+    void FormatSpice::setPropertyOverride(Component *component, const QString &property,
+                                          const QString &value)
+    {
+        m_overrides[component][property] = value;
+    }
+
     GraphicsScene *FormatSpice::graphicsScene() const
     {
         return m_schematicDocument ? m_schematicDocument->graphicsScene() : 0;
@@ -1361,19 +1370,94 @@ namespace Caneda
      *  used for the spice netlist. The set of rules used for generating the
      *  netlist from the model is specified in \ref ModelsFormat.
      *
-     *  \sa generateNetlistTopology(), \ref ModelsFormat
+     *  The netlist is generated incrementally, using the NetlistCache of the
+     *  scene: only the components changed since the last generation are
+     *  parsed again.
+     *
+     *  \sa generateNetlistTopology(), NetlistCache, \ref ModelsFormat
      */
     QString FormatSpice::generateNetlist()
+    {
+        QStringList schematicsList;
+        QString retVal;
+
+        if(m_overrides.isEmpty()) {
+            retVal = generateNetlist(graphicsScene()->netlistCache(), &schematicsList);
+        }
+        else {
+            // The fragments with overridden values are generated in a copy
+            // of the cache, to keep those of the scene valid.
+            NetlistCache cache = *graphicsScene()->netlistCache();
+            foreach(Component *c, m_overrides.keys()) {
+                cache.invalidateComponent(c);
+            }
+            retVal = generateNetlist(&cache, &schematicsList);
+        }
+
+        // ************************************************************
+        // Create the needed recursive netlist documents
+        // ************************************************************
+        if(!schematicsList.isEmpty()) {
+            for(int i=0; i<schematicsList.size(); i++){
+
+                SchematicDocument *document = new SchematicDocument();
+                document->setFileName(schematicsList.at(i));
+
+                if(document->load()) {
+                    // Export the schematic to a spice netlist
+                    FormatSpice *format = new FormatSpice(document);
+                    format->save();
+                }
+
+                delete document;
+            }
+        }
+
+        return retVal;
+    }
+
+    /*!
+     *  \brief Generate netlist with the fragments of \a cache
+     *
+     *  Only the fragments of the components that changed, or whose nets
+     *  changed, are generated again. The fragments are then joined in the
+     *  order of the components in the scene, and the models, subcircuits
+     *  and directives of all of them are appended at the end of the file.
+     *
+     *  \param cache Cache to be used and updated. An empty cache generates
+     *  the whole netlist from scratch.
+     *  \param schematicsList List to fill with the schematics needed for
+     *  recursive netlists, may be 0.
+     *
+     *  \sa generateComponentNetlist()
+     */
+    QString FormatSpice::generateNetlist(NetlistCache *cache, QStringList *schematicsList)
     {
         LibraryManager *libraryManager = LibraryManager::instance();
         QList<QGraphicsItem*> items = graphicsScene()->items();
         QList<Component*> components = filterItems<Component>(items);
-        PortsNetlist netlist = generateNetlistTopology();
+
+        // The fragments include the path of the schematic
+        const QString filePath = QFileInfo(m_schematicDocument->fileName()).absolutePath();
+        if(cache->filePath() != filePath) {
+            cache->invalidateAll();
+            cache->setFilePath(filePath);
+        }
+
+        if(!cache->isTopologyValid()) {
+            cache->setNets(generateNetlistTopology());
+        }
+        else {
+            cache->updateNets();
+        }
+        cache->prune(components);
+
+        const QHash<Port*, QString> &nets = cache->nets();
 
         QStringList modelsList;
         QStringList subcircuitsList;
         QStringList directivesList;
-        QStringList schematicsList;
+        QSet<QString> modelsSet, subcircuitsSet, directivesSet, schematicsSet;
 
         // Start the document and write the header
         QString retVal;
@@ -1386,170 +1470,50 @@ namespace Caneda
         // cascadable commands and if control statements correct extraction.
         foreach(Component *c, components) {
 
-            // Get the spice model (multiple models may be available)
-            QString model = c->model("spice");
-
-            // ************************************************************
-            // Parse and replace the simple commands (e.g. label)
-            // ************************************************************
-            model.replace("%label", c->label());
-            model.replace("%n", "\n");
-
-            QString path = libraryManager->library(c->library())->libraryPath();
-            model.replace("%librarypath", path);
-
-            path = QFileInfo(m_schematicDocument->fileName()).absolutePath();
-            model.replace("%filepath", path);
-
-            // ************************************************************
-            // Parse and replace the commands with parameters
-            // ************************************************************
-            QStringList commands;
-            QRegularExpression re;
-            QRegularExpressionMatchIterator it;
-
-            // ************************************************************
-            // First parse the cascadable commands (e.g. properties)
-            // ************************************************************
-            commands.clear();
-            re.setPattern("(%\\w+\{([\\w+-]+)})");
-            it = re.globalMatch(model);
-            while (it.hasNext()) {
-                QRegularExpressionMatch match = it.next();
-                commands << match.captured(0);
-            }
-
-            // For each command replace the parameter with the correct value
-            for(int i=0; i<commands.size(); i++){
-
-                // Extract the parameters, removing the comand (including the
-                // "{" and the last character "}")
-                QString parameter = commands.at(i);
-                parameter.remove(QRegularExpression("(%\\w+\{)")).chop(1);
-
-                if(commands.at(i).startsWith("%port")){
-                    foreach(Port *_port, c->ports()) {
-                        if(_port->name() == parameter) {
-                            // Found the port, now look for its netlist name
-                            for(int j = 0; j < netlist.size(); ++j) {
-                                if(netlist.at(j).first == _port) {
-                                    model.replace(commands.at(i), netlist.at(j).second);
-                                }
-                            }
-                        }
-                    }
-                }
-                else if(commands.at(i).startsWith("%property")){
-                    model.replace(commands.at(i), c->properties()->propertyValue(parameter));
-                }
-            }
-
-            // ************************************************************
-            // Parse if control statements
-            // ************************************************************
-            commands.clear();
-            re.setPattern("(%\\w+\{([\\w =+-,]*)})");
-            it = re.globalMatch(model);
-            while (it.hasNext()) {
-                QRegularExpressionMatch match = it.next();
-                commands << match.captured(0);
-            }
-
-            // For each command replace the parameter with the correct value
-            for(int i=0; i<commands.size(); i++){
-
-                // Extract the parameters, removing the comand (including the
-                // "{" and the last character "}")
-                QString parameter = commands.at(i);
-                parameter.remove(QRegularExpression("(%\\w+\{)")).chop(1);
-                QStringList controlStrings = parameter.split(",");
+            QString libraryPath = libraryManager->libraryPath(c->symbolHandle());
 
-                if(commands.at(i).startsWith("%if")){
-                    if(!controlStrings.at(0).isEmpty() && controlStrings.size() > 1) {
-                        model.replace(commands.at(i), controlStrings.at(1));
-                    }
-                    else {
-                        model.remove(commands.at(i));
-                    }
-                }
+            QStringList portNets;
+            foreach(Port *_port, c->ports()) {
+                portNets << nets.value(_port);
             }
 
-            // ************************************************************
-            // Now parse the non-cascadable commands (e.g. models), which may
-            // have a cascadable command as an argument (e.g. properties).
-            // ************************************************************
-            commands.clear();
-            re.setPattern("(%\\w+\{([\\w =+-\\\\(\\\\)\\n\\*\{}]+)})");
-            it = re.globalMatch(model);
-            while (it.hasNext()) {
-                QRegularExpressionMatch match = it.next();
-                commands << match.captured(0);
+            NetlistFragment *fragment = cache->fragment(c);
+            if(!fragment->valid || fragment->nets != portNets || fragment->libraryPath != libraryPath) {
+                generateComponentNetlist(c, nets, libraryPath, filePath, fragment);
+                fragment->nets = portNets;
             }
 
-            // For each command replace the parameter with the correct value
-            for(int i=0; i<commands.size(); i++){
-
-                // Extract the parameters, removing the comand (including the
-                // "{" and the last character "}")
-                QString parameter = commands.at(i);
-                parameter.remove(QRegularExpression("(%\\w+\{)")).chop(1);
-
-                if(commands.at(i).startsWith("%model")){
-
-                    // Models should be added to a temporal list to be included
-                    // only once at the end of the spice file.
-                    if(!modelsList.contains(parameter)) {
-                        modelsList << parameter;
-                    }
-
-                    model.remove(commands.at(i));
-
+            // Add the model and a newline to the file
+            retVal.append(fragment->text + "\n");
+
+            // Models, subcircuits, directives and schematics are included
+            // only once, in order of appearance.
+            foreach(const QString &model, fragment->models) {
+                if(!modelsSet.contains(model)) {
+                    modelsSet.insert(model);
+                    modelsList << model;
                 }
-                else if(commands.at(i).startsWith("%subcircuit")){
-
-                    // Subcircuits should be added to a temporal list to be included
-                    // only once at the end of the spice file.
-                    if(!subcircuitsList.contains(parameter)) {
-                        subcircuitsList << parameter;
-                    }
-
-                    model.remove(commands.at(i));
-
+            }
+            foreach(const QString &subcircuit, fragment->subcircuits) {
+                if(!subcircuitsSet.contains(subcircuit)) {
+                    subcircuitsSet.insert(subcircuit);
+                    subcircuitsList << subcircuit;
                 }
-                else if(commands.at(i).startsWith("%directive")){
-
-                    // Directives should be added to a temporal list to be included
-                    // only once at the end of the spice file.
-                    if(!directivesList.contains(parameter)) {
-                        directivesList << parameter;
-                    }
-
-                    model.remove(commands.at(i));
-
+            }
+            foreach(const QString &directive, fragment->directives) {
+                if(!directivesSet.contains(directive)) {
+                    directivesSet.insert(directive);
+                    directivesList << directive;
                 }
             }
-
-            // ************************************************************
-            // Now parse the generateNetlist command, which creates a
-            // temporal list of schematics needed for recursive netlists
-            // generation (for recursive simulations).
-            // ************************************************************
-            if(model.contains("%generateNetlist")){
-
-                QFileInfo info(c->filename());
-                QString baseName = info.completeBaseName();
-                QString path = libraryManager->library(c->library())->libraryPath();
-                QString schematic = path + "/" + baseName + ".xsch";
-
-                if(!schematicsList.contains(schematic)) {
-                    schematicsList << schematic;
+            if(schematicsList) {
+                foreach(const QString &schematic, fragment->schematics) {
+                    if(!schematicsSet.contains(schematic)) {
+                        schematicsSet.insert(schematic);
+                        *schematicsList << schematic;
+                    }
                 }
-
-                model.remove("%generateNetlist");
             }
-
-            // Add the model and a newline to the file
-            retVal.append(model + "\n");
         }
 
         // ************************************************************
@@ -1560,7 +1524,7 @@ namespace Caneda
         if(!modelsList.isEmpty()) {
             retVal.append("\n* Device models.\n");
             for(int i=0; i<modelsList.size(); i++){
-                retVal.append(".model " + modelsList.at(i) + "\n");
+                retVal.append(removeMultipleSpaces(".model " + modelsList.at(i) + "\n"));
             }
         }
 
@@ -1568,8 +1532,8 @@ namespace Caneda
         if(!subcircuitsList.isEmpty()) {
             retVal.append("\n* Subcircuits models.\n");
             for(int i=0; i<subcircuitsList.size(); i++){
-                retVal.append(".subckt " + subcircuitsList.at(i) + "\n"
-                              + ".ends" + "\n");
+                retVal.append(removeMultipleSpaces(".subckt " + subcircuitsList.at(i) + "\n"
+                              + ".ends" + "\n"));
             }
         }
 
@@ -1577,52 +1541,227 @@ namespace Caneda
         if(!directivesList.isEmpty()) {
             retVal.append("\n* Spice directives.\n");
             for(int i=0; i<directivesList.size(); i++){
-                retVal.append(directivesList.at(i) + "\n");
+                retVal.append(removeMultipleSpaces(directivesList.at(i) + "\n"));
             }
         }
 
+        return retVal;
+    }
+
+    /*!
+     *  \brief Generate the netlist fragment of one component
+     *
+     *  Parses the spice model of the component, replacing its label,
+     *  properties and port nets, and collects the models, subcircuits,
+     *  directives and schematics it requires.
+     *
+     *  \param c Component to be parsed.
+     *  \param nets Net of each port.
+     *  \param libraryPath Path of the library of the component.
+     *  \param filePath Path of the schematic.
+     *  \param fragment Fragment to be filled.
+     */
+    void FormatSpice::generateComponentNetlist(Component *c, const QHash<Port*, QString> &nets,
+                                               const QString &libraryPath, const QString &filePath,
+                                               NetlistFragment *fragment)
+    {
+        fragment->models.clear();
+        fragment->subcircuits.clear();
+        fragment->directives.clear();
+        fragment->schematics.clear();
+
+        // Get the spice model (multiple models may be available)
+        QString model = c->model("spice");
+
         // ************************************************************
-        // Create the needed recursive netlist documents
+        // Parse and replace the simple commands (e.g. label)
         // ************************************************************
-        if(!schematicsList.isEmpty()) {
-            for(int i=0; i<schematicsList.size(); i++){
+        model.replace("%label", c->label());
+        model.replace("%n", "\n");
 
-                SchematicDocument *document = new SchematicDocument();
-                document->setFileName(schematicsList.at(i));
+        model.replace("%librarypath", libraryPath);
+        model.replace("%filepath", filePath);
 
-                if(document->load()) {
-                    // Export the schematic to a spice netlist
-                    FormatSpice *format = new FormatSpice(document);
-                    format->save();
+        // ************************************************************
+        // Parse and replace the commands with parameters
+        // ************************************************************
+        QStringList commands;
+        QRegularExpression re;
+        QRegularExpressionMatchIterator it;
+
+        // ************************************************************
+        // First parse the cascadable commands (e.g. properties)
+        // ************************************************************
+        commands.clear();
+        re.setPattern("(%\\w+\{([\\w+-]+)})");
+        it = re.globalMatch(model);
+        while (it.hasNext()) {
+            QRegularExpressionMatch match = it.next();
+            commands << match.captured(0);
+        }
+
+        // For each command replace the parameter with the correct value
+        for(int i=0; i<commands.size(); i++){
+
+            // Extract the parameters, removing the comand (including the
+            // "{" and the last character "}")
+            QString parameter = commands.at(i);
+            parameter.remove(QRegularExpression("(%\\w+\{)")).chop(1);
+
+            if(commands.at(i).startsWith("%port")){
+                foreach(Port *_port, c->ports()) {
+                    if(_port->name() == parameter && nets.contains(_port)) {
+                        // Found the port, now replace its netlist name
+                        model.replace(commands.at(i), nets.value(_port));
+                    }
                 }
+            }
+            else if(commands.at(i).startsWith("%property")){
+                model.replace(commands.at(i),
+                              m_overrides.value(c).value(parameter, c->properties()->propertyValue(parameter)));
+            }
+        }
 
-                delete document;
+        // ************************************************************
+        // Parse if control statements
+        // ************************************************************
+        commands.clear();
+        re.setPattern("(%\\w+\{([\\w =+-,]*)})");
+        it = re.globalMatch(model);
+        while (it.hasNext()) {
+            QRegularExpressionMatch match = it.next();
+            commands << match.captured(0);
+        }
+
+        // For each command replace the parameter with the correct value
+        for(int i=0; i<commands.size(); i++){
+
+            // Extract the parameters, removing the comand (including the
+            // "{" and the last character "}")
+            QString parameter = commands.at(i);
+            parameter.remove(QRegularExpression("(%\\w+\{)")).chop(1);
+            QStringList controlStrings = parameter.split(",");
+
+            if(commands.at(i).startsWith("%if")){
+                if(!controlStrings.at(0).isEmpty() && controlStrings.size() > 1) {
+                    model.replace(commands.at(i), controlStrings.at(1));
+                }
+                else {
+                    model.remove(commands.at(i));
+                }
             }
         }
 
-        // Remove multiple white spaces to clean up the file
-        QRegularExpression re(" {2,}");
-        retVal.replace(re, " ");
+        // ************************************************************
+        // Now parse the non-cascadable commands (e.g. models), which may
+        // have a cascadable command as an argument (e.g. properties).
+        // ************************************************************
+        commands.clear();
+        re.setPattern("(%\\w+\{([\\w =+-\\\\(\\\\)\\n\\*\{}]+)})");
+        it = re.globalMatch(model);
+        while (it.hasNext()) {
+            QRegularExpressionMatch match = it.next();
+            commands << match.captured(0);
+        }
 
-        return retVal;
+        // For each command replace the parameter with the correct value
+        for(int i=0; i<commands.size(); i++){
+
+            // Extract the parameters, removing the comand (including the
+            // "{" and the last character "}")
+            QString parameter = commands.at(i);
+            parameter.remove(QRegularExpression("(%\\w+\{)")).chop(1);
+
+            if(commands.at(i).startsWith("%model")){
+
+                // Models should be added to a temporal list to be included
+                // only once at the end of the spice file.
+                if(!fragment->models.contains(parameter)) {
+                    fragment->models << parameter;
+                }
+
+                model.remove(commands.at(i));
+
+            }
+            else if(commands.at(i).startsWith("%subcircuit")){
+
+                // Subcircuits should be added to a temporal list to be included
+                // only once at the end of the spice file.
+                if(!fragment->subcircuits.contains(parameter)) {
+                    fragment->subcircuits << parameter;
+                }
+
+                model.remove(commands.at(i));
+
+            }
+            else if(commands.at(i).startsWith("%directive")){
+
+                // Directives should be added to a temporal list to be included
+                // only once at the end of the spice file.
+                if(!fragment->directives.contains(parameter)) {
+                    fragment->directives << parameter;
+                }
+
+                model.remove(commands.at(i));
+
+            }
+        }
+
+        // ************************************************************
+        // Now parse the generateNetlist command, which creates a
+        // temporal list of schematics needed for recursive netlists
+        // generation (for recursive simulations).
+        // ************************************************************
+        if(model.contains("%generateNetlist")){
+
+            QFileInfo info(c->filename());
+            QString baseName = info.completeBaseName();
+            QString schematic = libraryPath + "/" + baseName + ".xsch";
+
+            if(!fragment->schematics.contains(schematic)) {
+                fragment->schematics << schematic;
+            }
+
+            model.remove("%generateNetlist");
+        }
+
+        // Remove multiple white spaces to clean up the file. As no run of
+        // spaces spans several lines, this is the same as cleaning up the
+        // whole file at once.
+        fragment->text = removeMultipleSpaces(model);
+        fragment->libraryPath = libraryPath;
+        fragment->valid = true;
+    }
+
+    //! \brief Replaces runs of white spaces in \a text by a single space.
+    QString FormatSpice::removeMultipleSpaces(QString text)
+    {
+        static const QRegularExpression re(" {2,}");
+        return text.replace(re, " ");
     }
 
     /*!
      *  \brief Generate netlist net numbers
      *
      *  Iterate over all ports, to group all connected ports under
-     *  the same name (name = equiId). This name or net number must
-     *  be used afterwads by all component ports during netlist
-     *  generation.
+     *  the same net. The nets are numbered (and named after their port
+     *  symbols) by the NetlistCache, and these names must be used
+     *  afterwads by all component ports during netlist generation.
      *
      *  We use all connected ports (including those connected by wires),
      *  instead of connected wires during netlist generation. This allows
      *  to create a netlist node even on those places not connected by
      *  wires (for example when connecting two components together).
      *
-     *  \sa saveComponents(), Port::getEquipotentialPorts()
+     *  This walks the whole schematic, and is only used the first time the
+     *  netlist of a scene is generated. Afterwards, the NetlistCache only
+     *  walks the nets changed by each edit.
+     *
+     *  \return The ports of each net.
+     *
+     *  \sa generateNetlist(), NetlistCache::setNets(), Port::getEquipotentialPorts()
      */
-    PortsNetlist FormatSpice::generateNetlistTopology()
+    QList<QList<Port*> > FormatSpice::generateNetlistTopology()
     {
         /*! \todo Investigate: If we use QList<GraphicsItem*> canedaItems = filterItems<Ports>(items);
          *  some phantom ports appear, and seem to be uninitialized, generating an ugly crash. Hence
@@ -1635,9 +1774,8 @@ namespace Caneda
             ports << i->ports();
         }
 
-        int equiId = 1;
-        PortsNetlist netlist;
-        QList<Port*> parsedPorts;
+        QList<QList<Port*> > nets;
+        QSet<Port*> parsedPorts;
 
         foreach(Port *p, ports) {
             if(parsedPorts.contains(p)) {
@@ -1647,60 +1785,13 @@ namespace Caneda
             QList<Port*> equi;
             p->getEquipotentialPorts(equi);
             foreach(Port *_port, equi) {
-                netlist.append(qMakePair(_port, QString::number(equiId)));
+                parsedPorts.insert(_port);
             }
 
-            equiId++;
-            parsedPorts += equi;
+            nets << equi;
         }
 
-        replacePortNames(&netlist);
-
-        return netlist;
-    }
-
-    /*!
-     * \brief Replace net names in the netlist by those specified by
-     * portSymbols.
-     *
-     * Iterate over all nets in the netlist, replacing those names that
-     * correspond to the ones selected by the user using PortSymbols.
-     * Take special care of the ground nets, that must be named "0" to
-     * be complatible with the spice netlist format.
-     *
-     * \param netlist Netlist which is to be used in PortSymbol names
-     * replacement.
-     *
-     * \sa PortSymbol, generateNetlistTopology()
-     */
-    void FormatSpice::replacePortNames(PortsNetlist *netlist)
-    {
-        QList<QGraphicsItem*> items = graphicsScene()->items();
-        QList<PortSymbol*> portSymbols = filterItems<PortSymbol>(items);
-
-        // Iterate over all PortSymbols
-        foreach(PortSymbol *p, portSymbols) {
-
-            // Given the port, look for its netlist name
-            QString netName;
-            for(int i = 0; i < netlist->size(); ++i) {
-                if(netlist->at(i).first == p->port()) {
-                    netName = netlist->at(i).second;
-                }
-            }
-
-            // Given the netlist name, rename all occurencies with the new name
-            for(int i = 0; i < netlist->size(); ++i) {
-                if(netlist->at(i).second == netName) {
-                    if(p->label().toLower() == "ground" || p->label().toLower() == "gnd") {
-                        netlist->replace(i, qMakePair(netlist->at(i).first, QString::number(0)));
-                    }
-                    else {
-                        netlist->replace(i, qMakePair(netlist->at(i).first, p->label()));
-                    }
-                }
-            }
-        }
+        return nets;
     }
 
 
@@ -1708,9 +1799,10 @@ namespace Caneda
      *                         FormatRawSimulation                           *
      *************************************************************************/
     //! \brief Constructor.
-    FormatRawSimulation::FormatRawSimulation(SimulationDocument *document) :
+    FormatRawSimulation::FormatRawSimulation(SimulationDocument *document, ChartScene *scene) :
         QObject(document),
-        m_simulationDocument(document)
+        m_simulationDocument(document),
+        m_chartScene(scene)
     {
     }
 
@@ -1734,6 +1826,10 @@ namespace Caneda
         parseFile(&in);  // Parse the raw file
         file.close();
 
+        // Reset the tables used by the measurement cursors (built on the
+        // first measurement of each waveform).
+        ChartSeries::updateIndexes(scene->items());
+
         return true;
     }
 
@@ -1797,13 +1893,8 @@ namespace Caneda
                             plotCurves.append(curve);   // Append new curve to the list
                         }
                         else {
-                            // If dealing with complex numbers, create an array for the magnitude and another one for the phase
-                            ChartSeries *curve = new ChartSeries("Mag(" + tok.at(1) + ")");       // tok.at(1) = name
-                            ChartSeries *curvePhase = new ChartSeries("Phase(" + tok.at(1) + ")");  // tok.at(1) = name
-                            curve->setType("magnitude");         // type of curve (magnitude, phase, etc)
-                            curvePhase->setType("phase");        // type of curve (magnitude, phase, etc)
-                            plotCurves.append(curve);            // Append new curve to the list
-                            plotCurvesPhase.append(curvePhase);  // Append new curve to the list
+                            // If dealing with complex numbers, the curves of each component are created with the data
+                            plotNames.append(tok.at(1));  // tok.at(1) = name
                         }
 
                     }
@@ -1833,99 +1924,45 @@ namespace Caneda
      * iso-8859-1, etc), and interpreting special characters as for example
      * newlines.
      *
-     * \sa parseBinaryData(), parseFile()
+     * \sa parseBinaryData(), parseFile(), addCurves()
      */
     void FormatRawSimulation::parseAsciiData(QTextStream *file, const int nvars, const int npoints, const bool real)
     {
-        // Create the arrays to deal with the data
-        QList<double*> dataSamples;               // List of curve's magnitude data. Once filled, used to set data in plotCurves.
-        QList<double*> dataSamplesPhase;          // List of curve's phase data. Used for complex numbers. Once filled, used to set data in plotCurves.
+        // Create the arrays to deal with the data. The data is stored as
+        // read: one array per variable for real data, and two (real and
+        // imaginary parts) for complex data.
+        QList<QVector<double> > dataReal;       // List of curve's real data.
+        QList<QVector<double> > dataImaginary;  // List of curve's imaginary data. Used for complex numbers.
+        QList<double*> columnsReal;
+        QList<double*> columnsImaginary;
 
         for(int i = 0; i < nvars; i++) {
-            if(real) {
-                // If dealing with real numbers, create an array only for the magnitude and use the provided curve types
-                double *data = new double[npoints];  // Create new dataset
-                dataSamples.append(data);  // Append new data set to the list
-            }
-            else {
-                // If dealing with complex numbers, create an array for the magnitude and another one for the phase
-                double *data = new double[npoints];  // Create new dataset
-                double *dataPhase = new double[npoints];  // Create new dataset
-                dataSamples.append(data);  // Append new data set to the list
-                dataSamplesPhase.append(dataPhase);  // Append new data set to the list
+            dataReal.append(QVector<double>(npoints));
+            columnsReal.append(dataReal.last().data());
+            if(!real) {
+                dataImaginary.append(QVector<double>(npoints));
+                columnsImaginary.append(dataImaginary.last().data());
             }
         }
 
         // Read the data
-        if(real) {
-            // The data is of type real
-            for(int i = 0; i < npoints; i++){
-                for(int j = 0; j < nvars; j++){
-                    QString line = file->readLine();
-                    dataSamples[j][i] = line.split("\t").last().toDouble();
-                }
-            }
+        for(int i = 0; i < npoints; i++){
+            for(int j = 0; j < nvars; j++){
+                QString line = file->readLine();
+                line = line.split("\t").last();  // Get the numeric data
 
-            // Avoid the first var, as it is the time base for the rest
-            // of the curves.
-            for(int i = 1; i < nvars; i++){
-                // Copy the data into the curves
-                plotCurves[i]->setSamples(dataSamples[0], dataSamples[i], npoints);
-                // Add the curve to the scene
-                chartScene()->addItem(plotCurves[i]);
-            }
-        }
-        else {
-            // The data is of type complex
-            double real = 0;
-            double imaginary = 0;
-            double magnitude = 0;
-            double phase = 0;
-
-            // Read the data values, converting the complex data into
-            // magnitude and phase data.
-            for(int i = 0; i < npoints; i++){
-                for(int j = 0; j < nvars; j++){
-                    QString line = file->readLine();
-                    QStringList tok = line.split("\t");
-                    line = tok.last();  // Get the complex numeric data
-                    tok = line.split(",");  // Split real and imaginary part
-
-                    real = tok.first().toDouble();  // Get the real part
-                    imaginary = tok.last().toDouble();  // Get the imaginary part
-
-                    magnitude = qSqrt(real*real + imaginary*imaginary);  // Calculate the magnitude part
-                    phase = qAtan(imaginary/real) * 180/M_PI;  // Calculate the phase part
-
-                    dataSamples[j][i] = magnitude;
-                    dataSamplesPhase[j][i] = phase;
+                if(real) {
+                    columnsReal[j][i] = line.toDouble();
                 }
-            }
-
-            // Convert the magnitude values into dB ( dB = 20*log10(V) ).
-            // Avoid the first var (var=0), as it is the frequency base
-            // for the rest of the curves.
-            for(int i = 0; i < npoints; i++){
-                for(int j = 1; j < nvars; j++){
-                    dataSamples[j][i] = 20*log10(dataSamples[j][i]);
+                else {
+                    QStringList tok = line.split(",");  // Split real and imaginary part
+                    columnsReal[j][i] = tok.first().toDouble();  // Get the real part
+                    columnsImaginary[j][i] = tok.last().toDouble();  // Get the imaginary part
                 }
             }
-
-            // Avoid the first var, as it is the frequency base for the
-            // rest of the curves.
-            for(int i = 1; i < nvars; i++){
-                // Copy the data into the curves
-                plotCurves[i]->setSamples(dataSamples[0], dataSamples[i], npoints);
-                plotCurvesPhase[i]->setSamples(dataSamples[0], dataSamplesPhase[i], npoints);
-                // Add the curve to the scene
-                chartScene()->addItem(plotCurves[i]);
-                chartScene()->addItem(plotCurvesPhase[i]);
-            }
         }
 
-        // Delete the temporal data arrays
-        qDeleteAll(dataSamples);
-        qDeleteAll(dataSamplesPhase);
+        addCurves(dataReal, dataImaginary);
     }
 
     /*!
@@ -1938,26 +1975,24 @@ namespace Caneda
      * be read from the file is composed by float numbers of 64 bit precision,
      * little endian format.
      *
-     * \sa parseAsciiData(), parseFile()
+     * \sa parseAsciiData(), parseFile(), addCurves()
      */
     void FormatRawSimulation::parseBinaryData(QTextStream *file, const int nvars, const int npoints, const bool real)
     {
-        // Create the arrays to deal with the data
-        QList<double*> dataSamples;               // List of curve's magnitude data. Once filled, used to set data in plotCurves.
-        QList<double*> dataSamplesPhase;          // List of curve's phase data. Used for complex numbers. Once filled, used to set data in plotCurves.
+        // Create the arrays to deal with the data. The data is stored as
+        // read: one array per variable for real data, and two (real and
+        // imaginary parts) for complex data.
+        QList<QVector<double> > dataReal;       // List of curve's real data.
+        QList<QVector<double> > dataImaginary;  // List of curve's imaginary data. Used for complex numbers.
+        QList<double*> columnsReal;
+        QList<double*> columnsImaginary;
 
         for(int i = 0; i < nvars; i++) {
-            if(real) {
-                // If dealing with real numbers, create an array only for the magnitude and use the provided curve types
-                double *data = new double[npoints];  // Create new dataset
-                dataSamples.append(data);  // Append new data set to the list
-            }
-            else {
-                // If dealing with complex numbers, create an array for the magnitude and another one for the phase
-                double *data = new double[npoints];  // Create new dataset
-                double *dataPhase = new double[npoints];  // Create new dataset
-                dataSamples.append(data);  // Append new data set to the list
-                dataSamplesPhase.append(dataPhase);  // Append new data set to the list
+            dataReal.append(QVector<double>(npoints));
+            columnsReal.append(dataReal.last().data());
+            if(!real) {
+                dataImaginary.append(QVector<double>(npoints));
+                columnsImaginary.append(dataImaginary.last().data());
             }
         }
 
@@ -1972,73 +2007,107 @@ namespace Caneda
         out.setFloatingPointPrecision(QDataStream::DoublePrecision);  // Use 64 bit precision (this shouldn't be neccessary as it is the default).
 
         // Read the data
-        if(real) {
-            // The data is of type real
-            for(int i = 0; i < npoints; i++){
-                for(int j = 0; j < nvars; j++){
-                    out >> dataSamples[j][i];
+        for(int i = 0; i < npoints; i++){
+            for(int j = 0; j < nvars; j++){
+                out >> columnsReal[j][i];  // Get the real part
+                if(!real) {
+                    out >> columnsImaginary[j][i];  // Get the imaginary part
                 }
             }
+        }
 
-            // Avoid the first var, as it is the time/frequency base
-            // for the rest of the curves.
-            for(int i = 1; i < nvars; i++){
-                // Copy the data into the curves
-                plotCurves[i]->setSamples(dataSamples[0], dataSamples[i], npoints);
-                // Add the curve to the scene
-                chartScene()->addItem(plotCurves[i]);
-            }
+        addCurves(dataReal, dataImaginary);
+    }
+
+    /*!
+     * \brief Set the data read into the curves, and add them to the scene.
+     *
+     * The first variable is the time/frequency base for the rest of the
+     * curves, and its array is implicitly shared among all of them.
+     *
+     * Complex (AC) data is not converted at load time. Each curve holds
+     * the raw real and imaginary parts (shared among all the curves of the
+     * same variable) and computes its component (magnitude, phase, etc)
+     * only when first displayed. Only the magnitude and phase curves are
+     * added, the rest of the components are created on demand (see
+     * ChartView::addDerivedTrace()).
+     *
+     * \param dataReal Real data of each variable.
+     * \param dataImaginary Imaginary data of each variable, empty for real
+     * (transient) data.
+     *
+     * \sa ComplexSeriesData
+     */
+    void FormatRawSimulation::addCurves(const QList<QVector<double> > &dataReal,
+                                        const QList<QVector<double> > &dataImaginary)
+    {
+        if(dataReal.isEmpty()) {
+            return;
         }
-        else {
-            // The data is of type complex
-            double real = 0;
-            double imaginary = 0;
-            double magnitude = 0;
-            double phase = 0;
-
-            // Read the data values, converting the complex data into
-            // magnitude and phase data.
-            for(int i = 0; i < npoints; i++){
-                for(int j = 0; j < nvars; j++){
-                    out >> real;  // Get the real part
-                    out >> imaginary;  // Get the imaginary part
-
-                    magnitude = qSqrt(real*real + imaginary*imaginary);  // Calculate the magnitude part
-                    phase = qAtan(imaginary/real) * 180/M_PI;  // Calculate the phase part
-
-                    dataSamples[j][i] = magnitude;
-                    dataSamplesPhase[j][i] = phase;
-                }
-            }
 
-            // Convert the magnitude values into dB ( dB = 20*log10(V) ).
-            // Avoid the first var (var=0), as it is the frequency base
-            // for the rest of the curves.
-            for(int i = 0; i < npoints; i++){
-                for(int j = 1; j < nvars; j++){
-                    dataSamples[j][i] = 20*log10(dataSamples[j][i]);
-                }
-            }
+        const QVector<double> &base = dataReal.first();
 
-            // Avoid the first var, as it is the time/frequency base
-            // for the rest of the curves.
-            for(int i = 1; i < nvars; i++){
+        if(dataImaginary.isEmpty()) {
+            // The data is of type real. Avoid the first var, as it is the
+            // time base for the rest of the curves.
+            for(int i = 1; i < dataReal.size(); i++){
                 // Copy the data into the curves
-                plotCurves[i]->setSamples(dataSamples[0], dataSamples[i], npoints);
-                plotCurvesPhase[i]->setSamples(dataSamples[0], dataSamplesPhase[i], npoints);
+                plotCurves[i]->setSamples(base, dataReal.at(i));
                 // Add the curve to the scene
                 chartScene()->addItem(plotCurves[i]);
-                chartScene()->addItem(plotCurvesPhase[i]);
             }
+
+            return;
         }
 
-        // Delete the temporal data arrays
-        qDeleteAll(dataSamples);
-        qDeleteAll(dataSamplesPhase);
+        addComplexCurves(chartScene(), plotNames, dataReal, dataImaginary);
+    }
+
+    /*!
+     * \brief Adds the curves of complex (ac) data to a scene.
+     *
+     * A magnitude and a phase curve are created for each variable. The
+     * additional components (Abs, UPhase, GD, Re and Im) are not added to
+     * the scene, but created from the raw data of the magnitude curve only
+     * when the user plots them (see ChartView::addDerivedTrace()).
+     *
+     * \param scene Scene to add the curves to.
+     * \param names Name of each variable, the first one being the frequency.
+     * \param dataReal Real part of each variable.
+     * \param dataImaginary Imaginary part of each variable.
+     *
+     * \sa ComplexSeriesData
+     */
+    void FormatRawSimulation::addComplexCurves(ChartScene *scene, const QStringList &names,
+                                               const QList<QVector<double> > &dataReal,
+                                               const QList<QVector<double> > &dataImaginary)
+    {
+        const QVector<double> &base = dataReal.first();
+
+        // Avoid the first var, as it is the frequency base for the rest of
+        // the curves.
+        for(int i = 1; i < dataReal.size(); i++){
+            ChartSeries *curve = new ChartSeries("Mag(" + names.at(i) + ")");
+            ChartSeries *curvePhase = new ChartSeries("Phase(" + names.at(i) + ")");
+            curve->setType("magnitude");    // type of curve (magnitude, phase, etc)
+            curvePhase->setType("phase");   // type of curve (magnitude, phase, etc)
+
+            curve->setData(new ComplexSeriesData(base, dataReal.at(i), dataImaginary.at(i),
+                                                 ComplexSeriesData::MagnitudeDb));
+            curvePhase->setData(new ComplexSeriesData(base, dataReal.at(i), dataImaginary.at(i),
+                                                      ComplexSeriesData::Phase));
+            // Add the curve to the scene
+            scene->addItem(curve);
+            scene->addItem(curvePhase);
+        }
     }
 
     ChartScene* FormatRawSimulation::chartScene() const
     {
+        if(m_chartScene) {
+            return m_chartScene;
+        }
+
         return m_simulationDocument ? m_simulationDocument->chartScene() : 0;
     }
 
@@ -22,6 +22,11 @@
 #define FILE_FORMATS_H
 
 #include "component.h"
+#include "idocument.h"
+#include "portsymbol.h"
+#include "wire.h"
+
+#include <QHash>
 
 // Forward declarations
 class QString;
@@ -33,13 +38,35 @@ namespace Caneda
     class ChartSeries;
     class ChartScene;
     class LayoutDocument;
+    class NetlistCache;
     class SchematicDocument;
     class SimulationDocument;
     class SymbolDocument;
     class XmlReader;
     class XmlWriter;
 
-    typedef QList<QPair<Port *, QString> > PortsNetlist;
+    struct NetlistFragment;
+
+    /*!
+     * \brief Copy of the contents of a schematic, see
+     * FormatXmlSchematic::snapshot().
+     *
+     * Components, ports and wires, which make up most of a schematic, are
+     * copied as plain values and implicitly shared data. Paintings are few
+     * and have many different kinds, so they are serialized into xml
+     * fragments when the snapshot is taken. The whole document is then
+     * generated by toText(), from any thread.
+     */
+    class SchematicSnapshot : public DocumentSnapshot
+    {
+    public:
+        QString toText() const;
+
+        QList<ComponentSnapshot> components;
+        QList<PortSymbolSnapshot> ports;
+        QList<WireSnapshot> wires;
+        QList<QString> paintings;  //! \brief Xml fragment of each painting
+    };
 
     /*!
      * \brief This class handles all the access to the schematic documents file
@@ -62,13 +89,10 @@ namespace Caneda
         bool save() const;
         bool load() const;
 
-    private:
         QString saveText() const;
-        void saveComponents(Caneda::XmlWriter *writer) const;
-        void savePorts(Caneda::XmlWriter *writer) const;
-        void saveWires(Caneda::XmlWriter *writer) const;
-        void savePaintings(Caneda::XmlWriter *writer) const;
+        SchematicSnapshot snapshot() const;
 
+    private:
         bool loadFromText(const QString &text) const;
         void loadComponents(Caneda::XmlReader *reader) const;
         void loadPorts(Caneda::XmlReader *reader) const;
@@ -103,8 +127,9 @@ namespace Caneda
         bool save() const;
         bool load() const;
 
-    private:
         QString saveText() const;
+
+    private:
         void saveSymbol(Caneda::XmlWriter *writer) const;
         void savePorts(Caneda::XmlWriter *writer) const;
         void saveProperties(Caneda::XmlWriter *writer) const;
@@ -146,8 +171,9 @@ namespace Caneda
         bool save() const;
         bool load() const;
 
-    private:
         QString saveText() const;
+
+    private:
         void savePaintings(Caneda::XmlWriter *writer) const;
 
         bool loadFromText(const QString &text) const;
@@ -182,16 +208,28 @@ namespace Caneda
         explicit FormatSpice(SchematicDocument *document = 0);
 
         bool save();
+        QString generateNetlist();
+
+        void setPropertyOverride(Component *component, const QString &property,
+                                 const QString &value);
+
+        QString generateNetlist(NetlistCache *cache, QStringList *schematicsList);
 
     private:
-        QString generateNetlist();
-        PortsNetlist generateNetlistTopology();
-        void replacePortNames(PortsNetlist *netlist);
+        void generateComponentNetlist(Component *c, const QHash<Port*, QString> &nets,
+                                      const QString &libraryPath, const QString &filePath,
+                                      NetlistFragment *fragment);
+        static QString removeMultipleSpaces(QString text);
+
+        QList<QList<Port*> > generateNetlistTopology();
 
         GraphicsScene* graphicsScene() const;
         QString fileName() const;
 
         SchematicDocument *m_schematicDocument;
+
+        //! \brief Values used in the netlist instead of the properties of each component
+        QHash<Component*, QHash<QString, QString> > m_overrides;
     };
 
     /*!
@@ -214,21 +252,29 @@ namespace Caneda
         Q_OBJECT
 
     public:
-        explicit FormatRawSimulation(SimulationDocument *document = 0);
+        explicit FormatRawSimulation(SimulationDocument *document = 0,
+                                     ChartScene *scene = 0);
 
         bool load();
 
+        static void addComplexCurves(ChartScene *scene, const QStringList &names,
+                                     const QList<QVector<double> > &dataReal,
+                                     const QList<QVector<double> > &dataImaginary);
+
     private:
         void parseFile(QTextStream *file);
         void parseAsciiData(QTextStream *file, const int nvars, const int npoints, const bool real);
         void parseBinaryData(QTextStream *file, const int nvars, const int npoints, const bool real);
+        void addCurves(const QList<QVector<double> > &dataReal,
+                       const QList<QVector<double> > &dataImaginary);
 
         ChartScene* chartScene() const;
 
         SimulationDocument *m_simulationDocument;
+        ChartScene *m_chartScene;  // Scene receiving the curves, if not the document one.
 
-        QList<ChartSeries*> plotCurves;       // List of magnitude curves.
-        QList<ChartSeries*> plotCurvesPhase;  // List of phase curves.
+        QList<ChartSeries*> plotCurves;       // List of curves (real data).
+        QStringList plotNames;                // List of variable names (complex data).
     };
 
 } // namespace Caneda
@@ -21,12 +21,16 @@
 #include "graphicsitem.h"
 
 #include "actionmanager.h"
+#include "component.h"
+#include "graphicsscene.h"
 #include "port.h"
+#include "rulechecker.h"
 #include "settings.h"
 #include "xmlutilities.h"
 
 #include <QGraphicsSceneEvent>
 #include <QMenu>
+#include <QStyleOptionGraphicsItem>
 
 namespace Caneda
 {
@@ -44,6 +48,106 @@ namespace Caneda
         setFlag(ItemSendsScenePositionChanges, true);
     }
 
+    /*!
+     * \brief Destructor.
+     *
+     * The rule checker and the views of the scene are told before the item is
+     * removed from the scene, as the QGraphicsItem destructor does not call
+     * itemChange().
+     */
+    GraphicsItem::~GraphicsItem()
+    {
+        GraphicsScene *graphicsScene = qobject_cast<GraphicsScene*>(scene());
+        if(graphicsScene) {
+            graphicsScene->ruleChecker()->removeItem(this);
+            graphicsScene->invalidateTiles(this);
+        }
+    }
+
+    /*!
+     * \brief Keeps the netlist cache of the scene up to date.
+     *
+     * Adding or removing an item with ports changes the nets of the
+     * schematic. A component added to the scene may also reuse the address
+     * of a deleted one, so its netlist fragment is invalidated. The rule
+     * checker of the scene is updated the same way.
+     *
+     * The cached tiles of the views are invalidated when the item is added,
+     * removed, moved, transformed, hidden or shown, both before the change
+     * (old area) and after it (new area). A change of selection moves the
+     * item in or out of the tiles, so it always invalidates them.
+     *
+     * \sa NetlistCache, RuleChecker, GraphicsScene::invalidateTiles()
+     */
+    QVariant GraphicsItem::itemChange(GraphicsItemChange change, const QVariant &value)
+    {
+        // The tiles are invalidated in the scene the item is in at each step
+        GraphicsScene *tilesScene = qobject_cast<GraphicsScene*>(scene());
+        if(tilesScene) {
+            switch(change) {
+            case ItemSceneChange:
+            case ItemSceneHasChanged:
+            case ItemPositionChange:
+            case ItemPositionHasChanged:
+            case ItemTransformChange:
+            case ItemTransformHasChanged:
+            case ItemRotationChange:
+            case ItemRotationHasChanged:
+            case ItemVisibleChange:
+            case ItemVisibleHasChanged:
+            case ItemZValueHasChanged:
+                tilesScene->invalidateTiles(this);
+                break;
+            case ItemSelectedHasChanged:
+                tilesScene->invalidateTiles(sceneBoundingRect() |
+                                            mapRectToScene(childrenBoundingRect()));
+                break;
+            default:
+                break;
+            }
+        }
+
+        // The scene is the old one before the change, and the new one after
+        if(change == ItemSceneChange || change == ItemSceneHasChanged) {
+            GraphicsScene *graphicsScene = qobject_cast<GraphicsScene*>(scene());
+            if(graphicsScene) {
+                // The ports leave the nets of the old scene, and form new
+                // nets in the new one
+                NetlistCache *cache = graphicsScene->netlistCache();
+                foreach(Port *port, m_ports) {
+                    if(change == ItemSceneChange) {
+                        cache->removePort(port);
+                    }
+                    else {
+                        cache->invalidatePort(port);
+                    }
+                }
+
+                // Components without ports (for example, spice directives)
+                // also have a netlist fragment
+                Component *component = canedaitem_cast<Component*>(this);
+                if(component) {
+                    graphicsScene->netlistCache()->invalidateComponent(component);
+                }
+            }
+        }
+
+        if(change == ItemSceneChange) {
+            GraphicsScene *graphicsScene = qobject_cast<GraphicsScene*>(scene());
+            if(graphicsScene) {
+                graphicsScene->ruleChecker()->removeItem(this);
+            }
+        }
+        else if(change == ItemSceneHasChanged) {
+            GraphicsScene *graphicsScene = qobject_cast<GraphicsScene*>(scene());
+            if(graphicsScene) {
+                graphicsScene->ruleChecker()->markDirty(this);
+            }
+        }
+
+        return QGraphicsItem::itemChange(change, value);
+    }
+
     /*!
      * \brief Rotate item by 90 degrees around a pivot point
      *
@@ -118,6 +222,25 @@ namespace Caneda
         setPos(newPos);
     }
 
+    /*!
+     * \brief Schedules a redraw of the item.
+     *
+     * This method hides QGraphicsItem::update() to also invalidate the
+     * cached tiles of the views, as the drawing of the item is about to
+     * change. All the subclasses redraw their items through this method.
+     *
+     * \sa GraphicsScene::invalidateTiles()
+     */
+    void GraphicsItem::update(const QRectF &rect)
+    {
+        GraphicsScene *graphicsScene = qobject_cast<GraphicsScene*>(scene());
+        if(graphicsScene) {
+            graphicsScene->invalidateTiles(this);
+        }
+
+        QGraphicsItem::update(rect);
+    }
+
     /*!
      * \brief Stores the item's current position for later usage.
      *
@@ -228,7 +351,11 @@ namespace Caneda
     void GraphicsItem::setShapeAndBoundRect(const QPainterPath& shape,
             const QRectF& boundingRect, qreal penWidth)
     {
-        // Inform scene about change in geometry.
+        // Inform scene and views about change in geometry.
+        GraphicsScene *graphicsScene = qobject_cast<GraphicsScene*>(scene());
+        if(graphicsScene) {
+            graphicsScene->invalidateTiles(this);
+        }
         prepareGeometryChange();
 
         // Adjust the bounding rect by pen width as required by graphicsview.
@@ -240,6 +367,32 @@ namespace Caneda
             // If path is empty just add the bounding rect to the path.
             m_shape.addRect(m_boundingRect);
         }
+
+        if(graphicsScene) {
+            graphicsScene->invalidateTiles(this);
+        }
+    }
+
+    /*!
+     * \brief Draws the ports of the item.
+     *
+     * Ports are not items of the scene, so each item draws its own ports from
+     * its paint() method, after the item itself. Below the
+     * "gui/lodDetailThreshold" zoom level ports are not drawn, as they would
+     * be only a few pixels wide.
+     *
+     * \sa Port::paint()
+     */
+    void GraphicsItem::paintPorts(QPainter *painter) const
+    {
+        qreal lod = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+        if(lod < Settings::instance()->currentValue("gui/lodDetailThreshold").toDouble()) {
+            return;
+        }
+
+        foreach(Port *port, m_ports) {
+            port->paint(painter);
+        }
     }
 
 } // namespace Caneda
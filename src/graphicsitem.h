@@ -61,6 +61,7 @@ namespace Caneda
     {
     public:
         explicit GraphicsItem(QGraphicsItem *parent = 0);
+        ~GraphicsItem();
 
         /*!
          * \brief GraphicsItem identification types.
@@ -132,6 +133,8 @@ namespace Caneda
         void rotate(Caneda::AngleDirection dir, QPointF pivotPoint);
         void mirror(Qt::Axis axis, QPointF pivotPoint);
 
+        void update(const QRectF &rect = QRectF());
+
         //! Return bounding box.
         QRectF boundingRect() const { return m_boundingRect; }
         //! Return the shape of the item.
@@ -152,12 +155,14 @@ namespace Caneda
         virtual void launchPropertiesDialog() = 0;
 
     protected:
+        QVariant itemChange(GraphicsItemChange change, const QVariant &value);
         void contextMenuEvent(QGraphicsSceneContextMenuEvent *event);
         void mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event);
 
         void setShapeAndBoundRect(const QPainterPath& path,
                 const QRectF& boundingRect,
                 qreal penWidth = 1.0);
+        void paintPorts(QPainter *painter) const;
 
         QRectF m_boundingRect; //! Bounding box cache
         QPainterPath m_shape; //! Shape cache
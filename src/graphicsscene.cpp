@@ -22,6 +22,7 @@
 #include "graphicsscene.h"
 
 #include "actionmanager.h"
+#include "clipboarddata.h"
 #include "documentviewmanager.h"
 #include "ellipsearc.h"
 #include "graphicsview.h"
@@ -32,20 +33,100 @@
 #include "portsymbol.h"
 #include "property.h"
 #include "propertydialog.h"
+#include "rulechecker.h"
 #include "settings.h"
+#include "tiledrenderer.h"
 #include "wire.h"
-#include "xmlutilities.h"
 
 #include <QClipboard>
 #include <QGraphicsSceneEvent>
 #include <QKeySequence>
 #include <QMenu>
+#include <QPaintEngine>
 #include <QPainter>
+#include <QPointer>
+#include <QProgressDialog>
 #include <QShortcutEvent>
+#include <QThread>
+#include <QTimer>
 #include <QtMath>
 
 namespace Caneda
 {
+    //! \brief Number of changed rects of a batch update above which they are coalesced into one.
+    static const int maxRegionRects = 64;
+
+    /*!
+     * \brief Records the regions of a TiledRenderer from a scene, on demand.
+     *
+     * Each region is recorded with QGraphicsScene::render() restricted to the
+     * corresponding area of the scene, so it only holds the items found there
+     * through the scene index.
+     *
+     * When exporting, the scene is prepared for the export (no selection,
+     * background nor rule markers) while the recorder exists, as the regions
+     * are recorded while the renderer writes the image.
+     */
+    class SceneTileRecorder : public TileRecorder
+    {
+    public:
+        /*!
+         * \param scene Scene to record.
+         * \param target Area of the final image where \a source is painted.
+         * \param source Area of the scene to paint.
+         * \param exporting True to prepare the scene for an export.
+         */
+        SceneTileRecorder(GraphicsScene *scene, const QRectF &target,
+                          const QRectF &source, bool exporting) :
+            m_scene(scene),
+            m_target(target),
+            m_source(source),
+            m_exporting(exporting)
+        {
+            if(m_exporting) {
+                m_selectedItems = scene->selectedItems();
+                scene->setItemsSelected(m_selectedItems, false);
+                scene->setBackgroundVisible(false);
+                scene->ruleChecker()->setMarkersVisible(false);
+            }
+        }
+
+        ~SceneTileRecorder()
+        {
+            if(m_exporting && m_scene) {
+                m_scene->ruleChecker()->setMarkersVisible(true);
+                m_scene->setBackgroundVisible(true);
+                m_scene->setItemsSelected(m_selectedItems, true);
+            }
+        }
+
+        void recordRegion(QPainter *painter, const QRect &region)
+        {
+            const QRectF area = m_target & QRectF(region);
+            if(!m_scene || area.isEmpty()) {
+                return;
+            }
+
+            // Scene area painted in this region
+            const qreal scaleX = m_source.width() / m_target.width();
+            const qreal scaleY = m_source.height() / m_target.height();
+            const QRectF part(m_source.left() + (area.left() - m_target.left()) * scaleX,
+                              m_source.top() + (area.top() - m_target.top()) * scaleY,
+                              area.width() * scaleX,
+                              area.height() * scaleY);
+
+            painter->setRenderHints(Caneda::DefaulRenderHints);
+            m_scene->render(painter, area, part, Qt::IgnoreAspectRatio);
+        }
+
+    private:
+        QPointer<GraphicsScene> m_scene;
+        QRectF m_target;
+        QRectF m_source;
+        bool m_exporting;
+        QList<QGraphicsItem*> m_selectedItems;
+    };
+
     /*!
      * \brief Constructs a new graphics scene.
      *
@@ -59,17 +140,23 @@ namespace Caneda
         m_mouseAction = Normal;
 
         // Setup spice/electric related scene properties
-        m_properties = new PropertyGroup();
+        m_properties = new PropertyGroup(this);
         m_properties->setUserPropertiesEnabled(true);
-        addItem(m_properties);
 
-        // Setup undo stack
+        // Setup undo stack. The undo limit must be set while the stack is
+        // still empty, older commands are discarded once the limit is reached.
         m_undoStack = new QUndoStack(this);
+        m_undoStack->setUndoLimit(Settings::instance()->currentValue("gui/undoLimit").toInt());
+
+        // Setup the rule checker, enabled by the documents checking their scene
+        m_ruleChecker = new RuleChecker(this);
 
         // Setup grid
         m_backgroundVisible = true;
+        m_printing = false;
 
         m_areItemsMoving = false;
+        m_moveMacroStarted = false;
         m_shortcutsBlocked = false;
 
         // Wire state machine
@@ -92,6 +179,24 @@ namespace Caneda
         m_zoomBandClicks = 0;
 
         connect(undoStack(), SIGNAL(cleanChanged(bool)), this, SIGNAL(changed()));
+
+        // Setup the selection notifications, see selectionChangeFinished()
+        m_selectionChangeDepth = 0;
+        m_selectionDirty = false;
+        m_selectionTimer = new QTimer(this);
+        m_selectionTimer->setSingleShot(true);
+        m_selectionTimer->setInterval(0);
+        connect(m_selectionTimer, SIGNAL(timeout()), this, SLOT(emitSelectionChangeFinished()));
+        connect(this, SIGNAL(selectionChanged()), this, SLOT(onSelectionChanged()));
+
+        m_tilesUpdateDepth = 0;
+    }
+
+    //! \brief Destructor.
+    GraphicsScene::~GraphicsScene()
+    {
+        // Delete the properties before the scene deletes their display
+        delete m_properties;
     }
 
     /**********************************************************************
@@ -106,29 +211,22 @@ namespace Caneda
         deleteItems(items);
     }
 
-    //! \brief Copy items
+    /*!
+     * \brief Copy items
+     *
+     * The items are cloned into a ClipboardData object, which generates its
+     * serialized formats only when requested by another process.
+     *
+     * \sa ClipboardData
+     */
     void GraphicsScene::copyItems(QList<GraphicsItem*> &items)
     {
         if(items.isEmpty()) {
             return;
         }
 
-        QString clipText;
-        Caneda::XmlWriter *writer = new Caneda::XmlWriter(&clipText);
-        writer->setAutoFormatting(true);
-        writer->writeStartDocument();
-        writer->writeDTD(QString("<!DOCTYPE caneda>"));
-        writer->writeStartElement("caneda");
-        writer->writeAttribute("version", Caneda::version());
-
-        foreach(GraphicsItem *item, items) {
-            item->saveData(writer);
-        }
-
-        writer->writeEndDocument();
-
         QClipboard *clipboard =  QApplication::clipboard();
-        clipboard->setText(clipText);
+        clipboard->setMimeData(new ClipboardData(items));
     }
 
     //! \brief Delete items
@@ -183,12 +281,6 @@ namespace Caneda
             return false;
         }
 
-        // Setup undo
-        m_undoStack->beginMacro(tr("Align items"));
-
-        // Disconnect
-        disconnectItems(items);
-
         // Compute bounding rectangle
         QRectF rect = items.first()->sceneBoundingRect();
         QList<GraphicsItem*>::iterator it = items.begin()+1;
@@ -197,6 +289,10 @@ namespace Caneda
             ++it;
         }
 
+        QList<GraphicsItem*> movedItems;
+        QList<QPointF> initialPositions;
+        QList<QPointF> finalPositions;
+
         it = items.begin();
         while(it != items.end()) {
             if((*it)->type() == GraphicsItem::WireType) {
@@ -234,12 +330,31 @@ namespace Caneda
                     break;
             }
 
-            // Move item
-            QPointF itemPos = (*it)->pos();
-            m_undoStack->push(new MoveItemCmd(*it, itemPos, itemPos + delta));;
+            // Store the item movement, if any
+            if(!delta.isNull()) {
+                QPointF itemPos = (*it)->pos();
+                movedItems << *it;
+                initialPositions << itemPos;
+                finalPositions << itemPos + delta;
+            }
             ++it;
         }
 
+        // Nothing to do if the items are already aligned
+        if(movedItems.isEmpty()) {
+            return true;
+        }
+
+        // Setup undo
+        m_undoStack->beginMacro(tr("Align items"));
+
+        // Disconnect
+        disconnectItems(items);
+
+        // Move all items at once
+        m_undoStack->push(new MoveItemsCmd(movedItems, initialPositions,
+                                           finalPositions, this));
+
         // Reconnect items
         connectItems(items);
         splitAndCreateNodes(items);
@@ -289,10 +404,6 @@ namespace Caneda
      */
     void GraphicsScene::distributeElementsHorizontally(QList<GraphicsItem*> items)
     {
-        m_undoStack->beginMacro(tr("Distribute items"));
-
-        disconnectItems(items);
-
         // Sort items
         qSort(items.begin(), items.end(), pointCmpFunction_X);
         qreal x1 = items.first()->pos().x();
@@ -302,6 +413,10 @@ namespace Caneda
         qreal dx = (x2 - x1) / (items.size() - 1);
         qreal x = x1;
 
+        QList<GraphicsItem*> movedItems;
+        QList<QPointF> initialPositions;
+        QList<QPointF> finalPositions;
+
         foreach(GraphicsItem *item, items) {
             if(item->type() == GraphicsItem::WireType) {
                 continue;
@@ -312,10 +427,26 @@ namespace Caneda
             newPos.setX(x);
             x += dx;
 
-            // Move the item to the new position
-            m_undoStack->push(new MoveItemCmd(item, item->pos(), newPos));
+            if(newPos != item->pos()) {
+                movedItems << item;
+                initialPositions << item->pos();
+                finalPositions << newPos;
+            }
+        }
+
+        // Nothing to do if the items are already distributed
+        if(movedItems.isEmpty()) {
+            return;
         }
 
+        m_undoStack->beginMacro(tr("Distribute items"));
+
+        disconnectItems(items);
+
+        // Move all items to their new positions at once
+        m_undoStack->push(new MoveItemsCmd(movedItems, initialPositions,
+                                           finalPositions, this));
+
         connectItems(items);
         splitAndCreateNodes(items);
 
@@ -329,10 +460,6 @@ namespace Caneda
      */
     void GraphicsScene::distributeElementsVertically(QList<GraphicsItem*> items)
     {
-        m_undoStack->beginMacro(tr("Distribute items"));
-
-        disconnectItems(items);
-
         // Sort items
         qSort(items.begin(), items.end(), pointCmpFunction_Y);
         qreal y1 = items.first()->pos().y();
@@ -342,6 +469,10 @@ namespace Caneda
         qreal dy = (y2 - y1) / (items.size() - 1);
         qreal y = y1;
 
+        QList<GraphicsItem*> movedItems;
+        QList<QPointF> initialPositions;
+        QList<QPointF> finalPositions;
+
         foreach(GraphicsItem *item, items) {
             if(item->type() == GraphicsItem::WireType) {
                 continue;
@@ -352,10 +483,26 @@ namespace Caneda
             newPos.setY(y);
             y += dy;
 
-            // Move the item to the new position
-            m_undoStack->push(new MoveItemCmd(item, item->pos(), newPos));
+            if(newPos != item->pos()) {
+                movedItems << item;
+                initialPositions << item->pos();
+                finalPositions << newPos;
+            }
         }
 
+        // Nothing to do if the items are already distributed
+        if(movedItems.isEmpty()) {
+            return;
+        }
+
+        m_undoStack->beginMacro(tr("Distribute items"));
+
+        disconnectItems(items);
+
+        // Move all items to their new positions at once
+        m_undoStack->push(new MoveItemsCmd(movedItems, initialPositions,
+                                           finalPositions, this));
+
         connectItems(items);
         splitAndCreateNodes(items);
 
@@ -378,12 +525,147 @@ namespace Caneda
         update();
     }
 
+    /*!
+     * \brief Returns true if an item must be painted on every update.
+     *
+     * Selected items (being moved or edited), items whose parent is selected,
+     * items not belonging to the schematic (for example, the zoom band),
+     * items ignoring the view transform (for example, the rule markers) and
+     * items drawn with a graphics effect are live items. All other items are
+     * static, and the views draw them from cached tiles.
+     *
+     * \sa GraphicsView, invalidateTiles()
+     */
+    bool GraphicsScene::isLiveItem(QGraphicsItem *item) const
+    {
+        QGraphicsItem *topLevel = item->topLevelItem();
+        if(item->isSelected() || topLevel->isSelected() ||
+                !canedaitem_cast<GraphicsItem*>(topLevel) ||
+                (item->flags() & QGraphicsItem::ItemIgnoresTransformations)) {
+            return true;
+        }
+
+        // Graphics effects are only applied by the views
+        for(QGraphicsItem *parent = item; parent; parent = parent->parentItem()) {
+            if(parent->graphicsEffect()) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /*!
+     * \brief Tells the views that the static items drawn in \a rect changed.
+     *
+     * The items call this method (or invalidateTiles(QGraphicsItem*)) when
+     * they are added, removed, moved or changed, instead of the views
+     * listening to QGraphicsScene::changed(), which would disable the direct
+     * item to view updates of the scene.
+     *
+     * During a batch update the rects are gathered instead, and the views are
+     * told once the batch ends.
+     *
+     * \sa tilesInvalidated(), beginTilesUpdate()
+     */
+    void GraphicsScene::invalidateTiles(const QRectF &rect)
+    {
+        if(m_tilesUpdateDepth > 0) {
+            m_pendingTileRects << rect;
+            return;
+        }
+
+        emit tilesInvalidated(rect);
+    }
+
+    /*!
+     * \brief Tells the views that the drawing of \a item (and its children)
+     * changed.
+     *
+     * Live items are not drawn in the cached tiles, so they are ignored.
+     *
+     * \sa isLiveItem()
+     */
+    void GraphicsScene::invalidateTiles(QGraphicsItem *item)
+    {
+        if(!isLiveItem(item)) {
+            invalidateTiles(item->sceneBoundingRect() |
+                            item->mapRectToScene(item->childrenBoundingRect()));
+        }
+    }
+
+    /*!
+     * \brief Begins a batch update of many items.
+     *
+     * The batch commands of the undo stack (for example, moving or removing
+     * a large selection) change many items at once. Each item would tell the
+     * views to discard their tiles before and after its own change. Between
+     * beginTilesUpdate() and the matching endTilesUpdate() the invalidated
+     * rects are instead gathered, and the views are told only once the whole
+     * batch is applied. Batches changing many items invalidate the bounding
+     * rect of the changes at once.
+     *
+     * Calls can be nested, only the outermost call ending the batch.
+     *
+     * \sa endTilesUpdate(), invalidateTiles()
+     */
+    void GraphicsScene::beginTilesUpdate()
+    {
+        ++m_tilesUpdateDepth;
+    }
+
+    /*!
+     * \brief Ends a batch update, telling the views about the changed rects.
+     *
+     * \sa beginTilesUpdate()
+     */
+    void GraphicsScene::endTilesUpdate()
+    {
+        Q_ASSERT(m_tilesUpdateDepth > 0);
+        --m_tilesUpdateDepth;
+
+        if(m_tilesUpdateDepth > 0) {
+            return;
+        }
+
+        QList<QRectF> rects = m_pendingTileRects;
+        m_pendingTileRects.clear();
+
+        // Many rects are coalesced into their bounding rect
+        if(rects.size() > maxRegionRects) {
+            QRectF boundingRect;
+            foreach(const QRectF &rect, rects) {
+                boundingRect |= rect;
+            }
+            rects = QList<QRectF>() << boundingRect;
+        }
+
+        foreach(const QRectF &rect, rects) {
+            emit tilesInvalidated(rect);
+        }
+    }
+
     /*!
      * \brief Prints the current scene to device
      *
      * The device to print the scene on can be a physical printer,
      * a postscript (ps) file or a portable document format (pdf)
      * file.
+     *
+     * The scene is printed on a grid of pages. Each page is rendered with
+     * QGraphicsScene::render() restricted to the page area, which only paints
+     * the items found in that area through the scene index. The grid is
+     * hidden while printing by means of a scene flag, leaving the global
+     * settings (and thus the open views) untouched.
+     *
+     * When printing to a raster printer, each page is rasterized in parallel,
+     * tile by tile, by a TiledRenderer. The regions of the page are recorded
+     * just before their tiles are rasterized. Vector outputs (pdf files) are
+     * painted directly.
+     *
+     * A progress dialog allows to cancel the print job between pages.
+     *
+     * \sa TiledRenderer
      */
     void GraphicsScene::print(QPrinter *printer, bool fitInView)
     {
@@ -391,14 +673,20 @@ namespace Caneda
         p.setRenderHints(Caneda::DefaulRenderHints);
 
         const bool fullPage = printer->fullPage();
+        const bool rasterPrinter = printer->outputFormat() == QPrinter::NativeFormat &&
+            printer->paintEngine()->type() != QPaintEngine::Pdf;
 
-        const bool viewGridStatus = Settings::instance()->currentValue("gui/gridVisible").value<bool>();
-        Settings::instance()->setCurrentValue("gui/gridVisible", false);
+        m_printing = true;
+        m_ruleChecker->setMarkersVisible(false);
 
         const QRectF diagramRect = itemsBoundingRect();
 
+        // Compute the pages to print, as pairs of destination and source rects
+        QList<QPair<QRectF, QRectF> > pagesToPrint;
+
         if(fitInView) {
-            render(&p, QRectF(), diagramRect, Qt::KeepAspectRatio);
+            pagesToPrint << qMakePair(QRectF(QPointF(0, 0), QSizeF(printer->width(), printer->height())),
+                                      diagramRect);
         }
         else {
             //Printing on one or more pages
@@ -409,8 +697,6 @@ namespace Caneda
             const int verticalPages =
                 qCeil(diagramRect.height() / printedArea.height());
 
-            QList<QRectF> pagesToPrint;
-
             //The schematic is printed on a grid of sheets running from top-bottom, left-right.
             qreal yOffset = 0;
             for(int y = 0; y < verticalPages; ++y) {
@@ -419,27 +705,74 @@ namespace Caneda
                 for(int x = 0; x < horizontalPages; ++x) {
                     const qreal width = qMin(printedArea.width(), diagramRect.width() - xOffset);
                     const qreal height = qMin(printedArea.height(), diagramRect.height() - yOffset);
-                    pagesToPrint << QRectF(xOffset, yOffset, width, height);
+                    const QRectF rect(xOffset, yOffset, width, height);
+                    pagesToPrint << qMakePair(rect.translated(-rect.topLeft()), // dest - topleft at (0, 0)
+                                              rect.translated(diagramRect.topLeft())); // src
                     xOffset += printedArea.width();
                 }
 
                 yOffset += printedArea.height();
             }
+        }
 
-            for (int i = 0; i < pagesToPrint.size(); ++i) {
-                const QRectF rect = pagesToPrint.at(i);
-                render(&p,
-                       rect.translated(-rect.topLeft()), // dest - topleft at (0, 0)
-                       rect.translated(diagramRect.topLeft()), // src
-                       Qt::KeepAspectRatio);
+        QProgressDialog progress(tr("Printing..."), tr("Cancel"), 0, pagesToPrint.size(),
+                                 QApplication::activeWindow());
+        progress.setWindowModality(Qt::WindowModal);
+        progress.setMinimumDuration(500);
 
-                if(i != (pagesToPrint.size() - 1)) {
-                    printer->newPage();
+        for(int i = 0; i < pagesToPrint.size(); ++i) {
+            progress.setValue(i);
+            if(progress.wasCanceled()) {
+                printer->abort();
+                break;
+            }
+
+            const QRectF dest = pagesToPrint.at(i).first;
+            const QRectF source = pagesToPrint.at(i).second;
+
+            if(rasterPrinter) {
+                // Record the page region by region while it is rasterized in
+                // parallel
+                TiledRenderer renderer(dest.toAlignedRect().size());
+
+                // Compute the page area actually covered, as render() does
+                // when keeping the aspect ratio
+                const qreal scale = qMin(dest.width() / source.width(),
+                                         dest.height() / source.height());
+                QRectF target(QPointF(0, 0), source.size() * scale);
+                target.moveCenter(dest.center());
+                renderer.setRecorder(new SceneTileRecorder(this, target, source, false));
+
+                QList<QRect> tiles;
+                for(int top = 0; top < renderer.imageSize().height(); top += renderer.tileSize()) {
+                    for(int left = 0; left < renderer.imageSize().width(); left += renderer.tileSize()) {
+                        tiles << QRect(left, top, renderer.tileSize(), renderer.tileSize())
+                            .intersected(QRect(QPoint(0, 0), renderer.imageSize()));
+                    }
                 }
+
+                const int groupSize = qMax(1, QThread::idealThreadCount());
+                for(int j = 0; j < tiles.size(); j += groupSize) {
+                    QList<QRect> group = tiles.mid(j, groupSize);
+                    QList<QImage> images = renderer.renderTiles(group);
+                    for(int k = 0; k < images.size(); ++k) {
+                        p.drawImage(group.at(k).topLeft(), images.at(k));
+                    }
+                }
+            }
+            else {
+                render(&p, dest, source, Qt::KeepAspectRatio);
+            }
+
+            if(i != (pagesToPrint.size() - 1)) {
+                printer->newPage();
             }
         }
 
-        Settings::instance()->setCurrentValue("gui/gridVisible", viewGridStatus);
+        progress.setValue(pagesToPrint.size());
+
+        m_ruleChecker->setMarkersVisible(true);
+        m_printing = false;
     }
 
     /*!
@@ -480,27 +813,53 @@ namespace Caneda
 
         // Deselect the elements
         QList<QGraphicsItem *> selected_elmts = selectedItems();
-        foreach(QGraphicsItem *qgi, selected_elmts) {
-            qgi->setSelected(false);
-        }
+        setItemsSelected(selected_elmts, false);
 
-        // Perform the rendering itself (without background for svg images)
+        // Perform the rendering itself (without background for svg images,
+        // and without rule markers)
         // As the size is specified, there is no need to keep the aspect ratio
         // (it will be kept if the dimensions of the source and destination areas
         // are proportional.
         setBackgroundVisible(false);
+        m_ruleChecker->setMarkersVisible(false);
         render(&p, dest_area, source_area, Qt::IgnoreAspectRatio);
+        m_ruleChecker->setMarkersVisible(true);
         setBackgroundVisible(true);
         p.end();
 
         // Restore the selected items
-        foreach(QGraphicsItem *qgi, selected_elmts) {
-            qgi->setSelected(true);
-        }
+        setItemsSelected(selected_elmts, true);
 
         return(true);
     }
 
+    /*!
+     * \brief Export the scene through a tiled renderer.
+     *
+     * This method is similar to exportImage(), but sets a recorder of the
+     * scene into \a renderer. Each region of the image is recorded just
+     * before its tiles are rendered, so only a few regions are held in
+     * memory at a time, and each tile only replays a small part of the
+     * drawing.
+     *
+     * The scene is kept prepared for the export (without selection,
+     * background nor rule markers) until \a renderer is destroyed.
+     *
+     * \param renderer Tiled renderer where the scene is to be recorded. Its
+     * image size is the size of the destination (final) image.
+     * \sa exportImage(), TiledRenderer
+     */
+    void GraphicsScene::exportTiles(TiledRenderer *renderer)
+    {
+        // Calculate the source area, as in exportImage()
+        QRectF source_area = itemsBoundingRect();
+        source_area.setBottom(source_area.bottom()+1);
+        source_area.setRight(source_area.right()+1);
+
+        renderer->setRecorder(new SceneTileRecorder(this, QRectF(QPointF(0, 0), renderer->imageSize()),
+                                                    source_area, true));
+    }
+
     /**********************************************************************
      *
      *                             Mouse actions
@@ -585,6 +944,7 @@ namespace Caneda
         m_insertibles = items;
 
         // Add items
+        beginSelectionChange();
         foreach(GraphicsItem *item, m_insertibles) {
             // Set the item as selected
             item->setSelected(true);
@@ -598,6 +958,7 @@ namespace Caneda
             // Finally add the item to the scene
             addItem(item);
         }
+        endSelectionChange();
     }
 
     /*!
@@ -788,6 +1149,101 @@ namespace Caneda
         }
     }
 
+    /**********************************************************************
+     *
+     *                              Selection
+     *
+     **********************************************************************/
+    /*!
+     * \brief Starts a group of selection changes.
+     *
+     * Selecting or deselecting items one by one emits selectionChanged()
+     * for every item. Between beginSelectionChange() and the matching
+     * endSelectionChange() the changes are instead gathered, and a single
+     * selectionChangeFinished() signal is emitted at the end. Groups of
+     * changes can be nested. The group is also a batch update of the cached
+     * tiles (see beginTilesUpdate()), so selecting all the items of a large
+     * scene discards the tiles once instead of once per item.
+     *
+     * Outside of a group, the selection changes of one event loop
+     * iteration (for example, those of a rubber band drag) are also
+     * gathered into a single notification.
+     *
+     * \sa endSelectionChange(), selectionChangeFinished()
+     */
+    void GraphicsScene::beginSelectionChange()
+    {
+        ++m_selectionChangeDepth;
+        beginTilesUpdate();
+    }
+
+    /*!
+     * \brief Ends a group of selection changes.
+     *
+     * \sa beginSelectionChange()
+     */
+    void GraphicsScene::endSelectionChange()
+    {
+        Q_ASSERT(m_selectionChangeDepth > 0);
+        --m_selectionChangeDepth;
+        endTilesUpdate();
+
+        if(m_selectionChangeDepth == 0 && m_selectionDirty) {
+            m_selectionTimer->stop();
+            emitSelectionChangeFinished();
+        }
+    }
+
+    /*!
+     * \brief Selects or deselects \a items as a single selection change.
+     *
+     * \param items Items to change.
+     * \param selected True to select the items, false to deselect them.
+     */
+    void GraphicsScene::setItemsSelected(const QList<QGraphicsItem*> &items, bool selected)
+    {
+        beginSelectionChange();
+        foreach(QGraphicsItem *item, items) {
+            item->setSelected(selected);
+        }
+        endSelectionChange();
+    }
+
+    /*!
+     * \brief Selects all the items of the scene as a single selection change.
+     *
+     * The items are taken directly from the scene index, without testing
+     * their shapes against a selection area.
+     */
+    void GraphicsScene::selectAll()
+    {
+        beginSelectionChange();
+        foreach(QGraphicsItem *item, items()) {
+            if(item->flags() & QGraphicsItem::ItemIsSelectable) {
+                item->setSelected(true);
+            }
+        }
+        endSelectionChange();
+    }
+
+    //! \brief Records a selection change, to be notified later.
+    void GraphicsScene::onSelectionChanged()
+    {
+        m_selectionDirty = true;
+        if(m_selectionChangeDepth == 0 && !m_selectionTimer->isActive()) {
+            m_selectionTimer->start();
+        }
+    }
+
+    //! \brief Emits selectionChangeFinished() if the selection changed.
+    void GraphicsScene::emitSelectionChangeFinished()
+    {
+        if(m_selectionDirty) {
+            m_selectionDirty = false;
+            emit selectionChangeFinished();
+        }
+    }
+
     /**********************************************************************
      *
      *               Spice/electric related scene properties
@@ -843,7 +1299,7 @@ namespace Caneda
         }
 
         // Draw grid
-        if(Settings::instance()->currentValue("gui/gridVisible").value<bool>()) {
+        if(!m_printing && Settings::instance()->currentValue("gui/gridVisible").value<bool>()) {
 
             int drawingGridWidth = Caneda::DefaultGridSpace;
             int drawingGridHeight = Caneda::DefaultGridSpace;
@@ -1152,7 +1608,6 @@ namespace Caneda
                         if((event->buttons() & Qt::LeftButton) && !selectedItems().isEmpty()) {
                             // Items are selected and we are begining a new move operation
                             m_areItemsMoving = true;
-                            m_undoStack->beginMacro(tr("Move items"));
 
                             disconnectDisconnectibles();
                             QGraphicsScene::mouseMoveEvent(event);
@@ -1176,7 +1631,6 @@ namespace Caneda
                     if(m_areItemsMoving) {
                         m_areItemsMoving = false;
                         endSpecialMove();
-                        m_undoStack->endMacro();
                     }
                     QGraphicsScene::mouseReleaseEvent(event);
                 }
@@ -1238,10 +1692,12 @@ namespace Caneda
 
                 // Re-add the inserting items into the scene, to be able to
                 // insert more items of the same kind.
+                beginSelectionChange();
                 foreach(GraphicsItem *item, m_insertibles) {
                     addItem(item);
                     item->setSelected(true);
                 }
+                endSelectionChange();
 
             }
             else if(event->button() == Qt::RightButton) {
@@ -1795,7 +2251,7 @@ namespace Caneda
                 // Check for disconnections and wire resizing
                 foreach(Port *port, item->ports()) {
 
-                    foreach(Port *other, *(port->connections())) {
+                    foreach(Port *other, port->connections()) {
                         // If the item connected is a component, determine whether it should
                         // be disconnected or not.
                         if(other->parentItem()->type() == GraphicsItem::ComponentType &&
@@ -1852,7 +2308,7 @@ namespace Caneda
                 Wire *wire = canedaitem_cast<Wire*>(item);
 
                 // First check port1
-                foreach(Port *other, *(wire->port1()->connections())) {
+                foreach(Port *other, wire->port1()->connections()) {
                     // If some of the connected ports has moved, we have found the
                     // moving wire and this port must copy that port position.
                     if(other->scenePos() != wire->port1()->scenePos()) {
@@ -1862,7 +2318,7 @@ namespace Caneda
                 }
 
                 // Then check port2
-                foreach(Port *other, *(wire->port2()->connections())) {
+                foreach(Port *other, wire->port2()->connections()) {
                     // If some of the connected ports has moved, we have found the
                     // moving wire and this port must copy that port position.
                     if(other->scenePos() != wire->port2()->scenePos()) {
@@ -1879,7 +2335,7 @@ namespace Caneda
 
                 PortSymbol *portSymbol = canedaitem_cast<PortSymbol*>(item);
 
-                foreach(Port *other, *(portSymbol->port()->connections())) {
+                foreach(Port *other, portSymbol->port()->connections()) {
                     // If some of the connected ports has moved, we have found the
                     // moving item and this port must copy that port position.
                     if(other->scenePos() != portSymbol->scenePos()) {
@@ -1904,18 +2360,48 @@ namespace Caneda
      */
     void GraphicsScene::endSpecialMove()
     {
+        QList<GraphicsItem*> movedItems;
+        QList<QPointF> initialPositions;
+        QList<QPointF> finalPositions;
+
         foreach(QGraphicsItem *qItem, selectedItems()) {
             GraphicsItem *item = canedaitem_cast<GraphicsItem*>(qItem);
 
             if(item) {
-                m_undoStack->push(new MoveItemCmd(item, item->storedPos(),
-                            smartNearingGridPoint(item->pos())));
+                QPointF finalPos = smartNearingGridPoint(item->pos());
+
+                if(finalPos != item->storedPos()) {
+                    movedItems << item;
+                    initialPositions << item->storedPos();
+                    finalPositions << finalPos;
+                }
+            }
+        }
+
+        // Push a single command for the whole selection. If there is no
+        // macro opened (no disconnections), consecutive moves of the same
+        // selection are merged together.
+        if(!movedItems.isEmpty()) {
+            MoveItemsCmd *cmd = new MoveItemsCmd(movedItems, initialPositions,
+                                                 finalPositions, this);
+            cmd->setText(tr("Move items"));
+            m_undoStack->push(cmd);
+        }
+
+        foreach(QGraphicsItem *qItem, selectedItems()) {
+            GraphicsItem *item = canedaitem_cast<GraphicsItem*>(qItem);
 
+            if(item) {
                 connectItems(item);
                 splitAndCreateNodes(item);
             }
         }
 
+        if(m_moveMacroStarted) {
+            m_undoStack->endMacro();
+            m_moveMacroStarted = false;
+        }
+
         specialMoveItems.clear();
         disconnectibles.clear();
     }
@@ -1928,23 +2414,27 @@ namespace Caneda
      * when two (or more) components are connected and one of them is clicked
      * and dragged, or when a wire is moved away from a (unselected) component.
      *
+     * All disconnections are pushed as a single DisconnectItemsCmd, inside a
+     * "Move items" macro that is closed by endSpecialMove().
+     *
      * \sa normalEvent(), processForSpecialMove()
      */
     void GraphicsScene::disconnectDisconnectibles()
     {
         QSet<GraphicsItem*> remove;
+        QList<PortPair> portPairs;
 
         foreach(GraphicsItem *item, disconnectibles) {
 
             int disconnections = 0;
             foreach(Port *port, item->ports()) {
 
-                foreach(Port *other, *(port->connections())) {
+                foreach(Port *other, port->connections()) {
                     if(other->parentItem()->type() == GraphicsItem::ComponentType &&
                             other->parentItem() != item &&
                             !other->parentItem()->isSelected()) {
 
-                        m_undoStack->push(new DisconnectCmd(port, other));
+                        portPairs << PortPair(port, other);
                         ++disconnections;
 
                         break;
@@ -1958,6 +2448,12 @@ namespace Caneda
             }
         }
 
+        if(!portPairs.isEmpty()) {
+            m_undoStack->beginMacro(tr("Move items"));
+            m_moveMacroStarted = true;
+            m_undoStack->push(new DisconnectItemsCmd(portPairs, this));
+        }
+
         foreach(GraphicsItem *item, remove) {
             disconnectibles.removeAll(item);
         }
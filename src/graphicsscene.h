@@ -22,6 +22,7 @@
 #define GRAPHICS_SCENE_H
 
 #include "global.h"
+#include "netlistcache.h"
 #include "undocommands.h"
 
 #include <QGraphicsItem>
@@ -31,6 +32,7 @@
 #include <QtPrintSupport/QPrinter>
 
 // Forward declarations
+class QTimer;
 class QUndoStack;
 
 namespace Caneda
@@ -39,6 +41,8 @@ namespace Caneda
     class Component;
     class GraphicsItem;
     class Painting;
+    class RuleChecker;
+    class TiledRenderer;
     class Wire;
 
     /*!
@@ -68,6 +72,7 @@ namespace Caneda
 
     public:
         explicit GraphicsScene(QObject *parent = 0);
+        ~GraphicsScene();
 
         // Edit actions
         void cutItems(QList<GraphicsItem*> &items);
@@ -92,6 +97,7 @@ namespace Caneda
 
         void print(QPrinter *printer, bool fitInView);
         bool exportImage(QPaintDevice &);
+        void exportTiles(TiledRenderer *renderer);
 
         // Mouse actions
         void setMouseAction(const Caneda::MouseAction ma);
@@ -117,10 +123,46 @@ namespace Caneda
         PropertyGroup* properties() { return m_properties; }
         void addProperty(Property property);
 
+        //! \brief Returns the cache used to regenerate the netlist of the scene
+        NetlistCache* netlistCache() { return &m_netlistCache; }
+        //! \brief Returns the electrical rule checker of the scene
+        RuleChecker* ruleChecker() { return m_ruleChecker; }
+
+        //! \brief Returns true if \a item is being placed/pasted
+        bool isInsertible(GraphicsItem *item) const { return m_insertibles.contains(item); }
+
+        // Cached view tiles
+        bool isLiveItem(QGraphicsItem *item) const;
+        void invalidateTiles(const QRectF &rect);
+        void invalidateTiles(QGraphicsItem *item);
+        void beginTilesUpdate();
+        void endTilesUpdate();
+
+        // Selection methods
+        void beginSelectionChange();
+        void endSelectionChange();
+        void setItemsSelected(const QList<QGraphicsItem*> &items, bool selected);
+        void selectAll();
+
     Q_SIGNALS:
         //! \brief This signal is emitted whenever the undostack enters or leaves the clean state.
         void changed();
         void mouseActionChanged(Caneda::MouseAction);
+        /*!
+         * \brief This signal is emitted once after a group of selection
+         * changes, instead of once per change as selectionChanged().
+         */
+        void selectionChangeFinished();
+        /*!
+         * \brief This signal is emitted whenever the drawing of the static
+         * items in \a rect (in scene coordinates) changes, and thus the views
+         * must discard their cached tiles in that area.
+         */
+        void tilesInvalidated(const QRectF &rect);
+
+    private Q_SLOTS:
+        void onSelectionChanged();
+        void emitSelectionChangeFinished();
 
     protected:
         void drawBackground(QPainter *p, const QRectF& r);
@@ -185,6 +227,12 @@ namespace Caneda
          */
         bool m_areItemsMoving;
 
+        /*!
+         * \brief Flag to determine whether a "Move items" undo macro was
+         *        opened by disconnectDisconnectibles() for the current move.
+         */
+        bool m_moveMacroStarted;
+
         //! \brief List of GraphicsItem which are to be placed/pasted.
         QList<GraphicsItem*> m_insertibles;
 
@@ -257,6 +305,13 @@ namespace Caneda
          */
         bool m_backgroundVisible;
 
+        /*!
+         * \brief Flag to hide the grid while the scene is being printed,
+         * without modifying the global "gui/gridVisible" setting
+         * \sa print
+         */
+        bool m_printing;
+
         /*!
          * \brief Rectangular widget to show feedback of an area being
          * selected for zooming
@@ -270,6 +325,30 @@ namespace Caneda
 
         //! \brief Spice/electric related scene properties
         PropertyGroup *m_properties;
+
+        //! \brief Netlist fragments of the components, see FormatSpice
+        NetlistCache m_netlistCache;
+
+        //! \brief Background electrical rule checker
+        RuleChecker *m_ruleChecker;
+
+        /*!
+         * \brief Nesting depth of the selection changes in progress
+         * \sa beginSelectionChange, endSelectionChange
+         */
+        int m_selectionChangeDepth;
+        //! \brief Flag to hold whether the selection changed since the last notification
+        bool m_selectionDirty;
+        //! \brief Timer coalescing the selection notifications of an event loop iteration
+        QTimer *m_selectionTimer;
+
+        /*!
+         * \brief Nesting depth of the batch updates in progress
+         * \sa beginTilesUpdate, endTilesUpdate
+         */
+        int m_tilesUpdateDepth;
+        //! \brief Rects invalidated during the batch update in progress
+        QList<QRectF> m_pendingTileRects;
     };
 
 } // namespace Caneda
@@ -20,12 +20,30 @@
 
 #include "graphicsview.h"
 
+#include "graphicsitem.h"
 #include "graphicsscene.h"
+#include "settings.h"
+#include "wire.h"
 
 #include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QtMath>
 
 namespace Caneda
 {
+    //! \brief Size in pixels of the cached tiles.
+    static const int tileSize = 256;
+    //! \brief Maximum size in kilobytes of the tile cache of each view.
+    static const int tileCacheSize = 64 * 1024;
+
+    //! \brief Returns the key of a tile in the tile cache.
+    static quint64 tileKey(int column, int row)
+    {
+        return (quint64(quint32(column)) << 32) | quint32(row);
+    }
+
     /*!
      * \brief Constructs a new graphics view.
      *
@@ -34,9 +52,11 @@ namespace Caneda
     GraphicsView::GraphicsView(GraphicsScene *scene) :
         QGraphicsView(scene),
         m_zoomFactor(0.3),
-        m_zoomRange(0.30, 10.0),
+        m_zoomRange(0.05, 10.0),
         m_currentZoom(1.0),
-        panMode(false)
+        panMode(false),
+        m_tiles(tileCacheSize),
+        m_tileScale(0.0)
     {
         centerOn(QPointF(0, 0));
 
@@ -51,8 +71,13 @@ namespace Caneda
         setMouseTracking(true);
         setAttribute(Qt::WA_NoSystemBackground);
 
+        // Paint the items through drawItems(), to composite the cached tiles
+        setOptimizationFlag(IndirectPainting, true);
+
         connect(scene, SIGNAL(mouseActionChanged(Caneda::MouseAction)),
                 this, SLOT(onMouseActionChanged(Caneda::MouseAction)));
+        connect(scene, SIGNAL(tilesInvalidated(QRectF)),
+                this, SLOT(invalidateTiles(QRectF)));
 
         // Update current drag mode
         onMouseActionChanged(Caneda::Normal);
@@ -102,8 +127,8 @@ namespace Caneda
         // Save the position to center on after the zoom operation.
         QPointF center = rect.center();
 
-        // Now set that zoom level and center the result.
-        setZoomLevel(minRatio);
+        // Now set that zoom level (within the zoom range) and center the result.
+        setZoomLevel(qBound(m_zoomRange.min, minRatio, m_zoomRange.max));
         centerOn(center);
     }
 
@@ -202,4 +227,256 @@ namespace Caneda
         setTransformationAnchor(QGraphicsView::NoAnchor);  // Restore graphicsview anchor to be able to move afterwards
     }
 
+    //! \brief Discards all the cached tiles, for example after a settings change.
+    void GraphicsView::invalidateTiles()
+    {
+        m_tiles.clear();
+    }
+
+    //! \brief Records the viewport rect being painted, used by drawTiles().
+    void GraphicsView::paintEvent(QPaintEvent *event)
+    {
+        m_exposedRect = event->rect();
+        QGraphicsView::paintEvent(event);
+    }
+
+    /*!
+     * \brief Draws the items of the view.
+     *
+     * The static items are composited from the cached tiles, and only the live
+     * items are actually painted. If the view transform does not allow the
+     * use of tiles (for example, while rotated), all items are painted.
+     *
+     * \sa GraphicsScene::isLiveItem(), drawTiles()
+     */
+    void GraphicsView::drawItems(QPainter *painter, int numItems, QGraphicsItem *items[],
+                                 const QStyleOptionGraphicsItem options[])
+    {
+        if(!isTileCacheUsable()) {
+            QGraphicsView::drawItems(painter, numItems, items, options);
+            return;
+        }
+
+        drawTiles(painter);
+
+        QVector<QGraphicsItem*> liveItems;
+        QVector<QStyleOptionGraphicsItem> liveOptions;
+        for(int i = 0; i < numItems; ++i) {
+            if(graphicsScene()->isLiveItem(items[i])) {
+                liveItems << items[i];
+                liveOptions << options[i];
+            }
+        }
+
+        if(!liveItems.isEmpty()) {
+            QGraphicsView::drawItems(painter, liveItems.size(), liveItems.data(),
+                                     liveOptions.constData());
+        }
+    }
+
+    /*!
+     * \brief Invalidates the cached tiles intersecting a changed rect.
+     *
+     * \param sceneRect Changed rect, in scene coordinates.
+     * \sa GraphicsScene::tilesInvalidated()
+     */
+    void GraphicsView::invalidateTiles(const QRectF &sceneRect)
+    {
+        if(m_tiles.isEmpty()) {
+            return;
+        }
+
+        // Adjust the rect to include antialiased edges
+        QRectF rect = QTransform::fromScale(m_tileScale, m_tileScale).mapRect(sceneRect);
+        rect.adjust(-2, -2, 2, 2);
+
+        int firstColumn = qFloor(rect.left() / tileSize);
+        int lastColumn = qFloor(rect.right() / tileSize);
+        int firstRow = qFloor(rect.top() / tileSize);
+        int lastRow = qFloor(rect.bottom() / tileSize);
+
+        // Large rects are checked against the cached tiles instead
+        if(qint64(lastColumn - firstColumn + 1) * (lastRow - firstRow + 1) > m_tiles.size()) {
+            foreach(quint64 key, m_tiles.keys()) {
+                int column = qint32(key >> 32);
+                int row = qint32(key & 0xffffffff);
+                if(column >= firstColumn && column <= lastColumn &&
+                        row >= firstRow && row <= lastRow) {
+                    m_tiles.remove(key);
+                }
+            }
+            return;
+        }
+
+        for(int row = firstRow; row <= lastRow; ++row) {
+            for(int column = firstColumn; column <= lastColumn; ++column) {
+                m_tiles.remove(tileKey(column, row));
+            }
+        }
+    }
+
+    /*!
+     * \brief Returns true if the static items can be drawn from cached tiles.
+     *
+     * Tiles are aligned to the viewport, so they can only be used when the
+     * view transform is a plain scale and translation.
+     */
+    bool GraphicsView::isTileCacheUsable() const
+    {
+        QTransform transform = viewportTransform();
+        return scene() &&
+               transform.m12() == 0 && transform.m21() == 0 &&
+               transform.m11() > 0 && transform.m11() == transform.m22();
+    }
+
+    /*!
+     * \brief Draws the cached tiles intersecting the viewport rect being
+     * painted, rendering the missing ones.
+     *
+     * Tiles are aligned to the scaled scene origin, so panning the view reuses
+     * all cached tiles, while changing the zoom level discards them.
+     */
+    void GraphicsView::drawTiles(QPainter *painter)
+    {
+        QTransform transform = viewportTransform();
+        if(transform.m11() != m_tileScale) {
+            m_tiles.clear();
+            m_tileScale = transform.m11();
+        }
+
+        // Viewport position of the scaled scene origin
+        QPoint origin = transform.map(QPointF(0, 0)).toPoint();
+        QRect rect = m_exposedRect.translated(-origin);
+
+        int firstColumn = qFloor(qreal(rect.left()) / tileSize);
+        int lastColumn = qFloor(qreal(rect.right()) / tileSize);
+        int firstRow = qFloor(qreal(rect.top()) / tileSize);
+        int lastRow = qFloor(qreal(rect.bottom()) / tileSize);
+
+        painter->save();
+        painter->resetTransform();
+
+        for(int row = firstRow; row <= lastRow; ++row) {
+            for(int column = firstColumn; column <= lastColumn; ++column) {
+                quint64 key = tileKey(column, row);
+
+                QPixmap tile;
+                if(m_tiles.contains(key)) {
+                    tile = *m_tiles.object(key);
+                }
+                else {
+                    tile = renderTile(column, row);
+                    // The cost is the actual size of the pixmap, which is
+                    // larger on high dpi screens
+                    m_tiles.insert(key, new QPixmap(tile), tile.width() * tile.height() * 4 / 1024);
+                }
+
+                painter->drawPixmap(origin + QPoint(column * tileSize, row * tileSize), tile);
+            }
+        }
+
+        painter->restore();
+    }
+
+    /*!
+     * \brief Renders the static items of a tile.
+     *
+     * The items are painted directly, with the opacity and clipping they
+     * would have in the scene. Items with graphics effects are live items,
+     * and are not drawn here (see GraphicsScene::isLiveItem()).
+     *
+     * \param column Column of the tile, counted from the scaled scene origin.
+     * \param row Row of the tile, counted from the scaled scene origin.
+     * \return Pixmap with the static items over a transparent background.
+     */
+    QPixmap GraphicsView::renderTile(int column, int row) const
+    {
+        int ratio = devicePixelRatio();
+        QPixmap pixmap(tileSize * ratio, tileSize * ratio);
+        pixmap.setDevicePixelRatio(ratio);
+        pixmap.fill(Qt::transparent);
+
+        // Transform from scene coordinates to tile coordinates
+        QTransform tileTransform = QTransform::fromScale(m_tileScale, m_tileScale) *
+                QTransform::fromTranslate(-column * tileSize, -row * tileSize);
+        QRectF sceneRect = tileTransform.inverted().mapRect(QRectF(0, 0, tileSize, tileSize));
+
+        QPainter painter(&pixmap);
+        painter.setRenderHints(renderHints());
+        painter.setClipRect(QRect(0, 0, tileSize, tileSize));
+
+        // At low zoom levels, consecutive wires are drawn as single pixel
+        // lines in one pass. The lines are drawn before the next item that
+        // is not a wire, to keep the stacking order of the items.
+        Settings *settings = Settings::instance();
+        bool batchWires = m_tileScale < settings->currentValue("gui/lodDetailThreshold").toDouble();
+        QPen wirePen(settings->currentValue("gui/lineColor").value<QColor>(), 0);
+        QVector<QLineF> wireLines;
+
+        QList<QGraphicsItem*> items = scene()->items(sceneRect, Qt::IntersectsItemBoundingRect,
+                                                     Qt::AscendingOrder);
+        foreach(QGraphicsItem *item, items) {
+            if(!item->isVisible() || graphicsScene()->isLiveItem(item)) {
+                continue;
+            }
+
+            if(batchWires && item->type() == GraphicsItem::WireType) {
+                Wire *wire = static_cast<Wire*>(item);
+                wireLines << QLineF(wire->port1()->scenePos(), wire->port2()->scenePos());
+                continue;
+            }
+
+            drawWireLines(&painter, tileTransform, wirePen, &wireLines);
+
+            qreal opacity = item->effectiveOpacity();
+            if(opacity <= 0) {
+                continue;
+            }
+
+            QStyleOptionGraphicsItem option;
+            option.state = QStyle::State_None;
+            if(item->isEnabled()) {
+                option.state |= QStyle::State_Enabled;
+            }
+            option.exposedRect = item->boundingRect();
+
+            painter.save();
+            painter.setTransform(item->sceneTransform() * tileTransform);
+            painter.setOpacity(opacity);
+            if(item->isClipped()) {
+                painter.setClipPath(item->clipPath(), Qt::IntersectClip);
+            }
+            item->paint(&painter, &option, viewport());
+            painter.restore();
+        }
+
+        drawWireLines(&painter, tileTransform, wirePen, &wireLines);
+
+        return pixmap;
+    }
+
+    /*!
+     * \brief Draws the wires batched by renderTile() and clears the batch.
+     *
+     * \param painter Painter of the tile.
+     * \param tileTransform Transform from scene to tile coordinates.
+     * \param pen Pen used for the wires.
+     * \param lines Lines of the batched wires, in scene coordinates.
+     */
+    void GraphicsView::drawWireLines(QPainter *painter, const QTransform &tileTransform,
+                                     const QPen &pen, QVector<QLineF> *lines)
+    {
+        if(lines->isEmpty()) {
+            return;
+        }
+
+        painter->save();
+        painter->setTransform(tileTransform);
+        painter->setPen(pen);
+        painter->drawLines(*lines);
+        painter->restore();
+
+        lines->clear();
+    }
+
 } // namespace Caneda
@@ -23,6 +23,7 @@
 
 #include "global.h"
 
+#include <QCache>
 #include <QGraphicsView>
 
 namespace Caneda
@@ -45,6 +46,14 @@ namespace Caneda
      * multiple views associated to it, allowing the user to look at the scene
      * for example, with multiple zoom levels.
      *
+     * To speed up the painting of large scenes, the static items (those not
+     * selected, and thus not being moved or edited) are rendered into
+     * viewport aligned tiles which are cached by the view. Only the live items
+     * are painted on every update, over the cached tiles. The tiles are
+     * invalidated per region when the scene items change (see
+     * GraphicsScene::tilesInvalidated()), and discarded whenever the zoom
+     * level changes.
+     *
      * \sa GraphicsScene
      */
     class GraphicsView : public QGraphicsView
@@ -64,6 +73,8 @@ namespace Caneda
 
         qreal currentZoom() { return m_currentZoom; }
 
+        void invalidateTiles();
+
     Q_SIGNALS:
         void cursorPositionChanged(const QString& newPos);
         void focussedIn(GraphicsView *view);
@@ -75,13 +86,23 @@ namespace Caneda
         void mouseReleaseEvent(QMouseEvent *event);
         void focusInEvent(QFocusEvent *event);
         void focusOutEvent(QFocusEvent *event);
+        void paintEvent(QPaintEvent *event);
+        void drawItems(QPainter *painter, int numItems, QGraphicsItem *items[],
+                       const QStyleOptionGraphicsItem options[]);
 
     private Q_SLOTS:
         void onMouseActionChanged(Caneda::MouseAction mouseAction);
+        void invalidateTiles(const QRectF &sceneRect);
 
     private:
         void setZoomLevel(qreal zoomLevel);
 
+        bool isTileCacheUsable() const;
+        void drawTiles(QPainter *painter);
+        QPixmap renderTile(int column, int row) const;
+        static void drawWireLines(QPainter *painter, const QTransform &tileTransform,
+                                  const QPen &pen, QVector<QLineF> *lines);
+
         const qreal m_zoomFactor;
         ZoomRange m_zoomRange;
         qreal m_currentZoom;
@@ -89,6 +110,13 @@ namespace Caneda
         //! \brief Auxiliary pan variables
         bool panMode;
         QPointF panStartPosition;
+
+        //! \brief Cached tiles of static items, indexed by column and row
+        QCache<quint64, QPixmap> m_tiles;
+        //! \brief Scale of the cached tiles
+        qreal m_tileScale;
+        //! \brief Viewport rect being painted
+        QRect m_exposedRect;
     };
 
 } // namespace Caneda
@@ -477,7 +477,7 @@ namespace Caneda
     void SimulationContext::updateSideBar()
     {
         if(m_sidebarBrowser) {
-            m_sidebarBrowser->updateChartSeriesMap();
+            m_sidebarBrowser->updateChartSeriesModel();
         }
     }
 
@@ -30,26 +30,51 @@
 #include "iview.h"
 #include "mainwindow.h"
 #include "messagewidget.h"
+#include "ngspiceshared.h"
 #include "portsymbol.h"
+#include "rulechecker.h"
 #include "settings.h"
+#include "simulationcache.h"
+#include "simulationstream.h"
 #include "statehandler.h"
 #include "syntaxhighlighters.h"
 #include "textedit.h"
+#include "tiledrenderer.h"
 
 #include <QDesktopServices>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
 #include <QMenu>
 #include <QMessageBox>
+#include <QPicture>
 #include <QPrinter>
 #include <QProcess>
 #include <QTextCodec>
 #include <QTextDocument>
 #include <QTextStream>
+#include <QTimer>
 
 namespace Caneda
 {
+    /*!
+     * \brief Snapshot of a document already serialized in the GUI thread.
+     *
+     * This is used by small documents, whose serialization is cheap.
+     */
+    class TextSnapshot : public DocumentSnapshot
+    {
+    public:
+        explicit TextSnapshot(const QString &text) : m_text(text) {}
+
+        QString toText() const { return m_text; }
+
+    private:
+        QString m_text;
+    };
+
     /*************************************************************************
      *                             IDocument                                 *
      *************************************************************************/
@@ -281,6 +306,28 @@ namespace Caneda
      * \sa \ref DocumentFormats
      */
 
+    /*!
+     * \fn IDocument::snapshot()
+     *
+     * \brief Returns a snapshot of the document, to be serialized in the
+     * same format used by save() from a worker thread.
+     *
+     * This is used to save the document without blocking the GUI thread,
+     * for example by the AutoSaver.
+     *
+     * \return Snapshot of the document, or a null pointer if the document
+     * does not support snapshots.
+     *
+     * \sa save(), DocumentSnapshot, AutoSaver
+     */
+
+    /*!
+     * \fn IDocument::undoStack()
+     *
+     * \brief Returns the undo stack of the document, or 0 if the document
+     * does not use a QUndoStack.
+     */
+
     /*!
      * \fn IDocument::contextMenuEvent(QGraphicsSceneContextMenuEvent *e)
      *
@@ -344,6 +391,26 @@ namespace Caneda
         return DocumentViewManager::instance()->viewsForDocument(this);
     }
 
+    /*!
+     * \brief Export current document through a tiled renderer.
+     *
+     * This method is called by the ExportDialog class to export big raster
+     * images (and pdf files). Graphics documents record their scene region
+     * by region, so each tile only replays the items it contains. This
+     * default implementation records the whole exportImage() output into a
+     * single picture.
+     *
+     * \sa exportImage(), TiledRenderer
+     */
+    void IDocument::exportTiles(TiledRenderer *renderer)
+    {
+        QPicture picture;
+        picture.setBoundingRect(QRect(QPoint(0, 0), renderer->imageSize()));
+        exportImage(picture);
+
+        renderer->addPicture(picture, QRect(QPoint(0, 0), renderer->imageSize()));
+    }
+
     void IDocument::emitDocumentChanged()
     {
         emit documentChanged(this);
@@ -363,7 +430,7 @@ namespace Caneda
                 this, SLOT(emitDocumentChanged()));
         connect(m_graphicsScene->undoStack(), SIGNAL(canRedoChanged(bool)),
                 this, SLOT(emitDocumentChanged()));
-        connect(m_graphicsScene, SIGNAL(selectionChanged()), this,
+        connect(m_graphicsScene, SIGNAL(selectionChangeFinished()), this,
                 SLOT(emitDocumentChanged()));
     }
 
@@ -443,9 +510,7 @@ namespace Caneda
 
     void LayoutDocument::selectAll()
     {
-        QPainterPath path;
-        path.addRect(m_graphicsScene->sceneRect());
-        m_graphicsScene->setSelectionArea(path);
+        m_graphicsScene->selectAll();
     }
 
     void LayoutDocument::enterHierarchy()
@@ -519,6 +584,11 @@ namespace Caneda
         m_graphicsScene->exportImage(device);
     }
 
+    void LayoutDocument::exportTiles(TiledRenderer *renderer)
+    {
+        m_graphicsScene->exportTiles(renderer);
+    }
+
     QSizeF LayoutDocument::documentSize()
     {
         return m_graphicsScene->itemsBoundingRect().size();
@@ -568,6 +638,18 @@ namespace Caneda
         return false;
     }
 
+    //! \brief Small documents are serialized here, see TextSnapshot.
+    DocumentSnapshotPtr LayoutDocument::snapshot()
+    {
+        FormatXmlLayout format(this);
+        return DocumentSnapshotPtr(new TextSnapshot(format.saveText()));
+    }
+
+    QUndoStack* LayoutDocument::undoStack()
+    {
+        return m_graphicsScene->undoStack();
+    }
+
     IView* LayoutDocument::createView()
     {
         return new LayoutView(this);
@@ -630,8 +712,11 @@ namespace Caneda
                 this, SLOT(emitDocumentChanged()));
         connect(m_graphicsScene->undoStack(), SIGNAL(canRedoChanged(bool)),
                 this, SLOT(emitDocumentChanged()));
-        connect(m_graphicsScene, SIGNAL(selectionChanged()), this,
+        connect(m_graphicsScene, SIGNAL(selectionChangeFinished()), this,
                 SLOT(emitDocumentChanged()));
+
+        Settings *settings = Settings::instance();
+        m_graphicsScene->ruleChecker()->setEnabled(settings->currentValue("sim/ruleCheck").toBool());
     }
 
     //! \brief Destructor.
@@ -710,9 +795,7 @@ namespace Caneda
 
     void SchematicDocument::selectAll()
     {
-        QPainterPath path;
-        path.addRect(m_graphicsScene->sceneRect());
-        m_graphicsScene->setSelectionArea(path);
+        m_graphicsScene->selectAll();
     }
 
     void SchematicDocument::enterHierarchy()
@@ -782,6 +865,15 @@ namespace Caneda
      */
     void SchematicDocument::simulate()
     {
+        // The ngspice shared library runs the simulation in process
+        Settings *settings = Settings::instance();
+        if(settings->currentValue("sim/simulationEngine").toString() == "ngspiceShared") {
+            if(performBasicChecks()) {
+                simulateInProcess();
+            }
+            return;
+        }
+
         /*! \todo In the future (after Qt5.6 is released), instead of this
          * first check, simply connect the simulation process with the slot
          * simulationError, in a way similar to the following:
@@ -808,8 +900,29 @@ namespace Caneda
             format->save();
         }
 
+        // Open the stored results if the same netlist was already simulated
+        SimulationCache *cache = SimulationCache::instance();
+        m_cacheKey.clear();
+        if(cache->isEnabled()) {
+            QFile netlist(path + "/" + baseName + ".net");
+            if(netlist.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                QString command = settings->currentValue("sim/simulationCommand").toString();
+                QString version = cache->simulatorVersion(command);
+
+                // Results of an unknown simulator version are not cached
+                if(!version.isNull()) {
+                    QString simulator = command + "\n" +
+                            settings->currentValue("sim/outputFormat").toString() + "\n" + version;
+
+                    m_cacheKey = cache->key(QString::fromUtf8(netlist.readAll()), path, simulator);
+                    if(openCachedResults()) {
+                        return;
+                    }
+                }
+            }
+        }
+
         // Invoke a spice simulator in batch mode
-        Settings *settings = Settings::instance();
         QString simulationCommand = settings->currentValue("sim/simulationCommand").toString();
         simulationCommand.replace("%filename", baseName);  // Replace all ocurrencies of %filename by the actual filename
 
@@ -828,13 +941,69 @@ namespace Caneda
         }
         simulationProcess->setProcessEnvironment(env);
 
+        // Follow the raw file while it is written, to plot the waveforms
+        // during the simulation. The previous raw file is removed to avoid
+        // streaming stale results.
+        delete m_simulationStream;
+        if(settings->currentValue("sim/liveWaveforms").toBool()) {
+            QString rawFile = QDir::toNativeSeparators(path + "/" + baseName + ".raw");
+            QFile::remove(rawFile);
+
+            m_simulationStream = new SimulationStream(rawFile, this);
+            m_simulationStream->start();
+        }
+
         // Start the simulation
+        m_simulationTimer.start();
         simulationProcess->start(simulationCommand);
 
         // The simulation results are opened in the simulationReady slot, to avoid blocking the interface while simulating
         connect(simulationProcess, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(simulationReady(int)));
     }
 
+    /*!
+     * \brief Simulates the schematic with the ngspice shared library.
+     *
+     * The netlist is generated in memory and simulated in a background
+     * thread. The results are shown in inProcessSimulationReady(), without
+     * writing or reading any file.
+     *
+     * \sa NgspiceShared, simulate()
+     */
+    void SchematicDocument::simulateInProcess()
+    {
+        NgspiceShared *ngspice = NgspiceShared::instance();
+
+        QString errorMessage;
+        if(!ngspice->load(&errorMessage)) {
+            QMessageBox::critical(0, tr("Error"), errorMessage);
+            return;
+        }
+
+        FormatSpice *format = new FormatSpice(this);
+        QString netlist = format->generateNetlist();
+        delete format;
+
+        // Open the stored results if the same netlist was already simulated
+        SimulationCache *cache = SimulationCache::instance();
+        m_cacheKey.clear();
+        if(cache->isEnabled()) {
+            Settings *settings = Settings::instance();
+            QString simulator = "ngspiceShared\n" + settings->currentValue("sim/ngspiceLibrary").toString();
+
+            m_cacheKey = cache->key(netlist, QFileInfo(fileName()).path(), simulator);
+            if(openCachedResults()) {
+                return;
+            }
+        }
+
+        m_simulationTimer.start();
+
+        QFutureWatcher<SimulationResults> *watcher = new QFutureWatcher<SimulationResults>(this);
+        connect(watcher, SIGNAL(finished()), this, SLOT(inProcessSimulationReady()));
+        watcher->setFuture(ngspice->run(netlist));
+    }
+
     void SchematicDocument::print(QPrinter *printer, bool fitInView)
     {
         m_graphicsScene->print(printer, fitInView);
@@ -845,6 +1014,11 @@ namespace Caneda
         m_graphicsScene->exportImage(device);
     }
 
+    void SchematicDocument::exportTiles(TiledRenderer *renderer)
+    {
+        m_graphicsScene->exportTiles(renderer);
+    }
+
     QSizeF SchematicDocument::documentSize()
     {
         return m_graphicsScene->itemsBoundingRect().size();
@@ -878,6 +1052,7 @@ namespace Caneda
         QFileInfo info(fileName());
 
         if(info.suffix() == "xsch") {
+            // The undo stack is only cleared once the file is written
             FormatXmlSchematic *format = new FormatXmlSchematic(this);
             if(!format->save()) {
                 return false;
@@ -894,6 +1069,17 @@ namespace Caneda
         return false;
     }
 
+    DocumentSnapshotPtr SchematicDocument::snapshot()
+    {
+        FormatXmlSchematic format(this);
+        return DocumentSnapshotPtr(new SchematicSnapshot(format.snapshot()));
+    }
+
+    QUndoStack* SchematicDocument::undoStack()
+    {
+        return m_graphicsScene->undoStack();
+    }
+
     IView* SchematicDocument::createView()
     {
         return new SchematicView(this);
@@ -954,9 +1140,21 @@ namespace Caneda
      */
     void SchematicDocument::simulationReady(int error)
     {
+        SimulationStream *stream = m_simulationStream;
+        m_simulationStream = 0;
+
+        QString cacheKey = m_cacheKey;
+        m_cacheKey.clear();
+
         // Test for errors, and open log file (in case something went wrong).
         // If there was an error, do not display the waveforms
         if(error) {
+            // Stop following the raw file. The partial results already
+            // shown are kept open.
+            if(stream) {
+                stream->finish();
+                delete stream;
+            }
 
             DocumentViewManager *manager = DocumentViewManager::instance();
             IView *view = manager->currentView();
@@ -977,14 +1175,137 @@ namespace Caneda
             return;
         }
 
-        // Open the resulting waveforms
+        QFileInfo info(fileName());
+        QString path = info.path();
+        QString baseName = info.completeBaseName();
+        QString rawFile = QDir::toNativeSeparators(path + "/" + baseName + ".raw");
+
+        // Store the results, to avoid simulating the same netlist again
+        if(!cacheKey.isEmpty()) {
+            SimulationCache::instance()->insert(cacheKey, rawFile, m_simulationTimer.elapsed());
+        }
+
+        // If the waveforms were plotted while simulating, read the rest of
+        // the results. Otherwise, open the resulting waveforms.
+        if(stream) {
+            bool streamed = stream->finish();
+            delete stream;
+            if(streamed) {
+                return;
+            }
+        }
+
         DocumentViewManager *manager = DocumentViewManager::instance();
+        manager->openFile(rawFile);
+    }
+
+    /*!
+     * \brief Show the results of a simulation run in process.
+     *
+     * On errors, the netlist and the simulator messages are written to the
+     * usual files, to allow the user to inspect them.
+     *
+     * \sa simulateInProcess()
+     */
+    void SchematicDocument::inProcessSimulationReady()
+    {
+        QFutureWatcher<SimulationResults> *watcher =
+                static_cast<QFutureWatcher<SimulationResults>*>(sender());
+        SimulationResults results = watcher->result();
+        watcher->deleteLater();
 
         QFileInfo info(fileName());
         QString path = info.path();
         QString baseName = info.completeBaseName();
 
-        manager->openFile(QDir::toNativeSeparators(path + "/" + baseName + ".raw"));
+        if(!results.errorMessage.isEmpty()) {
+            FormatSpice *format = new FormatSpice(this);
+            format->save();
+            delete format;
+
+            QFile log(path + "/" + baseName + ".log");
+            if(log.open(QIODevice::WriteOnly | QIODevice::Text)) {
+                QTextStream stream(&log);
+                stream << results.output.join("\n") << "\n";
+            }
+
+            simulationReady(1);
+            return;
+        }
+
+        // Replace the results of a previous simulation in place, keeping
+        // the state of its views
+        DocumentViewManager *manager = DocumentViewManager::instance();
+        QString rawFile = QDir::toNativeSeparators(path + "/" + baseName + ".raw");
+
+        SimulationDocument *document =
+                qobject_cast<SimulationDocument*>(manager->documentForFileName(rawFile));
+        if(document) {
+            ChartScene scene;
+            NgspiceShared::addCurves(results, &scene);
+            document->replaceCurves(scene.items());
+        }
+        else {
+            document = new SimulationDocument;
+            document->setFileName(rawFile);
+            NgspiceShared::addCurves(results, document->chartScene());
+
+            manager->addDocument(document);
+        }
+
+        // Write the results to the raw file once they are shown, as the
+        // external simulator would, and store them in the cache. The file
+        // holds the waveforms already shown, so it is not reloaded.
+        bool saved = NgspiceShared::saveRawFile(results, rawFile);
+        if(saved) {
+            document->watchFile(QFileInfo(rawFile));
+            if(!m_cacheKey.isEmpty()) {
+                SimulationCache::instance()->insert(m_cacheKey, rawFile, m_simulationTimer.elapsed());
+            }
+        }
+        m_cacheKey.clear();
+    }
+
+    /*!
+     * \brief Opens the stored results of the simulation, if available.
+     *
+     * The stored raw file is copied as the results of this schematic, and
+     * the user is told the time saved by not simulating it again.
+     *
+     * \return True if the results were found in the simulation cache.
+     *
+     * \sa SimulationCache
+     */
+    bool SchematicDocument::openCachedResults()
+    {
+        QString cachedFile;
+        qint64 duration = 0;
+        SimulationCache *cache = SimulationCache::instance();
+        if(m_cacheKey.isEmpty() || !cache->lookup(m_cacheKey, &cachedFile, &duration)) {
+            return false;
+        }
+
+        QFileInfo info(fileName());
+        QString rawFile = QDir::toNativeSeparators(info.path() + "/" + info.completeBaseName() + ".raw");
+
+        QFile::remove(rawFile);
+        if(!QFile::copy(cachedFile, rawFile)) {
+            return false;
+        }
+        cache->markUsed(m_cacheKey);
+        m_cacheKey.clear();
+
+        DocumentViewManager *manager = DocumentViewManager::instance();
+        manager->openFile(rawFile);
+
+        MessageWidget *dialog = new MessageWidget(tr("Results loaded from the simulation cache, saving %1 s of simulation.")
+                                                  .arg(duration / 1000.0, 0, 'f', 2),
+                                                  manager->currentView()->toWidget());
+        dialog->setMessageType(MessageWidget::Positive);
+        dialog->setIcon(Caneda::icon("dialog-information"));
+        dialog->show();
+
+        return true;
     }
 
     /*!
@@ -1184,10 +1505,25 @@ namespace Caneda
     /*************************************************************************
      *                         SimulationDocument                            *
      *************************************************************************/
+    //! \brief Time to wait for the writes to a waveform file to settle, in ms.
+    static const int reloadDelay = 500;
+
     //! \brief Constructor.
-    SimulationDocument::SimulationDocument(QObject *parent) : IDocument(parent)
+    SimulationDocument::SimulationDocument(QObject *parent) :
+        IDocument(parent),
+        m_loadedSize(-1)
     {
         m_chartScene = new ChartScene;
+
+        // Reload the waveforms when a simulation overwrites the file
+        m_fileWatcher = new QFileSystemWatcher(this);
+        connect(m_fileWatcher, SIGNAL(fileChanged(const QString &)), this,
+                SLOT(onFileChanged()));
+
+        m_reloadTimer = new QTimer(this);
+        m_reloadTimer->setSingleShot(true);
+        m_reloadTimer->setInterval(reloadDelay);
+        connect(m_reloadTimer, SIGNAL(timeout()), this, SLOT(reloadChangedFile()));
     }
 
     //! \brief Destructor.
@@ -1269,6 +1605,10 @@ namespace Caneda
         QFileInfo info(fileName());
 
         if(info.suffix() == "raw") {
+            // The state of the file is recorded before reading it, so that
+            // writes during the load are reloaded afterwards
+            watchFile(info);
+
             FormatRawSimulation *format = new FormatRawSimulation(this);
             return format->load();
         }
@@ -1280,6 +1620,225 @@ namespace Caneda
         return false;
     }
 
+    /*!
+     * \brief Reloads the waveforms in place, keeping the views and their state.
+     *
+     * The file is parsed into a new set of curves, which replaces the
+     * current one (see replaceCurves()).
+     *
+     * Nothing is done if the size and modification time of the file did not
+     * change since it was last loaded, so an unchanged file is not read at
+     * all. Modification times have sub-second resolution on the usual file
+     * systems, so a simulation rewriting the file is detected even if the
+     * size of the results did not change.
+     *
+     * \return True on success, false if the file could not be loaded (the
+     * current waveforms are kept).
+     *
+     * \sa replaceCurves()
+     */
+    bool SimulationDocument::reload(QString *errorMessage)
+    {
+        QFileInfo info(fileName());
+        if(info.suffix() != "raw" || !info.exists()) {
+            if(errorMessage) {
+                *errorMessage = tr("Unknown file format!");
+            }
+            return false;
+        }
+
+        if(info.size() == m_loadedSize && info.lastModified() == m_loadedModified) {
+            return true;
+        }
+
+        ChartScene scene;
+        FormatRawSimulation format(this, &scene);
+        if(!format.load() || scene.items().isEmpty()) {
+            qDeleteAll(scene.items());
+            return false;
+        }
+
+        replaceCurves(scene.items());
+        watchFile(info);
+
+        return true;
+    }
+
+    /*!
+     * \brief Replaces the waveforms in place, keeping the views and their
+     * state.
+     *
+     * The new set of curves is compared by name with the current one. The
+     * data of the curves present in both sets is swapped under the existing
+     * curves, curves no longer present are removed and new ones are added.
+     * The views keep their zoom, cursors, split state and the visibility of
+     * each waveform.
+     *
+     * This is used both to reload the file and to show the results of a
+     * new simulation of the same schematic.
+     *
+     * \param curves New curves, owned by this document afterwards.
+     *
+     * \sa ChartView::reloadCurves()
+     */
+    void SimulationDocument::replaceCurves(const QList<ChartSeries*> &curves)
+    {
+        // Match the new curves with the current ones by name
+        QHash<QString, QList<ChartSeries*> > currentCurves;
+        foreach(ChartSeries *curve, m_chartScene->items()) {
+            currentCurves[curve->title().text()] << curve;
+        }
+
+        QHash<const QwtSeriesData<QPointF>*, ChartSeries*> replaced;
+        QList<QwtSeriesData<QPointF>*> oldData;
+        QList<ChartSeries*> added;
+
+        foreach(ChartSeries *curve, curves) {
+            QList<ChartSeries*> &candidates = currentCurves[curve->title().text()];
+            if(candidates.isEmpty()) {
+                m_chartScene->addItem(curve);
+                added << curve;
+                continue;
+            }
+
+            ChartSeries *current = candidates.takeFirst();
+            QwtSeriesData<QPointF> *data = current->swapData(curve->swapData(0));
+            current->setType(curve->type());
+            current->setFamily(curve->family());
+            current->setIndex(curve->index());
+
+            replaced.insert(data, current);
+            oldData << data;
+            delete curve;
+        }
+
+        // Curves no longer present are removed once the views are updated
+        QList<ChartSeries*> removed;
+        foreach(const QList<ChartSeries*> &candidates, currentCurves) {
+            foreach(ChartSeries *curve, candidates) {
+                m_chartScene->removeItem(curve);
+                oldData << curve->swapData(0);
+                removed << curve;
+            }
+        }
+
+        DocumentViewManager *manager = DocumentViewManager::instance();
+        foreach(IView *view, manager->viewsForDocument(this)) {
+            ChartView *chartView = qobject_cast<ChartView*>(view->toWidget());
+            if(chartView) {
+                chartView->reloadCurves(replaced, added);
+            }
+        }
+
+        qDeleteAll(removed);
+        qDeleteAll(oldData);
+
+        // Keep the waveforms list in sync if this document is being shown
+        IView *currentView = manager->currentView();
+        if(currentView && currentView->document() == this) {
+            context()->updateSideBar();
+        }
+    }
+
+    //! \brief Schedules a reload once the writes to the file settle.
+    void SimulationDocument::onFileChanged()
+    {
+        m_reloadTimer->start();
+    }
+
+    /*!
+     * \brief Reloads the waveforms after the file changed.
+     *
+     * Writes may pause for longer than the reload delay while a simulation
+     * is running, so the file is only reloaded once it is complete. The
+     * simulator writes the file again when it finishes, which schedules
+     * a new reload.
+     *
+     * \sa isRawFileComplete()
+     */
+    void SimulationDocument::reloadChangedFile()
+    {
+        if(isRawFileComplete(fileName())) {
+            reload();
+        }
+    }
+
+    /*!
+     * \brief Records the loaded file state and watches the file for changes.
+     *
+     * Files replaced (instead of rewritten) by other programs are removed
+     * from the watcher, so the file is added again each time it is loaded.
+     *
+     * \param loadedFile State of the file when its waveforms were read (or
+     * written, for results shown before being saved).
+     *
+     * \sa reload()
+     */
+    void SimulationDocument::watchFile(const QFileInfo &loadedFile)
+    {
+        m_loadedSize = loadedFile.size();
+        m_loadedModified = loadedFile.lastModified();
+
+        if(!m_fileWatcher->files().contains(fileName())) {
+            m_fileWatcher->addPath(fileName());
+        }
+    }
+
+    /*!
+     * \brief Returns true if a raw file holds all the points of its header.
+     *
+     * Simulators write the number of points in the header once the
+     * simulation finishes (until then, it is zero), and the data of the
+     * points as they are computed. A file being written has either no
+     * points in the header yet, or less data than the header announces.
+     * Only the first plot of the file is checked.
+     */
+    bool SimulationDocument::isRawFileComplete(const QString &fileName)
+    {
+        QFile file(fileName);
+        if(!file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+
+        int variables = 0;
+        qint64 points = 0;
+        bool complex = false;
+
+        forever {
+            const QByteArray rawLine = file.readLine();
+            if(rawLine.isEmpty()) {
+                return false;  // No data yet
+            }
+
+            const QString line = QString::fromUtf8(rawLine).trimmed();
+            const QString keyword = line.section(':', 0, 0).toLower();
+
+            if(keyword == "flags") {
+                complex = line.section(':', 1).toLower().contains("complex");
+            }
+            else if(keyword == "no. variables") {
+                variables = line.section(':', 1).trimmed().toInt();
+            }
+            else if(keyword == "no. points") {
+                points = line.section(':', 1).trimmed().toLongLong();
+            }
+            else if(keyword == "binary") {
+                const qint64 pointSize = qint64(variables) * (complex ? 16 : 8);
+                return points > 0 && file.size() - file.pos() >= points * pointSize;
+            }
+            else if(keyword == "values") {
+                // Each point takes one line per variable
+                qint64 lines = 0;
+                while(!file.atEnd()) {
+                    if(!file.readLine().trimmed().isEmpty()) {
+                        ++lines;
+                    }
+                }
+                return points > 0 && lines >= points * variables;
+            }
+        }
+    }
+
     IView* SimulationDocument::createView()
     {
         return new SimulationView(this);
@@ -1310,7 +1869,7 @@ namespace Caneda
                 this, SLOT(emitDocumentChanged()));
         connect(m_graphicsScene->undoStack(), SIGNAL(canRedoChanged(bool)),
                 this, SLOT(emitDocumentChanged()));
-        connect(m_graphicsScene, SIGNAL(selectionChanged()), this,
+        connect(m_graphicsScene, SIGNAL(selectionChangeFinished()), this,
                 SLOT(emitDocumentChanged()));
     }
 
@@ -1390,9 +1949,7 @@ namespace Caneda
 
     void SymbolDocument::selectAll()
     {
-        QPainterPath path;
-        path.addRect(m_graphicsScene->sceneRect());
-        m_graphicsScene->setSelectionArea(path);
+        m_graphicsScene->selectAll();
     }
 
     void SymbolDocument::enterHierarchy()
@@ -1461,6 +2018,11 @@ namespace Caneda
         m_graphicsScene->exportImage(device);
     }
 
+    void SymbolDocument::exportTiles(TiledRenderer *renderer)
+    {
+        m_graphicsScene->exportTiles(renderer);
+    }
+
     QSizeF SymbolDocument::documentSize()
     {
         return m_graphicsScene->itemsBoundingRect().size();
@@ -1510,6 +2072,18 @@ namespace Caneda
         return false;
     }
 
+    //! \brief Small documents are serialized here, see TextSnapshot.
+    DocumentSnapshotPtr SymbolDocument::snapshot()
+    {
+        FormatXmlSymbol format(this);
+        return DocumentSnapshotPtr(new TextSnapshot(format.saveText()));
+    }
+
+    QUndoStack* SymbolDocument::undoStack()
+    {
+        return m_graphicsScene->undoStack();
+    }
+
     IView* SymbolDocument::createView()
     {
         return new SymbolView(this);
@@ -21,23 +21,55 @@
 #ifndef CANEDA_IDOCUMENT_H
 #define CANEDA_IDOCUMENT_H
 
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <QObject>
 #include <QGraphicsSceneEvent>
+#include <QPointer>
+#include <QSharedPointer>
 
 // Forward declarations
+class QFileInfo;
+class QFileSystemWatcher;
 class QPaintDevice;
 class QPrinter;
 class QTextDocument;
+class QTimer;
+class QUndoStack;
 
 namespace Caneda
 {
     // Forward declarations
     class GraphicsScene;
     class ChartScene;
+    class ChartSeries;
     class DocumentViewManager;
     class IContext;
     class IView;
+    class SimulationStream;
     class TextEdit;
+    class TiledRenderer;
+
+    /*!
+     * \brief Copy of the contents of a document, to be saved in a worker
+     * thread.
+     *
+     * A snapshot is taken in the GUI thread by IDocument::snapshot(), and
+     * must be cheap to take. Its text is then generated by toText(), which
+     * may run in any thread and must not access the document.
+     *
+     * \sa IDocument::snapshot(), AutoSaver
+     */
+    class DocumentSnapshot
+    {
+    public:
+        virtual ~DocumentSnapshot() {}
+
+        //! \brief Returns the document serialized in its file format.
+        virtual QString toText() const = 0;
+    };
+
+    typedef QSharedPointer<DocumentSnapshot> DocumentSnapshotPtr;
 
     /*************************************************************************
      *                    General IDocument Structure                        *
@@ -103,10 +135,13 @@ namespace Caneda
         virtual bool printSupportsFitInPage() const = 0;
         virtual void print(QPrinter *printer, bool fitInPage) = 0;
         virtual void exportImage(QPaintDevice &device) = 0;
+        virtual void exportTiles(TiledRenderer *renderer);
         virtual QSizeF documentSize() = 0;
 
         virtual bool load(QString *errorMessage = 0) = 0;
         virtual bool save(QString *errorMessage = 0) = 0;
+        virtual DocumentSnapshotPtr snapshot() = 0;
+        virtual QUndoStack* undoStack() = 0;
 
         virtual IView* createView() = 0;
         QList<IView*> views() const;
@@ -192,10 +227,13 @@ namespace Caneda
         virtual bool printSupportsFitInPage() const  { return true; }
         virtual void print(QPrinter *printer, bool fitInView);
         virtual void exportImage(QPaintDevice &device);
+        virtual void exportTiles(TiledRenderer *renderer);
         virtual QSizeF documentSize();
 
         virtual bool load(QString *errorMessage = 0);
         virtual bool save(QString *errorMessage = 0);
+        virtual DocumentSnapshotPtr snapshot();
+        virtual QUndoStack* undoStack();
 
         virtual IView* createView();
 
@@ -272,10 +310,13 @@ namespace Caneda
         virtual bool printSupportsFitInPage() const { return true; }
         virtual void print(QPrinter *printer, bool fitInView);
         virtual void exportImage(QPaintDevice &device);
+        virtual void exportTiles(TiledRenderer *renderer);
         virtual QSizeF documentSize();
 
         virtual bool load(QString *errorMessage = 0);
         virtual bool save(QString *errorMessage = 0);
+        virtual DocumentSnapshotPtr snapshot();
+        virtual QUndoStack* undoStack();
 
         virtual IView* createView();
 
@@ -287,11 +328,19 @@ namespace Caneda
 
     private Q_SLOTS:
         void simulationReady(int error);
+        void inProcessSimulationReady();
         bool simulationError();
         void showSimulationHelp();
 
     private:
+        void simulateInProcess();
+        bool openCachedResults();
+
         GraphicsScene *m_graphicsScene;
+        QPointer<SimulationStream> m_simulationStream;  //! \brief Live results of the running simulation
+
+        QString m_cacheKey;               //! \brief Simulation cache key of the running simulation
+        QElapsedTimer m_simulationTimer;  //! \brief Duration of the running simulation
 
         void alignElements(Qt::Alignment alignment);
         bool performBasicChecks();
@@ -309,6 +358,9 @@ namespace Caneda
      * actual scene. The scene itself is included as a pointer to
      * ChartScene, that contains all the scene specific methods.
      *
+     * The waveform file is watched for changes, and reloaded in place
+     * (see reload()) once a new simulation has completely rewritten it.
+     *
      * \sa IContext, IDocument, IView, \ref DocumentViewFramework
      * \sa SimulationContext, SimulationView
      */
@@ -362,6 +414,8 @@ namespace Caneda
 
         virtual bool load(QString *errorMessage = 0);
         virtual bool save(QString *errorMessage = 0) {}
+        virtual DocumentSnapshotPtr snapshot() { return DocumentSnapshotPtr(); }
+        virtual QUndoStack* undoStack() { return 0; }
 
         virtual IView* createView();
 
@@ -371,8 +425,23 @@ namespace Caneda
 
         ChartScene* chartScene() const { return m_chartScene; }
 
+        bool reload(QString *errorMessage = 0);
+        void replaceCurves(const QList<ChartSeries*> &curves);
+        void watchFile(const QFileInfo &loadedFile);
+
+    private Q_SLOTS:
+        void onFileChanged();
+        void reloadChangedFile();
+
     private:
+        static bool isRawFileComplete(const QString &fileName);
+
         ChartScene *m_chartScene;
+
+        QFileSystemWatcher *m_fileWatcher;  //! \brief Watches the waveform file for changes
+        QTimer *m_reloadTimer;         //! \brief Waits for the file writes to settle before reloading
+        qint64 m_loadedSize;           //! \brief Size of the loaded file
+        QDateTime m_loadedModified;    //! \brief Modification time of the loaded file
     };
 
     /*!
@@ -436,10 +505,13 @@ namespace Caneda
         virtual bool printSupportsFitInPage() const { return true; }
         virtual void print(QPrinter *printer, bool fitInView);
         virtual void exportImage(QPaintDevice &device);
+        virtual void exportTiles(TiledRenderer *renderer);
         virtual QSizeF documentSize();
 
         virtual bool load(QString *errorMessage = 0);
         virtual bool save(QString *errorMessage = 0);
+        virtual DocumentSnapshotPtr snapshot();
+        virtual QUndoStack* undoStack();
 
         virtual IView* createView();
 
@@ -520,6 +592,8 @@ namespace Caneda
 
         virtual bool load(QString *errorMessage = 0);
         virtual bool save(QString *errorMessage = 0);
+        virtual DocumentSnapshotPtr snapshot() { return DocumentSnapshotPtr(); }
+        virtual QUndoStack* undoStack() { return 0; }
 
         virtual IView* createView();
 
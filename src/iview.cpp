@@ -24,10 +24,13 @@
 #include "chartscene.h"
 #include "chartview.h"
 #include "documentviewmanager.h"
+#include "graphicsscene.h"
 #include "graphicsview.h"
 #include "icontext.h"
 #include "idocument.h"
 #include "global.h"
+#include "rulechecker.h"
+#include "settings.h"
 #include "statehandler.h"
 #include "textedit.h"
 
@@ -240,6 +243,7 @@ namespace Caneda
     {
         m_graphicsView->invalidateScene();
         m_graphicsView->resetCachedContent();
+        m_graphicsView->invalidateTiles();
     }
 
     void LayoutView::onWidgetFocussedIn()
@@ -313,6 +317,11 @@ namespace Caneda
     {
         m_graphicsView->invalidateScene();
         m_graphicsView->resetCachedContent();
+        m_graphicsView->invalidateTiles();
+
+        Settings *settings = Settings::instance();
+        m_graphicsView->graphicsScene()->ruleChecker()->setEnabled(
+                    settings->currentValue("sim/ruleCheck").toBool());
     }
 
     void SchematicView::onWidgetFocussedIn()
@@ -463,6 +472,7 @@ namespace Caneda
     {
         m_graphicsView->invalidateScene();
         m_graphicsView->resetCachedContent();
+        m_graphicsView->invalidateTiles();
     }
 
     void SymbolView::onWidgetFocussedIn()
@@ -269,40 +269,66 @@ namespace Caneda
      * This is specially useful to let the user choose whatever name he wants,
      * without having to check for existing names.
      *
+     * The key is interned to an integer handle, which should be kept by the
+     * component data. In this way, painting a component only needs an indexed
+     * access instead of building and hashing a string key.
+     *
      * \param compName Component name, used as part of the key
      * \param libName Library name, used as part of the key
-     * \param content QPainterPath containing the symbol to register
+     * \param libPath Library path, used by the netlist generation
+     * \param content SymbolGeometry containing the symbol to register
+     * \return The handle of the symbol
      *
      * \sa symbolCache(), pixmapCache()
      */
-    void LibraryManager::registerComponent(const QString &compName, const QString &libName, const QPainterPath& content)
+    int LibraryManager::registerComponent(const QString &compName, const QString &libName,
+                                          const QString &libPath, const SymbolGeometry& content)
     {
         QString symbol_id = compName + ":" + libName;
 
-        if(m_dataHash.contains(symbol_id)) {
-            return;
+        if(m_symbolHandles.contains(symbol_id)) {
+            return m_symbolHandles.value(symbol_id);
         }
 
-        m_dataHash[symbol_id] = content;
+        int handle = m_symbols.size();
+        m_symbols.append(content);
+        m_pixmapKeys.append(QPixmapCache::Key());
+        m_libraryPaths.append(libPath);
+        m_symbolHandles.insert(symbol_id, handle);
+
+        return handle;
     }
 
     /*!
-     * \brief Returns the symbol (QPainterPath) of a component corresponding to
-     * a key.
+     * \brief Returns the handle of a registered symbol, or -1 if the symbol
+     * is not registered.
+     *
+     * \param compName Component name, used as part of the key
+     * \param libName Library name, used as part of the key
+     *
+     * \sa registerComponent()
+     */
+    int LibraryManager::symbolHandle(const QString &compName, const QString &libName) const
+    {
+        return m_symbolHandles.value(compName + ":" + libName, -1);
+    }
+
+    /*!
+     * \brief Returns the symbol (SymbolGeometry) of a component corresponding
+     * to a key.
      *
      * Each component's key is saved in the form "componentName:libraryName" to
      * allow for different libraries to have components with the same name.
      *
      * \param compName Component name, used as part of the key
      * \param libName Library name, used as part of the key
-     * \return QPainterPath corresponding to the symbol
+     * \return SymbolGeometry corresponding to the symbol
      *
      * \sa registerComponent(), pixmapCache()
      */
-    QPainterPath LibraryManager::symbolCache(const QString &compName, const QString &libName)
+    const SymbolGeometry& LibraryManager::symbolCache(const QString &compName, const QString &libName) const
     {
-        QString symbol_id = compName + ":" + libName;
-        return m_dataHash[symbol_id];
+        return symbolCache(symbolHandle(compName, libName));
     }
 
     /*!
@@ -320,12 +346,73 @@ namespace Caneda
      */
     const QPixmap LibraryManager::pixmapCache(const QString &compName, const QString &libName)
     {
-        QString symbol_id = compName + ":" + libName;
+        return pixmapCache(symbolHandle(compName, libName));
+    }
+
+    /*!
+     * \brief Returns the symbol (SymbolGeometry) corresponding to a handle.
+     *
+     * \param handle Symbol handle, as returned by registerComponent()
+     * \return SymbolGeometry corresponding to the symbol, or an empty
+     * geometry if the handle is not valid
+     *
+     * \sa registerComponent(), pixmapCache()
+     */
+    const SymbolGeometry& LibraryManager::symbolCache(int handle) const
+    {
+        static const SymbolGeometry emptySymbol;
+
+        if(handle < 0 || handle >= m_symbols.size()) {
+            return emptySymbol;
+        }
+
+        return m_symbols.at(handle);
+    }
+
+    /*!
+     * \brief Returns the path of the library of the symbol corresponding to
+     * a handle.
+     *
+     * This allows the netlist generation to resolve the library of each
+     * component with an indexed access, instead of looking the library up
+     * by name.
+     *
+     * \param handle Symbol handle, as returned by registerComponent()
+     * \return Library path, or an empty string if the handle is not valid
+     *
+     * \sa registerComponent(), FormatSpice::generateNetlist()
+     */
+    QString LibraryManager::libraryPath(int handle) const
+    {
+        if(handle < 0 || handle >= m_libraryPaths.size()) {
+            return QString();
+        }
+
+        return m_libraryPaths.at(handle);
+    }
+
+    /*!
+     * \brief Returns the cached pixmap corresponding to a handle.
+     *
+     * The pixmap is kept in the global QPixmapCache, referenced by a
+     * QPixmapCache::Key instead of a string. If the pixmap was evicted from
+     * the cache, it is created again.
+     *
+     * \param handle Symbol handle, as returned by registerComponent()
+     * \return QPixmap corresponding to the symbol
+     *
+     * \sa registerComponent(), symbolCache()
+     */
+    const QPixmap LibraryManager::pixmapCache(int handle)
+    {
         QPixmap pix;
+        if(handle < 0 || handle >= m_symbols.size()) {
+            return pix;
+        }
 
-        if(!QPixmapCache::find(symbol_id, pix)) {
+        if(!QPixmapCache::find(m_pixmapKeys.at(handle), &pix)) {
 
-            QPainterPath data = m_dataHash[symbol_id];
+            const SymbolGeometry &data = m_symbols.at(handle);
             QRect rect =  data.boundingRect().toRect();
             rect.adjust(-1.0, -1.0, 1.0, 1.0); // Adjust rect to avoid clipping due to rounding (rectF -> rect)
             pix = QPixmap(rect.size());
@@ -340,9 +427,10 @@ namespace Caneda
 
             QPointF offset = -rect.topLeft(); // (0,0)-topLeft()
             painter.translate(offset);
-            painter.drawPath(data);
+            data.draw(&painter);
+            painter.end();
 
-            QPixmapCache::insert(symbol_id, pix);
+            m_pixmapKeys[handle] = QPixmapCache::insert(pix);
         }
 
         return pix;
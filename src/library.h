@@ -22,8 +22,11 @@
 #define LIBRARY_H
 
 #include "component.h"
+#include "symbolgeometry.h"
 
 #include <QHash>
+#include <QPixmapCache>
+#include <QVector>
 
 namespace Caneda
 {
@@ -77,9 +80,10 @@ namespace Caneda
      * library loading. To render a component, the symbol id must be given and
      * a pointer to the symbol drawing is returned (paths, rectangles, circles,
      * etc). The component to be rendered should be first registered with the
-     * instance of this class. A cache of components is created an data needed
-     * for painting components is created only once (independently of the
-     * number of components used by the user in the final schematic).
+     * instance of this class, which interns the symbol to an integer handle
+     * kept by the component data. A cache of components is created an data
+     * needed for painting components is created only once (independently of
+     * the number of components used by the user in the final schematic).
      *
      * This class is a singleton class and its only static instance (returned
      * by instance()) is to be used.
@@ -104,11 +108,17 @@ namespace Caneda
         const QList<QString> librariesList() const { return m_libraryHash.uniqueKeys(); }
 
         // Symbol caching related methods
-        void registerComponent(const QString &compName, const QString &libName, const QPainterPath& content);
+        int registerComponent(const QString &compName, const QString &libName,
+                              const QString &libPath, const SymbolGeometry& content);
+        int symbolHandle(const QString &compName, const QString &libName) const;
 
-        QPainterPath symbolCache(const QString &compName, const QString &libName);
+        const SymbolGeometry& symbolCache(const QString &compName, const QString &libName) const;
         const QPixmap pixmapCache(const QString &compName, const QString &libName);
 
+        const SymbolGeometry& symbolCache(int handle) const;
+        const QPixmap pixmapCache(int handle);
+        QString libraryPath(int handle) const;
+
         ComponentDataPtr componentData(QString name, QString library);
 
     private:
@@ -117,8 +127,14 @@ namespace Caneda
         //! Hash table to hold libraries.
         QHash<QString, Library*> m_libraryHash;
 
-        //! Symbol cache (hash table) to hold symbol's QPainterPaths.
-        QHash<QString, QPainterPath> m_dataHash;
+        //! Symbol cache holding symbol's geometry, indexed by handle.
+        QVector<SymbolGeometry> m_symbols;
+        //! Keys of the cached symbol's pixmaps, indexed by handle.
+        QVector<QPixmapCache::Key> m_pixmapKeys;
+        //! Path of the library of each symbol, indexed by handle.
+        QVector<QString> m_libraryPaths;
+        //! Symbol handles, indexed by "componentName:libraryName" keys.
+        QHash<QString, int> m_symbolHandles;
     };
 
 } // namespace Caneda
@@ -22,6 +22,7 @@
 
 #include "aboutdialog.h"
 #include "actionmanager.h"
+#include "autosaver.h"
 #include "documentviewmanager.h"
 #include "exportdialog.h"
 #include "filenewdialog.h"
@@ -40,6 +41,7 @@
 #include "settingsdialog.h"
 #include "shortcutsdialog.h"
 #include "statehandler.h"
+#include "sweepdialog.h"
 #include "tabs.h"
 
 #include <QtWidgets>
@@ -73,6 +75,8 @@ namespace Caneda
         setupFolderBrowserSidebar();
 
         loadSettings();  // Load window and docks geometry
+
+        AutoSaver::instance();  // Start the periodic documents backup
     }
 
     /*!
@@ -678,6 +682,35 @@ namespace Caneda
         }
     }
 
+    /*!
+     * \brief Opens the parameter sweep dialog for the current schematic.
+     *
+     * The dialog is not modal, allowing to keep working while the sweep
+     * is simulated.
+     *
+     * \sa SweepDialog
+     */
+    void MainWindow::sweep()
+    {
+        IDocument *document = DocumentViewManager::instance()->currentDocument();
+        SchematicDocument *schematic = qobject_cast<SchematicDocument*>(document);
+        if(!schematic) {
+            QMessageBox::information(this, tr("Parameter sweep"),
+                                     tr("Parameter sweeps can only be run on schematics."));
+            return;
+        }
+
+        if(schematic->fileName().isEmpty()) {
+            QMessageBox::warning(this, tr("Parameter sweep"),
+                                 tr("The schematic must be saved before running a sweep."));
+            return;
+        }
+
+        SweepDialog *dialog = new SweepDialog(schematic, this);
+        dialog->setAttribute(Qt::WA_DeleteOnClose);
+        dialog->show();
+    }
+
     //! \brief Opens the simulation corresponding to the current file.
     void MainWindow::openSimulation()
     {
@@ -843,6 +876,7 @@ namespace Caneda
         // Update all document views to reflect the current settings.
         if(result == QDialog::Accepted) {
             DocumentViewManager::instance()->updateSettingsChanges();
+            AutoSaver::instance()->updateSettingsChanges();
             repaint();
         }
 
@@ -1142,6 +1176,11 @@ namespace Caneda
         action->setWhatsThis(tr("Simulate\n\nSimulates the current circuit"));
         connect(action, SIGNAL(triggered()), SLOT(simulate()));
 
+        action = am->createAction("sweep", Caneda::icon("media-seek-forward"), tr("Parameter sweep..."));
+        action->setStatusTip(tr("Simulates the current circuit varying some of its properties"));
+        action->setWhatsThis(tr("Parameter Sweep\n\nSimulates the current circuit several times, sweeping properties or varying them randomly (Monte Carlo analysis)"));
+        connect(action, SIGNAL(triggered()), SLOT(sweep()));
+
         action = am->createAction("openSimulation", Caneda::icon("system-switch-user"), tr("View circuit simulation"));
         action->setStatusTip(tr("Changes to circuit simulation"));
         action->setWhatsThis(tr("View Circuit Simulation\n\n")+tr("Changes to circuit simulation"));
@@ -1474,6 +1513,7 @@ namespace Caneda
         menu->addSeparator();
 
         menu->addAction(am->actionForName("simulate"));
+        menu->addAction(am->actionForName("sweep"));
         menu->addAction(am->actionForName("openSimulation"));
 
         menu->addSeparator();
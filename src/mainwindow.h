@@ -115,6 +115,7 @@ namespace Caneda
         void openSchematic();
         void openSymbol();
         void simulate();
+        void sweep();
         void openSimulation();
         void openLog();
         void openNetlist();
@@ -0,0 +1,297 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#include "netlistcache.h"
+
+#include "port.h"
+#include "portsymbol.h"
+
+namespace Caneda
+{
+    //! \brief Constructor.
+    NetlistCache::NetlistCache() :
+        m_nextNetNumber(1),
+        m_topologyValid(false)
+    {
+    }
+
+    //! \brief Invalidates the fragment of \a component, after it changed.
+    void NetlistCache::invalidateComponent(Component *component)
+    {
+        QHash<Component*, NetlistFragment>::iterator it = m_fragments.find(component);
+        if(it != m_fragments.end()) {
+            it->valid = false;
+        }
+    }
+
+    /*!
+     * \brief Marks the net of \a port to be walked again, after a
+     * connectivity change or after the port was added to the scene.
+     *
+     * \sa updateNets()
+     */
+    void NetlistCache::invalidatePort(Port *port)
+    {
+        if(m_topologyValid) {
+            m_changedPorts.insert(port);
+        }
+    }
+
+    /*!
+     * \brief Forgets \a port, after it was removed from the scene or
+     * deleted.
+     *
+     * The net it belonged to is walked again on the next update, as it may
+     * have been split.
+     *
+     * \sa updateNets()
+     */
+    void NetlistCache::removePort(Port *port)
+    {
+        if(!m_topologyValid) {
+            return;
+        }
+
+        m_changedPorts.remove(port);
+        m_nets.remove(port);
+
+        QHash<Port*, int>::iterator it = m_netNumbers.find(port);
+        if(it != m_netNumbers.end()) {
+            m_netPorts[it.value()].removeOne(port);
+            m_changedNets.insert(it.value());
+            m_netNumbers.erase(it);
+        }
+    }
+
+    //! \brief Invalidates all the fragments and the nets.
+    void NetlistCache::invalidateAll()
+    {
+        m_fragments.clear();
+        m_nets.clear();
+        m_netNumbers.clear();
+        m_netPorts.clear();
+        m_changedPorts.clear();
+        m_changedNets.clear();
+        m_nextNetNumber = 1;
+        m_topologyValid = false;
+    }
+
+    /*!
+     * \brief Numbers all the nets of the scene from scratch.
+     *
+     * \param nets Ports of each net (as found by Port::getEquipotentialPorts()),
+     * numbered in this order starting from 1.
+     *
+     * \sa updateNets()
+     */
+    void NetlistCache::setNets(const QList<QList<Port*> > &nets)
+    {
+        m_nets.clear();
+        m_netNumbers.clear();
+        m_netPorts.clear();
+        m_changedPorts.clear();
+        m_changedNets.clear();
+        m_nextNetNumber = 1;
+
+        foreach(const QList<Port*> &ports, nets) {
+            assignNet(ports, m_nextNetNumber++);
+        }
+
+        m_topologyValid = true;
+    }
+
+    /*!
+     * \brief Numbers again the nets of the ports changed since the last
+     * update.
+     *
+     * The nets of the changed ports are released, and walked again from
+     * every port they held. Each resulting net keeps the lowest number of
+     * the nets its ports had before (unless an earlier net of this update
+     * already took it), so unchanged nets and the nets that only grew keep
+     * their names. Nets reached by the walk but not released (when a
+     * connection joins them to a changed net) are merged into the new one.
+     *
+     * Only the ports of the walked nets are visited, so the cost of the
+     * update depends on the size of the nets touched by the changes, not
+     * on the size of the schematic.
+     *
+     * \sa setNets(), Port::getEquipotentialPorts()
+     */
+    void NetlistCache::updateNets()
+    {
+        if(m_changedPorts.isEmpty() && m_changedNets.isEmpty()) {
+            return;
+        }
+
+        QList<Port*> seeds = m_changedPorts.toList();
+        foreach(Port *port, m_changedPorts) {
+            QHash<Port*, int>::const_iterator it = m_netNumbers.constFind(port);
+            if(it != m_netNumbers.constEnd()) {
+                m_changedNets.insert(it.value());
+            }
+        }
+
+        // Release the changed nets, remembering their numbers
+        QHash<Port*, int> previousNumbers;
+        foreach(int number, m_changedNets) {
+            foreach(Port *port, m_netPorts.take(number)) {
+                previousNumbers.insert(port, number);
+                m_netNumbers.remove(port);
+                m_nets.remove(port);
+                seeds << port;
+            }
+        }
+
+        m_changedPorts.clear();
+        m_changedNets.clear();
+
+        // Walk the nets again from the ports they held
+        QSet<Port*> walked;
+        QSet<int> usedNumbers;
+        foreach(Port *seed, seeds) {
+            if(walked.contains(seed) || !seed->scene()) {
+                continue;
+            }
+
+            QList<Port*> ports;
+            seed->getEquipotentialPorts(ports);
+
+            int number = 0;
+            foreach(Port *port, ports) {
+                walked.insert(port);
+
+                int previous = previousNumbers.value(port);
+                QHash<Port*, int>::const_iterator it = m_netNumbers.constFind(port);
+                if(it != m_netNumbers.constEnd()) {
+                    // A net joined to this one, all its ports are walked here
+                    previous = it.value();
+                    m_netPorts.remove(previous);
+                }
+
+                if(previous && !usedNumbers.contains(previous) && (!number || previous < number)) {
+                    number = previous;
+                }
+            }
+
+            if(!number) {
+                number = m_nextNetNumber++;
+            }
+
+            usedNumbers.insert(number);
+            assignNet(ports, number);
+        }
+    }
+
+    /*!
+     * \brief Returns the name of the net holding \a ports.
+     *
+     * Nets are named after the labels of their port symbols, the ground
+     * symbols being named "0" to be compatible with the spice netlist
+     * format. When a net holds several port symbols, the lowest label (in
+     * string order) is used, so the name does not depend on the order of
+     * the items in the scene. Nets without port symbols are named after
+     * their \a number.
+     *
+     * \sa PortSymbol
+     */
+    QString NetlistCache::netName(const QList<Port*> &ports, int number)
+    {
+        QString name;
+        bool named = false;
+
+        foreach(Port *port, ports) {
+            if(!port->scene() || port->parentItem()->type() != GraphicsItem::PortSymbolType) {
+                continue;
+            }
+
+            QString label = static_cast<PortSymbol*>(port->parentItem())->label();
+            if(label.toLower() == "ground" || label.toLower() == "gnd") {
+                label = QString::number(0);
+            }
+
+            if(!named || label < name) {
+                name = label;
+                named = true;
+            }
+        }
+
+        return named ? name : QString::number(number);
+    }
+
+    /*!
+     * \brief Stores the net \a number, holding \a ports.
+     *
+     * Ports no longer in a scene (reached through the connections of a
+     * removed item) are not stored, as they may be deleted at any time.
+     */
+    void NetlistCache::assignNet(const QList<Port*> &ports, int number)
+    {
+        QList<Port*> &netPorts = m_netPorts[number];
+        netPorts.clear();
+
+        const QString name = netName(ports, number);
+        foreach(Port *port, ports) {
+            if(port->scene()) {
+                netPorts << port;
+                m_netNumbers.insert(port, number);
+                m_nets.insert(port, name);
+            }
+        }
+
+        if(netPorts.isEmpty()) {
+            m_netPorts.remove(number);
+        }
+    }
+
+    /*!
+     * \brief Returns the fragment of \a component.
+     *
+     * An invalid fragment is created if the component had none.
+     */
+    NetlistFragment* NetlistCache::fragment(Component *component)
+    {
+        return &m_fragments[component];
+    }
+
+    /*!
+     * \brief Removes the fragments of the components not in \a components.
+     *
+     * This avoids keeping the fragments of deleted components, whose
+     * address may be used later by new ones.
+     */
+    void NetlistCache::prune(const QList<Component*> &components)
+    {
+        if(m_fragments.size() <= components.size()) {
+            return;
+        }
+
+        QSet<Component*> current = components.toSet();
+        QHash<Component*, NetlistFragment>::iterator it = m_fragments.begin();
+        while(it != m_fragments.end()) {
+            if(current.contains(it.key())) {
+                ++it;
+            }
+            else {
+                it = m_fragments.erase(it);
+            }
+        }
+    }
+
+} // namespace Caneda
@@ -0,0 +1,139 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#ifndef NETLIST_CACHE_H
+#define NETLIST_CACHE_H
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+namespace Caneda
+{
+    // Forward declarations
+    class Component;
+    class Port;
+
+    /*!
+     * \brief Netlist text generated from one component.
+     *
+     * Besides the netlist lines of the component, the models, subcircuits,
+     * directives and schematics it requires are kept, to be merged with
+     * those of the rest of the components.
+     *
+     * \sa NetlistCache
+     */
+    struct NetlistFragment
+    {
+        NetlistFragment() : valid(false) {}
+
+        QString text;             //! \brief Netlist lines of the component
+        QStringList models;       //! \brief Device models required
+        QStringList subcircuits;  //! \brief Subcircuits required
+        QStringList directives;   //! \brief Spice directives required
+        QStringList schematics;   //! \brief Schematics of recursive netlists
+
+        QStringList nets;         //! \brief Net of each port when generated
+        QString libraryPath;      //! \brief Library path when generated
+        bool valid;               //! \brief False once the component changed
+    };
+
+    /*!
+     * \brief Cache of the spice netlist of a schematic, to regenerate it
+     * incrementally.
+     *
+     * Parsing the models of the components is the most expensive part of
+     * the netlist generation (see FormatSpice::generateNetlist()). This
+     * class keeps the netlist fragment generated from each component, and
+     * the net of each port, so that after an edit only the fragments of
+     * the changed components are generated again.
+     *
+     * Each GraphicsScene has one cache, invalidated through the following
+     * changes of the scene:
+     * \li Property changes invalidate the fragment of their component
+     * (see PropertyGroup).
+     * \li Connections and disconnections of ports (see Port), items added
+     * to or removed from the scene (see GraphicsItem::itemChange()) and
+     * port symbol renames (see PortSymbol::setLabel()) mark the involved
+     * ports as changed. Only the nets of the changed ports are walked and
+     * named again (see updateNets()), keeping their previous numbers where
+     * possible, so the cost of an edit depends on the size of the nets it
+     * touches and not on the size of the schematic. Then only the fragments
+     * of the components whose nets changed are generated again.
+     *
+     * The nets are numbered from scratch the first time (see setNets()),
+     * and after invalidateAll().
+     *
+     * \sa FormatSpice, NetlistFragment
+     */
+    class NetlistCache
+    {
+    public:
+        NetlistCache();
+
+        void invalidateComponent(Component *component);
+        void invalidatePort(Port *port);
+        void removePort(Port *port);
+        void invalidateAll();
+
+        //! \brief Returns true once the nets were numbered
+        bool isTopologyValid() const { return m_topologyValid; }
+        //! \brief Returns the net of each port
+        const QHash<Port*, QString>& nets() const { return m_nets; }
+        void setNets(const QList<QList<Port*> > &nets);
+        void updateNets();
+
+        //! \brief Returns the path of the schematic when the fragments were generated
+        QString filePath() const { return m_filePath; }
+        //! \brief Sets the path of the schematic used in the fragments
+        void setFilePath(const QString &filePath) { m_filePath = filePath; }
+
+        NetlistFragment* fragment(Component *component);
+        void prune(const QList<Component*> &components);
+
+        static QString netName(const QList<Port*> &ports, int number);
+
+    private:
+        void assignNet(const QList<Port*> &ports, int number);
+
+        QHash<Component*, NetlistFragment> m_fragments;
+
+        //! \brief Name of the net of each port
+        QHash<Port*, QString> m_nets;
+        //! \brief Number of the net of each port
+        QHash<Port*, int> m_netNumbers;
+        //! \brief Ports of each net, by number
+        QHash<int, QList<Port*> > m_netPorts;
+        //! \brief Ports whose net may have changed since the last update
+        QSet<Port*> m_changedPorts;
+        //! \brief Nets which lost a port since the last update
+        QSet<int> m_changedNets;
+        //! \brief Number of the next new net
+        int m_nextNetNumber;
+
+        QString m_filePath;
+        bool m_topologyValid;
+    };
+
+} // namespace Caneda
+
+#endif //NETLIST_CACHE_H
@@ -0,0 +1,603 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#include "ngspiceshared.h"
+
+#include "chartitem.h"
+#include "chartscene.h"
+#include "fileformats.h"
+#include "settings.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QtConcurrent>
+
+namespace Caneda
+{
+    /*************************************************************************
+     *                  Ngspice shared library interface                     *
+     *************************************************************************/
+    // The following declarations mirror the ones in the sharedspice.h header
+    // of ngspice. They are repeated here to avoid depending on the ngspice
+    // headers at build time, as the library is loaded at runtime.
+
+    //! \brief Value of a vector in a new point (vecvalues)
+    struct NgVectorValue
+    {
+        char *name;
+        double real;
+        double imaginary;
+        bool isScale;
+        bool isComplex;
+    };
+
+    //! \brief Values of all vectors in a new point (vecvaluesall)
+    struct NgPointValues
+    {
+        int count;
+        int index;
+        NgVectorValue **values;
+    };
+
+    //! \brief Description of a vector (vecinfo)
+    struct NgVectorInfo
+    {
+        int number;
+        char *name;
+        bool isReal;
+        void *vector;
+        void *scale;
+    };
+
+    //! \brief Description of a plot (vecinfoall)
+    struct NgPlotInfo
+    {
+        char *name;
+        char *title;
+        char *date;
+        char *type;
+        int count;
+        NgVectorInfo **vectors;
+    };
+
+    typedef int (*NgSendChar)(char *, int, void *);
+    typedef int (*NgSendStat)(char *, int, void *);
+    typedef int (*NgControlledExit)(int, bool, bool, int, void *);
+    typedef int (*NgSendData)(NgPointValues *, int, int, void *);
+    typedef int (*NgSendInitData)(NgPlotInfo *, int, void *);
+    typedef int (*NgBGThreadRunning)(bool, int, void *);
+
+    typedef int (*NgSpiceInit)(NgSendChar, NgSendStat, NgControlledExit,
+                               NgSendData, NgSendInitData, NgBGThreadRunning, void *);
+    typedef int (*NgSpiceCirc)(char **);
+    typedef int (*NgSpiceCommand)(char *);
+
+    //! \brief State of the running simulation, updated by the callbacks
+    struct NgspiceRun
+    {
+        SimulationResults *results;
+        QVector<int> order;  //! \brief Vector index of each results column
+        bool exited;         //! \brief The simulator requested to be unloaded
+    };
+
+    //! \brief Running simulation. Ngspice runs only one simulation at a time.
+    static NgspiceRun *currentRun = 0;
+
+    /*!
+     * \brief Returns the name of an ngspice vector as written in raw files.
+     *
+     * Node voltages are named after the node (out is v(out)) and branch
+     * currents after the branch (v1#branch is i(v1)).
+     */
+    static QString rawName(const QString &vector, QString *type)
+    {
+        if(vector.endsWith("#branch", Qt::CaseInsensitive)) {
+            *type = "current";
+            return "i(" + vector.left(vector.size() - 7) + ")";
+        }
+
+        if(vector.startsWith('@') || vector.contains('(')) {
+            *type = vector.startsWith("i(", Qt::CaseInsensitive) ? "current" : "voltage";
+            return vector;
+        }
+
+        *type = "voltage";
+        return "v(" + vector + ")";
+    }
+
+    /*!
+     * \brief Returns true if \a line is an error reported by the simulator.
+     *
+     * ngspice reports failures as "Error: ...", "Error on line ..." or
+     * "Fatal error: ...". Other messages may mention errors too (warnings,
+     * tolerances, notes) without the simulation failing, so only those
+     * prefixes are considered.
+     */
+    static bool isSimulatorError(const QString &line)
+    {
+        QString message = line.trimmed();
+        return message.startsWith("Error:", Qt::CaseInsensitive) ||
+                message.startsWith("Error on line", Qt::CaseInsensitive) ||
+                message.startsWith("Fatal error", Qt::CaseInsensitive) ||
+                message.startsWith("Fatal:", Qt::CaseInsensitive);
+    }
+
+    //! \brief Receives the messages of the simulator.
+    static int ngspiceSendChar(char *text, int, void *)
+    {
+        if(!currentRun) {
+            return 0;
+        }
+
+        // Messages are prefixed by the stream they were written to
+        QString line = QString::fromLocal8Bit(text);
+        if(line.startsWith("stderr ")) {
+            line = line.mid(7);
+            if(isSimulatorError(line) &&
+                    currentRun->results->errorMessage.isEmpty()) {
+                currentRun->results->errorMessage = line;
+            }
+        }
+        else if(line.startsWith("stdout ")) {
+            line = line.mid(7);
+        }
+
+        currentRun->results->output << line;
+        return 0;
+    }
+
+    static int ngspiceSendStat(char *, int, void *)
+    {
+        return 0;
+    }
+
+    //! \brief Called when the simulator would exit the process.
+    static int ngspiceControlledExit(int status, bool unload, bool, int, void *)
+    {
+        if(currentRun) {
+            if(currentRun->results->errorMessage.isEmpty()) {
+                currentRun->results->errorMessage =
+                        QObject::tr("The simulator exited with status %1").arg(status);
+            }
+            currentRun->exited = unload;
+        }
+
+        return 0;
+    }
+
+    /*!
+     * \brief Receives the vectors of a new plot.
+     *
+     * The simulator sends a new plot for each analysis, only the results of
+     * the last one are kept.
+     */
+    static int ngspiceSendInitData(NgPlotInfo *plot, int, void *)
+    {
+        if(!currentRun) {
+            return 0;
+        }
+
+        SimulationResults *results = currentRun->results;
+        results->names.clear();
+        results->types.clear();
+        results->real.clear();
+        results->imaginary.clear();
+        results->complex = false;
+        currentRun->order.clear();
+
+        for(int i = 0; i < plot->count; ++i) {
+            results->complex = results->complex || !plot->vectors[i]->isReal;
+        }
+
+        return 0;
+    }
+
+    /*!
+     * \brief Receives the values of a new point.
+     *
+     * The columns are set up on the first point, where the scale vector is
+     * known, and each value is appended to its column.
+     */
+    static int ngspiceSendData(NgPointValues *point, int, int, void *)
+    {
+        if(!currentRun) {
+            return 0;
+        }
+
+        SimulationResults *results = currentRun->results;
+        QVector<int> &order = currentRun->order;
+
+        if(order.isEmpty()) {
+            // The scale (time, frequency, etc) is the first column
+            int scale = 0;
+            for(int i = 0; i < point->count; ++i) {
+                if(point->values[i]->isScale) {
+                    scale = i;
+                }
+            }
+
+            order << scale;
+            for(int i = 0; i < point->count; ++i) {
+                if(i != scale) {
+                    order << i;
+                }
+            }
+
+            foreach(int i, order) {
+                const QString vector = QString::fromLocal8Bit(point->values[i]->name);
+                QString type = vector.toLower();
+                results->names << (i == scale ? vector : rawName(vector, &type));
+                results->types << type;
+
+                results->real << QSharedPointer<ChartSampleBuffer>(new ChartSampleBuffer);
+                if(results->complex) {
+                    results->imaginary << QSharedPointer<ChartSampleBuffer>(new ChartSampleBuffer);
+                }
+            }
+        }
+
+        for(int c = 0; c < order.size(); ++c) {
+            const NgVectorValue *value = point->values[order.at(c)];
+            results->real[c]->append(value->real);
+            if(results->complex) {
+                results->imaginary[c]->append(value->imaginary);
+            }
+        }
+
+        return 0;
+    }
+
+    static int ngspiceBGThreadRunning(bool, int, void *)
+    {
+        return 0;
+    }
+
+    /*************************************************************************
+     *                            NgspiceShared                              *
+     *************************************************************************/
+    //! \brief Constructor.
+    NgspiceShared::NgspiceShared(QObject *parent) :
+        QObject(parent),
+        m_initialized(false),
+        m_circ(0),
+        m_command(0)
+    {
+    }
+
+    //! \copydoc MainWindow::instance()
+    NgspiceShared* NgspiceShared::instance()
+    {
+        static NgspiceShared *instance = 0;
+        if (!instance) {
+            instance = new NgspiceShared();
+        }
+        return instance;
+    }
+
+    /*!
+     * \brief Loads and initializes the ngspice shared library.
+     *
+     * The library file is taken from the sim/ngspiceLibrary setting, which
+     * can be a full path or a library name to be found in the system paths.
+     *
+     * \param errorMessage If not null, set to a description of the error.
+     * \return True on success, false otherwise.
+     */
+    bool NgspiceShared::load(QString *errorMessage)
+    {
+        QMutexLocker locker(&m_mutex);
+
+        if(m_initialized) {
+            return true;
+        }
+
+        Settings *settings = Settings::instance();
+        m_library.setFileName(settings->currentValue("sim/ngspiceLibrary").toString());
+
+        if(!m_library.load()) {
+            if(errorMessage) {
+                *errorMessage = tr("Cannot load the ngspice shared library: %1").arg(m_library.errorString());
+            }
+            return false;
+        }
+
+        NgSpiceInit init = reinterpret_cast<NgSpiceInit>(m_library.resolve("ngSpice_Init"));
+        m_circ = m_library.resolve("ngSpice_Circ");
+        m_command = m_library.resolve("ngSpice_Command");
+
+        if(!init || !m_circ || !m_command) {
+            m_library.unload();
+            if(errorMessage) {
+                *errorMessage = tr("%1 is not an ngspice shared library").arg(m_library.fileName());
+            }
+            return false;
+        }
+
+        init(ngspiceSendChar, ngspiceSendStat, ngspiceControlledExit,
+             ngspiceSendData, ngspiceSendInitData, ngspiceBGThreadRunning, 0);
+
+        m_initialized = true;
+        return true;
+    }
+
+    /*!
+     * \brief Runs a simulation in a background thread.
+     *
+     * The library must be loaded with load() first. If a simulation is
+     * already running, this one starts once the other finishes.
+     *
+     * \param netlist Spice netlist to simulate.
+     * \return Future with the results of the simulation.
+     */
+    QFuture<SimulationResults> NgspiceShared::run(const QString &netlist)
+    {
+        return QtConcurrent::run(this, &NgspiceShared::simulate, netlist);
+    }
+
+    /*!
+     * \brief Adds the waveforms of a simulation to a scene.
+     *
+     * Real waveforms use the sample buffers filled by the simulator
+     * directly, without copying them. Complex waveforms are added as
+     * FormatRawSimulation does.
+     */
+    void NgspiceShared::addCurves(const SimulationResults &results, ChartScene *scene)
+    {
+        if(results.names.size() < 2) {
+            return;
+        }
+
+        if(results.complex) {
+            QList<QVector<double> > dataReal;
+            QList<QVector<double> > dataImaginary;
+            for(int i = 0; i < results.names.size(); ++i) {
+                dataReal << results.real.at(i)->toVector();
+                dataImaginary << results.imaginary.at(i)->toVector();
+            }
+
+            FormatRawSimulation::addComplexCurves(scene, results.names, dataReal, dataImaginary);
+        }
+        else {
+            // Avoid the first var, as it is the time base for the rest of
+            // the curves.
+            for(int i = 1; i < results.names.size(); ++i) {
+                StreamingSeriesData *data = new StreamingSeriesData(results.real.first(), results.real.at(i));
+                data->update();
+
+                ChartSeries *curve = new ChartSeries(results.names.at(i));
+                curve->setType(results.types.at(i));
+                curve->setData(data);
+                scene->addItem(curve);
+            }
+        }
+
+        ChartSeries::updateIndexes(scene->items());
+    }
+
+    /*!
+     * \brief Saves the results of a simulation as a binary raw file.
+     *
+     * The file is written in the same format as ngspice does, so it can be
+     * opened later as any other simulation (see FormatRawSimulation).
+     *
+     * \return True on success, false otherwise.
+     */
+    bool NgspiceShared::saveRawFile(const SimulationResults &results, const QString &fileName)
+    {
+        QFile file(fileName);
+        if(!file.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+
+        const int points = results.real.isEmpty() ? 0 : results.real.first()->size();
+
+        QTextStream header(&file);
+        header << "Title: Caneda\n";
+        header << "Date: " << QDateTime::currentDateTime().toString() << "\n";
+        header << "Plotname: " << (results.complex ? "AC Analysis" : "Transient Analysis") << "\n";
+        header << "Flags: " << (results.complex ? "complex" : "real") << "\n";
+        header << "No. Variables: " << results.names.size() << "\n";
+        header << "No. Points: " << points << "\n";
+        header << "Variables:\n";
+        for(int i = 0; i < results.names.size(); ++i) {
+            header << "\t" << i << "\t" << results.names.at(i) << "\t" << results.types.at(i) << "\n";
+        }
+        header << "Binary:\n";
+        header.flush();
+
+        QDataStream data(&file);
+        data.setByteOrder(QDataStream::LittleEndian);  // Use little endian format.
+        data.setFloatingPointPrecision(QDataStream::DoublePrecision);  // Use 64 bit precision.
+
+        for(int p = 0; p < points; ++p) {
+            for(int i = 0; i < results.names.size(); ++i) {
+                data << results.real.at(i)->at(p);
+                if(results.complex) {
+                    data << results.imaginary.at(i)->at(p);
+                }
+            }
+        }
+
+        return data.status() == QDataStream::Ok;
+    }
+
+    /*!
+     * \brief Reads the first plot of a binary raw file.
+     *
+     * This is the counterpart of saveRawFile(), also used to read the raw
+     * files written by ngspice processes in batch mode when the results are
+     * needed as sample buffers and not as a document (see SweepRunner).
+     * As it does not access any shared state, it may be called from any
+     * thread.
+     *
+     * \return True on success, false otherwise (ascii or malformed files).
+     */
+    bool NgspiceShared::readRawFile(const QString &fileName, SimulationResults *results)
+    {
+        QFile file(fileName);
+        if(!file.open(QIODevice::ReadOnly)) {
+            results->errorMessage = tr("Could not open the file %1").arg(fileName);
+            return false;
+        }
+
+        int points = 0;
+        forever {
+            const QByteArray rawLine = file.readLine();
+            if(rawLine.isEmpty()) {
+                results->errorMessage = tr("The file %1 has no binary data").arg(fileName);
+                return false;
+            }
+
+            const QString line = QString::fromUtf8(rawLine).remove('\n');
+            const QString keyword = line.section(':', 0, 0).toLower();
+
+            if(line.startsWith('\t')) {
+                // Variable definition: number, name and type
+                QStringList tok = line.split("\t", QString::SkipEmptyParts);
+                if(tok.size() >= 3) {
+                    results->names << tok.at(1);
+                    results->types << tok.at(2).trimmed();
+                }
+            }
+            else if(keyword == "flags") {
+                results->complex = line.section(':', 1).toLower().contains("complex");
+            }
+            else if(keyword == "no. points") {
+                points = line.section(':', 1).trimmed().toInt();
+            }
+            else if(keyword == "values") {
+                results->errorMessage = tr("The file %1 is not a binary raw file").arg(fileName);
+                return false;
+            }
+            else if(keyword == "binary") {
+                break;
+            }
+        }
+
+        for(int i = 0; i < results->names.size(); ++i) {
+            results->real.append(QSharedPointer<ChartSampleBuffer>(new ChartSampleBuffer));
+            if(results->complex) {
+                results->imaginary.append(QSharedPointer<ChartSampleBuffer>(new ChartSampleBuffer));
+            }
+        }
+
+        QDataStream data(&file);
+        data.setByteOrder(QDataStream::LittleEndian);  // Use little endian format.
+        data.setFloatingPointPrecision(QDataStream::DoublePrecision);  // Use 64 bit precision.
+
+        // Truncated files (for example, of an interrupted simulation) keep
+        // the complete points read so far.
+        const int columns = results->complex ? 2 : 1;
+        QVector<double> point(results->names.size() * columns);
+        for(int p = 0; p < points; ++p) {
+            for(int j = 0; j < point.size(); ++j) {
+                data >> point[j];
+            }
+            if(data.status() != QDataStream::Ok) {
+                break;
+            }
+
+            for(int i = 0; i < results->names.size(); ++i) {
+                results->real[i]->append(point.at(i * columns));
+                if(results->complex) {
+                    results->imaginary[i]->append(point.at(i * columns + 1));
+                }
+            }
+        }
+
+        return !results->names.isEmpty();
+    }
+
+    /*!
+     * \brief Runs a simulation (in a background thread).
+     *
+     * The netlist is passed to the simulator as an array of lines, and the
+     * results are received through the callbacks above.
+     */
+    SimulationResults NgspiceShared::simulate(const QString &netlist)
+    {
+        QMutexLocker locker(&m_mutex);
+
+        SimulationResults results;
+        if(!m_initialized) {
+            results.errorMessage = tr("The ngspice shared library is not loaded");
+            return results;
+        }
+
+        NgspiceRun run;
+        run.results = &results;
+        run.exited = false;
+        currentRun = &run;
+
+        // The circuit is an array of lines ending with .end, terminated by a
+        // null pointer.
+        QList<QByteArray> lines;
+        foreach(const QString &line, netlist.split('\n')) {
+            lines << line.toLocal8Bit();
+        }
+        lines << QByteArray(".end");
+
+        QVector<char*> circuit;
+        for(int i = 0; i < lines.size(); ++i) {
+            circuit << lines[i].data();
+        }
+        circuit << 0;
+
+        NgSpiceCirc circ = reinterpret_cast<NgSpiceCirc>(m_circ);
+        if(circ(circuit.data()) != 0 || !command("run")) {
+            if(results.errorMessage.isEmpty()) {
+                results.errorMessage = tr("The simulator could not run the netlist");
+            }
+        }
+
+        // Free the circuit and the vectors kept by the simulator
+        command("remcirc");
+        command("destroy all");
+
+        currentRun = 0;
+
+        if(run.exited) {
+            m_library.unload();
+            m_initialized = false;
+        }
+
+        if(results.errorMessage.isEmpty() && results.names.size() < 2) {
+            results.errorMessage = tr("The simulation produced no results");
+        }
+
+        return results;
+    }
+
+    //! \brief Sends a command to the simulator. Returns true on success.
+    bool NgspiceShared::command(const char *text)
+    {
+        if(!m_initialized) {
+            return false;
+        }
+
+        QByteArray buffer(text);
+        NgSpiceCommand ngspiceCommand = reinterpret_cast<NgSpiceCommand>(m_command);
+        return ngspiceCommand(buffer.data()) == 0;
+    }
+
+} // namespace Caneda
@@ -0,0 +1,114 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#ifndef NGSPICE_SHARED_H
+#define NGSPICE_SHARED_H
+
+#include <QFuture>
+#include <QLibrary>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QSharedPointer>
+#include <QStringList>
+
+namespace Caneda
+{
+    // Forward declarations
+    class ChartSampleBuffer;
+    class ChartScene;
+
+    /*!
+     * \brief Results of a simulation run by NgspiceShared.
+     *
+     * The samples of each variable are stored in columns as they are
+     * received from the simulator. The first variable is the scale (time,
+     * frequency, etc) of the rest of the variables.
+     */
+    struct SimulationResults
+    {
+        SimulationResults() : complex(false) {}
+
+        QStringList names;  //! \brief Name of each variable, as in raw files (v(out), i(v1), etc)
+        QStringList types;  //! \brief Type of each variable (time, voltage, current, etc)
+        bool complex;       //! \brief True for complex data (ac analysis)
+
+        QList<QSharedPointer<ChartSampleBuffer> > real;       //! \brief Real part of each variable
+        QList<QSharedPointer<ChartSampleBuffer> > imaginary;  //! \brief Imaginary part of each variable
+
+        QStringList output;    //! \brief Messages of the simulator
+        QString errorMessage;  //! \brief Description of the error, empty on success
+    };
+
+    /*!
+     * \brief This class runs simulations with the ngspice shared library.
+     *
+     * Instead of writing the netlist to a file, starting an ngspice process
+     * and parsing the raw file written by it, the netlist is passed to the
+     * library as lines in memory, and the results are received through
+     * callbacks straight into the sample buffers used by the waveforms.
+     * This removes the process startup and file round-trips, which are
+     * most of the latency of short simulations.
+     *
+     * The library is loaded at runtime (see load()), so it is an optional
+     * dependency. As ngspice keeps its state in global variables, this
+     * class is a singleton and only one simulation runs at a time, in a
+     * background thread.
+     *
+     * This class is a singleton class and its only static instance (returned
+     * by instance()) is to be used.
+     *
+     * \sa SchematicDocument::simulate(), SimulationResults
+     */
+    class NgspiceShared : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        static NgspiceShared* instance();
+
+        bool load(QString *errorMessage = 0);
+        //! \brief Returns true if the shared library is loaded and initialized
+        bool isLoaded() const { return m_initialized; }
+
+        QFuture<SimulationResults> run(const QString &netlist);
+
+        static void addCurves(const SimulationResults &results, ChartScene *scene);
+        static bool saveRawFile(const SimulationResults &results, const QString &fileName);
+        static bool readRawFile(const QString &fileName, SimulationResults *results);
+
+    private:
+        explicit NgspiceShared(QObject *parent = 0);
+
+        SimulationResults simulate(const QString &netlist);
+        bool command(const char *text);
+
+        QLibrary m_library;
+        bool m_initialized;
+
+        QFunctionPointer m_circ;     //! \brief ngSpice_Circ() function
+        QFunctionPointer m_command;  //! \brief ngSpice_Command() function
+
+        QMutex m_mutex;  //! \brief Serializes the simulations
+    };
+
+} // namespace Caneda
+
+#endif //NGSPICE_SHARED_H
@@ -23,6 +23,7 @@
 #include "global.h"
 #include "graphictextdialog.h"
 #include "settings.h"
+#include "statictextcache.h"
 #include "xmlutilities.h"
 
 #include <QPainter>
@@ -38,7 +39,8 @@ namespace Caneda
      * \param parent Parent of the GraphicText item.
      */
     GraphicText::GraphicText(const QString &text, QGraphicsItem *parent) :
-        Painting(parent)
+        Painting(parent),
+        m_plainText(false)
     {
         m_textItem = new QGraphicsTextItem(this);
         m_textItem->setAcceptedMouseButtons(0);
@@ -56,12 +58,18 @@ namespace Caneda
      * The text will be displayed as plain text. Newline characters ('\n') as well
      * as characters of type QChar::LineSeparator will cause item to break the
      * text into multiple lines.
+     *
+     * Plain text is not painted by the inner text item, but through the
+     * StaticTextCache, to avoid laying out the text again on every paint.
      */
     void GraphicText::setPlainText(const QString &text)
     {
         prepareGeometryChange();
         QString unicodeText = Caneda::latexToUnicode(text);
         m_textItem->setPlainText(unicodeText);
+        m_textItem->hide();
+        m_plainText = true;
+        m_text = m_textItem->toPlainText();
         setPaintingRect(m_textItem->boundingRect());
     }
 
@@ -75,6 +83,9 @@ namespace Caneda
         prepareGeometryChange();
         QString unicodeText = Caneda::latexToUnicode(text);
         m_textItem->setHtml(unicodeText);
+        m_textItem->show();
+        m_plainText = false;
+        m_text.clear();
         setPaintingRect(m_textItem->boundingRect());
     }
 
@@ -88,9 +99,25 @@ namespace Caneda
         }
     }
 
-    //! \brief Draw's hightlight rect if selected.
+    //! \brief Draw's plain text and hightlight rect if selected.
     void GraphicText::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *)
     {
+        if(m_plainText) {
+            // Save pen
+            const QPen savePen = painter->pen();
+
+            // Draw the text where the inner text item would draw it
+            qreal margin = m_textItem->document()->documentMargin();
+            painter->setPen(m_textItem->defaultTextColor());
+            StaticTextCache::instance()->drawText(painter,
+                                                  m_textItem->pos() + QPointF(margin, margin),
+                                                  m_text,
+                                                  m_textItem->font());
+
+            // Restore pen
+            painter->setPen(savePen);
+        }
+
         if(option->state & QStyle::State_Selected) {
             // Save pen
             const QPen savePen = painter->pen();
@@ -56,6 +56,10 @@ namespace Caneda
 
     private:
         QGraphicsTextItem *m_textItem;
+        //! True if the text is plain text, drawn through the StaticTextCache.
+        bool m_plainText;
+        //! Plain text drawn on paint, kept to avoid rebuilding it each time.
+        QString m_text;
     };
 
 } // namespace Caneda
@@ -20,12 +20,13 @@
 
 #include "port.h"
 
+#include "graphicsscene.h"
+#include "rulechecker.h"
 #include "settings.h"
 #include "wire.h"
 
-#include <QGraphicsItem>
 #include <QPainter>
-#include <QStyleOptionGraphicsItem>
+#include <QSet>
 
 namespace Caneda
 {
@@ -33,32 +34,46 @@ namespace Caneda
      * \brief Constructs a Port item with a GraphicsItem as \a parent and
      * port's name \a portName.
      */
-    Port::Port(GraphicsItem *parent) : QGraphicsItem(parent)
+    Port::Port(GraphicsItem *parent) :
+        m_parent(parent),
+        m_net(0),
+        m_netIndex(0)
     {
-        // Set component flags
-        setFlag(ItemSendsGeometryChanges, true);
-        setFlag(ItemSendsScenePositionChanges, true);
-
-        m_connections.append(this);
+        // Ports added to an item already in a scene are a new net
+        invalidateNetlist();
     }
 
     //! \brief Destroys the port object, removing all connections from the item
     Port::~Port()
     {
         disconnect();
+
+        GraphicsScene *graphicsScene = qobject_cast<GraphicsScene*>(scene());
+        if(graphicsScene) {
+            graphicsScene->netlistCache()->removePort(this);
+        }
     }
 
-    /*!
-     *  \brief Returns a pointer to this item's parent item. If this item does
-     *  not have a parent, 0 is returned.
-     */
-    GraphicsItem* Port::parentItem() const
+    //! \brief Returns the scene of the parent item, or 0 if there is none.
+    QGraphicsScene* Port::scene() const
+    {
+        return m_parent ? m_parent->scene() : 0;
+    }
+
+    //! \brief Returns the port position in scene coordinates.
+    QPointF Port::scenePos() const
+    {
+        return m_parent ? m_parent->mapToScene(m_pos) : m_pos;
+    }
+
+    //! \brief Returns the list of connected ports, including this one.
+    QList<Port*> Port::connections() const
     {
-        GraphicsItem *item = canedaitem_cast<GraphicsItem*>(QGraphicsItem::parentItem());
-        if(item) {
-            return item;
+        if(m_net) {
+            return m_net->ports;
         }
-        return 0;
+
+        return QList<Port*>() << const_cast<Port*>(this);
     }
 
     /*!
@@ -71,9 +86,10 @@ namespace Caneda
      *  netlist creation to determine each unique net and group all components
      *  connected ports under only one name.
      *
-     *  This method works in a recursive way, filling a list with the port
-     *  direct connections (contained in m_connections) and searching for
-     *  the connections of those ports connected to this one by a wire.
+     *  This method walks the nets, filling a list with the port direct
+     *  connections (contained in m_net) and following the wires to the nets
+     *  at their other end. Visited ports are kept in a set, so each port is
+     *  added and checked only once.
      *
      *  \param connectedPorts List to fill with the connections of this port.
      *
@@ -81,22 +97,47 @@ namespace Caneda
      */
     void Port::getEquipotentialPorts(QList<Port*> &connectedPorts)
     {
-        if(connectedPorts.contains(this)) {
+        QSet<Port*> visited = connectedPorts.toSet();
+        if(visited.contains(this)) {
             return;
         }
 
-        connectedPorts << m_connections;
+        QList<Port*> pending;
+        pending << this;
 
-        foreach(Port *port, connectedPorts) {
-            if(port->parentItem()->type() == GraphicsItem::WireType) {
-                Wire *_wire = static_cast<Wire*>(port->parentItem());
-                _wire->port1()->getEquipotentialPorts(connectedPorts);
-                _wire->port2()->getEquipotentialPorts(connectedPorts);
+        while(!pending.isEmpty()) {
+            Port *current = pending.takeLast();
+            if(visited.contains(current)) {
+                continue;
+            }
+
+            foreach(Port *port, current->connections()) {
+                if(visited.contains(port)) {
+                    continue;
+                }
+
+                visited.insert(port);
+                connectedPorts << port;
+
+                // Follow the wire to the net at its other end
+                if(port->parentItem()->type() == GraphicsItem::WireType) {
+                    Wire *_wire = static_cast<Wire*>(port->parentItem());
+                    Port *other = (_wire->port1() == port) ? _wire->port2() : _wire->port1();
+                    if(!visited.contains(other)) {
+                        pending << other;
+                    }
+                }
             }
         }
     }
 
-    //! \brief Connect this port to \a other.
+    /*!
+     * \brief Connect this port to \a other.
+     *
+     * Connecting an unconnected port into a net only appends it to the
+     * shared net. When both ports already belong to different nets, the
+     * ports of the smaller net are moved into the larger one.
+     */
     void Port::connectTo(Port *other)
     {
         if(this == other || !other) {
@@ -122,66 +163,130 @@ namespace Caneda
             return;
         }
 
-        // If the connections are same, they are already connected.
-        if(m_connections == other->m_connections) {
+        // If the nets are same, they are already connected.
+        if(isConnectedTo(other)) {
             qWarning() << "Port::connectTo() : The ports are already connected";
+            return;
+        }
+
+        if(!m_net && !other->m_net) {
+            m_net = new Net;
+            m_net->ports << this << other;
+            other->m_net = m_net;
+            m_netIndex = 0;
+            other->m_netIndex = 1;
+        }
+        else if(!m_net) {
+            m_net = other->m_net;
+            m_netIndex = m_net->ports.size();
+            m_net->ports << this;
+        }
+        else if(!other->m_net) {
+            other->m_net = m_net;
+            other->m_netIndex = m_net->ports.size();
+            m_net->ports << other;
         }
         else {
-            // Create a list of connections by merging both lists of connections
-            // and replicating the list in all connected ports.
-            m_connections += other->m_connections;
-            foreach(Port *p, m_connections) {
-                p->m_connections = m_connections;
+            Net *target = m_net;
+            Net *source = other->m_net;
+            if(source->ports.size() > target->ports.size()) {
+                qSwap(target, source);
             }
+
+            int index = target->ports.size();
+            foreach(Port *p, source->ports) {
+                p->m_net = target;
+                p->m_netIndex = index++;
+            }
+            target->ports += source->ports;
+            delete source;
         }
 
-        // Update all ports parents.
-        foreach(Port *p, m_connections) {
-            p->parentItem()->update();
+        // Update the ports parents. Only the nets becoming a junction change
+        // the drawing of every member.
+        if(m_net->ports.size() <= 3) {
+            foreach(Port *p, m_net->ports) {
+                p->parentItem()->update();
+            }
+        }
+        else {
+            parentItem()->update();
+            other->parentItem()->update();
         }
+
+        invalidateNetlist();
     }
 
     /*!
      * \brief Disconnect a port
      *
-     * A disconnect operation must remove this port from every other port's
-     * list of connections (effectively disconnecting all ports currently
-     * connected), thus avoiding false or erroneous connections to remain as
-     * valid.
+     * A disconnect operation must remove this port from its net (effectively
+     * disconnecting all ports currently connected to it), thus avoiding false
+     * or erroneous connections to remain as valid. The net is deleted once
+     * only one port remains in it.
      */
     void Port::disconnect()
     {
         // Check if there is any connection
-        if(m_connections.size() <= 1) {
+        if(!m_net) {
             return;
         }
 
-        // Disconnect this port from every connected port
-        foreach(Port *p, m_connections) {
-            p->m_connections.removeAll(this);
-            p->parentItem()->update();
+        // Move the last port of the net into our place, instead of shifting
+        // every port after us
+        Net *net = m_net;
+        Port *last = net->ports.last();
+        Port *remaining = (last == this) ? net->ports.first() : last;
+        net->ports[m_netIndex] = last;
+        last->m_netIndex = m_netIndex;
+        net->ports.removeLast();
+        m_net = 0;
+        m_netIndex = 0;
+
+        // The remaining ports lose a connection, even if their net is kept
+        GraphicsScene *graphicsScene = qobject_cast<GraphicsScene*>(scene());
+        if(graphicsScene) {
+            foreach(Port *p, net->ports) {
+                graphicsScene->ruleChecker()->markDirty(p->parentItem());
+            }
+        }
+
+        // Update the remaining ports, whose drawing may change
+        if(net->ports.size() <= 2) {
+            foreach(Port *p, net->ports) {
+                p->parentItem()->update();
+            }
         }
 
-        m_connections.clear();
-        m_connections.append(this);
+        if(net->ports.size() == 1) {
+            net->ports.first()->m_net = 0;
+            net->ports.first()->m_netIndex = 0;
+            delete net;
+        }
 
         // Update parent item.
         parentItem()->update();
+
+        // The net left behind may be split too (this port may be out of the
+        // scene already, if its item was removed while connected)
+        invalidateNetlist();
+        remaining->invalidateNetlist();
     }
 
-    //! \brief Check if port \a other is connected to this port.
-    bool Port::isConnectedTo(Port *other)
+    //! \brief Marks the net of this port as changed, after a connectivity change.
+    void Port::invalidateNetlist()
     {
-        bool retVal = m_connections == other->m_connections &&
-            m_connections.contains(other);
-        return retVal;
+        GraphicsScene *graphicsScene = qobject_cast<GraphicsScene*>(scene());
+        if(graphicsScene) {
+            graphicsScene->netlistCache()->invalidatePort(this);
+            graphicsScene->ruleChecker()->markDirty(parentItem());
+        }
     }
 
-    //! \brief Returns true if this port is connected to any other port
-    bool Port::hasAnyConnection() const
+    //! \brief Check if port \a other is connected to this port.
+    bool Port::isConnectedTo(Port *other) const
     {
-        bool retVal = (m_connections.size() > 1);
-        return retVal;
+        return m_net && m_net == other->m_net;
     }
 
     //! \brief Finds a coinciding port on schematic.
@@ -201,7 +306,7 @@ namespace Caneda
                 foreach(Port *p, ports) {
                     if(p->scenePos() == scenePos() &&
                             p->parentItem() != parentItem() &&
-                            !m_connections.contains(p)) {
+                            !isConnectedTo(p)) {
                         return p;
                     }
                 }
@@ -215,38 +320,41 @@ namespace Caneda
     /*!
      * \brief Draws the port based on the current connection status.
      *
-     *  Ports are drawn only if:
+     *  This method is called from the paint() method of the parent item, in
+     *  parent coordinates. Ports are drawn only if:
      *    \li the port is not connected
      *    \li there are more than two connections to the port
      */
-    void Port::paint(QPainter *painter, const QStyleOptionGraphicsItem* option, QWidget*)
+    void Port::paint(QPainter *painter) const
     {
-        // Save pen
+        // Save pen and brush
         QPen savedPen = painter->pen();
+        QBrush savedBrush = painter->brush();
 
         // Set global pen settings
         Settings *settings = Settings::instance();
-        if(m_connections.size() <= 1) {
+        int count = connectionCount();
+        if(count <= 1) {
             painter->setPen(QPen(Qt::darkRed));
             painter->setBrush(Qt::NoBrush);
-            painter->drawEllipse(portEllipse);
+            painter->drawEllipse(portEllipse.translated(m_pos));
         }
-        else if(m_connections.size() > 2 && parentItem()->isSelected()) {
+        else if(count > 2 && parentItem()->isSelected()) {
             painter->setPen(QPen(settings->currentValue("gui/selectionColor").value<QColor>(),
                                  settings->currentValue("gui/lineWidth").toInt()));
             painter->setBrush(QBrush(settings->currentValue("gui/selectionColor").value<QColor>()));
-            painter->drawEllipse(portEllipse.adjusted(1,1,-1,-1));  // Adjust the ellipse to be just a little smaller than the open port
+            painter->drawEllipse(portEllipse.adjusted(1,1,-1,-1).translated(m_pos));  // Adjust the ellipse to be just a little smaller than the open port
         }
-        else if(m_connections.size() > 2) {
+        else if(count > 2) {
             painter->setPen(QPen(settings->currentValue("gui/lineColor").value<QColor>(),
                                  settings->currentValue("gui/lineWidth").toInt()));
             painter->setBrush(QBrush(settings->currentValue("gui/lineColor").value<QColor>()));
-            painter->drawEllipse(portEllipse.adjusted(1,1,-1,-1));  // Adjust the ellipse to be just a little smaller than the open port
+            painter->drawEllipse(portEllipse.adjusted(1,1,-1,-1).translated(m_pos));  // Adjust the ellipse to be just a little smaller than the open port
         }
 
-        // Restore pen
+        // Restore pen and brush
         painter->setPen(savedPen);
-
+        painter->setBrush(savedBrush);
     }
 
 } // namespace Caneda
@@ -43,6 +43,28 @@ namespace Caneda
         QString name;
     };
 
+    // Forward declarations
+    class Port;
+
+    /*!
+     * \brief The Net class holds the ports connected together at one point.
+     *
+     * A net is shared by all its member ports, instead of each port holding
+     * its own copy of the connections list. Connecting a port into a net is
+     * therefore a constant time operation, and merging two nets only moves
+     * the ports of the smaller one. Each port remembers its position in the
+     * net, so that disconnecting it is a constant time operation too.
+     * Unconnected ports have no net at all.
+     *
+     * \sa Port
+     */
+    class Net
+    {
+    public:
+        //! Ports connected together by this net.
+        QList<Port*> ports;
+    };
+
     /*!
      * \brief The Port class is an electric port graphical representation, that
      * allows components to be connected together through the use of wires.
@@ -53,14 +75,18 @@ namespace Caneda
      * can be connected to multiple ports, thus allowing interconnection of
      * electric components such as wires, pasive and active components, etc.
      *
+     * Ports are not items of the scene themselves, but lightweight objects
+     * drawn by the paint() method of their parent. Their connections are held
+     * by a Net shared among all the connected ports.
+     *
      * A disconnected port (that only has its parent) is represented by a
      * hollow circle, while a connected port (with only one connection) is not
      * drawn. When multiple connections are made into one port, a filled circle
      * with the foreground color is drawn.
      *
-     * \sa Component, Wire
+     * \sa Component, Wire, Net
      */
-    class Port : public QGraphicsItem
+    class Port
     {
     public:
         explicit Port(GraphicsItem *parent = 0);
@@ -70,27 +96,42 @@ namespace Caneda
         QString name() const { return m_name; }
         void setName(const QString &newName) { m_name = newName; }
 
-        GraphicsItem* parentItem() const;
+        //! Returns the item this port belongs to.
+        GraphicsItem* parentItem() const { return m_parent; }
+        QGraphicsScene* scene() const;
+
+        //! Returns the port position, in parent coordinates.
+        QPointF pos() const { return m_pos; }
+        //! Sets the port position, in parent coordinates.
+        void setPos(const QPointF &pos) { m_pos = pos; }
+        QPointF scenePos() const;
 
-        //! Returns a pointer to list of connected ports
-        QList<Port*> *connections() { return &(m_connections); }
+        QList<Port*> connections() const;
+        //! Returns the number of ports in the net, including this one.
+        int connectionCount() const { return m_net ? m_net->ports.size() : 1; }
         void getEquipotentialPorts(QList<Caneda::Port *> &connectedPorts);
 
         void connectTo(Port *other);
         void disconnect();
 
-        bool isConnectedTo(Port *other);
-        bool hasAnyConnection() const;
+        bool isConnectedTo(Port *other) const;
+        //! Returns true if this port is connected to any other port.
+        bool hasAnyConnection() const { return m_net != 0; }
 
         Port* findCoincidingPort() const;
 
-        //! Return bounding box
-        QRectF boundingRect() const { return portEllipse; }
-        void paint(QPainter *painter, const QStyleOptionGraphicsItem* option, QWidget*);
+        void paint(QPainter *painter) const;
 
     private:
+        void invalidateNetlist();
+
         QString m_name;
-        QList<Port*> m_connections;
+        QPointF m_pos;
+        GraphicsItem *m_parent;
+        //! Net shared with the connected ports, null when unconnected.
+        Net *m_net;
+        //! Position of this port in the ports list of its net.
+        int m_netIndex;
     };
 
 } // namespace Caneda
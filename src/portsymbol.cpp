@@ -20,10 +20,13 @@
 #include "portsymbol.h"
 
 #include "graphicsitem.h"
+#include "graphicsscene.h"
 #include "portsymboldialog.h"
+#include "rulechecker.h"
 #include "settings.h"
 #include "xmlutilities.h"
 
+#include <QGraphicsSimpleTextItem>
 #include <QStyleOptionGraphicsItem>
 
 namespace Caneda
@@ -70,6 +73,13 @@ namespace Caneda
         m_label->setText(newLabel);
         updateGeometry();
 
+        // The label names the net of the port
+        GraphicsScene *graphicsScene = qobject_cast<GraphicsScene*>(scene());
+        if(graphicsScene) {
+            graphicsScene->netlistCache()->invalidatePort(port());
+            graphicsScene->ruleChecker()->markDirty(this);
+        }
+
         return true;
     }
 
@@ -107,6 +117,7 @@ namespace Caneda
         // would be very difficult to select (the selection would only work
         // when picking the lines).
         QRectF _boundRect = m_symbol.boundingRect() | m_label->boundingRect().translated(labelPos);
+        _boundRect |= portEllipse;  // The port is drawn by this item
         QPainterPath _path = QPainterPath();
         _path.addRect(_boundRect);
 
@@ -140,12 +151,15 @@ namespace Caneda
         // Draw the port symbol if it is a termination point or ground
         if(m_label->text().toLower() == "ground" ||
                 m_label->text().toLower() == "gnd" ||
-                port()->connections()->size() <= 2) {
+                port()->connectionCount() <= 2) {
             painter->drawPath(m_symbol);
         }
 
         // Restore pen
         painter->setPen(savedPen);
+
+        // Draw the ports
+        paintPorts(painter);
     }
 
     //! \copydoc GraphicsItem::copy()
@@ -158,13 +172,28 @@ namespace Caneda
         return portSymbol;
     }
 
+    //! \brief Returns a copy of the data saved by the port, see saveData().
+    PortSymbolSnapshot PortSymbol::snapshot() const
+    {
+        PortSymbolSnapshot snapshot;
+        snapshot.label = m_label->text();
+        snapshot.pos = pos();
+        return snapshot;
+    }
+
     //! \copydoc GraphicsItem::saveData()
     void PortSymbol::saveData(Caneda::XmlWriter *writer) const
+    {
+        snapshot().write(writer);
+    }
+
+    //! \brief Writes the port symbol to xml, see PortSymbol::saveData().
+    void PortSymbolSnapshot::write(Caneda::XmlWriter *writer) const
     {
         writer->writeStartElement("port");
 
-        writer->writeAttribute("name", m_label->text());
-        writer->writePointAttribute(pos(), "pos");
+        writer->writeAttribute("name", label);
+        writer->writePointAttribute(pos, "pos");
 
         writer->writeEndElement(); // < /port>
     }
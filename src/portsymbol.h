@@ -27,6 +27,20 @@ namespace Caneda
     // Forward declarations
     class GraphicsItem;
 
+    /*!
+     * \brief Copy of the data saved by a PortSymbol, which can be written
+     * from any thread.
+     *
+     * \sa PortSymbol::snapshot(), PortSymbol::saveData()
+     */
+    struct PortSymbolSnapshot
+    {
+        QString label;
+        QPointF pos;
+
+        void write(Caneda::XmlWriter *writer) const;
+    };
+
     /*!
      * \brief Represents the port symbol on component symbols and schematics.
      *
@@ -65,6 +79,7 @@ namespace Caneda
 
         PortSymbol* copy() const;
 
+        PortSymbolSnapshot snapshot() const;
         void saveData(Caneda::XmlWriter *writer) const;
         void loadData(Caneda::XmlReader *reader);
 
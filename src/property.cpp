@@ -20,12 +20,18 @@
 
 #include "property.h"
 
+#include "component.h"
 #include "global.h"
+#include "graphicsscene.h"
 #include "propertydialog.h"
+#include "rulechecker.h"
 #include "settings.h"
+#include "statictextcache.h"
 #include "xmlutilities.h"
 
 #include <QDebug>
+#include <QFont>
+#include <QFontMetricsF>
 #include <QGraphicsScene>
 #include <QPainter>
 #include <QStyleOptionGraphicsItem>
@@ -154,46 +160,264 @@ namespace Caneda
 
 
     /*************************************************************************
-     *                            PropertyGroup                              *
+     *                           PropertyDisplay                             *
      *************************************************************************/
     /*!
-     * \brief Constructs a new PropertyGroup.
+     * \brief Constructs a new PropertyDisplay.
      *
+     * \param group Property group whose properties are displayed.
      * \param parent Parent of the item.
      */
-    PropertyGroup::PropertyGroup(QGraphicsItem *parent) :
-        QGraphicsSimpleTextItem(parent)
+    PropertyDisplay::PropertyDisplay(PropertyGroup *group, QGraphicsItem *parent) :
+        QGraphicsItem(parent),
+        m_group(group)
     {
-        m_userPropertiesEnabled = false;
-
         // Set items flags
         setFlags(ItemIsMovable | ItemIsSelectable | ItemIsFocusable);
         setFlag(ItemSendsGeometryChanges, true);
         setFlag(ItemSendsScenePositionChanges, true);
     }
 
+    /*!
+     * \brief Sets all the displayed lines to \a lines.
+     *
+     * Only the lines differing from the currently displayed ones are
+     * measured again.
+     */
+    void PropertyDisplay::setLines(const QStringList &lines)
+    {
+        QFontMetricsF metrics = QFontMetricsF(QFont());
+        m_lineWidths.resize(lines.size());
+        for(int i = 0; i < lines.size(); ++i) {
+            if(i >= m_lines.size() || m_lines.at(i) != lines.at(i)) {
+                m_lineWidths[i] = metrics.width(lines.at(i));
+            }
+        }
+
+        m_lines = lines;
+        updateBoundingRect();
+    }
+
+    //! \brief Sets the displayed line at \a index to \a line.
+    void PropertyDisplay::setLine(int index, const QString &line)
+    {
+        if(m_lines.at(index) == line) {
+            return;
+        }
+
+        m_lines[index] = line;
+        m_lineWidths[index] = QFontMetricsF(QFont()).width(line);
+        updateBoundingRect();
+    }
+
+    //! \brief Updates the bounding rect from the width of the lines.
+    void PropertyDisplay::updateBoundingRect()
+    {
+        qreal width = 0;
+        foreach(qreal lineWidth, m_lineWidths) {
+            width = qMax(width, lineWidth);
+        }
+
+        QFontMetricsF metrics = QFontMetricsF(QFont());
+        QRectF rect(0, 0, width, m_lines.size() * metrics.lineSpacing());
+
+        QRectF oldRect = m_boundingRect;
+        if(rect != m_boundingRect) {
+            prepareGeometryChange();
+            m_boundingRect = rect;
+        }
+        else {
+            update();
+        }
+
+        // The cached tiles of the views hold the old text, both in the old
+        // and the new area
+        GraphicsScene *graphicsScene = qobject_cast<GraphicsScene*>(scene());
+        if(graphicsScene && !graphicsScene->isLiveItem(this)) {
+            graphicsScene->invalidateTiles(mapRectToScene(oldRect | rect));
+        }
+    }
+
+    /*!
+     * \brief Draws the PropertyDisplay to painter.
+     *
+     * This method draws the PropertyGroup contents on a scene. The pen color
+     * changes according to the selection state, thus giving state feedback to
+     * the user.
+     *
+     * The selection rectangle around all PropertyGroup contents is handled by
+     * this method. Currently, no selection rectangle around property items is
+     * drawn, although it could change in the future (acording to user's feedback).
+     * In that case, this class bounding rect should be used. The selection state
+     * is instead handled by changing the properties' pen color according to the
+     * global selection pen.
+     *
+     * Below the "gui/lodDetailThreshold" zoom level the properties are not
+     * drawn.
+     */
+    void PropertyDisplay::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
+            QWidget *widget)
+    {
+        // Skip the text at low zoom levels, where it would be unreadable
+        Settings *settings = Settings::instance();
+        qreal lod = option->levelOfDetailFromTransform(painter->worldTransform());
+        if(lod < settings->currentValue("gui/lodDetailThreshold").toDouble()) {
+            return;
+        }
+
+        // Save pen
+        QPen savedPen = painter->pen();
+
+        // Set global pen settings
+        if(isSelected()) {
+            painter->setPen(QPen(settings->currentValue("gui/selectionColor").value<QColor>(),
+                                 settings->currentValue("gui/lineWidth").toInt()));
+        }
+        else {
+            painter->setPen(QPen(settings->currentValue("gui/foregroundColor").value<QColor>(),
+                                 settings->currentValue("gui/lineWidth").toInt()));
+        }
+
+        // Paint the property text, one line per property
+        StaticTextCache *cache = StaticTextCache::instance();
+        const QFont font;
+        qreal lineSpacing = QFontMetricsF(font).lineSpacing();
+        for(int i = 0; i < m_lines.size(); ++i) {
+            cache->drawText(painter, QPointF(0, i * lineSpacing), m_lines.at(i), font);
+        }
+
+        // Restore pen
+        painter->setPen(savedPen);
+    }
+
+    /*!
+     * \brief Invalidates the cached tiles of the views when the display is
+     * moved or its selection changes.
+     *
+     * \sa GraphicsItem::itemChange()
+     */
+    QVariant PropertyDisplay::itemChange(GraphicsItemChange change, const QVariant &value)
+    {
+        GraphicsScene *graphicsScene = qobject_cast<GraphicsScene*>(scene());
+        if(graphicsScene) {
+            if(change == ItemPositionChange || change == ItemPositionHasChanged) {
+                graphicsScene->invalidateTiles(this);
+            }
+            else if(change == ItemSelectedHasChanged) {
+                graphicsScene->invalidateTiles(sceneBoundingRect());
+            }
+        }
+
+        return QGraphicsItem::itemChange(change, value);
+    }
+
+    //! \brief On mouse click deselect selected items other than this.
+    void PropertyDisplay::mousePressEvent(QGraphicsSceneMouseEvent *event)
+    {
+        GraphicsScene *graphicsScene = qobject_cast<GraphicsScene*>(scene());
+        if(graphicsScene) {
+            QList<QGraphicsItem*> items = graphicsScene->selectedItems();
+            items.removeAll(this);
+            graphicsScene->setItemsSelected(items, false);
+        }
+
+        QGraphicsItem::mousePressEvent(event);
+    }
+
+    //! \brief Launches property dialog on double click.
+    void PropertyDisplay::mouseDoubleClickEvent(QGraphicsSceneMouseEvent *)
+    {
+        m_group->launchPropertiesDialog();
+    }
+
+
+    /*************************************************************************
+     *                            PropertyGroup                              *
+     *************************************************************************/
+    //! \brief Returns true if both properties hold the same data.
+    static bool isSameProperty(const Property &a, const Property &b)
+    {
+        return a.value() == b.value() &&
+               a.isVisible() == b.isVisible() &&
+               a.name() == b.name() &&
+               a.description() == b.description();
+    }
+
+    /*!
+     * \brief Constructs a new PropertyGroup.
+     *
+     * \param scene Scene where the properties are displayed, if the group
+     * is not owned by an item.
+     */
+    PropertyGroup::PropertyGroup(QGraphicsScene *scene) :
+        m_userPropertiesEnabled(false),
+        m_display(0),
+        m_parentItem(0),
+        m_scene(scene)
+    {
+    }
+
+    //! \brief Destructor.
+    PropertyGroup::~PropertyGroup()
+    {
+        delete m_display;
+    }
+
     //! \brief Adds a new property to the PropertyMap.
     void PropertyGroup::addProperty(const QString& key, const Property &prop)
     {
         m_propertyMap.insert(key, prop);
-        updatePropertyDisplay();  // This is necessary to update the properties display on a scene
+        pruneProperty(key);
+        invalidateNetlist();
+        updatePropertyDisplay(key);  // This is necessary to update the properties display on a scene
     }
 
     //! \brief Sets property \a key to \a value in the PropertyMap.
     void PropertyGroup::setPropertyValue(const QString& key, const QString& value)
     {
-        if(m_propertyMap.contains(key)) {
-            m_propertyMap[key].setValue(value);
-            updatePropertyDisplay();  // This is necessary to update the properties display on a scene
+        if(m_propertyMap.contains(key) || m_defaultMap.contains(key)) {
+            overrideProperty(key).setValue(value);
+            pruneProperty(key);
+            invalidateNetlist();
+            updatePropertyDisplay(key);  // This is necessary to update the properties display on a scene
+        }
+    }
+
+    /*!
+     * \brief Returns the property map (actually a copy of property map).
+     *
+     * The returned map holds the default properties merged with the
+     * overridden ones.
+     */
+    PropertyMap PropertyGroup::propertyMap() const
+    {
+        return mergeProperties(m_propertyMap, m_defaultMap);
+    }
+
+    //! \brief Returns the \a defaults map with the \a overrides applied.
+    PropertyMap PropertyGroup::mergeProperties(const PropertyMap& overrides,
+                                               const PropertyMap& defaults)
+    {
+        if(defaults.isEmpty()) {
+            return overrides;
+        }
+
+        PropertyMap propMap = defaults;
+        PropertyMap::const_iterator it;
+        for(it = overrides.constBegin(); it != overrides.constEnd(); ++it) {
+            propMap.insert(it.key(), it.value());
         }
+
+        return propMap;
     }
 
     /*!
      * \brief Set all the properties values through a PropertyMap.
      *
      * This method sets the properties values by updating the propertyMap
-     * to \a propMap. After setting the propertyMap, this method also takes
-     * care of updating the properties display on the scene.
+     * to \a propMap. Only the properties differing from the defaults are
+     * kept. After setting the propertyMap, this method also takes care of
+     * updating the properties display on the scene.
      *
      * \param propMap The new property map to be set.
      *
@@ -202,6 +426,36 @@ namespace Caneda
     void PropertyGroup::setPropertyMap(const PropertyMap& propMap)
     {
         m_propertyMap = propMap;
+        foreach(const QString &key, propMap.keys()) {
+            pruneProperty(key);
+        }
+
+        invalidateNetlist();
+        updatePropertyDisplay();  // This is necessary to update the properties display on a scene
+    }
+
+    /*!
+     * \brief Sets the default properties from another PropertyGroup.
+     *
+     * The properties of a library group (which has no defaults of its own)
+     * become the defaults of this group, while the defaults and overrides of
+     * a component instance are copied as they are. In both cases the maps
+     * are implicitly shared and no property is actually copied.
+     *
+     * \param other PropertyGroup whose properties become the defaults.
+     */
+    void PropertyGroup::setDefaultProperties(const PropertyGroup *other)
+    {
+        if(other->m_defaultMap.isEmpty()) {
+            m_defaultMap = other->m_propertyMap;
+            m_propertyMap.clear();
+        }
+        else {
+            m_defaultMap = other->m_defaultMap;
+            m_propertyMap = other->m_propertyMap;
+        }
+
+        invalidateNetlist();
         updatePropertyDisplay();  // This is necessary to update the properties display on a scene
     }
 
@@ -224,108 +478,170 @@ namespace Caneda
      * \brief Updates the visual display of all the properties in the PropertyGroup.
      *
      * This method is key to alter the visual display text of given properties. It
-     * should be called wherever a property changes.
+     * should be called wherever several properties change at once.
      *
      * To update the visual display, it recreates all individual properties display
-     * from the group and then adds them to the plaintext property of this item (if
-     * the given property is visible). This method also updates the visible value of
-     * the property.
+     * lines from the group and then sets them as the lines of the display item
+     * (if the given property is visible). The display item is created the first
+     * time a property becomes visible.
+     *
+     * \sa updatePropertyDisplay(const QString&)
      */
     void PropertyGroup::updatePropertyDisplay()
     {
-        bool itemsVisible = false;
+        QStringList keys;
+        QStringList lines;
 
-        // Determine if any item is visible.
-        foreach(const Property property, m_propertyMap) {
-            if(property.isVisible()) {
-                 itemsVisible = true;
-                 break;
+        // Iterate through all properties to add its values
+        PropertyMap propMap = propertyMap();
+        PropertyMap::const_iterator it;
+        for(it = propMap.constBegin(); it != propMap.constEnd(); ++it) {
+            if(it.value().isVisible()) {
+                keys << it.key();
+                lines << displayText(it.value());
             }
         }
 
+        m_displayKeys = keys;
+
         // Hide the display if none of the properties are visible.
-        if(!itemsVisible) {
-            hide();
+        if(lines.isEmpty()) {
+            if(m_display) {
+                m_display->hide();
+            }
             return;
         }
 
-        // Else update its value, and make visible (show()).
-        QString newValue;  // New value to set
+        // Else create the display if needed, update its value, and make
+        // visible (show()).
+        if(!m_display) {
+            m_display = new PropertyDisplay(this, m_parentItem);
+            // Setting a transform allocates the transform data of the item
+            if(!m_transform.isIdentity()) {
+                m_display->setTransform(m_transform);
+            }
+            m_display->setPos(m_pos);
+            if(!m_parentItem && m_scene) {
+                m_scene->addItem(m_display);
+            }
+        }
 
-        // Iterate through all properties to add its values
-        foreach(const Property property, m_propertyMap) {
-            if(property.isVisible()) {
+        m_display->setLines(lines);
+        m_display->show();
+    }
 
-                QString propertyText = QString();  // Current property text
+    /*!
+     * \brief Updates the visual display of the property \a key.
+     *
+     * If the visibility of the property did not change, only its own line of
+     * the display is updated, otherwise the whole display is recreated.
+     *
+     * \sa updatePropertyDisplay()
+     */
+    void PropertyGroup::updatePropertyDisplay(const QString& key)
+    {
+        Property prop = property(key);
+        int index = m_displayKeys.indexOf(key);
 
-                // Add property name (except for the label property)
-                if(!property.name().startsWith("label", Qt::CaseInsensitive)) {
-                    propertyText = property.name() + " = ";
-                }
+        if(index == -1 && !prop.isVisible()) {
+            return;
+        }
 
-                // Add property value
-                propertyText.append(property.value());
+        if(index == -1 || !prop.isVisible() || !m_display) {
+            updatePropertyDisplay();
+            return;
+        }
 
-                // Add the property to the group
-                if(!newValue.isEmpty()) {
-                    newValue.append("\n");  // If already has properties, add newline
-                }
-                newValue.append(propertyText);
-            }
+        m_display->setLine(index, displayText(prop));
+        m_display->show();
+    }
+
+    //! \brief Returns the text used to display \a property.
+    QString PropertyGroup::displayText(const Property& property)
+    {
+        // Add property name (except for the label property)
+        if(property.name().startsWith("label", Qt::CaseInsensitive)) {
+            return property.value();
         }
 
-        // Set new properties values
-        setText(newValue);
+        return property.name() + " = " + property.value();
+    }
 
-        // Make item visible
-        show();
+    //! \brief Returns the scene where the properties are displayed.
+    QGraphicsScene* PropertyGroup::scene() const
+    {
+        return m_parentItem ? m_parentItem->scene() : m_scene;
     }
 
-    /*!
-     * \brief Draws the PropertyGroup to painter.
-     *
-     * This method draws the PropertyGroup contents on a scene. The pen color
-     * changes according to the selection state, thus giving state feedback to
-     * the user.
-     *
-     * The selection rectangle around all PropertyGroup contents is handled by
-     * this method. Currently, no selection rectangle around property items is
-     * drawn, although it could change in the future (acording to user's feedback).
-     * In that case, this class bounding rect should be used. The selection state
-     * is instead handled by changing the properties' pen color according to the
-     * global selection pen.
-     */
-    void PropertyGroup::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
-            QWidget *widget)
+    //! \brief Sets the item owning the properties to \a parent.
+    void PropertyGroup::setParentItem(QGraphicsItem *parent)
     {
-        // Save pen
-        QPen savedPen = painter->pen();
+        m_parentItem = parent;
+        if(m_display) {
+            m_display->setParentItem(parent);
+        }
+    }
 
-        // Set global pen settings
-        Settings *settings = Settings::instance();
-        if(isSelected()) {
-            painter->setPen(QPen(settings->currentValue("gui/selectionColor").value<QColor>(),
-                                 settings->currentValue("gui/lineWidth").toInt()));
+    //! \brief Returns the position of the properties display.
+    QPointF PropertyGroup::pos() const
+    {
+        return m_display ? m_display->pos() : m_pos;
+    }
+
+    //! \brief Sets the position of the properties display to \a pos.
+    void PropertyGroup::setPos(const QPointF &pos)
+    {
+        m_pos = pos;
+        if(m_display) {
+            m_display->setPos(pos);
         }
-        else {
-            painter->setPen(QPen(settings->currentValue("gui/foregroundColor").value<QColor>(),
-                                 settings->currentValue("gui/lineWidth").toInt()));
+    }
+
+    //! \brief Sets the transform of the properties display to \a transform.
+    void PropertyGroup::setTransform(const QTransform &transform)
+    {
+        m_transform = transform;
+        if(m_display && (!transform.isIdentity() || !m_display->transform().isIdentity())) {
+            m_display->setTransform(transform);
         }
+    }
 
-        // Paint the property text
-        painter->drawText(boundingRect(), text());
+    //! \brief Hides the properties display until the properties change.
+    void PropertyGroup::hide()
+    {
+        if(m_display) {
+            m_display->hide();
+        }
+    }
 
-        // Restore pen
-        painter->setPen(savedPen);
+    /*!
+     * \brief Returns a copy of the properties to be written later, possibly
+     * from another thread.
+     *
+     * \sa writeProperties()
+     */
+    PropertySnapshot PropertyGroup::snapshot() const
+    {
+        PropertySnapshot snapshot;
+        snapshot.pos = pos();
+        snapshot.overrides = m_propertyMap;
+        snapshot.defaults = m_defaultMap;
+        return snapshot;
     }
 
     //! \brief Helper method to write all properties in \a m_propertyMap to xml.
     void PropertyGroup::writeProperties(Caneda::XmlWriter *writer)
+    {
+        snapshot().write(writer);
+    }
+
+    //! \brief Writes the properties to xml, see PropertyGroup::writeProperties().
+    void PropertySnapshot::write(Caneda::XmlWriter *writer) const
     {
         writer->writeStartElement("properties");
-        writer->writePointAttribute(pos(), "pos");
+        writer->writePointAttribute(pos, "pos");
 
-        foreach(const Property p, m_propertyMap) {
+        foreach(const Property p, PropertyGroup::mergeProperties(overrides, defaults)) {
             writer->writeEmptyElement("property");
             writer->writeAttribute("name", p.name());
             writer->writeAttribute("value", p.value());
@@ -352,14 +668,15 @@ namespace Caneda
                 if(reader->name() == "property") {
                     QXmlStreamAttributes attribs(reader->attributes());
                     QString propName = attribs.value("name").toString();
-                    if(!m_propertyMap.contains(propName)) {
+                    if(!m_propertyMap.contains(propName) && !m_defaultMap.contains(propName)) {
                         qWarning() << "readProperties() : " << "Property " << propName
                                    << "not found in map!";
                     }
                     else {
-                        Property &prop = m_propertyMap[propName];
+                        Property &prop = overrideProperty(propName);
                         prop.setValue(attribs.value("value").toString());
                         prop.setVisible(attribs.value("visible") == "true");
+                        pruneProperty(propName);
                     }
                     // Read till end element
                     reader->readUnknownElement();
@@ -370,34 +687,55 @@ namespace Caneda
             }
         }
 
+        invalidateNetlist();
         updatePropertyDisplay();
     }
 
-    //! \copydoc GraphicsItem::launchPropertiesDialog()
-    void PropertyGroup::launchPropertiesDialog()
+    /*!
+     * \brief Returns the overridden property \a key, copying it from the
+     * defaults if it is not overridden yet.
+     *
+     * The copy shares its data with the default property until it is
+     * modified.
+     */
+    Property& PropertyGroup::overrideProperty(const QString& key)
     {
-        PropertyDialog dialog(this);
-        dialog.exec();
+        if(!m_propertyMap.contains(key)) {
+            m_propertyMap.insert(key, m_defaultMap.value(key));
+        }
+
+        return m_propertyMap[key];
     }
 
-    //! \brief On mouse click deselect selected items other than this.
-    void PropertyGroup::mousePressEvent(QGraphicsSceneMouseEvent *event)
+    //! \brief Removes the override of property \a key if it equals the default.
+    void PropertyGroup::pruneProperty(const QString& key)
     {
-        if(scene()) {
-            foreach(QGraphicsItem *item, scene()->selectedItems()) {
-                if(item != this) {
-                    item->setSelected(false);
-                }
-            }
+        if(m_defaultMap.contains(key) &&
+                isSameProperty(m_propertyMap.value(key), m_defaultMap.value(key))) {
+            m_propertyMap.remove(key);
         }
+    }
 
-        QGraphicsSimpleTextItem::mousePressEvent(event);
+    /*!
+     * \brief Invalidates the netlist of the component owning the properties.
+     *
+     * \sa NetlistCache
+     */
+    void PropertyGroup::invalidateNetlist()
+    {
+        GraphicsScene *graphicsScene = qobject_cast<GraphicsScene*>(scene());
+        Component *component = canedaitem_cast<Component*>(m_parentItem);
+        if(graphicsScene && component) {
+            graphicsScene->netlistCache()->invalidateComponent(component);
+            graphicsScene->ruleChecker()->markDirty(component);
+        }
     }
 
-    //! \brief Launches property dialog on double click.
-    void PropertyGroup::mouseDoubleClickEvent(QGraphicsSceneMouseEvent *)
+    //! \copydoc GraphicsItem::launchPropertiesDialog()
+    void PropertyGroup::launchPropertiesDialog()
     {
-        launchPropertiesDialog();
+        PropertyDialog dialog(this);
+        dialog.exec();
     }
 
 } // namespace Caneda
@@ -21,7 +21,10 @@
 #ifndef PROPERTY_H
 #define PROPERTY_H
 
-#include <QGraphicsSimpleTextItem>
+#include <QGraphicsItem>
+#include <QSharedDataPointer>
+#include <QStringList>
+#include <QVector>
 
 namespace Caneda
 {
@@ -59,10 +62,11 @@ namespace Caneda
      * like p for pico, u for micro, and {R} for parameter, for example.
      *
      * While Property class holds actual properties, PropertyGroup class
-     * groups them all together and renders them on a scene, allowing
-     * selection and moving of all properties at once.
+     * groups them all together, and its PropertyDisplay renders the visible
+     * ones on a scene, allowing selection and moving of all properties at
+     * once.
      *
-     * \sa PropertyData, PropertyGroup
+     * \sa PropertyData, PropertyGroup, PropertyDisplay
      */
     class Property
     {
@@ -106,54 +110,160 @@ namespace Caneda
     typedef QMap<QString, Property> PropertyMap;
 
     /*!
-     * \brief Class used to group properties all together and render
-     * them on a scene.
+     * \brief Copy of the properties saved by a PropertyGroup.
+     *
+     * Both property maps are implicitly shared, so taking a snapshot does not
+     * copy any property. A snapshot can be written from any thread.
+     *
+     * \sa PropertyGroup::snapshot()
+     */
+    struct PropertySnapshot
+    {
+        QPointF pos;            //! \brief Position of the properties display
+        PropertyMap overrides;  //! \brief Properties overriding the defaults
+        PropertyMap defaults;   //! \brief Default properties
+
+        void write(Caneda::XmlWriter *writer) const;
+    };
+
+    // Forward declarations
+    class PropertyGroup;
+
+    /*!
+     * \brief Class used to render the visible properties of a PropertyGroup
+     * on a scene.
+     *
+     * The display is created by its PropertyGroup only once a property
+     * becomes visible, and allows the selection and moving of all properties
+     * at once.
+     *
+     * Each visible property is displayed as one line of text. Lines are
+     * updated individually, so only the changed lines are measured again,
+     * and drawn through the StaticTextCache.
+     *
+     * The label of components is visible by default, so in practice most
+     * components do have a display. To keep it light, the display uses the
+     * application font instead of holding its own, and only gets a
+     * transform when it is not the identity.
+     *
+     * \sa PropertyGroup, StaticTextCache
+     */
+    class PropertyDisplay : public QGraphicsItem
+    {
+    public:
+        explicit PropertyDisplay(PropertyGroup *group, QGraphicsItem *parent = 0);
+
+        //! \copydoc QGraphicsItem::boundingRect()
+        QRectF boundingRect() const { return m_boundingRect; }
+
+        //! Returns the displayed lines of text.
+        QStringList lines() const { return m_lines; }
+        void setLines(const QStringList &lines);
+        void setLine(int index, const QString &line);
+
+        void paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
+                QWidget *widget = 0 );
+
+    protected:
+        QVariant itemChange(GraphicsItemChange change, const QVariant &value);
+        void mousePressEvent(QGraphicsSceneMouseEvent *event);
+        void mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event);
+
+    private:
+        void updateBoundingRect();
+
+        //! Property group whose properties are displayed.
+        PropertyGroup *m_group;
+
+        //! Displayed lines of text, one per visible property.
+        QStringList m_lines;
+        //! Width of each displayed line.
+        QVector<qreal> m_lineWidths;
+        //! Cached bounding rect of all lines.
+        QRectF m_boundingRect;
+    };
+
+    /*!
+     * \brief Class used to group properties all together.
      *
      * Gouping several properties into a QMap (m_propertyMap) provides
      * a convenient way of handling them all together. In this way, for
      * example, the properties of a component can be selected and moved
      * all at once.
      *
-     * While Property class holds actual properties, PropertyGroup class
-     * groups them all together and renders them on a scene, allowing
-     * selection and moving of all properties at once.
+     * The properties of a component instance are stored as a sparse table
+     * of overrides (m_propertyMap) over the default properties of its
+     * library (m_defaultMap). The defaults map is implicitly shared among
+     * all the instances of a component, and a property is only copied into
+     * the overrides once its value or visibility differs from the default.
      *
-     * \sa PropertyData, Property
+     * The properties are rendered on a scene by a PropertyDisplay item,
+     * which is only created once at least one property is visible. As the
+     * label of components is visible by default, most component instances
+     * do create one (see tests/propertymemorytest.cpp for the cost of both
+     * cases).
+     *
+     * \sa PropertyData, Property, PropertyDisplay
      */
-    class PropertyGroup : public QGraphicsSimpleTextItem
+    class PropertyGroup
     {
     public:
-        explicit PropertyGroup(QGraphicsItem *parent = 0);
+        explicit PropertyGroup(QGraphicsScene *scene = 0);
+        ~PropertyGroup();
 
         void addProperty(const QString& key, const Property& prop);
         //! Returns selected property from property map.
-        QString propertyValue(const QString& key) const { return m_propertyMap[key].value(); }
+        QString propertyValue(const QString& key) const { return property(key).value(); }
         void setPropertyValue(const QString& key, const QString& value);
 
-        //! Returns the property map (actually a copy of property map).
-        PropertyMap propertyMap() const { return m_propertyMap; }
+        PropertyMap propertyMap() const;
         void setPropertyMap(const PropertyMap& propMap);
+        static PropertyMap mergeProperties(const PropertyMap& overrides,
+                                           const PropertyMap& defaults);
+
+        void setDefaultProperties(const PropertyGroup *other);
 
         //! Returns if the user is enabled to add or remove properties.
         bool userPropertiesEnabled() const { return m_userPropertiesEnabled; }
         void setUserPropertiesEnabled(const bool enable);
 
         void updatePropertyDisplay();
-        void paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
-                QWidget *widget = 0 );
+        void updatePropertyDisplay(const QString& key);
+
+        //! Returns the item displaying the properties, if any property is visible.
+        PropertyDisplay* display() const { return m_display; }
+
+        QGraphicsScene* scene() const;
+        //! Returns the item owning the properties.
+        QGraphicsItem* parentItem() const { return m_parentItem; }
+        void setParentItem(QGraphicsItem *parent);
 
+        QPointF pos() const;
+        void setPos(const QPointF &pos);
+        void setTransform(const QTransform &transform);
+        void hide();
+
+        PropertySnapshot snapshot() const;
         void writeProperties(Caneda::XmlWriter *writer);
         void readProperties(Caneda::XmlReader *reader);
 
         void launchPropertiesDialog();
 
-    protected:
-        void mousePressEvent(QGraphicsSceneMouseEvent *event);
-        void mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event);
-
     private:
-        //! QMap holding actual properties.
+        //! Returns the property \a key, either overridden or default.
+        Property property(const QString& key) const {
+            return m_propertyMap.contains(key) ? m_propertyMap.value(key) : m_defaultMap.value(key);
+        }
+        Property& overrideProperty(const QString& key);
+        void pruneProperty(const QString& key);
+
+        void invalidateNetlist();
+        static QString displayText(const Property& property);
+
+        //! QMap holding the properties overriding the defaults.
         PropertyMap m_propertyMap;
+        //! QMap holding the default properties, shared with the library.
+        PropertyMap m_defaultMap;
 
         /*!
          * \brief Holds the user created properties enable status.
@@ -166,6 +276,20 @@ namespace Caneda
          * \sa userPropertiesEnabled(), setUserPropertiesEnabled()
          */
         bool m_userPropertiesEnabled;
+
+        //! Item displaying the visible properties, created on demand.
+        PropertyDisplay *m_display;
+        //! Keys of the displayed properties, one per line of the display.
+        QStringList m_displayKeys;
+        //! Item owning the properties, if any.
+        QGraphicsItem *m_parentItem;
+        //! Scene holding the display when there is no parent item.
+        QGraphicsScene *m_scene;
+
+        //! Position of the display, relative to the parent item.
+        QPointF m_pos;
+        //! Transform of the display.
+        QTransform m_transform;
     };
 
 } // namespace Caneda
@@ -0,0 +1,579 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#include "rulechecker.h"
+
+#include "component.h"
+#include "graphicsscene.h"
+#include "port.h"
+#include "settings.h"
+
+#include <QPainter>
+#include <QTimer>
+#include <QtConcurrent>
+
+namespace Caneda
+{
+    //! \brief Time gathering the changes of the scene into one check, in ms.
+    static const int checkDelay = 250;
+    //! \brief Radius in pixels of the rule markers.
+    static const qreal markerRadius = 5.0;
+    //! \brief Name of the component used to mark ports intentionally unconnected.
+    static const char *noConnectName = "No connect";
+
+    /*************************************************************************
+     *                              RuleMarker                               *
+     *************************************************************************/
+    /*!
+     * \brief Constructs a new RuleMarker.
+     *
+     * \param message Description of the violation.
+     * \param parent Item violating the rule.
+     */
+    RuleMarker::RuleMarker(const QString &message, QGraphicsItem *parent) :
+        QGraphicsItem(parent)
+    {
+        setFlag(ItemIgnoresTransformations, true);
+        setAcceptedMouseButtons(0);
+        setZValue(1);
+        addMessage(message);
+    }
+
+    //! \brief Adds the description of another violation at the same position.
+    void RuleMarker::addMessage(const QString &message)
+    {
+        m_messages << message;
+        setToolTip(m_messages.join("\n"));
+    }
+
+    QRectF RuleMarker::boundingRect() const
+    {
+        return QRectF(-markerRadius - 1, -markerRadius - 1,
+                      2 * markerRadius + 2, 2 * markerRadius + 2);
+    }
+
+    //! \brief Draws the marker as a circle with an exclamation mark.
+    void RuleMarker::paint(QPainter *painter, const QStyleOptionGraphicsItem *,
+                           QWidget *)
+    {
+        QColor color = Settings::instance()->currentValue("gui/ruleMarkerColor").value<QColor>();
+
+        painter->save();
+        painter->setRenderHint(QPainter::Antialiasing, true);
+        painter->setPen(QPen(color, 1));
+        painter->setBrush(QBrush(Qt::white));
+        painter->drawEllipse(QPointF(0, 0), markerRadius, markerRadius);
+        painter->drawLine(QPointF(0, -3), QPointF(0, 1));
+        painter->drawPoint(QPointF(0, 3));
+        painter->restore();
+    }
+
+
+    /*************************************************************************
+     *                           Snapshot builder                            *
+     *************************************************************************/
+    /*!
+     * \brief Helper class copying the nets around a set of items into a
+     * RuleCheckSnapshot.
+     *
+     * Starting from the ports of the items, each net is followed through
+     * its wires until all the ports in the net are found. Components and
+     * port symbols reached this way are copied too, but the nets of their
+     * other ports are not followed (they are marked as not traversed).
+     */
+    class RuleSnapshotBuilder
+    {
+    public:
+        explicit RuleSnapshotBuilder(const QMultiHash<QString, GraphicsItem*> *labelOwners) :
+            m_labelOwners(labelOwners)
+        {
+        }
+
+        void addNets(GraphicsItem *item);
+
+        RuleCheckSnapshot snapshot;
+
+    private:
+        int addItem(GraphicsItem *item);
+        void visit(int port);
+
+        const QMultiHash<QString, GraphicsItem*> *m_labelOwners;
+
+        QHash<GraphicsItem*, int> m_items;
+        QHash<Port*, int> m_portIndexes;
+        QList<Port*> m_ports;
+        QList<int> m_pending;  //! \brief Ports whose net is still to be followed
+    };
+
+    //! \brief Adds \a item and all the nets connected to its ports.
+    void RuleSnapshotBuilder::addNets(GraphicsItem *item)
+    {
+        int index = addItem(item);
+        m_pending << snapshot.items.at(index).ports;
+
+        while(!m_pending.isEmpty()) {
+            int port = m_pending.takeLast();
+            if(snapshot.ports.at(port).traversed) {
+                continue;
+            }
+
+            // All the other ports of the net are linked to this one, and
+            // are not followed again
+            visit(port);
+            foreach(Port *other, m_ports.at(port)->connections()) {
+                addItem(other->parentItem());
+                int otherPort = m_portIndexes.value(other);
+                snapshot.links << qMakePair(port, otherPort);
+                visit(otherPort);
+            }
+        }
+    }
+
+    //! \brief Adds \a item and its ports, returning its index.
+    int RuleSnapshotBuilder::addItem(GraphicsItem *item)
+    {
+        if(m_items.contains(item)) {
+            return m_items.value(item);
+        }
+
+        RuleCheckItem data;
+        data.item = item;
+        data.type = item->type();
+        data.voltageSource = false;
+        data.missingModel = false;
+        data.duplicateLabel = false;
+
+        Component *component = canedaitem_cast<Component*>(item);
+        if(component) {
+            QString model = component->model("spice");
+            data.label = component->label();
+            data.voltageSource = model.startsWith('V', Qt::CaseInsensitive);
+            data.missingModel = model.isEmpty() && component->name() != noConnectName;
+            data.duplicateLabel = m_labelOwners->count(data.label) > 1;
+        }
+
+        int index = snapshot.items.size();
+        foreach(Port *port, item->ports()) {
+            RuleCheckPort portData;
+            portData.item = index;
+            portData.pos = port->pos();
+            portData.connected = port->hasAnyConnection();
+            portData.traversed = false;
+
+            data.ports << snapshot.ports.size();
+            m_portIndexes.insert(port, snapshot.ports.size());
+            m_ports << port;
+            snapshot.ports << portData;
+        }
+
+        // Both ends of a wire are in the same net
+        if(data.type == GraphicsItem::WireType && data.ports.size() == 2) {
+            snapshot.links << qMakePair(data.ports.at(0), data.ports.at(1));
+        }
+
+        snapshot.items << data;
+        m_items.insert(item, index);
+
+        return index;
+    }
+
+    /*!
+     * \brief Marks \a port as traversed, and follows the net through the
+     * other end of a wire.
+     */
+    void RuleSnapshotBuilder::visit(int port)
+    {
+        snapshot.ports[port].traversed = true;
+
+        const RuleCheckItem &item = snapshot.items.at(snapshot.ports.at(port).item);
+        if(item.type == GraphicsItem::WireType) {
+            foreach(int other, item.ports) {
+                if(!snapshot.ports.at(other).traversed) {
+                    m_pending << other;
+                }
+            }
+        }
+    }
+
+
+    /*************************************************************************
+     *                              RuleChecker                              *
+     *************************************************************************/
+    /*!
+     * \brief Constructs a new RuleChecker.
+     *
+     * The checker is disabled until setEnabled() is called.
+     *
+     * \param scene Scene to be checked.
+     */
+    RuleChecker::RuleChecker(GraphicsScene *scene) :
+        QObject(scene),
+        m_scene(scene),
+        m_enabled(false),
+        m_markersVisible(true)
+    {
+        m_timer = new QTimer(this);
+        m_timer->setSingleShot(true);
+        m_timer->setInterval(checkDelay);
+        connect(m_timer, SIGNAL(timeout()), this, SLOT(startCheck()));
+
+        m_watcher = new QFutureWatcher<RuleCheckResult>(this);
+        connect(m_watcher, SIGNAL(finished()), this, SLOT(applyResult()));
+    }
+
+    /*!
+     * \brief Enables or disables the checker.
+     *
+     * Enabling the checker checks the whole scene, disabling it removes all
+     * the markers.
+     */
+    void RuleChecker::setEnabled(bool enabled)
+    {
+        if(enabled == m_enabled) {
+            return;
+        }
+        m_enabled = enabled;
+
+        if(enabled) {
+            foreach(QGraphicsItem *item, m_scene->items()) {
+                markDirty(canedaitem_cast<GraphicsItem*>(item));
+            }
+            return;
+        }
+
+        m_timer->stop();
+        foreach(GraphicsItem *item, m_markers.keys()) {
+            clearMarkers(item);
+        }
+        m_dirtyItems.clear();
+        m_items.clear();
+        m_labels.clear();
+        m_labelOwners.clear();
+    }
+
+    /*!
+     * \brief Marks \a item to be checked again, after it changed.
+     *
+     * Only components, wires and port symbols are checked, other items are
+     * ignored.
+     */
+    void RuleChecker::markDirty(GraphicsItem *item)
+    {
+        if(!m_enabled || !item) {
+            return;
+        }
+
+        int type = item->type();
+        if(type != GraphicsItem::ComponentType && type != GraphicsItem::WireType &&
+                type != GraphicsItem::PortSymbolType) {
+            return;
+        }
+
+        m_dirtyItems << item;
+        if(!m_timer->isActive() && !m_watcher->isRunning()) {
+            m_timer->start();
+        }
+    }
+
+    /*!
+     * \brief Forgets \a item, once removed from the scene or deleted.
+     *
+     * The markers of the item are removed, and the components sharing its
+     * label are checked again.
+     */
+    void RuleChecker::removeItem(GraphicsItem *item)
+    {
+        m_dirtyItems.remove(item);
+        m_items.remove(item);
+        clearMarkers(item);
+
+        // The item may be being deleted, so it is not cast to a component
+        if(m_labels.contains(item)) {
+            QString label = m_labels.take(item);
+            m_labelOwners.remove(label, item);
+            foreach(GraphicsItem *other, m_labelOwners.values(label)) {
+                markDirty(other);
+            }
+        }
+    }
+
+    /*!
+     * \brief Shows or hides all the markers.
+     *
+     * The markers are only an editing aid, so they are hidden while the
+     * scene is printed or exported.
+     *
+     * \sa GraphicsScene::print(), GraphicsScene::exportImage()
+     */
+    void RuleChecker::setMarkersVisible(bool visible)
+    {
+        m_markersVisible = visible;
+
+        foreach(const QList<RuleMarker*> &markers, m_markers) {
+            foreach(RuleMarker *marker, markers) {
+                marker->setVisible(visible);
+            }
+        }
+    }
+
+    //! \brief Checks the items changed, unless a check is already running.
+    void RuleChecker::startCheck()
+    {
+        if(m_watcher->isRunning() || m_dirtyItems.isEmpty()) {
+            return;
+        }
+
+        RuleCheckSnapshot snapshot = takeSnapshot();
+        m_watcher->setFuture(QtConcurrent::run(&RuleChecker::check, snapshot));
+    }
+
+    /*!
+     * \brief Replaces the markers of the items checked with the violations
+     * found.
+     *
+     * Items removed from the scene while the check was running are skipped.
+     */
+    void RuleChecker::applyResult()
+    {
+        RuleCheckResult result = m_watcher->result();
+
+        foreach(GraphicsItem *item, result.items) {
+            if(m_items.contains(item)) {
+                clearMarkers(item);
+            }
+        }
+
+        foreach(const RuleViolation &violation, result.violations) {
+            if(!m_items.contains(violation.item)) {
+                continue;
+            }
+
+            // Violations at the same position share a marker
+            QList<RuleMarker*> &markers = m_markers[violation.item];
+            RuleMarker *marker = 0;
+            foreach(RuleMarker *m, markers) {
+                if(m->pos() == violation.pos) {
+                    marker = m;
+                    break;
+                }
+            }
+
+            if(marker) {
+                marker->addMessage(violation.message);
+            }
+            else {
+                marker = new RuleMarker(violation.message, violation.item);
+                marker->setPos(violation.pos);
+                marker->setVisible(m_markersVisible);
+                markers << marker;
+            }
+        }
+
+        // Check the changes made while this check was running
+        if(!m_dirtyItems.isEmpty()) {
+            m_timer->start();
+        }
+    }
+
+    /*!
+     * \brief Copies the dirty items and the nets connected to them.
+     *
+     * Items no longer in the scene, hidden or being inserted are skipped.
+     * The label index is updated here, and components whose label is shared
+     * with a changed component are checked too.
+     */
+    RuleCheckSnapshot RuleChecker::takeSnapshot()
+    {
+        QList<GraphicsItem*> items;
+        foreach(GraphicsItem *item, m_dirtyItems) {
+            if(item->scene() == m_scene && item->isVisible() && !m_scene->isInsertible(item)) {
+                items << item;
+            }
+        }
+        m_dirtyItems.clear();
+
+        QList<GraphicsItem*> affected;
+        foreach(GraphicsItem *item, items) {
+            Component *component = canedaitem_cast<Component*>(item);
+            if(component) {
+                updateLabel(component, &affected);
+            }
+        }
+        items << affected;
+
+        RuleSnapshotBuilder builder(&m_labelOwners);
+        foreach(GraphicsItem *item, items) {
+            builder.addNets(item);
+        }
+
+        foreach(const RuleCheckItem &item, builder.snapshot.items) {
+            m_items << item.item;
+        }
+
+        return builder.snapshot;
+    }
+
+    /*!
+     * \brief Updates the label index with the current label of \a component.
+     *
+     * \param component Component whose label may have changed.
+     * \param affected Where the other components using the old or new label
+     * are appended, as their duplicated label state may change.
+     */
+    void RuleChecker::updateLabel(Component *component, QList<GraphicsItem*> *affected)
+    {
+        QString label = component->label();
+        if(m_labels.contains(component)) {
+            QString oldLabel = m_labels.value(component);
+            if(oldLabel == label) {
+                return;
+            }
+
+            m_labelOwners.remove(oldLabel, component);
+            foreach(GraphicsItem *other, m_labelOwners.values(oldLabel)) {
+                *affected << other;
+            }
+        }
+
+        foreach(GraphicsItem *other, m_labelOwners.values(label)) {
+            *affected << other;
+        }
+
+        m_labels.insert(component, label);
+        m_labelOwners.insert(label, component);
+    }
+
+    //! \brief Removes the markers shown on \a item.
+    void RuleChecker::clearMarkers(GraphicsItem *item)
+    {
+        qDeleteAll(m_markers.take(item));
+    }
+
+    //! \brief Returns the root of the net of \a port, see check().
+    static int findNet(QVector<int> &nets, int port)
+    {
+        while(nets.at(port) != port) {
+            nets[port] = nets.at(nets.at(port));
+            port = nets.at(port);
+        }
+        return port;
+    }
+
+    /*!
+     * \brief Checks the rules on \a snapshot.
+     *
+     * This method runs in a worker thread, and only uses the snapshot data.
+     * The ports are first grouped into nets, which are then checked along
+     * with each item.
+     */
+    RuleCheckResult RuleChecker::check(const RuleCheckSnapshot &snapshot)
+    {
+        RuleCheckResult result;
+
+        // Group the ports into nets
+        QVector<int> nets(snapshot.ports.size());
+        for(int i = 0; i < nets.size(); ++i) {
+            nets[i] = i;
+        }
+
+        for(int i = 0; i < snapshot.links.size(); ++i) {
+            int first = findNet(nets, snapshot.links.at(i).first);
+            int second = findNet(nets, snapshot.links.at(i).second);
+            if(first != second) {
+                nets[first] = second;
+            }
+        }
+
+        // Count the ports of components and port symbols in each complete
+        // net, and find a wire of it to show floating nets
+        QHash<int, int> terminals;
+        QHash<int, int> wirePorts;
+        for(int i = 0; i < snapshot.ports.size(); ++i) {
+            const RuleCheckPort &port = snapshot.ports.at(i);
+            if(!port.traversed) {
+                continue;
+            }
+
+            int net = findNet(nets, i);
+            if(snapshot.items.at(port.item).type == GraphicsItem::WireType) {
+                if(!wirePorts.contains(net)) {
+                    wirePorts.insert(net, i);
+                }
+            }
+            else {
+                terminals[net] += 1;
+            }
+        }
+
+        // Check the items
+        foreach(const RuleCheckItem &item, snapshot.items) {
+            result.items << item.item;
+
+            if(item.type == GraphicsItem::WireType) {
+                continue;
+            }
+
+            foreach(int port, item.ports) {
+                if(!snapshot.ports.at(port).connected) {
+                    RuleViolation violation = { item.item, snapshot.ports.at(port).pos,
+                                                tr("Unconnected port") };
+                    result.violations << violation;
+                }
+            }
+
+            if(item.missingModel) {
+                RuleViolation violation = { item.item, QPointF(), tr("Missing spice model") };
+                result.violations << violation;
+            }
+
+            if(item.duplicateLabel) {
+                RuleViolation violation = { item.item, QPointF(),
+                                            tr("Duplicated label %1").arg(item.label) };
+                result.violations << violation;
+            }
+
+            // A port outside the nets followed can't be in the same net
+            // as a port inside them
+            if(item.voltageSource && item.ports.size() == 2) {
+                int first = item.ports.at(0);
+                int second = item.ports.at(1);
+                if(snapshot.ports.at(first).traversed && snapshot.ports.at(second).traversed &&
+                        findNet(nets, first) == findNet(nets, second)) {
+                    RuleViolation violation = { item.item, QPointF(), tr("Shorted voltage source") };
+                    result.violations << violation;
+                }
+            }
+        }
+
+        // Check the nets
+        QHash<int, int>::const_iterator it;
+        for(it = wirePorts.constBegin(); it != wirePorts.constEnd(); ++it) {
+            if(terminals.value(it.key()) < 2) {
+                const RuleCheckPort &port = snapshot.ports.at(it.value());
+                RuleViolation violation = { snapshot.items.at(port.item).item, port.pos,
+                                            tr("Floating net") };
+                result.violations << violation;
+            }
+        }
+
+        return result;
+    }
+
+} // namespace Caneda
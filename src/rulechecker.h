@@ -0,0 +1,195 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#ifndef RULE_CHECKER_H
+#define RULE_CHECKER_H
+
+#include <QFutureWatcher>
+#include <QGraphicsItem>
+#include <QHash>
+#include <QList>
+#include <QMultiHash>
+#include <QObject>
+#include <QPair>
+#include <QPointF>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+// Forward declarations
+class QTimer;
+
+namespace Caneda
+{
+    // Forward declarations
+    class Component;
+    class GraphicsItem;
+    class GraphicsScene;
+
+    //! \brief Port of a RuleCheckSnapshot.
+    struct RuleCheckPort
+    {
+        int item;         //! \brief Index of the item owning the port
+        QPointF pos;      //! \brief Position of the port, in item coordinates
+        bool connected;   //! \brief True if the port is connected to any other port
+        bool traversed;   //! \brief True if the whole net of the port is in the snapshot
+    };
+
+    //! \brief Item of a RuleCheckSnapshot.
+    struct RuleCheckItem
+    {
+        GraphicsItem *item;   //! \brief Item, only used as a key outside the GUI thread
+        int type;             //! \brief Type of the item, see GraphicsItem::type()
+        QString label;        //! \brief Label of the component, if any
+        bool voltageSource;   //! \brief True if the component is a voltage source
+        bool missingModel;    //! \brief True if the component has no spice model
+        bool duplicateLabel;  //! \brief True if other components share the label
+        QList<int> ports;     //! \brief Indexes of the ports of the item
+    };
+
+    /*!
+     * \brief Copy of the region of a schematic to be checked.
+     *
+     * The snapshot holds plain data only, so it can be checked in a worker
+     * thread while the scene is being edited.
+     */
+    struct RuleCheckSnapshot
+    {
+        QList<RuleCheckItem> items;
+        QVector<RuleCheckPort> ports;
+        QList<QPair<int, int> > links;  //! \brief Pairs of ports in the same net
+    };
+
+    //! \brief Violation of an electrical rule, found by RuleChecker.
+    struct RuleViolation
+    {
+        GraphicsItem *item;  //! \brief Item where the violation is shown
+        QPointF pos;         //! \brief Position of the violation, in item coordinates
+        QString message;     //! \brief Description of the violation
+    };
+
+    //! \brief Result of checking a RuleCheckSnapshot.
+    struct RuleCheckResult
+    {
+        QList<GraphicsItem*> items;         //! \brief Items checked
+        QList<RuleViolation> violations;    //! \brief Violations found
+    };
+
+    /*!
+     * \brief Marker shown on a schematic item violating an electrical rule.
+     *
+     * The marker is a child of the item, so it follows the item when moved
+     * and is removed along with it. It keeps its size at every zoom level,
+     * and the violations are described in its tooltip.
+     *
+     * \sa RuleChecker
+     */
+    class RuleMarker : public QGraphicsItem
+    {
+    public:
+        RuleMarker(const QString &message, QGraphicsItem *parent);
+
+        void addMessage(const QString &message);
+
+        QRectF boundingRect() const;
+        void paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
+                   QWidget *widget = 0);
+
+    private:
+        QStringList m_messages;
+    };
+
+    /*!
+     * \brief Electrical rule checker running in the background while a
+     * schematic is edited.
+     *
+     * The following rules are checked:
+     * \li Unconnected ports of components and port symbols.
+     * \li Floating nets: wires connecting less than two ports of components
+     * or port symbols.
+     * \li Shorted voltage sources: both ports of a voltage source in the
+     * same net (only wired connections are considered, not nets joined by
+     * port symbol labels).
+     * \li Duplicated component labels.
+     * \li Components without a spice model.
+     *
+     * The checker is updated incrementally. The same changes of the scene
+     * that invalidate the NetlistCache mark their items dirty (see
+     * markDirty()). Shortly after, the dirty items and the nets they are
+     * connected to are copied into a RuleCheckSnapshot in the GUI thread,
+     * and checked in a worker thread. The markers of the items checked are
+     * then replaced with the violations found. The cost of a check is thus
+     * proportional to the edited region, not to the size of the schematic.
+     *
+     * \sa RuleMarker, NetlistCache
+     */
+    class RuleChecker : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        explicit RuleChecker(GraphicsScene *scene);
+
+        //! \brief Returns true if the checker is running
+        bool isEnabled() const { return m_enabled; }
+        void setEnabled(bool enabled);
+
+        void markDirty(GraphicsItem *item);
+        void removeItem(GraphicsItem *item);
+
+        void setMarkersVisible(bool visible);
+
+    private Q_SLOTS:
+        void startCheck();
+        void applyResult();
+
+    private:
+        RuleCheckSnapshot takeSnapshot();
+        void updateLabel(Component *component, QList<GraphicsItem*> *affected);
+        void clearMarkers(GraphicsItem *item);
+
+        static RuleCheckResult check(const RuleCheckSnapshot &snapshot);
+
+        GraphicsScene *m_scene;
+        bool m_enabled;
+        //! \brief False while the scene is printed or exported
+        bool m_markersVisible;
+
+        //! \brief Items changed since the last check
+        QSet<GraphicsItem*> m_dirtyItems;
+        //! \brief Items checked at least once, and still in the scene
+        QSet<GraphicsItem*> m_items;
+        //! \brief Markers shown on each item
+        QHash<GraphicsItem*, QList<RuleMarker*> > m_markers;
+
+        //! \brief Label of each component, when last checked
+        QHash<GraphicsItem*, QString> m_labels;
+        //! \brief Components using each label
+        QMultiHash<QString, GraphicsItem*> m_labelOwners;
+
+        //! \brief Gathers the changes made in a short time into one check
+        QTimer *m_timer;
+        //! \brief Check running in the worker thread
+        QFutureWatcher<RuleCheckResult> *m_watcher;
+    };
+
+} // namespace Caneda
+
+#endif //RULE_CHECKER_H
@@ -62,7 +62,12 @@ namespace Caneda
         defaultSettings["gui/simulationBackgroundColor"] = QVariant(QColor(Qt::white));
         defaultSettings["gui/lineColor"] = QVariant(QColor(Qt::blue));
         defaultSettings["gui/selectionColor"] = QVariant(QColor(255, 128, 0)); // Dark orange
+        defaultSettings["gui/ruleMarkerColor"] = QVariant(QColor(Qt::red));
         defaultSettings["gui/lineWidth"] = QVariant(int(1));
+        defaultSettings["gui/autoSaveInterval"] = QVariant(int(5));  // Minutes between automatic backups, 0 disables autosave
+        defaultSettings["gui/undoLimit"] = QVariant(int(500));  // Maximum number of undo steps kept per document, 0 means unlimited
+        defaultSettings["gui/lodDetailThreshold"] = QVariant(qreal(0.5));  // Zoom level below which ports and property texts are not drawn
+        defaultSettings["gui/lodSymbolThreshold"] = QVariant(qreal(0.2));  // Zoom level below which components are drawn as boxes
 
         defaultSettings["gui/hdl/keyword"]= QVariant(QVariant(QColor(Qt::black)));
         defaultSettings["gui/hdl/type"]= QVariant(QVariant(QColor(Qt::blue)));
@@ -85,6 +90,10 @@ namespace Caneda
         defaultSettings["sim/simulationEngine"] = QVariant(QString("ngspice"));  //! \todo In the future this could be replaced by an enum, to avoid problems
         defaultSettings["sim/simulationCommand"] = QVariant(QString("ngspice -b -r %filename.raw %filename.net"));
         defaultSettings["sim/outputFormat"] = QVariant(QString("binary"));  //! \todo In the future this could be replaced by an enum, to avoid problems
+        defaultSettings["sim/liveWaveforms"] = QVariant(bool(true));
+        defaultSettings["sim/ngspiceLibrary"] = QVariant(QString("ngspice"));
+        defaultSettings["sim/cacheSize"] = QVariant(int(256));  // Megabytes, 0 disables the simulation cache
+        defaultSettings["sim/ruleCheck"] = QVariant(bool(true));  // Check the electrical rules of the schematics while editing
 
         defaultSettings["shortcuts/fileNew"] = QVariant(QKeySequence(QKeySequence::New));
         defaultSettings["shortcuts/fileOpen"] = QVariant(QKeySequence(QKeySequence::Open));
@@ -122,6 +131,7 @@ namespace Caneda
         defaultSettings["shortcuts/openSymbol"] = QVariant(QKeySequence(tr("F3")));
         defaultSettings["shortcuts/openLayout"] = QVariant(QKeySequence(tr("F4")));
         defaultSettings["shortcuts/simulate"] = QVariant(QKeySequence(QKeySequence::Refresh));
+        defaultSettings["shortcuts/sweep"] = QVariant(QKeySequence(tr("Shift+F5")));
         defaultSettings["shortcuts/openSimulation"] = QVariant(QKeySequence(tr("F6")));
         defaultSettings["shortcuts/openLog"] = QVariant(QKeySequence(tr("F7")));
         defaultSettings["shortcuts/openNetlist"] = QVariant(QKeySequence(tr("F8")));
@@ -19,50 +19,367 @@
 
 #include "sidebarchartsbrowser.h"
 
+#include "chartitem.h"
 #include "chartview.h"
 #include "documentviewmanager.h"
 #include "iview.h"
+#include "spectrumdialog.h"
 
 #include <QHBoxLayout>
+#include <QHash>
 #include <QHeaderView>
 #include <QLabel>
 #include <QLineEdit>
+#include <QMessageBox>
 #include <QPushButton>
-#include <QShortcut>
-#include <QSortFilterProxyModel>
-#include <QTableView>
+#include <QTableWidget>
+#include <QTreeView>
 #include <QVBoxLayout>
+#include <QtConcurrent>
 
 #include <qwt_plot_curve.h>
 
 namespace Caneda
 {
+    //! \brief Maximum number of filter matches to expand automatically.
+    static const int maxExpandedMatches = 500;
+
+    /*!
+     * \brief Returns the name of the circuit element of a waveform.
+     *
+     * Function-like wrappers are removed, for example v(x1.out) or
+     * Mag(v(x1.out)) return x1.out. \a device is set if the waveform
+     * belongs to a device (currents and device parameters) instead of a
+     * node.
+     */
+    static QString elementName(const QString &name, bool *device)
+    {
+        QString inner = name;
+        *device = inner.startsWith('@') || inner.contains("#branch", Qt::CaseInsensitive);
+
+        forever {
+            const int open = inner.indexOf('(');
+            if(open <= 0 || !inner.endsWith(')')) {
+                break;
+            }
+
+            if(inner.left(open).compare("i", Qt::CaseInsensitive) == 0) {
+                *device = true;
+            }
+            inner = inner.mid(open + 1, inner.size() - open - 2);
+        }
+
+        return inner;
+    }
+
+    /*!
+     * \brief Returns true if all the characters of \a pattern appear in
+     * \a name in the same order (case insensitive fuzzy match).
+     *
+     * \a pattern must be in lower case.
+     */
+    static bool fuzzyMatch(const QString &name, const QString &pattern)
+    {
+        int j = 0;
+        for(int i = 0; i < name.size() && j < pattern.size(); ++i) {
+            if(name.at(i).toLower() == pattern.at(j)) {
+                ++j;
+            }
+        }
+
+        return j == pattern.size();
+    }
+
+    //! \brief Builds the hierarchy of the waveforms \a names.
+    static SignalTree* buildSignalTree(const QStringList &names)
+    {
+        SignalTree *tree = new SignalTree;
+        tree->variables = names;
+        tree->leaves.resize(names.size());
+
+        SignalTree::Node root;
+        root.parent = -1;
+        root.variable = -1;
+        tree->nodes.append(root);
+
+        QHash<QPair<int, QString>, int> groups;  // (parent, name) -> group node
+
+        for(int v = 0; v < names.size(); ++v) {
+            bool device = false;
+            QStringList path = elementName(names.at(v), &device).split('.', QString::SkipEmptyParts);
+            path.removeLast();  // The element itself is the leaf
+            path.prepend(device ? QObject::tr("Devices") : QObject::tr("Nodes"));
+
+            int parent = 0;
+            foreach(const QString &group, path) {
+                const QPair<int, QString> key(parent, group);
+                int node = groups.value(key, -1);
+                if(node < 0) {
+                    SignalTree::Node groupNode;
+                    groupNode.name = group;
+                    groupNode.parent = parent;
+                    groupNode.variable = -1;
+
+                    node = tree->nodes.size();
+                    tree->nodes.append(groupNode);
+                    tree->nodes[parent].children.append(node);
+                    groups.insert(key, node);
+                }
+                parent = node;
+            }
+
+            SignalTree::Node leaf;
+            leaf.name = names.at(v);
+            leaf.parent = parent;
+            leaf.variable = v;
+
+            tree->leaves[v] = tree->nodes.size();
+            tree->nodes[parent].children.append(tree->nodes.size());
+            tree->nodes.append(leaf);
+        }
+
+        return tree;
+    }
+
+    /*!
+     * \brief Computes the subset of \a tree matching \a text.
+     *
+     * This function runs in a background thread. If \a text extends the
+     * text of the \a previous filter, only its matches are checked again.
+     */
+    static SignalFilter computeSignalFilter(QSharedPointer<SignalTree> tree,
+                                            const QString &text,
+                                            const SignalFilter &previous)
+    {
+        SignalFilter filter;
+        filter.text = text.toLower();
+
+        const int variables = tree->variables.size();
+        const bool refine = !previous.text.isEmpty() && filter.text.startsWith(previous.text) &&
+                previous.matches.size() == variables;
+
+        filter.matches = QBitArray(variables);
+        for(int v = 0; v < variables; ++v) {
+            if(refine && !previous.matches.testBit(v)) {
+                continue;
+            }
+            if(fuzzyMatch(tree->variables.at(v), filter.text)) {
+                filter.matches.setBit(v);
+                ++filter.count;
+            }
+        }
+
+        // Include the ancestors of the matching waveforms
+        const int size = tree->nodes.size();
+        QBitArray included(size);
+        included.setBit(0);
+        for(int v = 0; v < variables; ++v) {
+            if(filter.matches.testBit(v)) {
+                for(int n = tree->leaves.at(v); !included.testBit(n); n = tree->nodes.at(n).parent) {
+                    included.setBit(n);
+                }
+            }
+        }
+
+        filter.children.resize(size);
+        filter.rows.resize(size);
+        for(int n = 0; n < size; ++n) {
+            foreach(int child, tree->nodes.at(n).children) {
+                if(included.testBit(child)) {
+                    filter.rows[child] = filter.children.at(n).size();
+                    filter.children[n].append(child);
+                }
+            }
+        }
+
+        return filter;
+    }
+
     //*************************************************************
     //******************* SidebarChartsModel **********************
     //*************************************************************
     /*!
      * \brief Constructor.
      *
-     * \param chartSeriesMap ChartSeriesMap which contains waveforms to be set
-     * visible/not-visible.
      * \param parent Parent of this object.
+     */
+    SidebarChartsModel::SidebarChartsModel(QObject *parent) :
+        QAbstractItemModel(parent),
+        m_tree(buildSignalTree(QStringList()))
+    {
+        m_filter = computeSignalFilter(m_tree, QString(), SignalFilter());
+        m_visibleLeaves.fill(0, 1);
+        m_leafCount.fill(0, 1);
+
+        connect(&m_filterWatcher, SIGNAL(finished()), this, SLOT(applyFilter()));
+    }
+
+    /*!
+     * \brief Sets the ChartView whose waveforms are handled by this model.
      *
-     * \sa ChartSeriesMap
+     * The hierarchy is only rebuilt if the view or its number of waveforms
+     * changed, otherwise only the visibility is synchronized.
      */
-    SidebarChartsModel::SidebarChartsModel(ChartSeriesMap chartSeriesMap, QObject *parent) :
-        QAbstractTableModel(parent),
-        m_chartSeriesMap(chartSeriesMap),
-        keys(chartSeriesMap.keys())
+    void SidebarChartsModel::setChartView(ChartView *view)
     {
+        QList<ChartSeries*> curves;
+        if(view) {
+            QwtPlotItemList list = view->itemList(QwtPlotItem::Rtti_PlotCurve);
+            foreach(QwtPlotItem *item, list) {
+                curves << static_cast<ChartSeries*>(item);
+            }
+        }
+
+        if(view == m_chartView && curves == m_curves) {
+            QBitArray visible(curves.size());
+            for(int v = 0; v < curves.size(); ++v) {
+                visible.setBit(v, curves.at(v)->isVisible());
+            }
+            if(visible != m_visible) {
+                setVisibility(visible);
+            }
+            return;
+        }
+
+        beginResetModel();
+
+        m_chartView = view;
+        m_curves = curves;
+
+        QStringList names;
+        foreach(ChartSeries *curve, m_curves) {
+            names << curve->title().text();
+        }
+        m_tree = QSharedPointer<SignalTree>(buildSignalTree(names));
+        m_filter = computeSignalFilter(m_tree, QString(), SignalFilter());
+
+        // Visibility, and the number of visible waveforms of each group
+        m_visible = QBitArray(m_curves.size());
+        m_visibleLeaves.fill(0, m_tree->nodes.size());
+        m_leafCount.fill(0, m_tree->nodes.size());
+
+        for(int v = 0; v < m_curves.size(); ++v) {
+            const bool visible = m_curves.at(v)->isVisible();
+            m_visible.setBit(v, visible);
+
+            for(int n = m_tree->leaves.at(v); n >= 0; n = m_tree->nodes.at(n).parent) {
+                ++m_leafCount[n];
+                if(visible) {
+                    ++m_visibleLeaves[n];
+                }
+            }
+        }
+
+        endResetModel();
+
+        // Apply the current filter to the new hierarchy
+        if(!m_filterText.isEmpty()) {
+            setFilter(m_filterText);
+        }
+    }
+
+    /*!
+     * \brief Shows only the waveforms matching \a text.
+     *
+     * The filter is computed in a background thread, and applied once
+     * finished (see applyFilter()). A new filter text discards the results
+     * of previous ones still running.
+     */
+    void SidebarChartsModel::setFilter(const QString &text)
+    {
+        m_filterText = text;
+
+        if(text.isEmpty()) {
+            beginResetModel();
+            m_filter = computeSignalFilter(m_tree, QString(), SignalFilter());
+            endResetModel();
+            emit filterApplied(m_filter.count);
+            return;
+        }
+
+        m_filterWatcher.setFuture(QtConcurrent::run(computeSignalFilter, m_tree, text, m_filter));
+    }
+
+    //! \brief Applies the results of the background filter.
+    void SidebarChartsModel::applyFilter()
+    {
+        SignalFilter filter = m_filterWatcher.result();
+
+        // Discard results of an outdated filter or hierarchy
+        if(filter.text != m_filterText.toLower() ||
+                filter.matches.size() != m_tree->variables.size()) {
+            return;
+        }
+
+        beginResetModel();
+        m_filter = filter;
+        endResetModel();
+
+        emit filterApplied(m_filter.count);
+    }
+
+    /*!
+     * \brief Sets the visibility of all waveforms at once.
+     *
+     * The plot is replotted only once, after all changes.
+     *
+     * \param visible Visibility of each variable.
+     */
+    void SidebarChartsModel::setVisibility(const QBitArray &visible)
+    {
+        emit layoutAboutToBeChanged();
+
+        for(int v = 0; v < m_curves.size() && v < visible.size(); ++v) {
+            if(m_visible.testBit(v) != visible.testBit(v)) {
+                setVariableVisible(v, visible.testBit(v));
+                m_curves.at(v)->setVisible(visible.testBit(v));
+            }
+        }
+
+        emit layoutChanged();
+
+        if(m_chartView) {
+            m_chartView->scheduleReplot();
+        }
+        emit visibilityChanged();
+    }
+
+    QModelIndex SidebarChartsModel::index(int row, int column, const QModelIndex &parent) const
+    {
+        const int node = parent.isValid() ? static_cast<int>(parent.internalId()) : 0;
+
+        if(column != 0 || row < 0 || row >= m_filter.children.at(node).size()) {
+            return QModelIndex();
+        }
+
+        return createIndex(row, column, m_filter.children.at(node).at(row));
+    }
+
+    QModelIndex SidebarChartsModel::parent(const QModelIndex &index) const
+    {
+        if(!index.isValid()) {
+            return QModelIndex();
+        }
+
+        const int parent = m_tree->nodes.at(static_cast<int>(index.internalId())).parent;
+        return parent > 0 ? indexForNode(parent) : QModelIndex();
+    }
+
+    int SidebarChartsModel::rowCount(const QModelIndex &parent) const
+    {
+        if(parent.column() > 0) {
+            return 0;
+        }
+
+        const int node = parent.isValid() ? static_cast<int>(parent.internalId()) : 0;
+        return m_filter.children.at(node).size();
     }
 
     /*!
      * \brief Returns the data stored for the item referred by index.
      *
-     * This class returns the item data corresponding to index position.
-     * For example, if we are editing an item in the first column, the
-     * data corresponds to the waveform name, hence the return value is
-     * the key of the waveform map in the form of a QString.
+     * The check state of groups is computed from the number of visible
+     * waveforms under them, so it does not depend on their size.
      *
      * \param index Item to return data from
      * \param role Role of the item (editable, checkable, etc).
@@ -70,17 +387,24 @@ namespace Caneda
      */
     QVariant SidebarChartsModel::data(const QModelIndex& index, int role) const
     {
-        if(!index.isValid() || index.row() >= m_chartSeriesMap.size()) {
+        if(!index.isValid()) {
             return QVariant();
         }
 
-        QString key = keys.at(index.row());
+        const int node = static_cast<int>(index.internalId());
+        const SignalTree::Node &item = m_tree->nodes.at(node);
 
-        if(role == Qt::DisplayRole && index.column() == 0) {
-            return key;
+        if(role == Qt::DisplayRole) {
+            return item.name;
         }
-        else if(role == Qt::CheckStateRole && index.column() == 1) {
-            return m_chartSeriesMap[key] ? Qt::Checked : Qt::Unchecked;
+        else if(role == Qt::CheckStateRole) {
+            if(item.variable >= 0) {
+                return m_visible.testBit(item.variable) ? Qt::Checked : Qt::Unchecked;
+            }
+            if(m_visibleLeaves.at(node) == 0) {
+                return Qt::Unchecked;
+            }
+            return m_visibleLeaves.at(node) == m_leafCount.at(node) ? Qt::Checked : Qt::PartiallyChecked;
         }
 
         return QVariant();
@@ -90,29 +414,20 @@ namespace Caneda
      * \brief Returns header data (text) for the given column
      *
      * This method defines column header text to be displayed on the
-     * associated table view.
+     * associated tree view.
      */
     QVariant SidebarChartsModel::headerData(int section, Qt::Orientation o, int role) const
     {
-        if(role != Qt::DisplayRole) {
-            return QVariant();
+        if(role == Qt::DisplayRole && o == Qt::Horizontal && section == 0) {
+            return tr("Waveforms");
         }
 
-        if(o == Qt::Vertical) {
-            return QAbstractTableModel::headerData(section, o, role);
-        }
-        else {
-            switch(section) {
-                case 0: return tr("Name");
-                case 1: return tr("Visible");
-            }
-        }
         return QVariant();
     }
 
     /*!
      * \brief Returns item flags according to its position. These flags
-     * are responsible for the item editable or checkable state.
+     * are responsible for the item checkable state.
      *
      * \param index Item for which its flags must be returned.
      * \return Qt::ItemFlags Item's flags.
@@ -123,48 +438,89 @@ namespace Caneda
             return Qt::ItemIsEnabled;
         }
 
-        Qt::ItemFlags flags = QAbstractTableModel::flags(index);
-
-        // Column 1 is checkable (visibility CheckBox)
-        if(index.column() == 1) {
-            flags |= Qt::ItemIsUserCheckable;
-        }
-        // Column 0 is not editable
-        else {
-            flags |= Qt::ItemIsEnabled;
-        }
-
-        return flags;
+        return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsUserCheckable;
     }
 
     /*!
      * \brief Sets data in a SidebarChartsModel item.
      *
-     * Sets the data in a SidebarChartsModel item, ie. modifies the user
-     * edited data.
+     * Checking a waveform shows it on the plot, drawing only that waveform.
+     * Checking a group shows or hides all its waveforms (matching the
+     * current filter), replotting only once.
      *
      * \param index Item to be edited.
      * \param value New value to be set.
-     * \param role Role of the item. Helps identify what are we editing (editable
-     * item, checkable item, etc).
+     * \param role Role of the item. Only the check state can be edited.
      * \return True on success, false otherwise.
-     *
-     * \sa ChartSeriesMap
      */
     bool SidebarChartsModel::setData(const QModelIndex& index, const QVariant& value,
             int role)
     {
-        if(index.isValid()){
-            // If editing the property visibility, set new visibility
-            if(role == Qt::CheckStateRole && index.column() == 1) {
-                m_chartSeriesMap[keys[index.row()]] = value.toBool();
+        if(!index.isValid() || role != Qt::CheckStateRole) {
+            return false;
+        }
+
+        const int node = static_cast<int>(index.internalId());
+        const bool visible = value.toInt() != Qt::Unchecked;
+        const int variable = m_tree->nodes.at(node).variable;
+
+        if(variable >= 0) {
+            if(m_visible.testBit(variable) == visible) {
+                return true;
             }
 
-            emit dataChanged(index, index);
+            setVariableVisible(variable, visible);
+            if(m_chartView) {
+                m_chartView->setCurveVisible(m_curves.at(variable), visible);
+            }
+
+            // Update the waveform and the tristate check of its groups
+            for(int n = node; n > 0; n = m_tree->nodes.at(n).parent) {
+                QModelIndex changed = indexForNode(n);
+                emit dataChanged(changed, changed);
+            }
+
+            emit visibilityChanged();
             return true;
         }
 
-        return false;
+        // Groups: set all the waveforms under it shown by the filter
+        QBitArray bits = m_visible;
+        QList<int> pending;
+        pending << node;
+        while(!pending.isEmpty()) {
+            const int n = pending.takeLast();
+            const int v = m_tree->nodes.at(n).variable;
+            if(v >= 0) {
+                bits.setBit(v, visible);
+            }
+            pending << m_filter.children.at(n).toList();
+        }
+
+        setVisibility(bits);
+        return true;
+    }
+
+    /*!
+     * \brief Sets the visibility bit of \a variable, updating the counters
+     * of its groups.
+     *
+     * The cost of this method only depends on the depth of the hierarchy.
+     */
+    void SidebarChartsModel::setVariableVisible(int variable, bool visible)
+    {
+        m_visible.setBit(variable, visible);
+
+        const int delta = visible ? 1 : -1;
+        for(int n = m_tree->leaves.at(variable); n >= 0; n = m_tree->nodes.at(n).parent) {
+            m_visibleLeaves[n] += delta;
+        }
+    }
+
+    //! \brief Returns the model index of a node shown by the current filter.
+    QModelIndex SidebarChartsModel::indexForNode(int node) const
+    {
+        return createIndex(m_filter.rows.at(node), 0, node);
     }
 
     //*************************************************************
@@ -189,20 +545,19 @@ namespace Caneda
         m_filterEdit->setPlaceholderText(tr("Search..."));
         layoutTop->addWidget(m_filterEdit);
 
-        // Create proxy model and set its properties.
-        // The model is set in updateWaveformsList().
-        m_proxyModel = new QSortFilterProxyModel(this);
-        m_proxyModel->setDynamicSortFilter(true);
-        m_proxyModel->setSortCaseSensitivity(Qt::CaseInsensitive);
-
-        // Apply table properties and set proxy model
-        m_tableView = new QTableView(this);
-        m_tableView->setModel(m_proxyModel);
-        m_tableView->setSelectionBehavior(QAbstractItemView::SelectRows);
-        m_tableView->setSelectionMode(QAbstractItemView::SingleSelection);
-        m_tableView->setEditTriggers(QAbstractItemView::AnyKeyPressed | QAbstractItemView::DoubleClicked);
-        m_tableView->verticalHeader()->setVisible(false);
-        layoutHorizontal->addWidget(m_tableView);
+        // Create the model. Its contents are set in updateChartSeriesModel().
+        m_model = new SidebarChartsModel(this);
+
+        // Apply tree properties and set the model. Uniform row heights allow
+        // the view to lay out only the visible rows.
+        m_treeView = new QTreeView(this);
+        m_treeView->setModel(m_model);
+        m_treeView->setHeaderHidden(true);
+        m_treeView->setUniformRowHeights(true);
+        m_treeView->setSelectionBehavior(QAbstractItemView::SelectRows);
+        m_treeView->setSelectionMode(QAbstractItemView::SingleSelection);
+        m_treeView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        layoutHorizontal->addWidget(m_treeView);
 
         // Add selection buttons
         QLabel *labelButtons = new QLabel(tr("Select:"), this);
@@ -218,10 +573,41 @@ namespace Caneda
         layoutButtons->addWidget(buttonCurrents);
         layoutButtons->addStretch();
 
+        buttonSpectrum = new QPushButton(tr("Spectrum..."), this);
+        buttonSpectrum->setToolTip(tr("Compute the spectrum of a waveform"));
+        layoutButtons->addWidget(buttonSpectrum);
+
         // Complete the layout of elements
         layoutHorizontal->addLayout(layoutButtons);
         layoutTop->addLayout(layoutHorizontal);
 
+        // Derived traces
+        QHBoxLayout *layoutExpression = new QHBoxLayout();
+        m_expressionEdit = new QLineEdit(this);
+        m_expressionEdit->setClearButtonEnabled(true);
+        m_expressionEdit->setPlaceholderText(tr("Expression, ie: v(out)-v(in)"));
+        m_expressionEdit->setToolTip(tr("Expression over the waveforms, or a component of an ac waveform: "
+                                        "Abs(), UPhase(), GD(), Re() or Im(), ie: Re(v(out))"));
+        buttonExpression = new QPushButton(tr("Plot"), this);
+        layoutExpression->addWidget(m_expressionEdit);
+        layoutExpression->addWidget(buttonExpression);
+        layoutTop->addLayout(layoutExpression);
+
+        // Measurements at the plot cursors
+        m_cursorsLabel = new QLabel(this);
+        m_cursorsLabel->setWordWrap(true);
+        layoutTop->addWidget(m_cursorsLabel);
+
+        m_measurementsTable = new QTableWidget(0, 9, this);
+        m_measurementsTable->setHorizontalHeaderLabels(QStringList() << tr("Waveform")
+                << "A" << "B" << QString::fromUtf8("Δ") << tr("Slope")
+                << tr("Min") << tr("Max") << tr("Avg") << tr("RMS"));
+        m_measurementsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        m_measurementsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+        m_measurementsTable->verticalHeader()->setVisible(false);
+        m_measurementsTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+        layoutTop->addWidget(m_measurementsTable);
+
         // Signals and slots connections
         connect(m_filterEdit, SIGNAL(textChanged(const QString &)),
                 this, SLOT(filterTextChanged()));
@@ -230,155 +616,218 @@ namespace Caneda
         connect(buttonNone, SIGNAL(clicked()), this, SLOT(selectNone()));
         connect(buttonVoltages, SIGNAL(clicked()), this, SLOT(selectVoltages()));
         connect(buttonCurrents, SIGNAL(clicked()), this, SLOT(selectCurrents()));
+        connect(buttonSpectrum, SIGNAL(clicked()), this, SLOT(openSpectrumDialog()));
 
-        connect(m_tableView, SIGNAL(clicked(QModelIndex)), this, SLOT(updateChartView()));
+        connect(m_model, SIGNAL(filterApplied(int)), this, SLOT(filterApplied(int)));
+        connect(m_model, SIGNAL(visibilityChanged()), this, SLOT(updateMeasurements()));
+
+        connect(m_expressionEdit, SIGNAL(returnPressed()), this, SLOT(addDerivedTrace()));
+        connect(buttonExpression, SIGNAL(clicked()), this, SLOT(addDerivedTrace()));
 
         setWindowTitle(tr("Displayed Waveforms"));
     }
 
-    //! \brief Filters properties according to user input on a QLineEdit.
+    //! \brief Filters waveforms according to user input on a QLineEdit.
     void SidebarChartsBrowser::filterTextChanged()
     {
-        QString text = m_filterEdit->text();
-        QRegExp regExp(text, Qt::CaseInsensitive, QRegExp::RegExp);
-        m_proxyModel->setFilterRegExp(regExp);
+        m_model->setFilter(m_filterEdit->text());
     }
 
-    //! \brief Select all available waveforms
-    void SidebarChartsBrowser::selectAll()
+    //! \brief Expands the filter results, if they are not too many.
+    void SidebarChartsBrowser::filterApplied(int matches)
     {
-        m_model->beginResetModel();
-
-        ChartSeriesMap::const_iterator it = m_model->m_chartSeriesMap.begin(),
-            end = m_model->m_chartSeriesMap.end();
-
-        while(it != end) {
-            m_model->m_chartSeriesMap[it.key()] = true;
-            ++it;
+        if(!m_filterEdit->text().isEmpty() && matches <= maxExpandedMatches) {
+            m_treeView->expandAll();
         }
+    }
 
-        m_model->endResetModel();
-
-        updateChartView();
+    //! \brief Select all available waveforms
+    void SidebarChartsBrowser::selectAll()
+    {
+        QBitArray visible(m_model->variableCount(), true);
+        m_model->setVisibility(visible);
     }
 
     //! \brief Deselect all waveforms
     void SidebarChartsBrowser::selectNone()
     {
-        m_model->beginResetModel();
-
-        ChartSeriesMap::const_iterator it = m_model->m_chartSeriesMap.begin(),
-            end = m_model->m_chartSeriesMap.end();
-
-        while(it != end) {
-            m_model->m_chartSeriesMap[it.key()] = false;
-            ++it;
-        }
-
-        m_model->endResetModel();
-
-        updateChartView();
+        QBitArray visible(m_model->variableCount(), false);
+        m_model->setVisibility(visible);
     }
 
     //! \brief Select all available voltage waveforms
     void SidebarChartsBrowser::selectVoltages()
     {
-        m_model->beginResetModel();
-
-        ChartSeriesMap::const_iterator it = m_model->m_chartSeriesMap.begin(),
-            end = m_model->m_chartSeriesMap.end();
-
-        while(it != end) {
-            if(it.key().startsWith("v")) {
-                m_model->m_chartSeriesMap[it.key()] = true;
-            }
-            else {
-                m_model->m_chartSeriesMap[it.key()] = false;
-            }
-
-            ++it;
-        }
-
-        m_model->endResetModel();
-
-        updateChartView();
+        selectByPrefix("v");
     }
 
     //! \brief Select all available current waveforms
     void SidebarChartsBrowser::selectCurrents()
     {
-        m_model->beginResetModel();
-
-        ChartSeriesMap::const_iterator it = m_model->m_chartSeriesMap.begin(),
-            end = m_model->m_chartSeriesMap.end();
-
-        while(it != end) {
-            if(it.key().startsWith("i")) {
-                m_model->m_chartSeriesMap[it.key()] = true;
-            }
-            else {
-                m_model->m_chartSeriesMap[it.key()] = false;
-            }
+        selectByPrefix("i");
+    }
 
-            ++it;
+    //! \brief Select only the waveforms whose name starts with \a prefix
+    void SidebarChartsBrowser::selectByPrefix(const QString &prefix)
+    {
+        QBitArray visible(m_model->variableCount());
+        for(int i = 0; i < visible.size(); ++i) {
+            visible.setBit(i, m_model->variableName(i).startsWith(prefix));
         }
 
-        m_model->endResetModel();
-
-        updateChartView();
+        m_model->setVisibility(visible);
     }
 
     /*!
-     * \brief Update ChartSeries map
+     * \brief Update ChartSeries model
      *
      * This method updates the waveforms list given a ChartView. This is
      * usually used when changing between views to keep the list of available
      * waveforms synchronized with the currently selected chart.
      */
-    void SidebarChartsBrowser::updateChartSeriesMap()
+    void SidebarChartsBrowser::updateChartSeriesModel()
     {
         // Get the current view
         DocumentViewManager *manager = DocumentViewManager::instance();
         ChartView *view = static_cast<ChartView*>(manager->currentView()->toWidget());
 
-        // Populate the waveforms list
-        QwtPlotItemList list = view->itemList(QwtPlotItem::Rtti_PlotCurve);
-        m_chartSeriesMap.clear();
-        for(int i=0; i<list.size(); ++i) {
-            m_chartSeriesMap.insert(list.at(i)->title().text(),
-                                    list.at(i)->isVisible());
+        // Populate the waveforms tree. The same model is reused for all
+        // views, and the hierarchy is only rebuilt when needed.
+        m_model->setChartView(view);
+
+        // Keep the measurements in sync with the cursors of this view
+        connect(view, SIGNAL(cursorsChanged()), this, SLOT(updateMeasurements()),
+                Qt::UniqueConnection);
+        updateMeasurements();
+    }
+
+    /*!
+     * \brief Add a trace derived from the expression entered by the user
+     * to the current view.
+     *
+     * \sa ChartView::addDerivedTrace()
+     */
+    void SidebarChartsBrowser::addDerivedTrace()
+    {
+        const QString expression = m_expressionEdit->text().trimmed();
+        if(expression.isEmpty()) {
+            return;
         }
 
-        // Create a new table model
-        m_model = new SidebarChartsModel(m_chartSeriesMap, this);  //! \todo What happens with the old pointer??? Should we destroy it first?
-        m_proxyModel->setSourceModel(m_model);
+        // Get the current view
+        DocumentViewManager *manager = DocumentViewManager::instance();
+        ChartView *view = static_cast<ChartView*>(manager->currentView()->toWidget());
+
+        QString errorMessage;
+        if(!view->addDerivedTrace(expression, &errorMessage)) {
+            QMessageBox::warning(this, tr("Invalid expression"), errorMessage);
+            return;
+        }
 
-        // Resize the table columns to fit the contents. This must be done
-        // here instead of the constructor because the columns are created
-        // here when filling the model (in the constructor the columns do
-        // not yet exist, resulting in a crash if resized there).
-        m_tableView->horizontalHeader()->setSectionResizeMode(1, QHeaderView::Stretch);
+        m_expressionEdit->clear();
+        updateChartSeriesModel();
     }
 
     /*!
-     * \brief Update chart waveforms visibility (ChartView)
+     * \brief Open the spectrum analysis dialog for the current view.
+     *
+     * The dialog is not modal, allowing to keep working with the waveforms
+     * while the spectrum is computed.
      *
-     * This method updates the chart waveforms visibility according to the
-     * user input.
+     * \sa SpectrumDialog
      */
-    void SidebarChartsBrowser::updateChartView()
+    void SidebarChartsBrowser::openSpectrumDialog()
     {
         // Get the current view
         DocumentViewManager *manager = DocumentViewManager::instance();
         ChartView *view = static_cast<ChartView*>(manager->currentView()->toWidget());
 
-        // Set waveforms visibility
+        SpectrumDialog *dialog = new SpectrumDialog(view, this);
+        dialog->setAttribute(Qt::WA_DeleteOnClose);
+        dialog->show();
+    }
+
+    /*!
+     * \brief Update the measurements at the cursors of the current view.
+     *
+     * Values at each cursor and statistics between cursors are obtained
+     * from the waveform lookup tables, so the cost of an update does not
+     * depend on the number of samples between the cursors. This allows
+     * refreshing the table while the cursors are being dragged.
+     *
+     * \sa ChartSeries::statistics(), ChartView::setCursorPosition()
+     */
+    void SidebarChartsBrowser::updateMeasurements()
+    {
+        // Get the current view
+        DocumentViewManager *manager = DocumentViewManager::instance();
+        IView *currentView = manager->currentView();
+        ChartView *view = currentView ? qobject_cast<ChartView*>(currentView->toWidget()) : 0;
+
+        bool cursorA = view && view->isCursorVisible(ChartView::CursorA);
+        bool cursorB = view && view->isCursorVisible(ChartView::CursorB);
+
+        if(!cursorA && !cursorB) {
+            m_cursorsLabel->setText(tr("Place the cursors with Ctrl + click (A) and Shift + click (B)."));
+            m_measurementsTable->setRowCount(0);
+            return;
+        }
+
+        double xA = view->cursorPosition(ChartView::CursorA);
+        double xB = view->cursorPosition(ChartView::CursorB);
+
+        QString text;
+        if(cursorA) {
+            text += QString("A: %1  ").arg(xA);
+        }
+        if(cursorB) {
+            text += QString("B: %1  ").arg(xB);
+        }
+        if(cursorA && cursorB) {
+            text += QString::fromUtf8("Δ: %1  1/Δ: %2").arg(xB - xA).arg(xB != xA ? 1.0 / (xB - xA) : 0);
+        }
+        m_cursorsLabel->setText(text);
+
+        // Fill one row per visible waveform
         QwtPlotItemList list = view->itemList(QwtPlotItem::Rtti_PlotCurve);
-        for(int i=0; i<list.size(); ++i) {
-            list.at(i)->setVisible(m_model->m_chartSeriesMap[list.at(i)->title().text()]);
+        QList<ChartSeries*> curves;
+        foreach(QwtPlotItem *item, list) {
+            if(item->isVisible()) {
+                curves << static_cast<ChartSeries*>(item);
+            }
         }
 
-        view->replot();
+        m_measurementsTable->setRowCount(curves.size());
+
+        for(int row = 0; row < curves.size(); ++row) {
+            ChartSeries *curve = curves.at(row);
+            QStringList values;
+            values << curve->title().text();
+
+            double vA = curve->valueAt(xA);
+            double vB = curve->valueAt(xB);
+            values << (cursorA ? QString::number(vA) : QString());
+            values << (cursorB ? QString::number(vB) : QString());
+
+            if(cursorA && cursorB) {
+                ChartSeriesStatistics statistics = curve->statistics(xA, xB);
+                values << QString::number(vB - vA);
+                values << (xB != xA ? QString::number((vB - vA) / (xB - xA)) : QString());
+                values << QString::number(statistics.minimum);
+                values << QString::number(statistics.maximum);
+                values << QString::number(statistics.average);
+                values << QString::number(statistics.rms);
+            }
+
+            for(int column = 0; column < m_measurementsTable->columnCount(); ++column) {
+                QTableWidgetItem *cell = m_measurementsTable->item(row, column);
+                if(!cell) {
+                    cell = new QTableWidgetItem;
+                    m_measurementsTable->setItem(row, column, cell);
+                }
+                cell->setText(column < values.size() ? values.at(column) : QString());
+            }
+        }
     }
 
 } // namespace Caneda
@@ -20,55 +20,115 @@
 #ifndef SIDEBAR_CHARTS_BROWSER_H
 #define SIDEBAR_CHARTS_BROWSER_H
 
-#include <QAbstractTableModel>
+#include <QAbstractItemModel>
+#include <QBitArray>
+#include <QFutureWatcher>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
 #include <QWidget>
 
 // Forward declarations.
+class QLabel;
 class QLineEdit;
 class QPushButton;
-class QSortFilterProxyModel;
-class QTableView;
+class QTableWidget;
+class QTreeView;
 
 namespace Caneda
 {
     // Forward declations
+    class ChartSeries;
     class ChartView;
 
-    //! \def ChartSeriesMap This is a typedef to map waveforms with selected status.
-    typedef QMap<QString, bool> ChartSeriesMap;
+    /*!
+     * \brief Hierarchy of the waveforms of a ChartView.
+     *
+     * Waveforms are grouped into nodes and devices, and then by subcircuit
+     * (for example, v(x1.x2.out) is found under Nodes/x1/x2). Each waveform
+     * is identified by its variable id, its position in the list of curves
+     * of the view. Once built, the tree is never modified, so it can be
+     * safely read from other threads.
+     *
+     * \sa SidebarChartsModel
+     */
+    struct SignalTree
+    {
+        //! \brief Node of the tree, either a group or a waveform (leaf)
+        struct Node
+        {
+            QString name;
+            int parent;          //! \brief Parent node, -1 for the root
+            int variable;        //! \brief Variable id for leaves, -1 for groups
+            QVector<int> children;
+        };
+
+        QVector<Node> nodes;     //! \brief All nodes, the root being the first one
+        QStringList variables;   //! \brief Name of each variable
+        QVector<int> leaves;     //! \brief Leaf node of each variable
+    };
+
+    /*!
+     * \brief Subset of a SignalTree matching a filter text.
+     *
+     * \sa SidebarChartsModel::setFilter()
+     */
+    struct SignalFilter
+    {
+        SignalFilter() : count(0) {}
+
+        QString text;                      //! \brief Filter text (lower case)
+        QBitArray matches;                 //! \brief Matching variables
+        QVector<QVector<int> > children;   //! \brief Children shown of each node
+        QVector<int> rows;                 //! \brief Row of each shown node in its parent
+        int count;                         //! \brief Number of matching variables
+    };
 
     /*!
      * \brief Model to provide the abstract interface for waveform items
-     * in a table.
+     * in a tree.
      *
-     * This class derives from QAbstractTableModel and provides the abstract
-     * interface for waveform items in a table model class. While the
+     * This class derives from QAbstractItemModel and provides the abstract
+     * interface for waveform items in a hierarchical model class. While the
      * SidebarChartsBrowser class implements the user interface, this class
      * interacts with the data itself.
      *
-     * This class defines a standard interface that must used to be able to
-     * interoperate with other components in Qt's model/view framework. The
-     * underlying data model is exposed as a simple table of rows and columns.
-     * Each item has a unique index specified by a QModelIndex.
+     * The model is designed to handle views with a very large number of
+     * waveforms (for example, post-layout simulations saving every signal):
+     * \li Items are created on demand by the view, only the nodes of the
+     * SignalTree are kept in memory.
+     * \li The visibility of the waveforms is a bitset indexed by variable
+     * id. Toggling a waveform updates only the counters of its ancestors
+     * (used for the tristate check of the groups) and draws only that
+     * waveform on the plot.
+     * \li Filtering is performed in a background thread, and refines the
+     * previous results when the filter text is extended.
      *
-     * Each item has a number of data elements associated with it and they can
-     * be retrieved by specifying a role (see Qt::ItemDataRole) to the model's
-     * data() function. Data for each role is set using a particular
-     * Qt::ItemDataRole. Data for individual roles are set individually with
-     * setData(). Items can be queried with flags() (see Qt::ItemFlag) to see
-     * if they can be selected, dragged, or manipulated in other ways.
-     *
-     * \sa QAbstractTableModel, SidebarChartsBrowser
+     * \sa SignalTree, SignalFilter, SidebarChartsBrowser
      */
-    class SidebarChartsModel : public QAbstractTableModel
+    class SidebarChartsModel : public QAbstractItemModel
     {
         Q_OBJECT
 
     public:
-        explicit SidebarChartsModel(ChartSeriesMap chartSeriesMap, QObject *parent = 0);
+        explicit SidebarChartsModel(QObject *parent = 0);
+
+        void setChartView(ChartView *view);
+        void setFilter(const QString &text);
+
+        //! \brief Returns the number of variables (waveforms) of the view
+        int variableCount() const { return m_curves.size(); }
+        //! \brief Returns the name of the variable \a id
+        QString variableName(int id) const { return m_tree->variables.at(id); }
+        //! \brief Returns the visibility of each variable
+        QBitArray visibility() const { return m_visible; }
+        void setVisibility(const QBitArray &visible);
 
-        int rowCount(const QModelIndex& = QModelIndex() ) const { return m_chartSeriesMap.size(); }
-        int columnCount(const QModelIndex& = QModelIndex() ) const { return 2; }
+        QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+        QModelIndex parent(const QModelIndex &index) const;
+        int rowCount(const QModelIndex &parent = QModelIndex()) const;
+        int columnCount(const QModelIndex& = QModelIndex()) const { return 1; }
 
         QVariant data(const QModelIndex&, int role) const;
         QVariant headerData(int section, Qt::Orientation o, int role) const;
@@ -76,11 +136,28 @@ namespace Caneda
         Qt::ItemFlags flags(const QModelIndex &index) const;
         bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
 
+    Q_SIGNALS:
+        void filterApplied(int matches);
+        void visibilityChanged();
+
+    private Q_SLOTS:
+        void applyFilter();
+
     private:
-        friend class SidebarChartsBrowser;
+        void setVariableVisible(int variable, bool visible);
+        QModelIndex indexForNode(int node) const;
 
-        ChartSeriesMap m_chartSeriesMap;
-        QList<QString> keys;
+        QPointer<ChartView> m_chartView;
+        QList<ChartSeries*> m_curves;  //! \brief Curve of each variable
+
+        QSharedPointer<SignalTree> m_tree;
+        SignalFilter m_filter;
+        QString m_filterText;
+        QFutureWatcher<SignalFilter> m_filterWatcher;
+
+        QBitArray m_visible;           //! \brief Visibility of each variable
+        QVector<int> m_visibleLeaves;  //! \brief Visible waveforms under each node
+        QVector<int> m_leafCount;      //! \brief Waveforms under each node
     };
 
     /*!
@@ -88,14 +165,15 @@ namespace Caneda
      * ChartView plot.
      *
      * This dialog presents to the user the properties of the selected
-     * simulation plot (ChartView) and the visible waveforms.
+     * simulation plot (ChartView) and the visible waveforms. It also shows
+     * the measurements of the visible waveforms at the plot cursors, and
+     * allows adding traces derived from the existing ones by an expression.
      *
      * This class handles the user interface part of the dialog, and
      * presentation part to the user, while SidebarChartsModel class
      * handles the data interaction itself.
      *
-     * \sa ChartView, ChartSeriesMap, SidebarChartsModel,
-     * QSortFilterProxyModel
+     * \sa ChartView, SidebarChartsModel
      */
     class SidebarChartsBrowser : public QWidget
     {
@@ -104,27 +182,36 @@ namespace Caneda
     public:
         explicit SidebarChartsBrowser(ChartView *parent = 0);
 
-        void updateChartSeriesMap();
+        void updateChartSeriesModel();
 
     private Q_SLOTS:
         void filterTextChanged();
+        void filterApplied(int matches);
 
         void selectAll();
         void selectNone();
         void selectVoltages();
         void selectCurrents();
 
-        void updateChartView();
+        void updateMeasurements();
+        void addDerivedTrace();
+        void openSpectrumDialog();
 
     private:
-        SidebarChartsModel *m_model;
-        QSortFilterProxyModel *m_proxyModel;
-        QTableView *m_tableView;
+        void selectByPrefix(const QString &prefix);
 
-        ChartSeriesMap m_chartSeriesMap;
+        SidebarChartsModel *m_model;
+        QTreeView *m_treeView;
 
         QLineEdit *m_filterEdit;
         QPushButton *buttonAll, *buttonNone, *buttonVoltages, *buttonCurrents;
+        QPushButton *buttonSpectrum;
+
+        QLineEdit *m_expressionEdit;
+        QPushButton *buttonExpression;
+
+        QLabel *m_cursorsLabel;
+        QTableWidget *m_measurementsTable;
     };
 
 } // namespace Caneda
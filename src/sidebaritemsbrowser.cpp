@@ -107,8 +107,8 @@ namespace Caneda
 
         foreach(const QString component, components) {
             ComponentDataPtr data = libItem->component(component);
-            QIcon icon = QIcon(manager->pixmapCache(data->name, data->library));
-            QStandardItem *item = new QStandardItem(icon, data->name);
+            QIcon icon = QIcon(manager->pixmapCache(data.constData()->symbol));
+            QStandardItem *item = new QStandardItem(icon, data.constData()->name);
             libRoot->appendRow(item);
         }
     }
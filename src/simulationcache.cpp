@@ -0,0 +1,270 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#include "simulationcache.h"
+
+#include "settings.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <QTextStream>
+
+namespace Caneda
+{
+    //! \brief Time to wait for the simulator to report its version, in milliseconds
+    static const int versionTimeout = 3000;
+
+    //! \brief Constructor.
+    SimulationCache::SimulationCache()
+    {
+    }
+
+    //! \copydoc MainWindow::instance()
+    SimulationCache* SimulationCache::instance()
+    {
+        static SimulationCache *instance = 0;
+        if (!instance) {
+            instance = new SimulationCache();
+        }
+        return instance;
+    }
+
+    //! \brief Returns true if the results must be cached.
+    bool SimulationCache::isEnabled() const
+    {
+        Settings *settings = Settings::instance();
+        return settings->currentValue("sim/cacheSize").toInt() > 0;
+    }
+
+    /*!
+     * \brief Returns the key of the results of a simulation.
+     *
+     * \param netlist Netlist to be simulated.
+     * \param directory Directory of the netlist, used to find the files
+     * included with relative paths.
+     * \param simulator Description of the simulator used, for example its
+     * command and version.
+     * \return Hash of the inputs of the simulation, in hexadecimal.
+     */
+    QString SimulationCache::key(const QString &netlist, const QString &directory,
+                                 const QString &simulator) const
+    {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(simulator.toUtf8());
+        hash.addData(netlist.toUtf8());
+
+        QSet<QString> visited;
+        addIncludedFiles(&hash, netlist, directory, &visited);
+
+        return QString::fromLatin1(hash.result().toHex());
+    }
+
+    /*!
+     * \brief Returns the version of the simulator invoked by \a command.
+     *
+     * The version of ngspice is asked once per session, waiting at most a
+     * few seconds for it. Other simulators are only identified by their
+     * command.
+     *
+     * \return The version, or a null string if it could not be determined
+     * (for example, if the simulator is not installed). In that case the
+     * results must not be cached, as they could not be told apart from
+     * those of other versions.
+     */
+    QString SimulationCache::simulatorVersion(const QString &command)
+    {
+        const QString program = command.section(' ', 0, 0);
+        if(program != "ngspice") {
+            return program;
+        }
+
+        if(!m_versions.contains(program)) {
+            // Failures are also stored, to avoid waiting for them again
+            QString version;
+
+            QProcess process;
+            process.start(program, QStringList() << "-v");
+            if(process.waitForStarted(versionTimeout) && process.waitForFinished(versionTimeout) &&
+                    process.exitStatus() == QProcess::NormalExit) {
+                version = QString::fromLocal8Bit(process.readAllStandardOutput()).trimmed();
+            }
+            else {
+                process.kill();
+                process.waitForFinished(versionTimeout);
+            }
+
+            m_versions.insert(program, version.isEmpty() ? QString() : version);
+        }
+
+        return m_versions.value(program);
+    }
+
+    /*!
+     * \brief Looks for the results of a simulation.
+     *
+     * The cache is not modified. Once the results are used, the entry
+     * should be marked as the most recently used with markUsed().
+     *
+     * \param key Key of the simulation, as returned by key().
+     * \param rawFile Set to the file with the stored results.
+     * \param duration Set to the time the simulation took, in milliseconds.
+     * \return True if the results were found.
+     */
+    bool SimulationCache::lookup(const QString &key, QString *rawFile, qint64 *duration) const
+    {
+        if(!isEnabled()) {
+            return false;
+        }
+
+        const QString base = cacheDirectory() + "/" + key;
+        QFile info(base + ".info");
+        if(!QFile::exists(base + ".raw") || !info.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            return false;
+        }
+
+        *rawFile = base + ".raw";
+        *duration = info.readLine().trimmed().toLongLong();
+
+        return true;
+    }
+
+    /*!
+     * \brief Marks the entry \a key as the most recently used.
+     *
+     * The information file is rewritten to update its modification time,
+     * used as the last access time when evicting entries.
+     */
+    void SimulationCache::markUsed(const QString &key)
+    {
+        QFile info(cacheDirectory() + "/" + key + ".info");
+        if(!info.open(QIODevice::ReadWrite | QIODevice::Text)) {
+            return;
+        }
+
+        const QByteArray contents = info.readAll();
+        info.resize(0);
+        info.write(contents);
+    }
+
+    /*!
+     * \brief Stores the results of a simulation.
+     *
+     * \param key Key of the simulation, as returned by key().
+     * \param rawFile File with the results, copied to the cache.
+     * \param duration Time the simulation took, in milliseconds.
+     * \return True on success.
+     */
+    bool SimulationCache::insert(const QString &key, const QString &rawFile, qint64 duration)
+    {
+        if(!isEnabled() || !QDir().mkpath(cacheDirectory())) {
+            return false;
+        }
+
+        const QString base = cacheDirectory() + "/" + key;
+        QFile::remove(base + ".raw");
+        if(!QFile::copy(rawFile, base + ".raw")) {
+            return false;
+        }
+
+        QFile info(base + ".info");
+        if(!info.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            QFile::remove(base + ".raw");
+            return false;
+        }
+
+        QTextStream stream(&info);
+        stream << duration << "\n";
+        info.close();
+
+        Settings *settings = Settings::instance();
+        evict(settings->currentValue("sim/cacheSize").toLongLong() * 1024 * 1024);
+
+        return true;
+    }
+
+    /*!
+     * \brief Adds the contents of the files included by a netlist to the
+     * hash.
+     *
+     * Files included with .include and .lib directives are followed
+     * recursively. Missing files are hashed by name only, as the
+     * simulation would fail anyway.
+     */
+    void SimulationCache::addIncludedFiles(QCryptographicHash *hash, const QString &text,
+                                           const QString &directory, QSet<QString> *visited) const
+    {
+        static const QRegularExpression include("^\\s*\\.(?:include|inc|lib)\\s+[\"']?([^\"'\\s]+)",
+                                                QRegularExpression::CaseInsensitiveOption |
+                                                QRegularExpression::MultilineOption);
+
+        QRegularExpressionMatchIterator it = include.globalMatch(text);
+        while(it.hasNext()) {
+            const QString name = it.next().captured(1);
+            const QString fileName = QFileInfo(QDir(directory), name).absoluteFilePath();
+
+            hash->addData(fileName.toUtf8());
+            if(visited->contains(fileName)) {
+                continue;
+            }
+            visited->insert(fileName);
+
+            QFile file(fileName);
+            if(file.open(QIODevice::ReadOnly)) {
+                const QByteArray contents = file.readAll();
+                hash->addData(contents);
+                addIncludedFiles(hash, QString::fromUtf8(contents), QFileInfo(fileName).path(), visited);
+            }
+        }
+    }
+
+    //! \brief Returns the directory where the results are stored.
+    QString SimulationCache::cacheDirectory() const
+    {
+        return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/simulations";
+    }
+
+    /*!
+     * \brief Removes the least recently used entries until the cache size
+     * is below \a maximumSize bytes.
+     */
+    void SimulationCache::evict(qint64 maximumSize)
+    {
+        QDir directory(cacheDirectory());
+        QFileInfoList entries = directory.entryInfoList(QStringList() << "*.info",
+                                                        QDir::Files, QDir::Time);  // Most recent first
+
+        qint64 size = 0;
+        foreach(const QFileInfo &entry, entries) {
+            const QString base = entry.absolutePath() + "/" + entry.completeBaseName();
+            size += entry.size() + QFileInfo(base + ".raw").size();
+
+            if(size > maximumSize) {
+                QFile::remove(base + ".raw");
+                QFile::remove(entry.absoluteFilePath());
+            }
+        }
+    }
+
+} // namespace Caneda
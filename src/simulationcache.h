@@ -0,0 +1,80 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#ifndef SIMULATION_CACHE_H
+#define SIMULATION_CACHE_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+// Forward declarations
+class QCryptographicHash;
+
+namespace Caneda
+{
+    /*!
+     * \brief This class stores the results of previous simulations.
+     *
+     * Results are addressed by a hash of everything that determines them:
+     * the netlist, the contents of the files it includes (models and
+     * libraries), and the simulator used (command and version). If the
+     * schematic did not change since a previous simulation, its stored
+     * results are opened instead of running the simulator again.
+     *
+     * The cache is a directory with a raw file per entry, plus a small
+     * file with the time the simulation took. Entries are evicted in least
+     * recently used order once the cache exceeds the size set in the
+     * sim/cacheSize setting (in megabytes, 0 disables the cache).
+     *
+     * This class is a singleton class and its only static instance (returned
+     * by instance()) is to be used.
+     *
+     * \sa SchematicDocument::simulate()
+     */
+    class SimulationCache
+    {
+    public:
+        static SimulationCache* instance();
+
+        bool isEnabled() const;
+
+        QString key(const QString &netlist, const QString &directory,
+                    const QString &simulator) const;
+        QString simulatorVersion(const QString &command);
+
+        bool lookup(const QString &key, QString *rawFile, qint64 *duration) const;
+        void markUsed(const QString &key);
+        bool insert(const QString &key, const QString &rawFile, qint64 duration);
+
+    private:
+        SimulationCache();
+
+        void addIncludedFiles(QCryptographicHash *hash, const QString &text,
+                              const QString &directory, QSet<QString> *visited) const;
+        QString cacheDirectory() const;
+        void evict(qint64 maximumSize);
+
+        QHash<QString, QString> m_versions;  //! \brief Version of each simulator used, null if unknown
+    };
+
+} // namespace Caneda
+
+#endif //SIMULATION_CACHE_H
@@ -0,0 +1,383 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#include "simulationstream.h"
+
+#include "chartitem.h"
+#include "chartscene.h"
+#include "chartview.h"
+#include "documentviewmanager.h"
+#include "idocument.h"
+#include "iview.h"
+
+#include <QDataStream>
+#include <QFileInfo>
+#include <QTimer>
+
+namespace Caneda
+{
+    //! \brief Interval between checks of the raw file, in milliseconds
+    static const int pollInterval = 100;
+    //! \brief Maximum amount of data read on each check, to keep the interface responsive
+    static const qint64 maxBytesPerPoll = 16 * 1024 * 1024;
+
+    /*!
+     * \brief Constructor.
+     *
+     * \param fileName Raw file written by the simulator.
+     * \param parent Parent of this object.
+     */
+    SimulationStream::SimulationStream(const QString &fileName, QObject *parent) :
+        QObject(parent),
+        m_file(fileName),
+        m_state(WaitingHeader),
+        m_binary(true),
+        m_dataOffset(0),
+        m_countOffset(0),
+        m_pointCount(0),
+        m_pointFill(0)
+    {
+        m_timer = new QTimer(this);
+        m_timer->setInterval(pollInterval);
+        connect(m_timer, SIGNAL(timeout()), this, SLOT(poll()));
+    }
+
+    //! \brief Starts following the raw file.
+    void SimulationStream::start()
+    {
+        m_timer->start();
+    }
+
+    /*!
+     * \brief Reads the rest of the raw file once the simulation finished.
+     *
+     * The lookup tables used by the measurement cursors are built here,
+     * once all the samples are available, and the views are rescaled to
+     * show the complete waveforms.
+     *
+     * \return True if the results are shown in document(), false if they
+     * could not be streamed (and must be loaded as usual).
+     */
+    bool SimulationStream::finish()
+    {
+        m_timer->stop();
+
+        if(m_file.isOpen() || m_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+            if(m_state == WaitingHeader) {
+                readHeader();
+            }
+            while(m_state == Streaming && readData(maxBytesPerPoll)) {
+            }
+            m_file.close();
+        }
+        m_state = Finished;
+
+        if(!m_document) {
+            return false;
+        }
+
+        publish();
+
+        ChartSeries::updateIndexes(m_document->chartScene()->items());
+
+        // The complete file holds the waveforms already shown, so it is
+        // not reloaded, but changes made afterwards are
+        m_document->watchFile(QFileInfo(m_file.fileName()));
+
+        DocumentViewManager *manager = DocumentViewManager::instance();
+        foreach(IView *view, manager->viewsForDocument(m_document)) {
+            ChartView *chartView = qobject_cast<ChartView*>(view->toWidget());
+            if(chartView) {
+                chartView->finishStreaming();
+            }
+        }
+
+        return true;
+    }
+
+    //! \brief Reads the data written since the last check.
+    void SimulationStream::poll()
+    {
+        // The simulator may not have created the file yet
+        if(!m_file.isOpen() && !m_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+            return;
+        }
+
+        if(m_state == WaitingHeader) {
+            readHeader();
+        }
+
+        if(m_state == Streaming) {
+            if(!m_document) {
+                // The document was closed by the user
+                m_state = Finished;
+            }
+            else if(readData(maxBytesPerPoll)) {
+                publish();
+            }
+        }
+
+        if(m_state == Finished) {
+            m_timer->stop();
+        }
+    }
+
+    /*!
+     * \brief Parses the header of the raw file, if it is complete.
+     *
+     * The header is complete once the line starting the data section
+     * (Binary: or Values:) was written. Only the first plot of the file is
+     * streamed.
+     *
+     * \return True if the header was read.
+     */
+    bool SimulationStream::readHeader()
+    {
+        m_file.seek(0);
+        const QByteArray header = m_file.read(m_file.size());
+
+        QStringList names;
+        QStringList types;
+        bool real = true;
+        int position = 0;
+
+        forever {
+            const int newline = header.indexOf('\n', position);
+            if(newline < 0) {
+                return false;  // Wait for the rest of the header
+            }
+
+            const QString line = QString::fromUtf8(header.constData() + position, newline - position);
+            const int lineStart = position;
+            position = newline + 1;
+
+            const QString keyword = line.section(':', 0, 0).toLower();
+
+            if(line.startsWith('\t')) {
+                // Variable definition: number, name and type
+                QStringList tok = line.split("\t", QString::SkipEmptyParts);
+                if(tok.size() >= 3) {
+                    names << tok.at(1);
+                    types << tok.at(2).trimmed();
+                }
+            }
+            else if(keyword == "flags") {
+                real = !line.section(':', 1).toLower().contains("complex");
+            }
+            else if(keyword == "no. points") {
+                m_countOffset = lineStart + line.indexOf(':') + 1;
+            }
+            else if(keyword == "binary" || keyword == "values") {
+                m_binary = (keyword == "binary");
+                m_dataOffset = position;
+                break;
+            }
+        }
+
+        // Complex data is loaded once the simulation finishes
+        if(!real || names.size() < 2) {
+            m_state = Finished;
+            return false;
+        }
+
+        m_names = names;
+        m_types = types;
+        for(int i = 0; i < m_names.size(); ++i) {
+            m_buffers.append(QSharedPointer<ChartSampleBuffer>(new ChartSampleBuffer));
+        }
+        m_point.resize(m_names.size());
+
+        m_state = Streaming;
+        createDocument();
+
+        return true;
+    }
+
+    /*!
+     * \brief Reads up to \a maxBytes of new data from the raw file.
+     *
+     * Only complete points are read, the rest of the data is left for the
+     * next call.
+     *
+     * \return True if any data was read.
+     */
+    bool SimulationStream::readData(qint64 maxBytes)
+    {
+        readPointCount();
+
+        const qint64 available = m_file.size() - m_dataOffset;
+        if(available <= 0) {
+            return false;
+        }
+
+        m_file.seek(m_dataOffset);
+        const QByteArray data = m_file.read(qMin(available, maxBytes));
+
+        const int consumed = m_binary ? readBinaryData(data) : readAsciiData(data);
+        m_dataOffset += consumed;
+
+        // Data after the last point belongs to other plots
+        if(m_pointCount > 0 && m_buffers.first()->size() >= m_pointCount) {
+            m_state = Finished;
+        }
+
+        return consumed > 0;
+    }
+
+    //! \brief Reads complete points of binary data. Returns the bytes used.
+    int SimulationStream::readBinaryData(const QByteArray &data)
+    {
+        const int pointSize = m_buffers.size() * static_cast<int>(sizeof(double));
+        const int points = data.size() / pointSize;
+
+        QDataStream in(data);
+        in.setByteOrder(QDataStream::LittleEndian);  // Use little endian format.
+        in.setFloatingPointPrecision(QDataStream::DoublePrecision);  // Use 64 bit precision.
+
+        for(int i = 0; i < points; ++i) {
+            for(int j = 0; j < m_point.size(); ++j) {
+                in >> m_point[j];
+            }
+            appendPoint(m_point.constData());
+        }
+
+        return points * pointSize;
+    }
+
+    //! \brief Reads complete lines of ascii data. Returns the bytes used.
+    int SimulationStream::readAsciiData(const QByteArray &data)
+    {
+        const int last = data.lastIndexOf('\n');
+        int position = 0;
+
+        while(position <= last) {
+            const int newline = data.indexOf('\n', position);
+            const QByteArray line = data.mid(position, newline - position).trimmed();
+            position = newline + 1;
+
+            if(line.isEmpty()) {
+                continue;
+            }
+
+            // The first value of each point is preceded by the point number
+            m_point[m_pointFill++] = line.mid(line.lastIndexOf('\t') + 1).toDouble();
+            if(m_pointFill == m_point.size()) {
+                appendPoint(m_point.constData());
+                m_pointFill = 0;
+            }
+        }
+
+        return last + 1;
+    }
+
+    //! \brief Appends the values of a point to the buffers of all variables.
+    void SimulationStream::appendPoint(const double *values)
+    {
+        if(m_pointCount > 0 && m_buffers.first()->size() >= m_pointCount) {
+            return;
+        }
+
+        for(int j = 0; j < m_buffers.size(); ++j) {
+            m_buffers[j]->append(values[j]);
+        }
+    }
+
+    /*!
+     * \brief Reads the number of points from the header.
+     *
+     * The simulator writes a placeholder while running, and the actual
+     * number once the plot is complete.
+     */
+    void SimulationStream::readPointCount()
+    {
+        if(m_pointCount > 0 || m_countOffset <= 0) {
+            return;
+        }
+
+        m_file.seek(m_countOffset);
+        const QByteArray text = m_file.read(32);
+        m_pointCount = text.left(text.indexOf('\n')).trimmed().toInt();
+    }
+
+    /*!
+     * \brief Opens a document showing the waveforms being streamed.
+     *
+     * The results of a previous simulation of the same file are replaced in
+     * place, so its views keep their zoom, split state and the visibility
+     * of each waveform.
+     *
+     * \sa SimulationDocument::replaceCurves()
+     */
+    void SimulationStream::createDocument()
+    {
+        // Avoid the first variable, as it is the time base for the rest of
+        // the curves.
+        QList<ChartSeries*> curves;
+        for(int i = 1; i < m_names.size(); ++i) {
+            ChartSeries *curve = new ChartSeries(m_names.at(i));
+            curve->setType(m_types.at(i));
+            curve->setData(new StreamingSeriesData(m_buffers.first(), m_buffers.at(i)));
+            curves << curve;
+        }
+
+        DocumentViewManager *manager = DocumentViewManager::instance();
+
+        SimulationDocument *document =
+                qobject_cast<SimulationDocument*>(manager->documentForFileName(m_file.fileName()));
+        if(document) {
+            document->replaceCurves(curves);
+            m_document = document;
+            return;
+        }
+
+        document = new SimulationDocument;
+        document->setFileName(m_file.fileName());
+        foreach(ChartSeries *curve, curves) {
+            document->chartScene()->addItem(curve);
+        }
+
+        m_document = document;
+        manager->addDocument(document);
+    }
+
+    //! \brief Makes the points read visible, and notifies the views.
+    void SimulationStream::publish()
+    {
+        if(!m_document) {
+            return;
+        }
+
+        foreach(ChartSeries *curve, m_document->chartScene()->items()) {
+            StreamingSeriesData *data = dynamic_cast<StreamingSeriesData*>(curve->data());
+            if(data) {
+                data->update();
+            }
+        }
+
+        DocumentViewManager *manager = DocumentViewManager::instance();
+        foreach(IView *view, manager->viewsForDocument(m_document)) {
+            ChartView *chartView = qobject_cast<ChartView*>(view->toWidget());
+            if(chartView) {
+                chartView->appendSamples();
+            }
+        }
+    }
+
+} // namespace Caneda
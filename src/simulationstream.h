@@ -0,0 +1,113 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#ifndef SIMULATION_STREAM_H
+#define SIMULATION_STREAM_H
+
+#include <QFile>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+
+// Forward declarations
+class QTimer;
+
+namespace Caneda
+{
+    // Forward declarations
+    class ChartSampleBuffer;
+    class SimulationDocument;
+
+    /*!
+     * \brief This class follows the raw file written by a running
+     * simulation, plotting the results while they are being computed.
+     *
+     * Ngspice writes the raw file progressively in batch mode: first the
+     * header (with a placeholder number of points), and then each point as
+     * soon as it is computed. This class polls the file, and once the
+     * header is complete a SimulationDocument is opened with one waveform
+     * per variable. New points are then appended to the waveforms in
+     * batches, once per poll, and the views are notified to draw only the
+     * new samples (see ChartView::appendSamples()).
+     *
+     * Only real data (transient and dc analysis) is streamed. For complex
+     * data (ac analysis) no document is created, and the results are
+     * loaded as usual once the simulation finishes.
+     *
+     * \sa SchematicDocument::simulate(), StreamingSeriesData
+     */
+    class SimulationStream : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        explicit SimulationStream(const QString &fileName, QObject *parent = 0);
+
+        void start();
+        bool finish();
+
+        //! \brief Returns the document showing the results, if created
+        SimulationDocument* document() const { return m_document; }
+
+    private Q_SLOTS:
+        void poll();
+
+    private:
+        //! \brief Progress of the stream
+        enum State {
+            WaitingHeader,  //! \brief The header is not complete yet
+            Streaming,      //! \brief Reading points as they are written
+            Finished        //! \brief All points read, or data not supported
+        };
+
+        bool readHeader();
+        bool readData(qint64 maxBytes);
+        int readBinaryData(const QByteArray &data);
+        int readAsciiData(const QByteArray &data);
+        void appendPoint(const double *values);
+        void readPointCount();
+
+        void createDocument();
+        void publish();
+
+        QFile m_file;
+        QTimer *m_timer;
+        State m_state;
+
+        bool m_binary;          //! \brief Binary or ascii data
+        qint64 m_dataOffset;    //! \brief File position of the next point
+        qint64 m_countOffset;   //! \brief File position of the number of points
+        int m_pointCount;       //! \brief Final number of points, 0 while unknown
+
+        QStringList m_names;    //! \brief Name of each variable
+        QStringList m_types;    //! \brief Type of each variable (voltage, current, etc)
+        QList<QSharedPointer<ChartSampleBuffer> > m_buffers;  //! \brief Samples of each variable
+        QVector<double> m_point;  //! \brief Partially read ascii point
+        int m_pointFill;          //! \brief Values read of the partial point
+
+        QPointer<SimulationDocument> m_document;
+    };
+
+} // namespace Caneda
+
+#endif //SIMULATION_STREAM_H
@@ -0,0 +1,392 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+#include "spectrumanalyzer.h"
+
+#include <QList>
+#include <QPair>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtMath>
+
+#include <complex>
+
+namespace Caneda
+{
+    typedef std::complex<double> Complex;
+
+    //! \brief Minimum FFT size whose stages are split across threads.
+    static const int parallelFftSize = 1 << 16;
+
+    //! \brief Maximum number of harmonics considered in the THD.
+    static const int maxHarmonics = 10;
+
+    /*!
+     * \brief Butterflies of a radix-2 stage.
+     *
+     * The butterflies of a stage are independent of each other, so each
+     * stage is split into ranges of butterflies run in parallel.
+     */
+    struct ButterflyFunctor
+    {
+        typedef void result_type;
+
+        ButterflyFunctor(Complex *data, const Complex *twiddles, int size, int length) :
+            m_data(data), m_twiddles(twiddles), m_size(size), m_length(length) {}
+
+        void operator()(const QPair<int, int> &range) const
+        {
+            const int half = m_length / 2;
+            const int step = m_size / m_length;
+
+            for(int b = range.first; b < range.second; ++b) {
+                const int k = b & (half - 1);
+                const int i = (b - k) * 2 + k;  // (b / half) * m_length + k
+                const int j = i + half;
+
+                const Complex t = m_data[j] * m_twiddles[k * step];
+                m_data[j] = m_data[i] - t;
+                m_data[i] += t;
+            }
+        }
+
+        Complex *m_data;
+        const Complex *m_twiddles;
+        int m_size;
+        int m_length;
+    };
+
+    //! \brief In place radix-2 FFT (without scaling). The size must be a power of two.
+    static void fftRadix2(QVector<Complex> &data, bool inverse)
+    {
+        const int size = data.size();
+        Complex *x = data.data();
+
+        // Bit reversal permutation
+        for(int i = 1, j = 0; i < size; ++i) {
+            int bit = size >> 1;
+            for(; j & bit; bit >>= 1) {
+                j ^= bit;
+            }
+            j ^= bit;
+
+            if(i < j) {
+                std::swap(x[i], x[j]);
+            }
+        }
+
+        QVector<Complex> twiddles(size / 2);
+        const double sign = inverse ? 1.0 : -1.0;
+        for(int k = 0; k < size / 2; ++k) {
+            const double angle = sign * 2 * M_PI * k / size;
+            twiddles[k] = Complex(qCos(angle), qSin(angle));
+        }
+
+        // Split the stages of large transforms into ranges of butterflies
+        QList<QPair<int, int> > ranges;
+        if(size >= parallelFftSize) {
+            const int chunks = 4 * QThread::idealThreadCount();
+            const int chunkSize = (size / 2 + chunks - 1) / chunks;
+            for(int begin = 0; begin < size / 2; begin += chunkSize) {
+                ranges << qMakePair(begin, qMin(begin + chunkSize, size / 2));
+            }
+        }
+
+        for(int length = 2; length <= size; length <<= 1) {
+            ButterflyFunctor stage(x, twiddles.constData(), size, length);
+
+            if(ranges.size() > 1) {
+                QtConcurrent::blockingMap(ranges, stage);
+            }
+            else {
+                stage(qMakePair(0, size / 2));
+            }
+        }
+    }
+
+    /*!
+     * \brief In place forward FFT of any size.
+     *
+     * Sizes other than a power of two are computed with Bluestein's
+     * algorithm, as a convolution of power of two size.
+     */
+    static void fft(QVector<Complex> &data)
+    {
+        const int size = data.size();
+        if((size & (size - 1)) == 0) {
+            fftRadix2(data, false);
+            return;
+        }
+
+        int m = 1;
+        while(m < 2 * size - 1) {
+            m <<= 1;
+        }
+
+        // Chirp exp(-i*pi*k^2/size). The index is reduced modulo 2*size to
+        // keep the precision of the angle for large k.
+        QVector<Complex> chirp(size);
+        for(int k = 0; k < size; ++k) {
+            const qint64 k2 = (static_cast<qint64>(k) * k) % (2 * static_cast<qint64>(size));
+            const double angle = M_PI * k2 / size;
+            chirp[k] = Complex(qCos(angle), -qSin(angle));
+        }
+
+        QVector<Complex> a(m, Complex(0, 0));
+        QVector<Complex> b(m, Complex(0, 0));
+        for(int k = 0; k < size; ++k) {
+            a[k] = data.at(k) * chirp.at(k);
+        }
+        b[0] = std::conj(chirp.at(0));
+        for(int k = 1; k < size; ++k) {
+            b[k] = b[m - k] = std::conj(chirp.at(k));
+        }
+
+        fftRadix2(a, false);
+        fftRadix2(b, false);
+        for(int i = 0; i < m; ++i) {
+            a[i] *= b.at(i);
+        }
+        fftRadix2(a, true);
+
+        for(int k = 0; k < size; ++k) {
+            data[k] = a.at(k) * chirp.at(k) / static_cast<double>(m);
+        }
+    }
+
+    /*!
+     * \brief Power spectrum of one windowed segment of the signal.
+     *
+     * Used to process the segments of Welch's method in parallel.
+     */
+    struct SegmentFunctor
+    {
+        typedef QVector<double> result_type;
+
+        SegmentFunctor(const QVector<double> *signal, const QVector<double> *window) :
+            m_signal(signal), m_window(window) {}
+
+        QVector<double> operator()(int start) const
+        {
+            const int size = m_window->size();
+
+            QVector<Complex> data(size);
+            for(int i = 0; i < size; ++i) {
+                data[i] = Complex(m_signal->at(start + i) * m_window->at(i), 0);
+            }
+
+            fft(data);
+
+            QVector<double> power(size / 2 + 1);
+            for(int k = 0; k < power.size(); ++k) {
+                power[k] = std::norm(data.at(k));
+            }
+
+            return power;
+        }
+
+        const QVector<double> *m_signal;
+        const QVector<double> *m_window;
+    };
+
+    //! \brief Accumulates the power spectra of the segments.
+    static void accumulatePower(QVector<double> &sum, const QVector<double> &power)
+    {
+        if(sum.isEmpty()) {
+            sum = power;
+            return;
+        }
+
+        for(int k = 0; k < sum.size(); ++k) {
+            sum[k] += power.at(k);
+        }
+    }
+
+    //! \brief Converts a power ratio to dB, avoiding infinite values.
+    static double powerToDb(double numerator, double denominator)
+    {
+        return 10 * log10(qMax(numerator, 1e-300) / qMax(denominator, 1e-300));
+    }
+
+    /*!
+     * \brief Starts the analysis of a waveform in a worker thread.
+     *
+     * The arguments are implicitly shared copies, so the waveform may be
+     * modified or deleted while the analysis runs.
+     *
+     * \sa analyze()
+     */
+    QFuture<SpectrumResult> SpectrumAnalyzer::run(const QVector<double> &time,
+                                                  const QVector<double> &values,
+                                                  Window window, int fftSize, int segments)
+    {
+        return QtConcurrent::run(SpectrumAnalyzer::analyze, time, values, window, fftSize, segments);
+    }
+
+    /*!
+     * \brief Computes the spectrum of a waveform.
+     *
+     * \param time Time base of the waveform (monotonic, maybe not uniform).
+     * \param values Values of the waveform.
+     * \param window Window applied to each segment.
+     * \param fftSize Number of points of each segment (any size).
+     * \param segments Number of segments averaged (Welch's method). The
+     * segments overlap by half their size, and the whole waveform is
+     * resampled to fit them.
+     * \return Spectrum and distortion figures. The result is empty if the
+     * arguments are not valid.
+     */
+    SpectrumResult SpectrumAnalyzer::analyze(const QVector<double> &time,
+                                             const QVector<double> &values,
+                                             Window window, int fftSize, int segments)
+    {
+        SpectrumResult result;
+
+        const int size = qMin(time.size(), values.size());
+        if(size < 2 || fftSize < 8 || segments < 1) {
+            return result;
+        }
+
+        const int hop = fftSize / 2;
+        const int total = fftSize + (segments - 1) * hop;
+        const double t0 = time.first();
+        const double dt = (time.at(size - 1) - t0) / (total - 1);
+        if(dt <= 0) {
+            return result;
+        }
+
+        // Uniform resampling by linear interpolation
+        QVector<double> signal(total);
+        for(int i = 0, j = 1; i < total; ++i) {
+            const double t = t0 + i * dt;
+            while(j < size - 1 && time.at(j) < t) {
+                ++j;
+            }
+
+            const double span = time.at(j) - time.at(j - 1);
+            const double ratio = span > 0 ? qBound(0.0, (t - time.at(j - 1)) / span, 1.0) : 1.0;
+            signal[i] = values.at(j - 1) + (values.at(j) - values.at(j - 1)) * ratio;
+        }
+
+        // Window coefficients, and main lobe half width in bins
+        QVector<double> coefficients(fftSize);
+        int lobe = 1;
+        double gain = 0;
+        for(int i = 0; i < fftSize; ++i) {
+            const double phase = 2 * M_PI * i / fftSize;
+            switch(window) {
+            case Hann:
+                coefficients[i] = 0.5 - 0.5 * qCos(phase);
+                lobe = 2;
+                break;
+            case BlackmanHarris:
+                coefficients[i] = 0.35875 - 0.48829 * qCos(phase) +
+                                  0.14128 * qCos(2 * phase) - 0.01168 * qCos(3 * phase);
+                lobe = 4;
+                break;
+            default:
+                coefficients[i] = 1;
+                lobe = 1;
+                break;
+            }
+            gain += coefficients.at(i);
+        }
+
+        // Average the power spectra of all segments, in parallel
+        QList<int> starts;
+        for(int s = 0; s < segments; ++s) {
+            starts << s * hop;
+        }
+
+        QVector<double> power = QtConcurrent::blockingMappedReduced<QVector<double> >(
+                    starts, SegmentFunctor(&signal, &coefficients), accumulatePower);
+
+        const int bins = power.size();
+        for(int k = 0; k < bins; ++k) {
+            power[k] /= segments;
+        }
+
+        // One sided amplitude spectrum, corrected by the window gain
+        const double df = 1.0 / (fftSize * dt);
+        result.frequency.resize(bins - 1);
+        result.magnitude.resize(bins - 1);
+        for(int k = 1; k < bins; ++k) {
+            const double amplitude = 2 * qSqrt(power.at(k)) / gain;
+            result.frequency[k - 1] = k * df;
+            result.magnitude[k - 1] = 20 * log10(qMax(amplitude, 1e-15));
+        }
+
+        // Fundamental: highest bin outside the DC lobe
+        int peak = -1;
+        for(int k = lobe + 1; k < bins; ++k) {
+            if(peak < 0 || power.at(k) > power.at(peak)) {
+                peak = k;
+            }
+        }
+        if(peak < 0) {
+            return result;
+        }
+
+        // Power in the main lobe of the DC, fundamental and harmonic bins
+        QVector<bool> used(bins, false);
+        for(int k = 0; k <= lobe && k < bins; ++k) {
+            used[k] = true;
+        }
+
+        double fundamentalPower = 0;
+        for(int k = qMax(0, peak - lobe); k <= qMin(bins - 1, peak + lobe); ++k) {
+            fundamentalPower += power.at(k);
+            used[k] = true;
+        }
+
+        double harmonicPower = 0;
+        for(int h = 2; h <= maxHarmonics && h * peak < bins; ++h) {
+            const int center = h * peak;
+            for(int k = qMax(0, center - lobe); k <= qMin(bins - 1, center + lobe); ++k) {
+                if(!used.at(k)) {
+                    harmonicPower += power.at(k);
+                    used[k] = true;
+                }
+            }
+        }
+
+        // Noise is what remains; spurs are any bin outside the DC and
+        // fundamental lobes (harmonics included).
+        double noisePower = 0;
+        double spur = 0;
+        for(int k = lobe + 1; k < bins; ++k) {
+            if(!used.at(k)) {
+                noisePower += power.at(k);
+            }
+            if(qAbs(k - peak) > lobe) {
+                spur = qMax(spur, power.at(k));
+            }
+        }
+
+        result.fundamental = peak * df;
+        result.thd = powerToDb(harmonicPower, fundamentalPower);
+        result.thdPercent = 100 * qSqrt(harmonicPower / qMax(fundamentalPower, 1e-300));
+        result.snr = powerToDb(fundamentalPower, noisePower);
+        result.sinad = powerToDb(fundamentalPower, noisePower + harmonicPower);
+        result.sfdr = powerToDb(power.at(peak), spur);
+
+        return result;
+    }
+
+} // namespace Caneda
@@ -0,0 +1,86 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+#ifndef SPECTRUM_ANALYZER_H
+#define SPECTRUM_ANALYZER_H
+
+#include <QFuture>
+#include <QVector>
+
+namespace Caneda
+{
+    /*!
+     * \brief Spectrum of a waveform and its distortion figures.
+     *
+     * \sa SpectrumAnalyzer
+     */
+    struct SpectrumResult
+    {
+        SpectrumResult() :
+            fundamental(0), thd(0), thdPercent(0), snr(0), sinad(0), sfdr(0) {}
+
+        QVector<double> frequency;  //! \brief Frequency of each bin [Hz], without DC
+        QVector<double> magnitude;  //! \brief Amplitude of each bin [dB]
+
+        double fundamental;  //! \brief Frequency of the fundamental [Hz]
+        double thd;          //! \brief Total harmonic distortion [dB]
+        double thdPercent;   //! \brief Total harmonic distortion [%]
+        double snr;          //! \brief Signal to noise ratio, harmonics excluded [dB]
+        double sinad;        //! \brief Signal to noise and distortion ratio [dB]
+        double sfdr;         //! \brief Spurious free dynamic range [dBc]
+    };
+
+    /*!
+     * \brief This class computes the spectrum of transient waveforms.
+     *
+     * Simulators use variable time steps, so the waveform is first linearly
+     * resampled on a uniform time base. The resampled record is then split
+     * into segments of the FFT size, overlapped by 50% (Welch's method),
+     * which are windowed and transformed in parallel. The averaged power
+     * spectrum is used to find the fundamental and compute the THD, SNR,
+     * SINAD and SFDR figures.
+     *
+     * The FFT supports any size: powers of two use an iterative radix-2
+     * transform (whose stages are split across threads for large sizes),
+     * other sizes use Bluestein's algorithm on top of it.
+     *
+     * \sa SpectrumResult, SpectrumDialog
+     */
+    class SpectrumAnalyzer
+    {
+    public:
+        //! \brief Window functions applied to each segment
+        enum Window {
+            Rectangular = 0,
+            Hann,
+            BlackmanHarris
+        };
+
+        static QFuture<SpectrumResult> run(const QVector<double> &time,
+                                           const QVector<double> &values,
+                                           Window window, int fftSize, int segments);
+
+        static SpectrumResult analyze(const QVector<double> &time,
+                                      const QVector<double> &values,
+                                      Window window, int fftSize, int segments);
+    };
+
+} // namespace Caneda
+
+#endif //SPECTRUM_ANALYZER_H
@@ -21,6 +21,7 @@
 #include "statehandler.h"
 
 #include "actionmanager.h"
+#include "clipboarddata.h"
 #include "documentviewmanager.h"
 #include "graphicsscene.h"
 #include "graphicsview.h"
@@ -28,8 +29,6 @@
 #include "library.h"
 #include "painting.h"
 #include "portsymbol.h"
-#include "wire.h"
-#include "xmlutilities.h"
 
 #include <QApplication>
 #include <QClipboard>
@@ -248,63 +247,13 @@ namespace Caneda
     /*!
      * \brief This method handles the paste action by reading the clipboard and
      * inserting (if found) the corresponding items.
+     *
+     * \sa ClipboardData::items()
      */
     void StateHandler::paste()
     {
         QClipboard *clipboard =  QApplication::clipboard();
-        const QString text = clipboard->text();
-
-        Caneda::XmlReader reader(text.toUtf8());
-
-        while(!reader.atEnd()) {
-            reader.readNext();
-
-            if(reader.isStartElement() && reader.name() == "caneda") {
-                break;
-            }
-        }
-
-        if(reader.hasError() || !(reader.isStartElement() && reader.name() == "caneda")) {
-            return;
-        }
-
-        if(!Caneda::checkVersion(reader.attributes().value("version").toString())) {
-            return;
-        }
-
-        QList<GraphicsItem*> items;
-        while(!reader.atEnd()) {
-            reader.readNext();
-
-            if(reader.isEndElement()) {
-                break;
-            }
-
-            if(reader.isStartElement()) {
-                GraphicsItem *readItem = 0;
-                if(reader.name() == "component") {
-                    readItem = new Component();
-                    readItem->loadData(&reader);
-                }
-                else if(reader.name() == "wire") {
-                    readItem = new Wire(QPointF(10,10), QPointF(50,50));
-                    readItem->loadData(&reader);
-                }
-                else if(reader.name() == "painting") {
-                    QString name = reader.attributes().value("name").toString();
-                    readItem = Painting::fromName(name);
-                    readItem->loadData(&reader);
-                }
-                else if(reader.name() == "port") {
-                    readItem = new PortSymbol();
-                    readItem->loadData(&reader);
-                }
-
-                if(readItem) {
-                    items << readItem;
-                }
-            }
-        }
+        QList<GraphicsItem*> items = ClipboardData::items(clipboard->mimeData());
 
         if (!items.isEmpty()) {
             clearInsertibles();
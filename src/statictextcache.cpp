@@ -0,0 +1,100 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#include "statictextcache.h"
+
+#include <QFont>
+#include <QPainter>
+#include <QPointF>
+#include <QTransform>
+
+namespace Caneda
+{
+    //! \brief Maximum number of text layouts kept in the cache.
+    static const int maxCachedTexts = 4096;
+
+    //! \brief Constructor.
+    StaticTextCache::StaticTextCache() :
+        m_texts(maxCachedTexts)
+    {
+    }
+
+    //! \copydoc MainWindow::instance()
+    StaticTextCache* StaticTextCache::instance()
+    {
+        static StaticTextCache *instance = 0;
+        if (!instance) {
+            instance = new StaticTextCache();
+        }
+        return instance;
+    }
+
+    /*!
+     * \brief Draws \a text with \a font at \a topLeft, reusing its layout
+     * if available.
+     *
+     * The text is drawn with the current pen of the painter. Newline
+     * characters ('\n') break the text into multiple lines.
+     *
+     * \param painter Painter used to draw the text.
+     * \param topLeft Top left corner of the text, in item coordinates.
+     * \param text Text to be drawn.
+     * \param font Font used to lay out the text.
+     */
+    void StaticTextCache::drawText(QPainter *painter, const QPointF &topLeft,
+                                   const QString &text, const QFont &font)
+    {
+        if(text.isEmpty()) {
+            return;
+        }
+
+        // Translations do not change the layout, so they are left out
+        const QTransform &world = painter->worldTransform();
+        StaticTextKey key;
+        key.text = text;
+        key.font = font;
+        key.m11 = world.m11();
+        key.m12 = world.m12();
+        key.m21 = world.m21();
+        key.m22 = world.m22();
+
+        QStaticText *staticText = m_texts.object(key);
+        if(!staticText) {
+            QString layoutText = text;
+            layoutText.replace(QLatin1Char('\n'), QChar::LineSeparator);
+
+            staticText = new QStaticText(layoutText);
+            staticText->setTextFormat(Qt::PlainText);
+            staticText->setPerformanceHint(QStaticText::AggressiveCaching);
+            staticText->prepare(QTransform(key.m11, key.m12, key.m21, key.m22, 0, 0), font);
+            m_texts.insert(key, staticText);
+        }
+
+        painter->setFont(font);
+        painter->drawStaticText(topLeft, *staticText);
+    }
+
+    //! \brief Discards all the cached text layouts.
+    void StaticTextCache::clear()
+    {
+        m_texts.clear();
+    }
+
+} // namespace Caneda
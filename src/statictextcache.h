@@ -0,0 +1,98 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#ifndef STATIC_TEXT_CACHE_H
+#define STATIC_TEXT_CACHE_H
+
+#include <QCache>
+#include <QFont>
+#include <QHash>
+#include <QStaticText>
+
+// Forward declarations
+class QPainter;
+class QPointF;
+
+namespace Caneda
+{
+    /*!
+     * \brief Key of a text layout in the StaticTextCache.
+     *
+     * Holds the text, the font and the linear part of the painter transform
+     * (translations do not change the layout) of a cached layout.
+     */
+    struct StaticTextKey
+    {
+        QString text;
+        QFont font;
+        qreal m11, m12, m21, m22;
+
+        bool operator==(const StaticTextKey &other) const
+        {
+            return m11 == other.m11 && m12 == other.m12 &&
+                    m21 == other.m21 && m22 == other.m22 &&
+                    text == other.text && font == other.font;
+        }
+    };
+
+    //! \brief Returns the hash of \a key, used by the StaticTextCache.
+    inline uint qHash(const StaticTextKey &key, uint seed = 0)
+    {
+        return ::qHash(key.text, seed) ^ ::qHash(key.font, seed) ^
+                ::qHash(key.m11, seed) ^ ::qHash(key.m12 * 3, seed) ^
+                ::qHash(key.m21 * 5, seed) ^ ::qHash(key.m22 * 7, seed);
+    }
+
+    /*!
+     * \brief Shared cache of laid out text used to draw labels on a scene.
+     *
+     * Laying out text is one of the most expensive parts of painting a
+     * dense schematic. This class keeps the layout of the most recently
+     * drawn strings as QStaticText objects, keyed by the string, the font
+     * and the transform class (the painter transform without translation),
+     * so that panning a view reuses the layouts and only new strings or zoom
+     * levels pay for the layout. The number of cached layouts is bounded,
+     * the least recently used being discarded first.
+     *
+     * This class is a singleton class and its only static instance (returned
+     * by instance()) is to be used.
+     *
+     * \sa PropertyDisplay, GraphicText
+     */
+    class StaticTextCache
+    {
+    public:
+        static StaticTextCache* instance();
+
+        void drawText(QPainter *painter, const QPointF &topLeft,
+                      const QString &text, const QFont &font);
+
+        void clear();
+
+    private:
+        StaticTextCache();
+
+        //! Cached text layouts.
+        QCache<StaticTextKey, QStaticText> m_texts;
+    };
+
+} // namespace Caneda
+
+#endif //STATIC_TEXT_CACHE_H
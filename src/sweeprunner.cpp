@@ -0,0 +1,717 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#include "sweeprunner.h"
+
+#include "chartitem.h"
+#include "chartscene.h"
+#include "component.h"
+#include "fileformats.h"
+#include "graphicsscene.h"
+#include "idocument.h"
+#include "ngspiceshared.h"
+#include "settings.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <QThread>
+#include <QtConcurrent>
+
+#include <qmath.h>
+#include <qnumeric.h>
+
+namespace Caneda
+{
+    //! \brief Maximum number of runs of a sweep
+    static const int maxRuns = 10000;
+    //! \brief Number of min/max pairs kept of each overlaid waveform
+    static const int overlayBuckets = 1000;
+
+    /*************************************************************************
+     *                            NetlistTemplate                            *
+     *************************************************************************/
+    //! \brief Constructor.
+    NetlistTemplate::NetlistTemplate() :
+        m_size(0)
+    {
+    }
+
+    /*!
+     * \brief Splits a netlist at the placeholders of the parameters.
+     *
+     * \param netlist Netlist generated with placeholder() as the value of
+     * each swept property.
+     * \param parameters Number of swept properties.
+     * \return True if every parameter is used in the netlist.
+     */
+    bool NetlistTemplate::compile(const QString &netlist, int parameters)
+    {
+        m_pieces.clear();
+        m_slots.clear();
+        m_size = 0;
+
+        QVector<bool> used(parameters, false);
+
+        QRegularExpression re("__caneda_sweep_(\\d+)__");
+        QRegularExpressionMatchIterator it = re.globalMatch(netlist);
+        int position = 0;
+        while(it.hasNext()) {
+            QRegularExpressionMatch match = it.next();
+            const int parameter = match.captured(1).toInt();
+            if(parameter >= parameters) {
+                continue;
+            }
+
+            m_pieces << netlist.mid(position, match.capturedStart() - position);
+            m_slots << parameter;
+            m_size += m_pieces.last().size();
+            used[parameter] = true;
+
+            position = match.capturedEnd();
+        }
+        m_pieces << netlist.mid(position);
+        m_size += m_pieces.last().size();
+
+        return !used.contains(false);
+    }
+
+    //! \brief Returns the netlist with the \a values of the parameters.
+    QString NetlistTemplate::instantiate(const QStringList &values) const
+    {
+        QString netlist;
+        netlist.reserve(m_size + m_slots.size() * 16);
+
+        for(int i = 0; i < m_slots.size(); ++i) {
+            netlist += m_pieces.at(i);
+            netlist += values.at(m_slots.at(i));
+        }
+        netlist += m_pieces.last();
+
+        return netlist;
+    }
+
+    /*!
+     * \brief Returns the text used as the value of the swept \a parameter
+     * while generating the netlist.
+     *
+     * Only word characters are used, so that the placeholder is kept by all
+     * the rules of the models (see FormatSpice::generateNetlist()).
+     */
+    QString NetlistTemplate::placeholder(int parameter)
+    {
+        return QString("__caneda_sweep_%1__").arg(parameter);
+    }
+
+    /*************************************************************************
+     *                          Results of each run                          *
+     *************************************************************************/
+    //! \brief Returns the index of the variable \a name, or -1 if not found.
+    static int variableIndex(const SimulationResults &results, const QString &name)
+    {
+        for(int i = 1; i < results.names.size(); ++i) {
+            if(results.names.at(i).compare(name, Qt::CaseInsensitive) == 0) {
+                return i;
+            }
+        }
+
+        return -1;
+    }
+
+    /*!
+     * \brief Keeps the minimum and maximum of each bucket of samples.
+     *
+     * The envelope of the waveform is preserved, so overlaying hundreds of
+     * runs costs a few thousand points per run regardless of the length of
+     * the simulation.
+     */
+    static void decimate(const QVector<double> &x, const QVector<double> &y,
+                         QVector<double> *outX, QVector<double> *outY)
+    {
+        const int n = x.size();
+        if(n <= 4 * overlayBuckets) {
+            *outX = x;
+            *outY = y;
+            return;
+        }
+
+        outX->reserve(2 * overlayBuckets);
+        outY->reserve(2 * overlayBuckets);
+
+        for(int b = 0; b < overlayBuckets; ++b) {
+            const int first = static_cast<int>(qint64(b) * n / overlayBuckets);
+            const int last = static_cast<int>(qint64(b + 1) * n / overlayBuckets);
+
+            int minimum = first;
+            int maximum = first;
+            for(int i = first + 1; i < last; ++i) {
+                if(y.at(i) < y.at(minimum)) {
+                    minimum = i;
+                }
+                if(y.at(i) > y.at(maximum)) {
+                    maximum = i;
+                }
+            }
+
+            // Keep the order of the samples
+            const int a = qMin(minimum, maximum);
+            const int c = qMax(minimum, maximum);
+            *outX << x.at(a);
+            *outY << y.at(a);
+            if(c != a) {
+                *outX << x.at(c);
+                *outY << y.at(c);
+            }
+        }
+    }
+
+    //! \brief Returns the \a measurement of a waveform.
+    static double measure(const QVector<double> &x, const QVector<double> &y,
+                          SweepRunner::Measurement measurement)
+    {
+        if(y.isEmpty()) {
+            return qQNaN();
+        }
+
+        double minimum = y.first();
+        double maximum = y.first();
+        double integral = 0;
+        double integralSquares = 0;
+
+        for(int i = 1; i < y.size(); ++i) {
+            minimum = qMin(minimum, y.at(i));
+            maximum = qMax(maximum, y.at(i));
+
+            // Trapezoidal rule, as the time step is variable
+            const double dx = x.at(i) - x.at(i-1);
+            integral += 0.5 * dx * (y.at(i) + y.at(i-1));
+            integralSquares += 0.5 * dx * (y.at(i) * y.at(i) + y.at(i-1) * y.at(i-1));
+        }
+
+        const double span = x.last() - x.first();
+
+        switch(measurement) {
+            case SweepRunner::Maximum:
+                return maximum;
+            case SweepRunner::Minimum:
+                return minimum;
+            case SweepRunner::PeakToPeak:
+                return maximum - minimum;
+            case SweepRunner::Average:
+                return span > 0 ? integral / span : y.first();
+            case SweepRunner::Rms:
+                return span > 0 ? qSqrt(integralSquares / span) : qAbs(y.first());
+            case SweepRunner::FinalValue:
+                return y.last();
+        }
+
+        return qQNaN();
+    }
+
+    /*!
+     * \brief Reads, decimates and measures the results of a run (in a
+     * background thread).
+     *
+     * The magnitude in dB of complex (ac) waveforms is used. Only the
+     * decimated waveforms and the measurements are kept, the complete
+     * results and the raw file are dropped once read.
+     */
+    static SweepRun loadRun(const QString &rawFile, const QStringList &outputs,
+                            SweepRunner::Measurement measurement)
+    {
+        SweepRun run;
+        SimulationResults results;
+
+        if(!NgspiceShared::readRawFile(rawFile, &results) || results.real.first()->size() == 0) {
+            run.errorMessage = results.errorMessage;
+            if(run.errorMessage.isEmpty()) {
+                run.errorMessage = QObject::tr("The simulation produced no results");
+            }
+            return run;
+        }
+        QFile::remove(rawFile);
+
+        const QVector<double> x = results.real.first()->toVector();
+
+        foreach(const QString &output, outputs) {
+            QVector<double> y;
+            QString type;
+            const int index = variableIndex(results, output);
+
+            if(index >= 0) {
+                y = results.real.at(index)->toVector();
+                type = results.types.at(index);
+                if(results.complex) {
+                    const QVector<double> imaginary = results.imaginary.at(index)->toVector();
+                    for(int i = 0; i < y.size(); ++i) {
+                        y[i] = 20.0 * log10(qSqrt(y.at(i) * y.at(i) + imaginary.at(i) * imaginary.at(i)));
+                    }
+                    type = "magnitude";
+                }
+            }
+
+            QVector<double> overlayX, overlayY;
+            if(!y.isEmpty()) {
+                decimate(x, y, &overlayX, &overlayY);
+            }
+
+            run.types << type;
+            run.overlayX << overlayX;
+            run.overlayY << overlayY;
+            run.measurements << measure(x, y, measurement);
+        }
+
+        return run;
+    }
+
+    /*************************************************************************
+     *                              SweepRunner                              *
+     *************************************************************************/
+    /*!
+     * \brief Constructor.
+     *
+     * \param document Schematic to be simulated.
+     * \param parent Parent of this object.
+     */
+    SweepRunner::SweepRunner(SchematicDocument *document, QObject *parent) :
+        QObject(parent),
+        m_document(document),
+        m_measurement(Maximum),
+        m_nextRun(0),
+        m_activeCount(0),
+        m_finishedCount(0),
+        m_running(false)
+    {
+    }
+
+    //! \brief Destructor.
+    SweepRunner::~SweepRunner()
+    {
+        cancel();
+    }
+
+    /*!
+     * \brief Compiles the netlist template and computes the values of each
+     * run.
+     *
+     * \param parameters Properties to be varied.
+     * \param monteCarloRuns Number of runs for each point of the sweeps,
+     * if any of the parameters has a random distribution.
+     * \param errorMessage Description of the error, if any.
+     * \return True on success, false otherwise.
+     */
+    bool SweepRunner::prepare(const QList<SweepParameter> &parameters, int monteCarloRuns,
+                              QString *errorMessage)
+    {
+        m_runs.clear();
+        m_parameters = parameters;
+
+        if(!m_document) {
+            return false;
+        }
+
+        if(parameters.isEmpty()) {
+            if(errorMessage) {
+                *errorMessage = tr("At least one parameter must be swept.");
+            }
+            return false;
+        }
+
+        // Find the swept properties and check the values
+        QList<QGraphicsItem*> items = m_document->graphicsScene()->items();
+        QList<Component*> components = filterItems<Component>(items);
+        QList<Component*> swept;
+
+        int gridSize = 1;
+        bool random = false;
+
+        foreach(const SweepParameter &parameter, parameters) {
+            Component *component = 0;
+            foreach(Component *c, components) {
+                if(c->label() == parameter.component) {
+                    component = c;
+                    break;
+                }
+            }
+
+            QString error;
+            if(!component || !component->properties()->propertyMap().contains(parameter.property)) {
+                error = tr("The property %1 of %2 was not found.").arg(parameter.property).arg(parameter.component);
+            }
+            else if(parameter.distribution == SweepParameter::Logarithmic &&
+                    (parameter.first <= 0 || parameter.second <= 0)) {
+                error = tr("A logarithmic sweep of %1 needs positive values.").arg(parameter.component);
+            }
+            else if(parameter.points < 1) {
+                error = tr("The sweep of %1 needs at least one point.").arg(parameter.component);
+            }
+
+            if(!error.isEmpty()) {
+                if(errorMessage) {
+                    *errorMessage = error;
+                }
+                return false;
+            }
+
+            swept << component;
+            if(parameter.distribution == SweepParameter::Linear ||
+                    parameter.distribution == SweepParameter::Logarithmic) {
+                gridSize *= parameter.points;
+            }
+            else {
+                random = true;
+            }
+
+            if(gridSize > maxRuns) {
+                break;
+            }
+        }
+
+        const qint64 count = qint64(gridSize) * (random ? qMax(1, monteCarloRuns) : 1);
+        if(count > maxRuns) {
+            if(errorMessage) {
+                *errorMessage = tr("The sweep has too many runs (the maximum is %1).").arg(maxRuns);
+            }
+            return false;
+        }
+
+        // Generate the netlist once, with placeholders in the swept
+        // properties. The components themselves are not modified.
+        FormatSpice *format = new FormatSpice(m_document);
+        for(int i = 0; i < parameters.size(); ++i) {
+            format->setPropertyOverride(swept.at(i), parameters.at(i).property, NetlistTemplate::placeholder(i));
+        }
+        const QString netlist = format->generateNetlist();
+        delete format;
+
+        if(!m_template.compile(netlist, parameters.size())) {
+            if(errorMessage) {
+                *errorMessage = tr("Some of the swept properties are not used in the netlist.");
+            }
+            return false;
+        }
+
+        // Compute the values of each run. The grid of sweeps is covered
+        // first, and then repeated for each Monte Carlo run.
+        qsrand(uint(QDateTime::currentMSecsSinceEpoch()));
+        m_runs.resize(count);
+
+        for(int r = 0; r < count; ++r) {
+            int rest = r % gridSize;
+            QVector<QString> values(parameters.size());
+
+            for(int i = parameters.size() - 1; i >= 0; --i) {
+                const SweepParameter &p = parameters.at(i);
+                double value = p.first;
+
+                switch(p.distribution) {
+                    case SweepParameter::Linear:
+                    case SweepParameter::Logarithmic:
+                        if(p.points > 1) {
+                            const double t = double(rest % p.points) / (p.points - 1);
+                            value = (p.distribution == SweepParameter::Linear) ?
+                                        p.first + t * (p.second - p.first) :
+                                        p.first * qPow(p.second / p.first, t);
+                        }
+                        rest /= p.points;
+                        break;
+
+                    case SweepParameter::Uniform:
+                        value = p.first + (p.second - p.first) * qrand() / double(RAND_MAX);
+                        break;
+
+                    case SweepParameter::Gaussian:
+                        {
+                            // Box-Muller transform
+                            const double u1 = (qrand() + 1.0) / (RAND_MAX + 2.0);
+                            const double u2 = qrand() / double(RAND_MAX);
+                            const double normal = qSqrt(-2.0 * qLn(u1)) * qCos(2.0 * M_PI * u2);
+                            value = p.first * (1.0 + p.second / 100.0 * normal);
+                        }
+                        break;
+                }
+
+                values[i] = QString::number(value, 'g', 12);
+            }
+
+            m_runs[r].values = values.toList();
+        }
+
+        return true;
+    }
+
+    /*!
+     * \brief Sets the waveforms overlaid and measured in each run.
+     *
+     * \param outputs Names of the waveforms, for example v(out).
+     * \param measurement Value measured on each of them.
+     */
+    void SweepRunner::setOutputs(const QStringList &outputs, Measurement measurement)
+    {
+        m_outputs = outputs;
+        m_measurement = measurement;
+    }
+
+    /*!
+     * \brief Starts simulating the runs prepared with prepare().
+     *
+     * The netlists and logs of the runs are written in a directory next
+     * to the schematic, named after it.
+     */
+    void SweepRunner::start()
+    {
+        if(!m_document || m_running || m_runs.isEmpty()) {
+            return;
+        }
+
+        QFileInfo info(m_document->fileName());
+        m_workingDirectory = info.path();
+        m_directory = info.completeBaseName() + "_sweep";
+        QDir(m_workingDirectory).mkpath(m_directory);
+
+        m_nextRun = 0;
+        m_activeCount = 0;
+        m_finishedCount = 0;
+        m_running = true;
+
+        const int concurrency = qMax(1, QThread::idealThreadCount());
+        for(int i = 0; i < concurrency && m_nextRun < m_runs.size(); ++i) {
+            launchNext();
+        }
+    }
+
+    //! \brief Stops the runs being simulated. Finished runs are kept.
+    void SweepRunner::cancel()
+    {
+        m_running = false;
+
+        foreach(QProcess *process, m_processes) {
+            process->disconnect(this);
+            process->kill();
+            process->waitForFinished(1000);
+            process->deleteLater();
+        }
+        m_processes.clear();
+
+        // The pending files are still read in background, but their results
+        // are discarded.
+        qDeleteAll(m_watchers);
+        m_watchers.clear();
+    }
+
+    //! \brief Returns the values of the parameters of a run, as a short text.
+    QString SweepRunner::runLabel(int index) const
+    {
+        QStringList labels;
+        for(int i = 0; i < m_parameters.size(); ++i) {
+            labels << QString("%1.%2=%3")
+                      .arg(m_parameters.at(i).component)
+                      .arg(m_parameters.at(i).property)
+                      .arg(m_runs.at(index).values.at(i).toDouble(), 0, 'g', 4);
+        }
+
+        return labels.join(", ");
+    }
+
+    /*!
+     * \brief Creates a document with the output waveforms of all the
+     * finished runs.
+     *
+     * Each output is plotted as a family of curves (see
+     * ChartSeries::family()), one decimated curve per run.
+     *
+     * \return The new document, or 0 if there are no results.
+     */
+    SimulationDocument* SweepRunner::createDocument() const
+    {
+        QList<ChartSeries*> curves;
+
+        for(int o = 0; o < m_outputs.size(); ++o) {
+            for(int r = 0; r < m_runs.size(); ++r) {
+                const SweepRun &run = m_runs.at(r);
+                if(!run.valid || o >= run.overlayX.size() || run.overlayX.at(o).isEmpty()) {
+                    continue;
+                }
+
+                ChartSeries *curve = new ChartSeries(QString("%1 [%2]").arg(m_outputs.at(o)).arg(runLabel(r)));
+                curve->setType(run.types.at(o));
+                curve->setFamily(o);
+                curve->setSamples(run.overlayX.at(o), run.overlayY.at(o));
+                curves << curve;
+            }
+        }
+
+        if(curves.isEmpty()) {
+            return 0;
+        }
+
+        ChartSeries::updateIndexes(curves);
+
+        SimulationDocument *document = new SimulationDocument;
+        foreach(ChartSeries *curve, curves) {
+            document->chartScene()->addItem(curve);
+        }
+
+        return document;
+    }
+
+    /*!
+     * \brief Parses a value with an optional engineering suffix, as used in
+     * spice netlists (1k, 10u, 2.2meg, etc).
+     */
+    double SweepRunner::parseValue(const QString &text, bool *ok)
+    {
+        QRegularExpression re("^\\s*([+-]?(\\d+\\.?\\d*|\\.\\d+)([eE][+-]?\\d+)?)([a-zA-Z]*)\\s*$");
+        QRegularExpressionMatch match = re.match(text);
+        if(!match.hasMatch()) {
+            if(ok) {
+                *ok = false;
+            }
+            return 0;
+        }
+
+        double value = match.captured(1).toDouble();
+
+        // Other letters after the suffix (units) are ignored, as in spice
+        const QString suffix = match.captured(4).toLower();
+        if(suffix.startsWith("meg")) {
+            value *= 1e6;
+        }
+        else if(!suffix.isEmpty()) {
+            const QString suffixes = "fpnumkgt";
+            const double factors[] = { 1e-15, 1e-12, 1e-9, 1e-6, 1e-3, 1e3, 1e9, 1e12 };
+            const int index = suffixes.indexOf(suffix.at(0));
+            if(index >= 0) {
+                value *= factors[index];
+            }
+        }
+
+        if(ok) {
+            *ok = true;
+        }
+        return value;
+    }
+
+    //! \brief Writes the netlist of the next run and starts its simulation.
+    void SweepRunner::launchNext()
+    {
+        if(!m_running) {
+            return;
+        }
+
+        if(m_nextRun >= m_runs.size()) {
+            if(m_activeCount == 0) {
+                m_running = false;
+                emit finished();
+            }
+            return;
+        }
+
+        const int index = m_nextRun++;
+        const QString baseName = m_directory + QString("/run_%1").arg(index + 1, 4, 10, QChar('0'));
+        const QString path = m_workingDirectory + "/" + baseName;
+
+        QFile file(path + ".net");
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            m_runs[index].errorMessage = tr("Could not write the file %1").arg(file.fileName());
+            m_finishedCount++;
+            emit runFinished(index);
+            launchNext();
+            return;
+        }
+
+        QTextStream stream(&file);
+        stream << m_template.instantiate(m_runs.at(index).values);
+        file.close();
+
+        QFile::remove(path + ".raw");
+
+        // The runs are read as binary raw files
+        QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+        env.insert("SPICE_ASCIIRAWFILE", "0");
+
+        QProcess *process = new QProcess(this);
+        process->setWorkingDirectory(m_workingDirectory);  // Relative includes of the netlist
+        process->setProcessChannelMode(QProcess::MergedChannels);
+        process->setStandardOutputFile(path + ".log", QIODevice::WriteOnly);
+        process->setProcessEnvironment(env);
+        process->setProperty("run", index);
+
+        connect(process, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(processFinished()));
+        connect(process, SIGNAL(error(QProcess::ProcessError)), this, SLOT(processFinished()));
+
+        QString command = Settings::instance()->currentValue("sim/simulationCommand").toString();
+        command.replace("%filename", baseName);
+
+        m_processes << process;
+        m_activeCount++;
+        process->start(command);
+    }
+
+    //! \brief Reads the results of a finished simulation in background.
+    void SweepRunner::processFinished()
+    {
+        QProcess *process = qobject_cast<QProcess*>(sender());
+
+        // A process that crashes reports both an error and its end
+        if(!process || !m_processes.contains(process)) {
+            return;
+        }
+        m_processes.removeOne(process);
+        process->deleteLater();
+
+        const int index = process->property("run").toInt();
+        const QString rawFile = m_workingDirectory + "/" + m_directory +
+                QString("/run_%1.raw").arg(index + 1, 4, 10, QChar('0'));
+
+        QFutureWatcher<SweepRun> *watcher = new QFutureWatcher<SweepRun>(this);
+        watcher->setProperty("run", index);
+        connect(watcher, SIGNAL(finished()), this, SLOT(resultsReady()));
+        m_watchers << watcher;
+
+        watcher->setFuture(QtConcurrent::run(loadRun, rawFile, m_outputs, m_measurement));
+    }
+
+    //! \brief Stores the results of a run, and launches the next one.
+    void SweepRunner::resultsReady()
+    {
+        QFutureWatcher<SweepRun> *watcher = static_cast<QFutureWatcher<SweepRun>*>(sender());
+        m_watchers.removeOne(watcher);
+        watcher->deleteLater();
+
+        const int index = watcher->property("run").toInt();
+
+        SweepRun run = watcher->result();
+        run.values = m_runs.at(index).values;
+        run.valid = run.errorMessage.isEmpty();
+        m_runs[index] = run;
+
+        m_activeCount--;
+        m_finishedCount++;
+        emit runFinished(index);
+
+        launchNext();
+    }
+
+} // namespace Caneda
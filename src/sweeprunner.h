@@ -0,0 +1,204 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#ifndef SWEEP_RUNNER_H
+#define SWEEP_RUNNER_H
+
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <QVector>
+
+// Forward declarations
+class QProcess;
+
+namespace Caneda
+{
+    // Forward declarations
+    class SchematicDocument;
+    class SimulationDocument;
+
+    /*!
+     * \brief Property varied by a parameter sweep or a Monte Carlo analysis.
+     *
+     * Sweeps (linear or logarithmic) take \a points values between \a first
+     * and \a second, and all the sweeps are combined in a grid. Random
+     * distributions take a new value in each Monte Carlo run.
+     *
+     * \sa SweepRunner
+     */
+    struct SweepParameter
+    {
+        //! \brief Values taken by the parameter
+        enum Distribution {
+            Linear,       //! \brief Linear sweep from first to second
+            Logarithmic,  //! \brief Logarithmic sweep from first to second
+            Uniform,      //! \brief Random value between first and second
+            Gaussian      //! \brief Random value of mean first, and second % of deviation
+        };
+
+        SweepParameter() : distribution(Linear), first(0), second(0), points(1) {}
+
+        QString component;  //! \brief Label of the component (R1, C2, etc)
+        QString property;   //! \brief Name of the swept property
+        Distribution distribution;
+        double first;       //! \brief Start, minimum or nominal value
+        double second;      //! \brief Stop, maximum or relative deviation (%)
+        int points;         //! \brief Number of values of a sweep
+    };
+
+    /*!
+     * \brief Netlist compiled once, from which the variants of a sweep are
+     * generated.
+     *
+     * The netlist is split at the placeholders of the swept properties,
+     * so that generating a variant only concatenates the fixed pieces and
+     * the values of the run, without parsing the schematic again.
+     *
+     * \sa SweepRunner
+     */
+    class NetlistTemplate
+    {
+    public:
+        NetlistTemplate();
+
+        bool compile(const QString &netlist, int parameters);
+        QString instantiate(const QStringList &values) const;
+
+        static QString placeholder(int parameter);
+
+    private:
+        QStringList m_pieces;  //! \brief Fixed text between placeholders
+        QVector<int> m_slots;  //! \brief Parameter following each piece
+        int m_size;            //! \brief Length of the fixed text
+    };
+
+    /*!
+     * \brief Results of one run of a sweep.
+     *
+     * Only the output waveforms are kept, decimated to be overlaid with the
+     * rest of the runs, and their measurements. The complete results of the
+     * simulation are dropped once read, so the memory used does not grow
+     * with the length of the simulations.
+     */
+    struct SweepRun
+    {
+        SweepRun() : valid(false) {}
+
+        QStringList values;    //! \brief Value of each parameter
+        QString errorMessage;  //! \brief Description of the error, empty on success
+        QStringList types;     //! \brief Type of each output (voltage, magnitude, etc)
+
+        QList<QVector<double> > overlayX;  //! \brief Decimated abscissa of each output
+        QList<QVector<double> > overlayY;  //! \brief Decimated values of each output
+        QVector<double> measurements;      //! \brief Measured value of each output
+        bool valid;                        //! \brief True if the run was simulated successfully
+    };
+
+    /*!
+     * \brief This class runs parameter sweeps and Monte Carlo analysis of a
+     * schematic.
+     *
+     * The netlist is generated once, with placeholders in the swept
+     * properties (see NetlistTemplate), and one variant is written per run.
+     * The runs are simulated by ngspice processes in batch mode, as many
+     * at a time as processor cores, and each raw file is read, decimated
+     * and measured in a background thread as soon as its process finishes.
+     * The results of all runs are kept in this object (see run()).
+     *
+     * \sa SweepParameter, SweepRun, SweepDialog
+     */
+    class SweepRunner : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        //! \brief Value measured on the output waveforms of each run
+        enum Measurement {
+            Maximum,
+            Minimum,
+            PeakToPeak,
+            Average,
+            Rms,
+            FinalValue
+        };
+
+        explicit SweepRunner(SchematicDocument *document, QObject *parent = 0);
+        ~SweepRunner();
+
+        bool prepare(const QList<SweepParameter> &parameters, int monteCarloRuns,
+                     QString *errorMessage = 0);
+        void setOutputs(const QStringList &outputs, Measurement measurement);
+
+        void start();
+        void cancel();
+        //! \brief Returns true while there are runs pending
+        bool isRunning() const { return m_running; }
+
+        //! \brief Returns the number of runs of the sweep
+        int runCount() const { return m_runs.size(); }
+        //! \brief Returns the number of runs finished, successfully or not
+        int finishedCount() const { return m_finishedCount; }
+        //! \brief Returns the results of the run \a index
+        const SweepRun& run(int index) const { return m_runs.at(index); }
+        QString runLabel(int index) const;
+
+        //! \brief Returns the waveforms measured and overlaid
+        QStringList outputs() const { return m_outputs; }
+
+        SimulationDocument* createDocument() const;
+
+        static double parseValue(const QString &text, bool *ok = 0);
+
+    Q_SIGNALS:
+        void runFinished(int index);
+        void finished();
+
+    private Q_SLOTS:
+        void processFinished();
+        void resultsReady();
+
+    private:
+        void launchNext();
+
+        QPointer<SchematicDocument> m_document;
+        NetlistTemplate m_template;
+        QList<SweepParameter> m_parameters;
+
+        QStringList m_outputs;
+        Measurement m_measurement;
+
+        QVector<SweepRun> m_runs;
+        QString m_workingDirectory;  //! \brief Directory of the schematic
+        QString m_directory;         //! \brief Directory of the netlists and raw files, relative to the schematic
+        int m_nextRun;        //! \brief Next run to be launched
+        int m_activeCount;    //! \brief Runs being simulated or read
+        int m_finishedCount;
+        bool m_running;
+
+        QList<QProcess*> m_processes;
+        QList<QFutureWatcher<SweepRun>*> m_watchers;
+    };
+
+} // namespace Caneda
+
+#endif //SWEEP_RUNNER_H
@@ -0,0 +1,243 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#include "symbolgeometry.h"
+
+#include "painting.h"
+#include "xmlutilities.h"
+
+#include <QPainter>
+#include <QPainterPath>
+#include <QPolygonF>
+#include <QTransform>
+#include <QtMath>
+
+namespace Caneda
+{
+    /*!
+     * \brief Reads the children of a painting element.
+     *
+     * Only the geometry is needed from a painting, so all children other
+     * than the properties (pen, brush, etc) are skipped.
+     *
+     * \param reader XmlReader positioned at the painting start element.
+     * \return The attributes of the properties child element, if any.
+     */
+    static QXmlStreamAttributes readPaintingProperties(Caneda::XmlReader *reader)
+    {
+        QXmlStreamAttributes attributes;
+
+        while(!reader->atEnd()) {
+            reader->readNext();
+
+            if(reader->isEndElement()) {
+                break;
+            }
+
+            if(reader->isStartElement()) {
+                if(reader->name() == "properties") {
+                    attributes = reader->attributes();
+                }
+                reader->readUnknownElement();  // Read till end tag
+            }
+        }
+
+        return attributes;
+    }
+
+    /*!
+     * \brief Returns the head polygon of an arrow.
+     *
+     * This mirrors Arrow::calcHeadPoints(), so that compiled symbols look
+     * exactly the same as the Painting items they were created from.
+     */
+    static QPolygonF arrowHead(const QRectF &rect, qreal headWidth, qreal headHeight)
+    {
+        qreal angle = qAtan2(-rect.height(), rect.width());
+        angle = -270 + (angle * 180 / M_PI);
+
+        QTransform mapper;
+        mapper.rotate(angle);
+
+        QPointF arrowTipPos = mapper.map(rect.bottomRight());
+        QPointF bottomLeft(arrowTipPos.x() - headWidth/2, arrowTipPos.y() - headHeight);
+        QPointF bottomRight(arrowTipPos.x() + headWidth/2, arrowTipPos.y() - headHeight);
+
+        mapper = mapper.inverted();
+
+        QPolygonF head;
+        head << mapper.map(bottomLeft) << mapper.map(arrowTipPos) << mapper.map(bottomRight);
+        return head;
+    }
+
+    //! \brief Constructs an empty symbol geometry.
+    SymbolGeometry::SymbolGeometry()
+    {
+    }
+
+    /*!
+     * \brief Decodes a painting element and adds its geometry.
+     *
+     * Lines, arrows, rectangles, ellipses and elliptic arcs are decoded
+     * directly from their attributes. Other paintings (texts, layers) fall
+     * back to creating the Painting item to get its shape.
+     *
+     * As in the Painting items, the painting rect is placed at the painting
+     * position.
+     *
+     * \param reader XmlReader positioned at the painting start element.
+     */
+    void SymbolGeometry::loadPainting(Caneda::XmlReader *reader)
+    {
+        Q_ASSERT(reader->isStartElement() && reader->name() == "painting");
+
+        QString name = reader->attributes().value("name").toString();
+        QPointF pos = reader->readPointAttribute("pos");
+
+        if(name == QLatin1String("line")) {
+            QLineF line = reader->readLineAttribute("line");
+            QRectF rect = QRectF(line.p1(), line.p2());
+            rect.moveTo(pos);
+
+            readPaintingProperties(reader);
+            addPolyline(QPolygonF() << rect.topLeft() << rect.bottomRight());
+        }
+        else if(name == QLatin1String("arrow")) {
+            QLineF line = reader->readLineAttribute("line");
+            QRectF rect = QRectF(line.p1(), line.p2());
+
+            QXmlStreamAttributes attributes = readPaintingProperties(reader);
+            QPointF headSize(12, 20);
+            if(attributes.hasAttribute("headSize")) {
+                QStringList size = attributes.value("headSize").toString().split(',');
+                if(size.size() == 2) {
+                    headSize = QPointF(size.at(0).toDouble(), size.at(1).toDouble());
+                }
+            }
+
+            QPolygonF head = arrowHead(rect, headSize.x(), headSize.y());
+            rect.moveTo(pos);
+
+            addPolyline(QPolygonF() << rect.topLeft() << rect.bottomRight());
+            head = head.translated(rect.topLeft());
+            head << head.first();  // Close the head
+            addPolyline(head);
+        }
+        else if(name == QLatin1String("rectangle")) {
+            QRectF rect = reader->readRectAttribute(QLatin1String("rectangle"));
+            rect.moveTo(pos);
+
+            readPaintingProperties(reader);
+            addPolyline(QPolygonF(rect));
+        }
+        else if(name == QLatin1String("ellipse")) {
+            QRectF rect = reader->readRectAttribute(QLatin1String("ellipse"));
+            rect.moveTo(pos);
+
+            readPaintingProperties(reader);
+            addArc(rect, 0, 360);
+        }
+        else if(name == QLatin1String("ellipseArc")) {
+            QRectF rect = reader->readRectAttribute(QLatin1String("ellipse"));
+            rect.moveTo(pos);
+
+            QXmlStreamAttributes attributes = readPaintingProperties(reader);
+            bool ok1, ok2;
+            int startAngle = attributes.value("startAngle").toString().toInt(&ok1);
+            int spanAngle = attributes.value("spanAngle").toString().toInt(&ok2);
+            if(!ok1 || !ok2) {
+                reader->raiseError(QObject::tr("Invalid arc attributes"));
+                return;
+            }
+
+            addArc(rect, startAngle, spanAngle);
+        }
+        else {
+            Painting *painting = Painting::fromName(name);
+            if(!painting) {
+                reader->readUnknownElement();
+                return;
+            }
+
+            painting->loadData(reader);
+
+            QRectF rect = painting->paintingRect();
+            rect.moveTo(painting->pos());
+            foreach(const QPolygonF &polygon, painting->shapeForRect(rect).toSubpathPolygons()) {
+                addPolyline(polygon);
+            }
+
+            delete painting;
+        }
+    }
+
+    //! \brief Adds a polyline to the geometry.
+    void SymbolGeometry::addPolyline(const QPolygonF &polyline)
+    {
+        if(polyline.isEmpty()) {
+            return;
+        }
+
+        m_points += polyline;
+        m_polylineEnds << m_points.size();
+        m_boundingRect |= polyline.boundingRect();
+    }
+
+    /*!
+     * \brief Adds an elliptic arc to the geometry.
+     *
+     * \param rect Rectangle of the ellipse.
+     * \param startAngle Start angle of the arc, in degrees.
+     * \param spanAngle Span angle of the arc, in degrees.
+     */
+    void SymbolGeometry::addArc(const QRectF &rect, int startAngle, int spanAngle)
+    {
+        Arc arc;
+        arc.rect = rect;
+        arc.startAngle = startAngle;
+        arc.spanAngle = spanAngle;
+        m_arcs << arc;
+
+        // The bounds of an arc are computed only once, while decoding
+        QPainterPath path;
+        path.arcMoveTo(rect, startAngle);
+        path.arcTo(rect, startAngle, spanAngle);
+        m_boundingRect |= path.boundingRect();
+    }
+
+    /*!
+     * \brief Draws the symbol with the current pen of \a painter.
+     *
+     * Symbols are only stroked, never filled.
+     */
+    void SymbolGeometry::draw(QPainter *painter) const
+    {
+        int start = 0;
+        foreach(int end, m_polylineEnds) {
+            painter->drawPolyline(m_points.constData() + start, end - start);
+            start = end;
+        }
+
+        foreach(const Arc &arc, m_arcs) {
+            painter->drawArc(arc.rect, 16 * arc.startAngle, 16 * arc.spanAngle);
+        }
+    }
+
+} // namespace Caneda
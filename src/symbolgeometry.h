@@ -0,0 +1,91 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+
+#ifndef SYMBOL_GEOMETRY_H
+#define SYMBOL_GEOMETRY_H
+
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+
+// Forward declarations
+class QPainter;
+class QPolygonF;
+
+namespace Caneda
+{
+    // Forward declarations
+    class XmlReader;
+
+    /*!
+     * \brief Compiled geometry of a library component symbol.
+     *
+     * Symbols of library components are decoded directly from their xml
+     * description into compact buffers: all polylines (lines, rectangles
+     * and arrows) are packed into one array of points, while ellipses and
+     * elliptic arcs are kept as arcs. The bounding rect is computed once
+     * while decoding.
+     *
+     * The same geometry is used to paint components, to compute their
+     * bounding rect (used for hit testing) and to render the pixmaps of the
+     * symbols.
+     *
+     * \sa LibraryManager, FormatXmlSymbol
+     */
+    class SymbolGeometry
+    {
+    public:
+        SymbolGeometry();
+
+        void loadPainting(Caneda::XmlReader *reader);
+
+        void addPolyline(const QPolygonF &polyline);
+        void addArc(const QRectF &rect, int startAngle, int spanAngle);
+
+        //! Returns true if the symbol has no geometry.
+        bool isEmpty() const { return m_points.isEmpty() && m_arcs.isEmpty(); }
+        //! Returns the bounding rect of the symbol.
+        QRectF boundingRect() const { return m_boundingRect; }
+
+        void draw(QPainter *painter) const;
+
+    private:
+        //! \brief Elliptic arc, with angles in degrees.
+        struct Arc
+        {
+            QRectF rect;
+            int startAngle;
+            int spanAngle;
+        };
+
+        //! Points of all polylines, one after the other.
+        QVector<QPointF> m_points;
+        //! End index (in m_points) of each polyline.
+        QVector<int> m_polylineEnds;
+        //! Ellipses and elliptic arcs.
+        QVector<Arc> m_arcs;
+
+        //! Bounding rect of all the geometry.
+        QRectF m_boundingRect;
+    };
+
+} // namespace Caneda
+
+#endif //SYMBOL_GEOMETRY_H
@@ -0,0 +1,638 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+#include "tiledrenderer.h"
+
+#include <QIODevice>
+#include <QPageSize>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QPicture>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtEndian>
+
+#include <zlib.h>
+
+namespace Caneda
+{
+    //! \brief Maximum page size allowed by the pdf format, in points.
+    static const int maxPdfPageSize = 14400;
+
+    //! \brief Size of the recorded regions, in tiles.
+    static const int regionTiles = 4;
+
+    //! \brief Maximum size of each PNG IDAT chunk.
+    static const int pngChunkSize = 64 * 1024;
+
+    //! \brief Functor used to render tiles in worker threads.
+    struct RenderTileFunctor
+    {
+        typedef QImage result_type;
+
+        explicit RenderTileFunctor(const TiledRenderer *renderer) : m_renderer(renderer) {}
+
+        QImage operator()(const QRect &tile) const
+        {
+            return m_renderer->renderTile(tile);
+        }
+
+        const TiledRenderer *m_renderer;
+    };
+
+    /*!
+     * \brief Functor used to render and compress TIFF tiles in worker threads.
+     *
+     * TIFF tiles must always have the nominal tile size, even at the right
+     * and bottom borders of the image, so the rendered tile is padded with
+     * white pixels as needed.
+     */
+    struct CompressTiffTileFunctor
+    {
+        typedef QByteArray result_type;
+
+        explicit CompressTiffTileFunctor(const TiledRenderer *renderer) : m_renderer(renderer) {}
+
+        QByteArray operator()(const QRect &tile) const
+        {
+            const int tileSize = m_renderer->tileSize();
+            QImage image = m_renderer->renderTile(tile);
+
+            QByteArray raw(tileSize * tileSize * 3, char(0xff));
+            uchar *dest = reinterpret_cast<uchar*>(raw.data());
+
+            for(int y = 0; y < image.height(); ++y) {
+                const QRgb *line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+                uchar *row = dest + y * tileSize * 3;
+                for(int x = 0; x < image.width(); ++x) {
+                    *row++ = qRed(line[x]);
+                    *row++ = qGreen(line[x]);
+                    *row++ = qBlue(line[x]);
+                }
+            }
+
+            uLongf length = compressBound(raw.size());
+            QByteArray compressed(int(length), Qt::Uninitialized);
+            compress2(reinterpret_cast<Bytef*>(compressed.data()), &length,
+                      reinterpret_cast<const Bytef*>(raw.constData()), raw.size(),
+                      Z_DEFAULT_COMPRESSION);
+            compressed.resize(int(length));
+
+            return compressed;
+        }
+
+        const TiledRenderer *m_renderer;
+    };
+
+    //! \brief Writes a 16 bits little endian value.
+    static bool writeLE16(QIODevice *device, quint16 value)
+    {
+        uchar data[2];
+        qToLittleEndian(value, data);
+        return device->write(reinterpret_cast<const char*>(data), 2) == 2;
+    }
+
+    //! \brief Writes a 32 bits little endian value.
+    static bool writeLE32(QIODevice *device, quint32 value)
+    {
+        uchar data[4];
+        qToLittleEndian(value, data);
+        return device->write(reinterpret_cast<const char*>(data), 4) == 4;
+    }
+
+    //! \brief Writes a 32 bits big endian value into a byte array.
+    static void appendBE32(QByteArray &array, quint32 value)
+    {
+        uchar data[4];
+        qToBigEndian(value, data);
+        array.append(reinterpret_cast<const char*>(data), 4);
+    }
+
+    //! \brief Writes a PNG chunk, including its length and checksum.
+    static bool writePngChunk(QIODevice *device, const char *type, const QByteArray &data)
+    {
+        QByteArray chunk;
+        appendBE32(chunk, data.size());
+        chunk.append(type, 4);
+        chunk.append(data);
+
+        uLong crc = crc32(0L, Z_NULL, 0);
+        crc = crc32(crc, reinterpret_cast<const Bytef*>(chunk.constData()) + 4, data.size() + 4);
+        appendBE32(chunk, quint32(crc));
+
+        return device->write(chunk) == chunk.size();
+    }
+
+    /*!
+     * \brief Writes a TIFF directory entry.
+     *
+     * \param device Device to write into.
+     * \param tag TIFF tag number.
+     * \param type TIFF field type (3 = SHORT, 4 = LONG, 5 = RATIONAL).
+     * \param count Number of values.
+     * \param value Value itself if it fits in four bytes, offset to the values
+     * otherwise.
+     * \return True on success, false otherwise.
+     */
+    static bool writeTiffEntry(QIODevice *device, quint16 tag, quint16 type,
+                               quint32 count, quint32 value)
+    {
+        bool ok = writeLE16(device, tag) && writeLE16(device, type) &&
+                  writeLE32(device, count);
+
+        if(type == 3 && count == 1) {
+            // Short values are left justified in the value field
+            return ok && writeLE16(device, quint16(value)) && writeLE16(device, 0);
+        }
+
+        return ok && writeLE32(device, value);
+    }
+
+    /*!
+     * \brief Constructs a tiled renderer without any drawing.
+     *
+     * The drawing must be later recorded with addPicture(), usually one
+     * picture for each one of the regions().
+     *
+     * \param imageSize Size of the final image.
+     * \param tileSize Width and height of each tile. It is rounded up to a
+     * multiple of 16 as required by the TIFF format.
+     */
+    TiledRenderer::TiledRenderer(const QSize &imageSize, int tileSize) :
+        m_recorder(0),
+        m_imageSize(imageSize)
+    {
+        m_tileSize = qMax(16, (tileSize + 15) / 16 * 16);
+    }
+
+    /*!
+     * \brief Constructs a tiled renderer from a single recorded drawing.
+     *
+     * \param picture Recorded drawing, in final image coordinates.
+     * \param imageSize Size of the final image.
+     * \param tileSize Width and height of each tile. It is rounded up to a
+     * multiple of 16 as required by the TIFF format.
+     */
+    TiledRenderer::TiledRenderer(const QPicture &picture, const QSize &imageSize,
+                                 int tileSize) :
+        m_recorder(0),
+        m_imageSize(imageSize)
+    {
+        m_tileSize = qMax(16, (tileSize + 15) / 16 * 16);
+        addPicture(picture, QRect(QPoint(0, 0), imageSize));
+    }
+
+    //! \brief Destructor, deleting the recorder if any.
+    TiledRenderer::~TiledRenderer()
+    {
+        delete m_recorder;
+    }
+
+    /*!
+     * \brief Returns the regions in which the drawing should be recorded.
+     *
+     * The image is split in a grid of regions, each one a square of several
+     * tiles, aligned to the tiles grid. This way each tile only replays the
+     * drawing of one region (or a few ones for pdf pages).
+     *
+     * \sa addPicture()
+     */
+    QList<QRect> TiledRenderer::regions() const
+    {
+        const int regionSize = m_tileSize * regionTiles;
+
+        QList<QRect> regions;
+        for(int top = 0; top < m_imageSize.height(); top += regionSize) {
+            for(int left = 0; left < m_imageSize.width(); left += regionSize) {
+                regions << QRect(left, top, qMin(regionSize, m_imageSize.width() - left),
+                                 qMin(regionSize, m_imageSize.height() - top));
+            }
+        }
+
+        return regions;
+    }
+
+    /*!
+     * \brief Adds the recorded drawing of a region of the image.
+     *
+     * \param picture Recorded drawing, in final image coordinates.
+     * \param region Region of the final image covered by \a picture. When
+     * painting, the picture is clipped to this region.
+     */
+    void TiledRenderer::addPicture(const QPicture &picture, const QRect &region)
+    {
+        RecordedPicture recorded;
+        recorded.region = region;
+        recorded.data = QByteArray(picture.data(), picture.size());
+        m_pictures << recorded;
+    }
+
+    /*!
+     * \brief Sets the object recording the regions on demand.
+     *
+     * Instead of recording all the regions upfront, each region is recorded
+     * by \a recorder just before the first tile overlapping it is rendered.
+     * The tiles are always rendered by rows, from top to bottom, so a region
+     * is released as soon as the tiles being rendered are below it.
+     *
+     * \param recorder Recorder of the regions. The renderer takes its
+     * ownership, and deletes it when destroyed.
+     */
+    void TiledRenderer::setRecorder(TileRecorder *recorder)
+    {
+        delete m_recorder;
+        m_recorder = recorder;
+        m_pictures.clear();
+    }
+
+    /*!
+     * \brief Records the regions needed to render \a tiles, if there is a
+     * recorder, releasing those already rendered.
+     *
+     * This method must be called from the GUI thread, with the tiles sorted
+     * by rows from top to bottom. Regions ending above the first tile are
+     * no longer needed by this call nor the following ones.
+     */
+    void TiledRenderer::prepareTiles(const QList<QRect> &tiles)
+    {
+        if(!m_recorder || tiles.isEmpty()) {
+            return;
+        }
+
+        const int top = tiles.first().top();
+        for(int i = m_pictures.size() - 1; i >= 0; --i) {
+            if(m_pictures.at(i).region.bottom() < top) {
+                m_pictures.removeAt(i);
+            }
+        }
+
+        foreach(const QRect &region, regions()) {
+            bool needed = false;
+            foreach(const QRect &tile, tiles) {
+                if(region.intersects(tile)) {
+                    needed = true;
+                    break;
+                }
+            }
+
+            bool recorded = false;
+            foreach(const RecordedPicture &picture, m_pictures) {
+                if(picture.region == region) {
+                    recorded = true;
+                    break;
+                }
+            }
+
+            if(needed && !recorded) {
+                QPicture picture;
+                picture.setBoundingRect(region);
+                QPainter painter(&picture);
+                m_recorder->recordRegion(&painter, region);
+                painter.end();
+
+                addPicture(picture, region);
+            }
+        }
+    }
+
+    /*!
+     * \brief Paints a region of the drawing into a painter.
+     *
+     * The region \a tile (in final image coordinates) is painted with its
+     * top left corner at the painter origin. Only the recorded pictures whose
+     * region overlaps \a tile are replayed. This method only uses its own
+     * copies of the recorded pictures, and thus can be called from several
+     * threads at the same time.
+     */
+    void TiledRenderer::paintTile(QPainter *painter, const QRect &tile) const
+    {
+        painter->save();
+        painter->translate(-tile.topLeft());
+
+        foreach(const RecordedPicture &recorded, m_pictures) {
+            const QRect area = recorded.region & tile;
+            if(area.isEmpty()) {
+                continue;
+            }
+
+            // QPicture playback is not reentrant on a shared picture, so every
+            // call uses its own deep copy of the recorded data.
+            QPicture picture;
+            picture.setData(recorded.data.constData(), recorded.data.size());
+
+            painter->setClipRect(area);
+            painter->drawPicture(0, 0, picture);
+        }
+
+        painter->restore();
+    }
+
+    //! \brief Renders a region of the drawing into a new image.
+    QImage TiledRenderer::renderTile(const QRect &tile) const
+    {
+        QImage image(tile.size(), QImage::Format_RGB32);
+        image.fill(qRgb(255, 255, 255));
+
+        QPainter painter(&image);
+        paintTile(&painter, tile);
+        painter.end();
+
+        return image;
+    }
+
+    /*!
+     * \brief Renders several tiles in parallel, in worker threads.
+     *
+     * \param tiles Tiles to render, sorted by rows from top to bottom. With a
+     * recorder, consecutive calls must also follow this order.
+     */
+    QList<QImage> TiledRenderer::renderTiles(const QList<QRect> &tiles)
+    {
+        prepareTiles(tiles);
+        return QtConcurrent::blockingMapped<QList<QImage> >(tiles, RenderTileFunctor(this));
+    }
+
+    /*!
+     * \brief Writes the drawing as a PNG image.
+     *
+     * The image is rendered one row of tiles at a time, and each image row is
+     * deflated into the PNG stream as soon as it is available. The memory
+     * used is thus proportional to the image width times the tile size.
+     *
+     * \param device Device to write into, already opened.
+     * \return True on success, false otherwise.
+     */
+    bool TiledRenderer::writePng(QIODevice *device)
+    {
+        const int width = m_imageSize.width();
+        const int height = m_imageSize.height();
+
+        if(width <= 0 || height <= 0) {
+            return false;
+        }
+
+        // Signature and header
+        const char signature[8] = { char(0x89), 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        if(device->write(signature, 8) != 8) {
+            return false;
+        }
+
+        QByteArray header;
+        appendBE32(header, width);
+        appendBE32(header, height);
+        header.append(char(8));  // Bit depth
+        header.append(char(2));  // Color type, RGB
+        header.append(char(0));  // Compression method
+        header.append(char(0));  // Filter method
+        header.append(char(0));  // Interlace method
+        if(!writePngChunk(device, "IHDR", header)) {
+            return false;
+        }
+
+        z_stream stream;
+        stream.zalloc = Z_NULL;
+        stream.zfree = Z_NULL;
+        stream.opaque = Z_NULL;
+        if(deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+            return false;
+        }
+
+        QByteArray row(width * 3 + 1, 0);  // Filter type byte + RGB data
+        QByteArray buffer(pngChunkSize, Qt::Uninitialized);
+        QByteArray pending;
+        bool ok = true;
+
+        for(int top = 0; top < height && ok; top += m_tileSize) {
+
+            // Render all the tiles of this row in parallel
+            const int bandHeight = qMin(m_tileSize, height - top);
+            QList<QRect> tiles;
+            for(int left = 0; left < width; left += m_tileSize) {
+                tiles << QRect(left, top, qMin(m_tileSize, width - left), bandHeight);
+            }
+
+            QList<QImage> images = renderTiles(tiles);
+
+            // Deflate each image row of the band
+            for(int y = 0; y < bandHeight && ok; ++y) {
+                uchar *dest = reinterpret_cast<uchar*>(row.data()) + 1;
+
+                foreach(const QImage &image, images) {
+                    const QRgb *line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+                    for(int x = 0; x < image.width(); ++x) {
+                        *dest++ = qRed(line[x]);
+                        *dest++ = qGreen(line[x]);
+                        *dest++ = qBlue(line[x]);
+                    }
+                }
+
+                const bool last = (top + y == height - 1);
+                stream.next_in = reinterpret_cast<Bytef*>(row.data());
+                stream.avail_in = row.size();
+
+                do {
+                    stream.next_out = reinterpret_cast<Bytef*>(buffer.data());
+                    stream.avail_out = buffer.size();
+                    deflate(&stream, last ? Z_FINISH : Z_NO_FLUSH);
+                    pending.append(buffer.constData(), buffer.size() - stream.avail_out);
+
+                    if(pending.size() >= pngChunkSize) {
+                        ok = writePngChunk(device, "IDAT", pending);
+                        pending.clear();
+                    }
+                } while(stream.avail_out == 0 && ok);
+            }
+        }
+
+        deflateEnd(&stream);
+
+        if(ok && !pending.isEmpty()) {
+            ok = writePngChunk(device, "IDAT", pending);
+        }
+
+        return ok && writePngChunk(device, "IEND", QByteArray());
+    }
+
+    /*!
+     * \brief Writes the drawing as a tiled TIFF image.
+     *
+     * The image is stored as deflate compressed tiles. Groups of tiles (as
+     * many as available processor cores) are rendered and compressed in
+     * parallel, and written in order, so the memory used only depends on the
+     * tile size. The image directory is written at the end of the file, once
+     * all the tile offsets are known.
+     *
+     * \param device Device to write into, already opened and seekable.
+     * \return True on success, false otherwise.
+     */
+    bool TiledRenderer::writeTiff(QIODevice *device)
+    {
+        const int width = m_imageSize.width();
+        const int height = m_imageSize.height();
+
+        if(width <= 0 || height <= 0 || device->isSequential()) {
+            return false;
+        }
+
+        // Header, the directory offset is written at the end
+        const qint64 start = device->pos();
+        if(device->write("II*\0", 4) != 4 || !writeLE32(device, 0)) {
+            return false;
+        }
+
+        QList<QRect> tiles;
+        for(int top = 0; top < height; top += m_tileSize) {
+            for(int left = 0; left < width; left += m_tileSize) {
+                tiles << QRect(left, top, qMin(m_tileSize, width - left),
+                               qMin(m_tileSize, height - top));
+            }
+        }
+
+        QList<quint32> offsets;
+        QList<quint32> byteCounts;
+        const int groupSize = qMax(1, QThread::idealThreadCount());
+
+        for(int i = 0; i < tiles.size(); i += groupSize) {
+            QList<QRect> group = tiles.mid(i, groupSize);
+            prepareTiles(group);
+
+            QList<QByteArray> compressed =
+                QtConcurrent::blockingMapped<QList<QByteArray> >(group, CompressTiffTileFunctor(this));
+
+            foreach(const QByteArray &data, compressed) {
+                offsets << quint32(device->pos() - start);
+                byteCounts << quint32(data.size());
+                if(device->write(data) != data.size()) {
+                    return false;
+                }
+            }
+        }
+
+        // Values that do not fit in the directory entries (word aligned)
+        bool ok = true;
+        if((device->pos() - start) % 2) {
+            ok = device->write("\0", 1) == 1;
+        }
+
+        const quint32 bitsPerSampleOffset = quint32(device->pos() - start);
+        ok = ok && writeLE16(device, 8) && writeLE16(device, 8) && writeLE16(device, 8);
+
+        const quint32 resolutionOffset = quint32(device->pos() - start);
+        ok = ok && writeLE32(device, 72) && writeLE32(device, 1);
+
+        quint32 offsetsOffset = offsets.first();
+        quint32 byteCountsOffset = byteCounts.first();
+        if(tiles.size() > 1) {
+            offsetsOffset = quint32(device->pos() - start);
+            foreach(quint32 offset, offsets) {
+                ok = ok && writeLE32(device, offset);
+            }
+
+            byteCountsOffset = quint32(device->pos() - start);
+            foreach(quint32 count, byteCounts) {
+                ok = ok && writeLE32(device, count);
+            }
+        }
+
+        // Image directory, with the entries sorted by tag
+        const quint32 directoryOffset = quint32(device->pos() - start);
+        ok = ok && writeLE16(device, 14) &&
+            writeTiffEntry(device, 256, 4, 1, width) &&                // ImageWidth
+            writeTiffEntry(device, 257, 4, 1, height) &&               // ImageLength
+            writeTiffEntry(device, 258, 3, 3, bitsPerSampleOffset) &&  // BitsPerSample
+            writeTiffEntry(device, 259, 3, 1, 8) &&                    // Compression, deflate
+            writeTiffEntry(device, 262, 3, 1, 2) &&                    // PhotometricInterpretation, RGB
+            writeTiffEntry(device, 277, 3, 1, 3) &&                    // SamplesPerPixel
+            writeTiffEntry(device, 282, 5, 1, resolutionOffset) &&     // XResolution
+            writeTiffEntry(device, 283, 5, 1, resolutionOffset) &&     // YResolution
+            writeTiffEntry(device, 284, 3, 1, 1) &&                    // PlanarConfiguration, chunky
+            writeTiffEntry(device, 296, 3, 1, 2) &&                    // ResolutionUnit, inch
+            writeTiffEntry(device, 322, 4, 1, m_tileSize) &&           // TileWidth
+            writeTiffEntry(device, 323, 4, 1, m_tileSize) &&           // TileLength
+            writeTiffEntry(device, 324, 4, offsets.size(), offsetsOffset) &&        // TileOffsets
+            writeTiffEntry(device, 325, 4, byteCounts.size(), byteCountsOffset) &&  // TileByteCounts
+            writeLE32(device, 0);  // No more directories
+
+        if(!ok) {
+            return false;
+        }
+
+        // Finally fill in the directory offset in the header
+        const qint64 end = device->pos();
+        if(!device->seek(start + 4) || !writeLE32(device, directoryOffset)) {
+            return false;
+        }
+
+        return device->seek(end);
+    }
+
+    /*!
+     * \brief Writes the drawing as a (possibly multipage) pdf document.
+     *
+     * Pdf pages can not exceed 14400 points in either direction, so big
+     * drawings are split into several pages, each one painted with
+     * paintTile(). The output keeps the vector nature of the drawing, using
+     * one point per image pixel.
+     *
+     * \param fileName Name of the pdf file to write.
+     * \return True on success, false otherwise.
+     */
+    bool TiledRenderer::writePdf(const QString &fileName)
+    {
+        const int width = m_imageSize.width();
+        const int height = m_imageSize.height();
+
+        if(width <= 0 || height <= 0) {
+            return false;
+        }
+
+        QList<QRect> pages;
+        for(int top = 0; top < height; top += maxPdfPageSize) {
+            for(int left = 0; left < width; left += maxPdfPageSize) {
+                pages << QRect(left, top, qMin(maxPdfPageSize, width - left),
+                               qMin(maxPdfPageSize, height - top));
+            }
+        }
+
+        QPdfWriter writer(fileName);
+        writer.setResolution(72);
+        writer.setPageMargins(QMarginsF(0, 0, 0, 0));
+        writer.setPageSize(QPageSize(QSizeF(pages.first().size()), QPageSize::Point,
+                                     QString(), QPageSize::ExactMatch));
+
+        QPainter painter;
+        if(!painter.begin(&writer)) {
+            return false;
+        }
+
+        for(int i = 0; i < pages.size(); ++i) {
+            if(i > 0) {
+                writer.setPageSize(QPageSize(QSizeF(pages.at(i).size()), QPageSize::Point,
+                                             QString(), QPageSize::ExactMatch));
+                writer.newPage();
+            }
+
+            prepareTiles(QList<QRect>() << pages.at(i));
+            paintTile(&painter, pages.at(i));
+        }
+
+        return painter.end();
+    }
+
+} // namespace Caneda
@@ -0,0 +1,128 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+#ifndef TILED_RENDERER_H
+#define TILED_RENDERER_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QList>
+#include <QRect>
+
+// Forward declarations
+class QIODevice;
+class QPainter;
+class QPicture;
+
+namespace Caneda
+{
+    /*!
+     * \brief Interface of the objects recording the drawing of a
+     * TiledRenderer on demand.
+     *
+     * \sa TiledRenderer::setRecorder()
+     */
+    class TileRecorder
+    {
+    public:
+        virtual ~TileRecorder() {}
+
+        /*!
+         * \brief Records the drawing of \a region (in final image
+         * coordinates) into \a painter.
+         *
+         * This method is always called from the GUI thread.
+         */
+        virtual void recordRegion(QPainter *painter, const QRect &region) = 0;
+    };
+
+    /*!
+     * \brief This class renders a recorded drawing into tiles, allowing to
+     * export images of any size using a bounded amount of memory.
+     *
+     * The drawing to export is recorded in the GUI thread, as one QPicture
+     * per region of the final image (see regions()). A scene records each
+     * region through its index, so each picture only holds the items found
+     * in that region (see IDocument::exportTiles()). The regions are either
+     * added upfront with addPicture(), or recorded on demand by a
+     * TileRecorder (see setRecorder()). In the latter case each region is
+     * recorded just before its first tile is rendered, and released once the
+     * rendering has moved past it, so only a couple of rows of regions are
+     * held at any time. The recorded pictures are a thread safe snapshot of
+     * the document. Each tile is then rendered in a worker thread by
+     * replaying only the pictures of the regions it overlaps into a small
+     * QImage.
+     *
+     * The rendered tiles are streamed into the output file as soon as they are
+     * available, without ever allocating the complete raster:
+     * \li writePng() renders one row of tiles at a time (all tiles of the row
+     * in parallel) and deflates the image rows into the PNG stream.
+     * \li writeTiff() writes a tiled TIFF, rendering and compressing groups of
+     * tiles in parallel, so memory usage only depends on the tile size.
+     * \li writePdf() splits the drawing into pages, painting each one with the
+     * same tile painting code as the raster formats (in this case the output
+     * remains a vector drawing).
+     *
+     * \sa ExportDialog
+     */
+    class TiledRenderer
+    {
+    public:
+        explicit TiledRenderer(const QSize &imageSize, int tileSize = 512);
+        TiledRenderer(const QPicture &picture, const QSize &imageSize,
+                      int tileSize = 512);
+        ~TiledRenderer();
+
+        QSize imageSize() const { return m_imageSize; }
+        int tileSize() const { return m_tileSize; }
+
+        QList<QRect> regions() const;
+        void addPicture(const QPicture &picture, const QRect &region);
+        void setRecorder(TileRecorder *recorder);
+
+        void paintTile(QPainter *painter, const QRect &tile) const;
+        QImage renderTile(const QRect &tile) const;
+        QList<QImage> renderTiles(const QList<QRect> &tiles);
+
+        bool writePng(QIODevice *device);
+        bool writeTiff(QIODevice *device);
+        bool writePdf(const QString &fileName);
+
+    private:
+        Q_DISABLE_COPY(TiledRenderer)
+
+        void prepareTiles(const QList<QRect> &tiles);
+
+        //! \brief Recorded drawing of a region of the final image.
+        struct RecordedPicture
+        {
+            QRect region;
+            QByteArray data;
+        };
+
+        QList<RecordedPicture> m_pictures;
+        //! \brief Recorder of the regions on demand, or 0 if added upfront.
+        TileRecorder *m_recorder;
+        QSize m_imageSize;
+        int m_tileSize;
+    };
+
+} // namespace Caneda
+
+#endif //TILED_RENDERER_H
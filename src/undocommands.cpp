@@ -102,6 +102,133 @@ namespace Caneda
     }
 
 
+    /*************************************************************************
+     *                            MoveItemsCmd                               *
+     *************************************************************************/
+    /*!
+     * \brief Constructs a batch move command.
+     *
+     * \param items List of items to be moved.
+     * \param init Initial position of each item.
+     * \param final Final position of each item.
+     * \param scene Scene where the items belong to.
+     * \param parent Parent undo command.
+     */
+    MoveItemsCmd::MoveItemsCmd(const QList<GraphicsItem*> &items,
+                               const QList<QPointF> &init,
+                               const QList<QPointF> &final,
+                               GraphicsScene *scene,
+                               QUndoCommand *parent) :
+        QUndoCommand(parent),
+        m_items(items),
+        m_scene(scene)
+    {
+        Q_ASSERT(init.size() == items.size() && final.size() == items.size());
+
+        m_initialPositions.reserve(items.size());
+        m_deltas.reserve(items.size());
+
+        for(int i = 0; i < items.size(); ++i) {
+            m_initialPositions << init.at(i);
+            m_deltas << final.at(i) - init.at(i);
+        }
+
+        compactDeltas();
+    }
+
+    /*!
+     * \copydoc MoveItemCmd::undo()
+     *
+     * The items are moved as a single batch update of the scene, see
+     * GraphicsScene::beginTilesUpdate().
+     */
+    void MoveItemsCmd::undo()
+    {
+        m_scene->beginTilesUpdate();
+
+        for(int i = 0; i < m_items.size(); ++i) {
+            m_items.at(i)->setPos(m_initialPositions.at(i));
+        }
+
+        m_scene->endTilesUpdate();
+    }
+
+    //! \copydoc MoveItemCmd::redo()
+    void MoveItemsCmd::redo()
+    {
+        m_scene->beginTilesUpdate();
+
+        for(int i = 0; i < m_items.size(); ++i) {
+            m_items.at(i)->setPos(m_initialPositions.at(i) + delta(i));
+        }
+
+        m_scene->endTilesUpdate();
+    }
+
+    /*!
+     * \brief Returns the id used to merge consecutive move commands.
+     *
+     * \sa mergeWith()
+     */
+    int MoveItemsCmd::id() const
+    {
+        return 1;
+    }
+
+    /*!
+     * \brief Merges a consecutive move of the same items into this command.
+     *
+     * When the same set of items is moved several times in a row (for example
+     * while repeatedly dragging a selection), only one command is kept in the
+     * undo stack, holding the accumulated displacement.
+     *
+     * \return True if the command was merged, false otherwise.
+     */
+    bool MoveItemsCmd::mergeWith(const QUndoCommand *other)
+    {
+        const MoveItemsCmd *cmd = static_cast<const MoveItemsCmd*>(other);
+
+        if(cmd->m_scene != m_scene || cmd->m_items != m_items) {
+            return false;
+        }
+
+        QVector<QPointF> deltas;
+        deltas.reserve(m_items.size());
+
+        for(int i = 0; i < m_items.size(); ++i) {
+            QPointF finalPos = cmd->m_initialPositions.at(i) + cmd->delta(i);
+            deltas << finalPos - m_initialPositions.at(i);
+        }
+
+        m_deltas = deltas;
+        compactDeltas();
+
+        return true;
+    }
+
+    //! \return The displacement of the item at position \a index.
+    QPointF MoveItemsCmd::delta(int index) const
+    {
+        return m_deltas.size() == 1 ? m_deltas.first() : m_deltas.at(index);
+    }
+
+    //! \brief Keeps a single delta when all items share the same displacement.
+    void MoveItemsCmd::compactDeltas()
+    {
+        for(int i = 1; i < m_deltas.size(); ++i) {
+            if(m_deltas.at(i) != m_deltas.first()) {
+                m_deltas.squeeze();
+                return;
+            }
+        }
+
+        if(!m_deltas.isEmpty()) {
+            m_deltas.resize(1);
+            m_deltas.squeeze();
+        }
+    }
+
+
     /*************************************************************************
      *                           DisconnectCmd                               *
      *************************************************************************/
@@ -126,6 +253,44 @@ namespace Caneda
     }
 
 
+    /*************************************************************************
+     *                         DisconnectItemsCmd                            *
+     *************************************************************************/
+    //! \copydoc MoveItemCmd::MoveItemCmd()
+    DisconnectItemsCmd::DisconnectItemsCmd(const QList<PortPair> &portPairs,
+                                           GraphicsScene *scene,
+                                           QUndoCommand *parent) :
+        QUndoCommand(parent),
+        m_portPairs(portPairs),
+        m_scene(scene)
+    {
+    }
+
+    //! \copydoc MoveItemCmd::undo()
+    void DisconnectItemsCmd::undo()
+    {
+        m_scene->beginTilesUpdate();
+
+        for(int i = m_portPairs.size() - 1; i >= 0; --i) {
+            m_portPairs.at(i).first->connectTo(m_portPairs.at(i).second);
+        }
+
+        m_scene->endTilesUpdate();
+    }
+
+    //! \copydoc MoveItemCmd::redo()
+    void DisconnectItemsCmd::redo()
+    {
+        m_scene->beginTilesUpdate();
+
+        foreach(const PortPair &p, m_portPairs) {
+            p.first->disconnect();
+        }
+
+        m_scene->endTilesUpdate();
+    }
+
+
     /*************************************************************************
      *                             InsertWireCmd                             *
      *************************************************************************/
@@ -199,23 +364,49 @@ namespace Caneda
         }
     }
 
+    /*!
+     * \brief Destructor.
+     *
+     * The removed items must be the same objects when the removal is undone,
+     * as the older commands of the stack refer to them. They are therefore
+     * kept alive while the command is in the stack, and deleted once the
+     * command leaves it (for example, when the undo limit drops it). Items
+     * back in the scene (the removal being undone) belong to the scene.
+     */
+    RemoveItemsCmd::~RemoveItemsCmd()
+    {
+        foreach(ItemPointPair p, m_itemPointPairs) {
+            if(!p.first->scene()) {
+                delete p.first;
+            }
+        }
+    }
+
     //! \copydoc MoveItemCmd::undo()
     void RemoveItemsCmd::undo()
     {
+        m_scene->beginTilesUpdate();
+
         foreach(ItemPointPair p, m_itemPointPairs) {
             m_scene->addItem(p.first);
             p.first->setPos(p.second);
             m_scene->connectItems(p.first);
         }
+
+        m_scene->endTilesUpdate();
     }
 
     //! \copydoc MoveItemCmd::redo()
     void RemoveItemsCmd::redo()
     {
+        m_scene->beginTilesUpdate();
+
         foreach(ItemPointPair p, m_itemPointPairs) {
             m_scene->disconnectItems(p.first);
             m_scene->removeItem(p.first);
         }
+
+        m_scene->endTilesUpdate();
     }
 
 
@@ -26,6 +26,7 @@
 
 #include <QPair>
 #include <QUndoCommand>
+#include <QVector>
 
 namespace Caneda
 {
@@ -38,6 +39,7 @@ namespace Caneda
     class Wire;
 
     typedef QPair<GraphicsItem*, QPointF> ItemPointPair;
+    typedef QPair<Port*, Port*> PortPair;
 
     /*!
      * \brief Move item command implementation of the QUndoCommand/QUndoStack
@@ -91,6 +93,47 @@ namespace Caneda
         QPointF m_finalPos;
     };
 
+    /*!
+     * \brief Move items command implementation of the QUndoCommand/QUndoStack
+     * pattern for Qt's Undo Framework.
+     *
+     * This command batches the movement of several items into a single undo
+     * step. Instead of keeping one MoveItemCmd per item, only the initial
+     * position of each item and the displacement applied are stored. When all
+     * items are displaced by the same amount (the usual case when dragging a
+     * selection) a single delta is kept for the whole operation.
+     *
+     * Consecutive moves of the same set of items are merged together through
+     * mergeWith(), so that repeatedly dragging a selection results in a single
+     * entry in the undo stack.
+     *
+     * \copydetails MoveItemCmd
+     */
+    class MoveItemsCmd : public QUndoCommand
+    {
+    public:
+        explicit MoveItemsCmd(const QList<GraphicsItem*> &items,
+                              const QList<QPointF> &init,
+                              const QList<QPointF> &final,
+                              GraphicsScene *scene,
+                              QUndoCommand *parent = 0);
+
+        void undo();
+        void redo();
+
+        int id() const;
+        bool mergeWith(const QUndoCommand *other);
+
+    private:
+        QPointF delta(int index) const;
+        void compactDeltas();
+
+        QList<GraphicsItem*> m_items;
+        QVector<QPointF> m_initialPositions;
+        QVector<QPointF> m_deltas;
+        GraphicsScene *const m_scene;
+    };
+
     /*!
      * \brief Disconnect command implementation of the QUndoCommand/QUndoStack
      * pattern for Qt's Undo Framework.
@@ -110,6 +153,30 @@ namespace Caneda
         Port *const m_port2;
     };
 
+    /*!
+     * \brief Disconnect items command implementation of the
+     * QUndoCommand/QUndoStack pattern for Qt's Undo Framework.
+     *
+     * This command batches several port disconnections into a single undo
+     * step, instead of pushing one DisconnectCmd per pair of ports.
+     *
+     * \copydetails MoveItemCmd
+     */
+    class DisconnectItemsCmd : public QUndoCommand
+    {
+    public:
+        explicit DisconnectItemsCmd(const QList<PortPair> &portPairs,
+                                    GraphicsScene *scene,
+                                    QUndoCommand *parent = 0);
+
+        void undo();
+        void redo();
+
+    private:
+        QList<PortPair> m_portPairs;
+        GraphicsScene *const m_scene;
+    };
+
     /*!
      * \brief Insert wire command implementation of the QUndoCommand/QUndoStack
      * pattern for Qt's Undo Framework.
@@ -166,6 +233,7 @@ namespace Caneda
         explicit RemoveItemsCmd(const QList<GraphicsItem*> &items,
                                 GraphicsScene *scene,
                                 QUndoCommand *parent = 0);
+        ~RemoveItemsCmd();
 
         void undo();
         void redo();
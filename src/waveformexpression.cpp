@@ -0,0 +1,815 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+#include "waveformexpression.h"
+
+#include "chartitem.h"
+
+#include <QObject>
+#include <QStringList>
+#include <QtMath>
+
+#include <cstring>
+
+namespace Caneda
+{
+    //! \brief Number of samples processed by each node in a single pass.
+    static const int blockSize = 4096;
+
+    /*!
+     * \brief Linearly resamples the waveform (\a x, \a y) onto \a base.
+     *
+     * Both abscissas are monotonic, so a single walk over the source samples
+     * is enough. Outside the source range, the first or last value is used.
+     */
+    static QVector<double> resample(const QVector<double> &x, const QVector<double> &y,
+                                    const QVector<double> &base)
+    {
+        QVector<double> result(base.size());
+        const int size = x.size();
+        int j = 0;
+
+        for(int i = 0; i < base.size(); ++i) {
+            const double t = base.at(i);
+
+            while(j < size && x.at(j) < t) {
+                ++j;
+            }
+
+            if(size == 0) {
+                result[i] = 0;
+            }
+            else if(j == 0) {
+                result[i] = y.at(0);
+            }
+            else if(j == size) {
+                result[i] = y.at(size - 1);
+            }
+            else {
+                const double dx = x.at(j) - x.at(j - 1);
+                result[i] = dx != 0 ? y.at(j - 1) + (y.at(j) - y.at(j - 1)) * (t - x.at(j - 1)) / dx
+                                    : y.at(j);
+            }
+        }
+
+        return result;
+    }
+
+    /*************************************************************************
+     *                          WaveformExpression                           *
+     *************************************************************************/
+    //! \brief Node of a compiled expression.
+    struct WaveformExpression::Node
+    {
+        enum Kind {
+            Constant,
+            Abscissa,
+            Waveform,
+            Negate,
+            Add,
+            Subtract,
+            Multiply,
+            Divide,
+            Power,
+            Function,
+            Derivative,
+            Integral
+        };
+
+        enum FunctionType {
+            Abs,
+            Sqrt,
+            Exp,
+            Ln,
+            Log10,
+            Db,
+            Sin,
+            Cos,
+            Tan,
+            Atan
+        };
+
+        explicit Node(Kind k) : kind(k), function(Abs), value(0), column(-1), left(0), right(0) {}
+
+        Kind kind;
+        FunctionType function;
+        double value;              //! \brief Value of constant nodes
+        int column;                //! \brief Index of the waveform of waveform nodes
+        Node *left;                //! \brief First (or only) operand
+        Node *right;               //! \brief Second operand of binary operators
+        QVector<double> scratch;   //! \brief Block buffer for an operand
+        QVector<double> result;    //! \brief Whole result of integral nodes
+    };
+
+    //! \brief Constructor.
+    WaveformExpression::WaveformExpression() :
+        m_position(0),
+        m_root(0),
+        m_margin(0)
+    {
+    }
+
+    //! \brief Destructor.
+    WaveformExpression::~WaveformExpression()
+    {
+        clear();
+    }
+
+    /*!
+     * \brief Parses an expression and resolves the referenced waveforms.
+     *
+     * \param text Expression to compile.
+     * \param curves Waveforms that can be referenced by the expression.
+     * \param errorMessage If not null, set to a description of the error on
+     * failure.
+     * \return True on success, false otherwise.
+     */
+    bool WaveformExpression::compile(const QString &text, const QList<ChartSeries*> &curves,
+                                     QString *errorMessage)
+    {
+        clear();
+
+        m_text = text;
+        m_curves = curves;
+        m_position = 0;
+        m_error.clear();
+
+        m_root = parseSum();
+        skipSpaces();
+
+        if(m_root && m_position < m_text.size()) {
+            m_error = QObject::tr("Unexpected \"%1\" at position %2.")
+                    .arg(m_text.at(m_position)).arg(m_position + 1);
+            m_root = 0;
+        }
+
+        if(m_root && m_columns.isEmpty()) {
+            m_error = QObject::tr("The expression does not reference any waveform.");
+            m_root = 0;
+        }
+
+        m_curves.clear();
+
+        if(!m_root) {
+            if(errorMessage) {
+                *errorMessage = m_error;
+            }
+            clear();
+            return false;
+        }
+
+        // Each derivative looks one sample back, the buffers must leave
+        // room for the worst case of nested derivatives.
+        m_margin = 0;
+        foreach(Node *node, m_nodes) {
+            if(node->kind == Node::Derivative) {
+                ++m_margin;
+            }
+        }
+
+        m_base = m_columns.first().x;
+        return true;
+    }
+
+    /*!
+     * \brief Evaluates the compiled expression.
+     *
+     * \param x Returns the time base of the result.
+     * \param y Returns the values of the result.
+     */
+    void WaveformExpression::evaluate(QVector<double> *x, QVector<double> *y)
+    {
+        if(!m_root) {
+            return;
+        }
+
+        const int size = m_base.size();
+
+        // Resample the waveforms not sampled on the common time base
+        for(int i = 0; i < m_columns.size(); ++i) {
+            Column &column = m_columns[i];
+            if(column.x.constData() != m_base.constData() && column.x != m_base) {
+                column.y = resample(column.x, column.y, m_base);
+                column.x = m_base;
+            }
+        }
+
+        // Allocate the block buffers
+        foreach(Node *node, m_nodes) {
+            if(node->right || node->kind == Node::Derivative) {
+                node->scratch.resize(blockSize + m_margin);
+            }
+        }
+
+        // Integrals depend on all previous samples, so they are computed
+        // beforehand. Nodes are created after their operands, so inner
+        // integrals are materialized first.
+        foreach(Node *node, m_nodes) {
+            if(node->kind == Node::Integral) {
+                materialize(node);
+            }
+        }
+
+        y->resize(size);
+        for(int start = 0; start < size; start += blockSize) {
+            evaluateBlock(m_root, start, qMin(blockSize, size - start), y->data() + start);
+        }
+
+        *x = m_base;
+    }
+
+    /*!
+     * \brief Evaluates the samples \a start to \a start + \a count of the
+     * subexpression \a node into \a out.
+     */
+    void WaveformExpression::evaluateBlock(Node *node, int start, int count, double *out)
+    {
+        switch(node->kind) {
+
+        case Node::Constant:
+            for(int i = 0; i < count; ++i) {
+                out[i] = node->value;
+            }
+            break;
+
+        case Node::Abscissa:
+            std::memcpy(out, m_base.constData() + start, count * sizeof(double));
+            break;
+
+        case Node::Waveform:
+            std::memcpy(out, m_columns.at(node->column).y.constData() + start, count * sizeof(double));
+            break;
+
+        case Node::Integral:
+            std::memcpy(out, node->result.constData() + start, count * sizeof(double));
+            break;
+
+        case Node::Negate:
+            evaluateBlock(node->left, start, count, out);
+            for(int i = 0; i < count; ++i) {
+                out[i] = -out[i];
+            }
+            break;
+
+        case Node::Add:
+        case Node::Subtract:
+        case Node::Multiply:
+        case Node::Divide:
+        case Node::Power:
+        {
+            double *operand = node->scratch.data();
+            evaluateBlock(node->left, start, count, out);
+            evaluateBlock(node->right, start, count, operand);
+
+            switch(node->kind) {
+            case Node::Add:
+                for(int i = 0; i < count; ++i) { out[i] += operand[i]; }
+                break;
+            case Node::Subtract:
+                for(int i = 0; i < count; ++i) { out[i] -= operand[i]; }
+                break;
+            case Node::Multiply:
+                for(int i = 0; i < count; ++i) { out[i] *= operand[i]; }
+                break;
+            case Node::Divide:
+                for(int i = 0; i < count; ++i) { out[i] /= operand[i]; }
+                break;
+            default:
+                for(int i = 0; i < count; ++i) { out[i] = qPow(out[i], operand[i]); }
+                break;
+            }
+            break;
+        }
+
+        case Node::Function:
+            evaluateBlock(node->left, start, count, out);
+
+            switch(node->function) {
+            case Node::Abs:
+                for(int i = 0; i < count; ++i) { out[i] = qAbs(out[i]); }
+                break;
+            case Node::Sqrt:
+                for(int i = 0; i < count; ++i) { out[i] = qSqrt(out[i]); }
+                break;
+            case Node::Exp:
+                for(int i = 0; i < count; ++i) { out[i] = qExp(out[i]); }
+                break;
+            case Node::Ln:
+                for(int i = 0; i < count; ++i) { out[i] = qLn(out[i]); }
+                break;
+            case Node::Log10:
+                for(int i = 0; i < count; ++i) { out[i] = log10(out[i]); }
+                break;
+            case Node::Db:
+                for(int i = 0; i < count; ++i) { out[i] = 20 * log10(qAbs(out[i])); }
+                break;
+            case Node::Sin:
+                for(int i = 0; i < count; ++i) { out[i] = qSin(out[i]); }
+                break;
+            case Node::Cos:
+                for(int i = 0; i < count; ++i) { out[i] = qCos(out[i]); }
+                break;
+            case Node::Tan:
+                for(int i = 0; i < count; ++i) { out[i] = qTan(out[i]); }
+                break;
+            case Node::Atan:
+                for(int i = 0; i < count; ++i) { out[i] = qAtan(out[i]); }
+                break;
+            }
+            break;
+
+        case Node::Derivative:
+        {
+            // Backward differences, looking one sample before the block
+            const int first = start > 0 ? start - 1 : 0;
+            const int offset = start - first;
+            double *y = node->scratch.data();
+            const double *x = m_base.constData() + first;
+
+            evaluateBlock(node->left, first, count + offset, y);
+
+            for(int i = 0; i < count; ++i) {
+                const int j = i + offset;
+                if(j == 0) {
+                    out[i] = 0;
+                    continue;
+                }
+
+                const double dx = x[j] - x[j - 1];
+                out[i] = dx != 0 ? (y[j] - y[j - 1]) / dx : (i > 0 ? out[i - 1] : 0);
+            }
+
+            // The first sample has no previous one, use the next difference
+            if(start == 0 && count > 1) {
+                out[0] = out[1];
+            }
+            break;
+        }
+        }
+    }
+
+    //! \brief Computes the whole running integral of an integral node.
+    void WaveformExpression::materialize(Node *node)
+    {
+        const int size = m_base.size();
+        const double *x = m_base.constData();
+
+        node->result.resize(size);
+        double *y = node->result.data();
+
+        for(int start = 0; start < size; start += blockSize) {
+            evaluateBlock(node->left, start, qMin(blockSize, size - start), y + start);
+        }
+
+        // Trapezoidal rule, in place
+        double previous = size > 0 ? y[0] : 0;
+        double sum = 0;
+        for(int i = 0; i < size; ++i) {
+            const double current = y[i];
+            if(i > 0) {
+                sum += 0.5 * (previous + current) * (x[i] - x[i - 1]);
+            }
+            y[i] = sum;
+            previous = current;
+        }
+    }
+
+    //! \brief Releases the compiled expression.
+    void WaveformExpression::clear()
+    {
+        qDeleteAll(m_nodes);
+        m_nodes.clear();
+        m_columns.clear();
+        m_root = 0;
+        m_base.clear();
+    }
+
+    /*************************************************************************
+     *                                Parser                                 *
+     *************************************************************************/
+    //! \brief Skips white space in the expression text.
+    void WaveformExpression::skipSpaces()
+    {
+        while(m_position < m_text.size() && m_text.at(m_position).isSpace()) {
+            ++m_position;
+        }
+    }
+
+    //! \brief Parses additions and subtractions.
+    WaveformExpression::Node* WaveformExpression::parseSum()
+    {
+        Node *left = parseProduct();
+
+        while(left) {
+            skipSpaces();
+            if(m_position >= m_text.size()) {
+                break;
+            }
+
+            const QChar op = m_text.at(m_position);
+            if(op != '+' && op != '-') {
+                break;
+            }
+            ++m_position;
+
+            Node *right = parseProduct();
+            if(!right) {
+                return 0;
+            }
+
+            Node *node = new Node(op == '+' ? Node::Add : Node::Subtract);
+            m_nodes.append(node);
+            node->left = left;
+            node->right = right;
+            left = node;
+        }
+
+        return left;
+    }
+
+    //! \brief Parses products and divisions.
+    WaveformExpression::Node* WaveformExpression::parseProduct()
+    {
+        Node *left = parseUnary();
+
+        while(left) {
+            skipSpaces();
+            if(m_position >= m_text.size()) {
+                break;
+            }
+
+            const QChar op = m_text.at(m_position);
+            if(op != '*' && op != '/') {
+                break;
+            }
+            ++m_position;
+
+            Node *right = parseUnary();
+            if(!right) {
+                return 0;
+            }
+
+            Node *node = new Node(op == '*' ? Node::Multiply : Node::Divide);
+            m_nodes.append(node);
+            node->left = left;
+            node->right = right;
+            left = node;
+        }
+
+        return left;
+    }
+
+    //! \brief Parses the unary sign operators.
+    WaveformExpression::Node* WaveformExpression::parseUnary()
+    {
+        skipSpaces();
+
+        if(m_position < m_text.size() && m_text.at(m_position) == '-') {
+            ++m_position;
+
+            Node *operand = parseUnary();
+            if(!operand) {
+                return 0;
+            }
+
+            Node *node = new Node(Node::Negate);
+            m_nodes.append(node);
+            node->left = operand;
+            return node;
+        }
+
+        if(m_position < m_text.size() && m_text.at(m_position) == '+') {
+            ++m_position;
+            return parseUnary();
+        }
+
+        return parsePower();
+    }
+
+    //! \brief Parses the (right associative) power operator.
+    WaveformExpression::Node* WaveformExpression::parsePower()
+    {
+        Node *base = parsePrimary();
+        if(!base) {
+            return 0;
+        }
+
+        skipSpaces();
+        if(m_position < m_text.size() && m_text.at(m_position) == '^') {
+            ++m_position;
+
+            Node *exponent = parseUnary();
+            if(!exponent) {
+                return 0;
+            }
+
+            Node *node = new Node(Node::Power);
+            m_nodes.append(node);
+            node->left = base;
+            node->right = exponent;
+            return node;
+        }
+
+        return base;
+    }
+
+    /*!
+     * \brief Parses numbers, parenthesized expressions, function calls and
+     * waveform references.
+     */
+    WaveformExpression::Node* WaveformExpression::parsePrimary()
+    {
+        skipSpaces();
+
+        if(m_position >= m_text.size()) {
+            m_error = QObject::tr("Unexpected end of expression.");
+            return 0;
+        }
+
+        QChar c = m_text.at(m_position);
+
+        // Parenthesized expression
+        if(c == '(') {
+            ++m_position;
+            Node *node = parseSum();
+            skipSpaces();
+            if(!node) {
+                return 0;
+            }
+            if(m_position >= m_text.size() || m_text.at(m_position) != ')') {
+                m_error = QObject::tr("Missing \")\" at position %1.").arg(m_position + 1);
+                return 0;
+            }
+            ++m_position;
+            return node;
+        }
+
+        // Numbers, with optional exponent and engineering suffix
+        if(c.isDigit() || c == '.') {
+            const int begin = m_position;
+            while(m_position < m_text.size() &&
+                  (m_text.at(m_position).isDigit() || m_text.at(m_position) == '.')) {
+                ++m_position;
+            }
+            if(m_position + 1 < m_text.size() && m_text.at(m_position).toLower() == 'e' &&
+                    (m_text.at(m_position + 1).isDigit() ||
+                     ((m_text.at(m_position + 1) == '+' || m_text.at(m_position + 1) == '-') &&
+                      m_position + 2 < m_text.size() && m_text.at(m_position + 2).isDigit()))) {
+                m_position += 2;
+                while(m_position < m_text.size() && m_text.at(m_position).isDigit()) {
+                    ++m_position;
+                }
+            }
+
+            bool ok = false;
+            double value = m_text.mid(begin, m_position - begin).toDouble(&ok);
+            if(!ok) {
+                m_error = QObject::tr("Invalid number at position %1.").arg(begin + 1);
+                return 0;
+            }
+
+            if(m_text.mid(m_position, 3).toLower() == "meg") {
+                value *= 1e6;
+                m_position += 3;
+            }
+            else if(m_position < m_text.size()) {
+                const QString suffixes = "fpnumkgt";
+                const double factors[] = { 1e-15, 1e-12, 1e-9, 1e-6, 1e-3, 1e3, 1e9, 1e12 };
+                const int index = suffixes.indexOf(m_text.at(m_position).toLower());
+                if(index >= 0) {
+                    value *= factors[index];
+                    ++m_position;
+                }
+            }
+
+            Node *node = new Node(Node::Constant);
+            m_nodes.append(node);
+            node->value = value;
+            return node;
+        }
+
+        // Derivative in its usual notation
+        if(m_text.mid(m_position, 4).toLower() == "d/dt") {
+            m_position += 4;
+            skipSpaces();
+            if(m_position >= m_text.size() || m_text.at(m_position) != '(') {
+                m_error = QObject::tr("Expected \"(\" after d/dt.");
+                return 0;
+            }
+
+            Node *operand = parsePrimary();
+            if(!operand) {
+                return 0;
+            }
+
+            Node *node = new Node(Node::Derivative);
+            m_nodes.append(node);
+            node->left = operand;
+            return node;
+        }
+
+        if(!c.isLetter() && c != '_') {
+            m_error = QObject::tr("Unexpected \"%1\" at position %2.").arg(c).arg(m_position + 1);
+            return 0;
+        }
+
+        // Identifiers: function names, constants or waveform names
+        const int begin = m_position;
+        while(m_position < m_text.size()) {
+            c = m_text.at(m_position);
+            if(!c.isLetterOrNumber() && c != '_' && c != '#' && c != '.' && c != ':') {
+                break;
+            }
+            ++m_position;
+        }
+        const QString identifier = m_text.mid(begin, m_position - begin).toLower();
+
+        skipSpaces();
+        const bool call = m_position < m_text.size() && m_text.at(m_position) == '(';
+
+        if(call) {
+            static QStringList functions;
+            if(functions.isEmpty()) {
+                functions << "abs" << "sqrt" << "exp" << "ln" << "log10" << "db"
+                          << "sin" << "cos" << "tan" << "atan";
+            }
+
+            int function = functions.indexOf(identifier);
+            if(identifier == "log") {
+                function = Node::Log10;
+            }
+
+            if(function >= 0 || identifier == "deriv" || identifier == "integ") {
+                Node *operand = parsePrimary();  // Parenthesized argument
+                if(!operand) {
+                    return 0;
+                }
+
+                Node *node;
+                if(identifier == "deriv") {
+                    node = new Node(Node::Derivative);
+                }
+                else if(identifier == "integ") {
+                    node = new Node(Node::Integral);
+                }
+                else {
+                    node = new Node(Node::Function);
+                    node->function = static_cast<Node::FunctionType>(function);
+                }
+                m_nodes.append(node);
+                node->left = operand;
+                return node;
+            }
+
+            // Waveform names as v(out) or i(v1), including nested parenthesis
+            int depth = 0;
+            const int nameBegin = m_position;
+            do {
+                if(m_text.at(m_position) == '(') {
+                    ++depth;
+                }
+                else if(m_text.at(m_position) == ')') {
+                    --depth;
+                }
+                ++m_position;
+            } while(depth > 0 && m_position < m_text.size());
+
+            if(depth > 0) {
+                m_error = QObject::tr("Missing \")\" at position %1.").arg(m_position + 1);
+                return 0;
+            }
+
+            return parseWaveform(identifier + m_text.mid(nameBegin, m_position - nameBegin));
+        }
+
+        if(identifier == "time" || identifier == "frequency") {
+            Node *node = new Node(Node::Abscissa);
+            m_nodes.append(node);
+            return node;
+        }
+
+        if(identifier == "pi") {
+            Node *node = new Node(Node::Constant);
+            m_nodes.append(node);
+            node->value = M_PI;
+            return node;
+        }
+
+        return parseWaveform(identifier);
+    }
+
+    /*!
+     * \brief Resolves a reference to the waveform \a name.
+     *
+     * The samples of the waveform are shared with the curve when possible,
+     * so referencing a waveform does not copy its data.
+     */
+    WaveformExpression::Node* WaveformExpression::parseWaveform(const QString &name)
+    {
+        QString key = name;
+        key.remove(' ');
+
+        ChartSeries *curve = 0;
+        foreach(ChartSeries *item, m_curves) {
+            QString title = item->title().text();
+            title.remove(' ');
+            if(title.compare(key, Qt::CaseInsensitive) == 0) {
+                curve = item;
+                break;
+            }
+        }
+
+        if(!curve) {
+            m_error = QObject::tr("Unknown waveform \"%1\".").arg(name);
+            return 0;
+        }
+
+        if(m_columns.isEmpty()) {
+            m_type = curve->type();
+        }
+
+        Column column;
+        curve->samples(&column.x, &column.y);
+        m_columns.append(column);
+
+        Node *node = new Node(Node::Waveform);
+        m_nodes.append(node);
+        node->column = m_columns.size() - 1;
+        return node;
+    }
+
+
+    /*************************************************************************
+     *                        WaveformExpressionData                         *
+     *************************************************************************/
+    /*!
+     * \brief Constructor.
+     *
+     * \param expression Compiled expression, owned by this object.
+     */
+    WaveformExpressionData::WaveformExpressionData(WaveformExpression *expression) :
+        m_expression(expression),
+        m_evaluated(false)
+    {
+    }
+
+    //! \brief Destructor.
+    WaveformExpressionData::~WaveformExpressionData()
+    {
+        delete m_expression;
+    }
+
+    size_t WaveformExpressionData::size() const
+    {
+        return m_evaluated ? m_x.size() : m_expression->size();
+    }
+
+    QPointF WaveformExpressionData::sample(size_t i) const
+    {
+        evaluate();
+        return QPointF(m_x.at(static_cast<int>(i)), m_y.at(static_cast<int>(i)));
+    }
+
+    QRectF WaveformExpressionData::boundingRect() const
+    {
+        evaluate();
+        if(d_boundingRect.width() < 0.0) {
+            d_boundingRect = qwtBoundingRect(*this);
+        }
+
+        return d_boundingRect;
+    }
+
+    //! \brief Evaluates the expression, if not done yet.
+    void WaveformExpressionData::evaluate() const
+    {
+        if(m_evaluated) {
+            return;
+        }
+
+        m_expression->evaluate(&m_x, &m_y);
+        m_evaluated = true;
+
+        // The compiled expression holds references to the source waveforms
+        // (and resampled copies), they are not needed anymore.
+        delete m_expression;
+        m_expression = 0;
+    }
+
+} // namespace Caneda
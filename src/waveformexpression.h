@@ -0,0 +1,149 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+#ifndef WAVEFORM_EXPRESSION_H
+#define WAVEFORM_EXPRESSION_H
+
+#include <QList>
+#include <QString>
+#include <QVector>
+
+#include <qwt_series_data.h>
+
+namespace Caneda
+{
+    // Forward declarations
+    class ChartSeries;
+
+    /*!
+     * \brief This class compiles and evaluates expressions over simulation
+     * waveforms, to create derived traces.
+     *
+     * Expressions combine waveforms, referenced by their name (for example
+     * v(out) or i(v1), case insensitive), numeric constants and the
+     * abscissa (\a time or \a frequency) using the following elements:
+     * \li Operators: + - * / ^ and unary minus.
+     * \li Functions: abs, sqrt, exp, ln, log10 (or log), db (20*log10(abs)),
+     * sin, cos, tan, atan.
+     * \li Calculus: deriv (or d/dt) and integ.
+     *
+     * For example: v(out)-v(in), i(r1)*v(n1), d/dt(v(out)) or
+     * 20*log10(abs(v(out)/v(in))).
+     *
+     * compile() parses the expression into a tree of nodes and resolves the
+     * referenced waveforms, but does not compute anything. evaluate() runs
+     * the tree over blocks of samples: each node processes a whole block
+     * with a simple loop over contiguous arrays, which the compiler can
+     * vectorize, and the block size keeps the temporary buffers in cache.
+     *
+     * The abscissa of the first referenced waveform is used as the common
+     * time base. Waveforms sampled on a different base are linearly
+     * resampled onto it before evaluation.
+     *
+     * \sa WaveformExpressionData, ChartView::addDerivedTrace()
+     */
+    class WaveformExpression
+    {
+    public:
+        WaveformExpression();
+        ~WaveformExpression();
+
+        bool compile(const QString &text, const QList<ChartSeries*> &curves,
+                     QString *errorMessage = 0);
+
+        //! \brief Returns the expression text
+        QString text() const { return m_text; }
+        //! \brief Returns the type of the first referenced waveform
+        QString type() const { return m_type; }
+        //! \brief Returns the number of samples of the result
+        int size() const { return m_base.size(); }
+
+        void evaluate(QVector<double> *x, QVector<double> *y);
+
+    private:
+        struct Node;
+        struct Column
+        {
+            QVector<double> x;
+            QVector<double> y;
+        };
+
+        // Parser
+        Node* parseSum();
+        Node* parseProduct();
+        Node* parseUnary();
+        Node* parsePower();
+        Node* parsePrimary();
+        Node* parseWaveform(const QString &name);
+        void skipSpaces();
+
+        // Evaluation
+        void evaluateBlock(Node *node, int start, int count, double *out);
+        void materialize(Node *node);
+
+        void clear();
+
+        QString m_text;
+        QString m_type;
+
+        // Parser state
+        int m_position;
+        QString m_error;
+        QList<ChartSeries*> m_curves;
+
+        Node *m_root;
+        QList<Node*> m_nodes;    //! \brief All nodes (for memory management)
+        QList<Column> m_columns; //! \brief Referenced waveforms
+
+        QVector<double> m_base;  //! \brief Common time base
+        int m_margin;            //! \brief Look-back samples needed by deriv
+    };
+
+    /*!
+     * \brief Series data of a derived trace, evaluated on first use.
+     *
+     * The expression is not evaluated when the derived trace is created,
+     * but the first time the plot requests its samples (usually when the
+     * trace is drawn for the first time). The result is then kept for the
+     * lifetime of the trace.
+     *
+     * \sa WaveformExpression
+     */
+    class WaveformExpressionData : public QwtSeriesData<QPointF>
+    {
+    public:
+        explicit WaveformExpressionData(WaveformExpression *expression);
+        virtual ~WaveformExpressionData();
+
+        virtual size_t size() const;
+        virtual QPointF sample(size_t i) const;
+        virtual QRectF boundingRect() const;
+
+    private:
+        void evaluate() const;
+
+        mutable WaveformExpression *m_expression;
+        mutable bool m_evaluated;
+        mutable QVector<double> m_x;
+        mutable QVector<double> m_y;
+    };
+
+} // namespace Caneda
+
+#endif //WAVEFORM_EXPRESSION_H
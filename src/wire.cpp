@@ -140,15 +140,21 @@ namespace Caneda
         // Save pen
         QPen savedPen = painter->pen();
 
-        // Set global pen settings
+        // Set global pen settings. At low zoom levels a single pixel pen is used.
         Settings *settings = Settings::instance();
+        qreal lod = option->levelOfDetailFromTransform(painter->worldTransform());
+        int lineWidth = settings->currentValue("gui/lineWidth").toInt();
+        if(lod < settings->currentValue("gui/lodDetailThreshold").toDouble()) {
+            lineWidth = 0;
+        }
+
         if(option->state & QStyle::State_Selected) {
             painter->setPen(QPen(settings->currentValue("gui/selectionColor").value<QColor>(),
-                                 settings->currentValue("gui/lineWidth").toInt()));
+                                 lineWidth));
         }
         else {
             painter->setPen(QPen(settings->currentValue("gui/lineColor").value<QColor>(),
-                                 settings->currentValue("gui/lineWidth").toInt()));
+                                 lineWidth));
         }
 
         // Draw the wire
@@ -156,6 +162,9 @@ namespace Caneda
 
         // Restore pen
         painter->setPen(savedPen);
+
+        // Draw the ports
+        paintPorts(painter);
     }
 
     //! \copydoc GraphicsItem::copy()
@@ -168,19 +177,28 @@ namespace Caneda
         return wire;
     }
 
+    //! \brief Returns a copy of the data saved by the wire, see saveData().
+    WireSnapshot Wire::snapshot() const
+    {
+        WireSnapshot snapshot;
+        snapshot.start = port1()->scenePos();
+        snapshot.end = port2()->scenePos();
+        return snapshot;
+    }
+
     //! \copydoc GraphicsItem::saveData()
     void Wire::saveData(Caneda::XmlWriter *writer) const
     {
-        writer->writeStartElement("wire");
-
-        QPointF p1 = port1()->scenePos();
-        QPointF p2 = port2()->scenePos();
+        snapshot().write(writer);
+    }
 
-        QString start = QString("%1,%2").arg(p1.x()).arg(p1.y());
-        QString end = QString("%1,%2").arg(p2.x()).arg(p2.y());
+    //! \brief Writes the wire to xml, see Wire::saveData().
+    void WireSnapshot::write(Caneda::XmlWriter *writer) const
+    {
+        writer->writeStartElement("wire");
 
-        writer->writeAttribute("start", start);
-        writer->writeAttribute("end", end);
+        writer->writeAttribute("start", QString("%1,%2").arg(start.x()).arg(start.y()));
+        writer->writeAttribute("end", QString("%1,%2").arg(end.x()).arg(end.y()));
 
         writer->writeEndElement();
     }
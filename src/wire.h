@@ -28,6 +28,20 @@ namespace Caneda
     // Forward declarations
     class GraphicsItem;
 
+    /*!
+     * \brief Copy of the data saved by a Wire, which can be written from any
+     * thread.
+     *
+     * \sa Wire::snapshot(), Wire::saveData()
+     */
+    struct WireSnapshot
+    {
+        QPointF start;  //! \brief Scene position of the first port
+        QPointF end;    //! \brief Scene position of the second port
+
+        void write(Caneda::XmlWriter *writer) const;
+    };
+
     /*!
      * \brief The Wire class forms part of one of the GraphicsItem
      * derived classes available on Caneda. It represents a wire on schematic,
@@ -72,6 +86,7 @@ namespace Caneda
 
         Wire* copy() const;
 
+        WireSnapshot snapshot() const;
         void saveData(Caneda::XmlWriter *writer) const;
         void loadData(Caneda::XmlReader *reader);
 
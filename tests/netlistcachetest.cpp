@@ -0,0 +1,294 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+#include "component.h"
+#include "fileformats.h"
+#include "graphicsscene.h"
+#include "idocument.h"
+#include "library.h"
+#include "netlistcache.h"
+#include "port.h"
+#include "portsymbol.h"
+#include "property.h"
+#include "wire.h"
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+using namespace Caneda;
+
+/*!
+ * \brief Checks that the netlist generated incrementally through the
+ * NetlistCache is always equivalent to a netlist generated from scratch.
+ *
+ * A schematic is edited with a long random (but repeatable) sequence of
+ * edits: components, wires and port symbols are added, removed, moved and
+ * rotated, and properties and labels changed. From time to time the
+ * netlist is generated with the cache of the scene, and checked against
+ * an uncached generation:
+ * \li The nets of the scene cache must group the ports exactly as the nets
+ * numbered from scratch with an empty cache. The nets named after port
+ * symbols must have the same names, while the numbered ones may have
+ * different numbers, as the incremental numbering keeps the numbers of the
+ * nets across edits.
+ * \li The netlist must be identical to the one generated with the same nets
+ * but without any cached fragment.
+ */
+class NetlistCacheTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void randomEdits_data();
+    void randomEdits();
+
+private:
+    void compareNets(const QHash<Port*, QString> &nets,
+                     const QHash<Port*, QString> &expected);
+
+    QPointF randomPos() const;
+    GraphicsItem* randomItem(GraphicsScene *scene) const;
+
+    void addComponent(GraphicsScene *scene);
+    void addWire(GraphicsScene *scene);
+    void addPortSymbol(GraphicsScene *scene);
+    void removeItem(GraphicsScene *scene);
+    void moveItem(GraphicsScene *scene);
+    void rotateItem(GraphicsScene *scene);
+    void changeProperty(GraphicsScene *scene);
+    void renamePortSymbol(GraphicsScene *scene);
+
+    int m_labelCount;
+};
+
+//! \brief Loads the passive components library.
+void NetlistCacheTest::initTestCase()
+{
+    QVERIFY(LibraryManager::instance()->load(QString(CANEDA_LIBRARIES_DIR) + "/passive"));
+    m_labelCount = 0;
+}
+
+void NetlistCacheTest::randomEdits_data()
+{
+    QTest::addColumn<uint>("seed");
+
+    QTest::newRow("seed 1") << 1u;
+    QTest::newRow("seed 2") << 2u;
+    QTest::newRow("seed 3") << 3u;
+}
+
+void NetlistCacheTest::randomEdits()
+{
+    QFETCH(uint, seed);
+    qsrand(seed);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    SchematicDocument document;
+    document.setFileName(dir.path() + "/test.xsch");
+    GraphicsScene *scene = document.graphicsScene();
+    NetlistCache *cache = scene->netlistCache();
+
+    FormatSpice format(&document);
+
+    for(int step = 0; step < 400; ++step) {
+        switch(qrand() % 8) {
+        case 0: addComponent(scene); break;
+        case 1: addWire(scene); break;
+        case 2: addPortSymbol(scene); break;
+        case 3: removeItem(scene); break;
+        case 4: moveItem(scene); break;
+        case 5: rotateItem(scene); break;
+        case 6: changeProperty(scene); break;
+        case 7: renamePortSymbol(scene); break;
+        }
+
+        // Only generate the netlist from time to time, so several edits
+        // are accumulated in the cache as while editing
+        if(qrand() % 3) {
+            continue;
+        }
+
+        QString incremental = format.generateNetlist();
+
+        // Number the nets from scratch, in an empty cache
+        NetlistCache uncached;
+        QString complete = format.generateNetlist(&uncached, 0);
+        compareNets(cache->nets(), uncached.nets());
+        QVERIFY(!QTest::currentTestFailed());
+
+        if(cache->nets() == uncached.nets()) {
+            QCOMPARE(incremental, complete);
+        }
+
+        // Generate all the fragments again, with the nets of the scene
+        NetlistCache regenerated = *cache;
+        QList<QGraphicsItem*> items = scene->items();
+        foreach(Component *component, filterItems<Component>(items)) {
+            regenerated.invalidateComponent(component);
+        }
+        QCOMPARE(incremental, format.generateNetlist(&regenerated, 0));
+    }
+}
+
+/*!
+ * \brief Compares the nets of the ports in \a nets with those in
+ * \a expected.
+ *
+ * Both must hold the same ports, grouped in the same nets. Nets named
+ * after port symbols must have the same name in both, while numbered nets
+ * may have different numbers.
+ */
+void NetlistCacheTest::compareNets(const QHash<Port*, QString> &nets,
+                                   const QHash<Port*, QString> &expected)
+{
+    QCOMPARE(nets.size(), expected.size());
+
+    QHash<QString, QString> names;
+    QHash<QString, QString> expectedNames;
+
+    QHash<Port*, QString>::const_iterator it;
+    for(it = expected.constBegin(); it != expected.constEnd(); ++it) {
+        QVERIFY(nets.contains(it.key()));
+        const QString name = nets.value(it.key());
+
+        bool isNumber = false;
+        const int number = it.value().toInt(&isNumber);
+        if(!isNumber || number <= 0) {
+            QCOMPARE(name, it.value());
+        }
+
+        // One net in one of the groupings must be one net in the other
+        QCOMPARE(names.value(it.value(), name), name);
+        QCOMPARE(expectedNames.value(name, it.value()), it.value());
+        names.insert(it.value(), name);
+        expectedNames.insert(name, it.value());
+    }
+}
+
+//! \brief Returns a random position on a small grid, so ports often coincide.
+QPointF NetlistCacheTest::randomPos() const
+{
+    return QPointF(20 * (qrand() % 10 - 5), 20 * (qrand() % 10 - 5));
+}
+
+//! \brief Returns a random schematic item of \a scene, or 0 if there is none.
+GraphicsItem* NetlistCacheTest::randomItem(GraphicsScene *scene) const
+{
+    QList<QGraphicsItem*> sceneItems = scene->items();
+    QList<GraphicsItem*> items = filterItems<GraphicsItem>(sceneItems);
+    return items.isEmpty() ? 0 : items.at(qrand() % items.size());
+}
+
+void NetlistCacheTest::addComponent(GraphicsScene *scene)
+{
+    static const char *names[] = { "Resistor", "Capacitor", "Inductor" };
+
+    ComponentDataPtr data = LibraryManager::instance()->componentData(names[qrand() % 3], "Passive");
+    QVERIFY(data.constData());
+
+    Component *component = new Component();
+    component->setComponentData(data);
+    component->setLabel(component->labelPrefix() + QString::number(++m_labelCount));
+    component->setPos(randomPos());
+
+    scene->addItem(component);
+    scene->connectItems(component);
+}
+
+void NetlistCacheTest::addWire(GraphicsScene *scene)
+{
+    Wire *wire = new Wire(randomPos(), randomPos());
+    scene->addItem(wire);
+    scene->connectItems(wire);
+}
+
+void NetlistCacheTest::addPortSymbol(GraphicsScene *scene)
+{
+    static const char *labels[] = { "Ground", "in", "out" };
+
+    PortSymbol *portSymbol = new PortSymbol();
+    portSymbol->setLabel(labels[qrand() % 3]);
+    portSymbol->setPos(randomPos());
+
+    scene->addItem(portSymbol);
+    scene->connectItems(portSymbol);
+}
+
+void NetlistCacheTest::removeItem(GraphicsScene *scene)
+{
+    GraphicsItem *item = randomItem(scene);
+    if(item) {
+        scene->disconnectItems(item);
+        scene->removeItem(item);
+        delete item;
+    }
+}
+
+void NetlistCacheTest::moveItem(GraphicsScene *scene)
+{
+    GraphicsItem *item = randomItem(scene);
+    if(item) {
+        scene->disconnectItems(item);
+        item->setPos(randomPos());
+        scene->connectItems(item);
+    }
+}
+
+void NetlistCacheTest::rotateItem(GraphicsScene *scene)
+{
+    GraphicsItem *item = randomItem(scene);
+    if(item) {
+        scene->disconnectItems(item);
+        item->rotate(Caneda::Clockwise, item->pos());
+        scene->connectItems(item);
+    }
+}
+
+void NetlistCacheTest::changeProperty(GraphicsScene *scene)
+{
+    QList<QGraphicsItem*> items = scene->items();
+    QList<Component*> components = filterItems<Component>(items);
+    if(components.isEmpty()) {
+        return;
+    }
+
+    Component *component = components.at(qrand() % components.size());
+    QStringList keys = component->properties()->propertyMap().keys();
+    keys.removeAll("label");
+    if(!keys.isEmpty()) {
+        component->properties()->setPropertyValue(keys.at(qrand() % keys.size()),
+                                                  QString::number(qrand() % 100));
+    }
+}
+
+void NetlistCacheTest::renamePortSymbol(GraphicsScene *scene)
+{
+    QList<QGraphicsItem*> items = scene->items();
+    QList<PortSymbol*> portSymbols = filterItems<PortSymbol>(items);
+    if(!portSymbols.isEmpty()) {
+        PortSymbol *portSymbol = portSymbols.at(qrand() % portSymbols.size());
+        portSymbol->setLabel(QString("net%1").arg(qrand() % 3));
+    }
+}
+
+QTEST_MAIN(NetlistCacheTest)
+#include "netlistcachetest.moc"
@@ -0,0 +1,180 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+#include "chartitem.h"
+#include "chartscene.h"
+#include "ngspiceshared.h"
+#include "settings.h"
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+using namespace Caneda;
+
+//! \brief Small circuit used by the tests, the stub only checks the analysis.
+static const char *transientNetlist =
+        "Test circuit\n"
+        "V1 in 0 DC 1\n"
+        "R1 in out 1k\n"
+        "C1 out 0 1u\n"
+        ".tran 1u 10u\n";
+
+/*!
+ * \brief Tests the in-process simulation backend (NgspiceShared).
+ *
+ * The simulations are run with a stub of the ngspice shared library
+ * (ngspicestub), which sends fixed waveforms through the same callbacks
+ * ngspice uses. This checks the netlist and results path of the backend
+ * without an ngspice installation.
+ */
+class NgspiceSharedTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void transient();
+    void ac();
+    void error();
+    void addCurves();
+    void rawFile();
+    void latency();
+};
+
+//! \brief Loads the stub library.
+void NgspiceSharedTest::initTestCase()
+{
+    Settings::instance()->setCurrentValue("sim/ngspiceLibrary", QString(NGSPICE_STUB_LIBRARY));
+
+    QString errorMessage;
+    QVERIFY2(NgspiceShared::instance()->load(&errorMessage), qPrintable(errorMessage));
+}
+
+void NgspiceSharedTest::transient()
+{
+    SimulationResults results = NgspiceShared::instance()->run(transientNetlist).result();
+
+    QVERIFY2(results.errorMessage.isEmpty(), qPrintable(results.errorMessage));
+    QCOMPARE(results.names, QStringList() << "time" << "v(out)" << "i(v1)");
+    QCOMPARE(results.types, QStringList() << "time" << "voltage" << "current");
+    QVERIFY(!results.complex);
+    QVERIFY(results.imaginary.isEmpty());
+    QVERIFY(results.output.contains("Stub simulation started"));
+
+    QCOMPARE(results.real.size(), 3);
+    QCOMPARE(results.real.at(0)->size(), 10);
+    for(int p = 0; p < 10; ++p) {
+        QCOMPARE(results.real.at(0)->at(p), double(p));
+        QCOMPARE(results.real.at(1)->at(p), 2.0 * p);
+        QCOMPARE(results.real.at(2)->at(p), -double(p));
+    }
+}
+
+void NgspiceSharedTest::ac()
+{
+    QString netlist = QString(transientNetlist).replace(".tran 1u 10u", ".ac dec 10 1 1meg");
+    SimulationResults results = NgspiceShared::instance()->run(netlist).result();
+
+    QVERIFY2(results.errorMessage.isEmpty(), qPrintable(results.errorMessage));
+    QCOMPARE(results.names, QStringList() << "frequency" << "v(out)");
+    QVERIFY(results.complex);
+
+    QCOMPARE(results.imaginary.size(), 2);
+    for(int p = 0; p < 10; ++p) {
+        QCOMPARE(results.real.at(1)->at(p), double(p));
+        QCOMPARE(results.imaginary.at(1)->at(p), double(p));
+    }
+}
+
+void NgspiceSharedTest::error()
+{
+    SimulationResults results =
+            NgspiceShared::instance()->run(QString(transientNetlist) + "error\n").result();
+
+    QCOMPARE(results.errorMessage, QString("Error: stub simulation failed"));
+    QVERIFY(results.output.contains("Error: stub simulation failed"));
+
+    // The library keeps working after a failed simulation
+    results = NgspiceShared::instance()->run(transientNetlist).result();
+    QVERIFY2(results.errorMessage.isEmpty(), qPrintable(results.errorMessage));
+
+    // Other messages mentioning errors are not failures
+    results = NgspiceShared::instance()->run(QString(transientNetlist) + "warning\n").result();
+    QVERIFY2(results.errorMessage.isEmpty(), qPrintable(results.errorMessage));
+    QVERIFY(results.output.contains("Warning: relative error tolerance relaxed"));
+    QCOMPARE(results.names.size(), 3);
+}
+
+void NgspiceSharedTest::addCurves()
+{
+    SimulationResults results = NgspiceShared::instance()->run(transientNetlist).result();
+
+    ChartScene scene;
+    NgspiceShared::addCurves(results, &scene);
+
+    // The scale is not added as a waveform
+    QCOMPARE(scene.items().size(), 2);
+    QCOMPARE(scene.items().at(0)->title().text(), QString("v(out)"));
+    QCOMPARE(scene.items().at(0)->type(), QString("voltage"));
+    QCOMPARE(scene.items().at(1)->type(), QString("current"));
+    QCOMPARE(int(scene.items().at(0)->dataSize()), 10);
+    QCOMPARE(scene.items().at(0)->sample(9), QPointF(9, 18));
+}
+
+//! \brief Checks that saved results are read back unchanged.
+void NgspiceSharedTest::rawFile()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + "/test.raw";
+
+    QString netlist = QString(transientNetlist).replace(".tran 1u 10u", ".ac dec 10 1 1meg");
+    SimulationResults results = NgspiceShared::instance()->run(netlist).result();
+    QVERIFY(NgspiceShared::saveRawFile(results, fileName));
+
+    SimulationResults read;
+    QVERIFY(NgspiceShared::readRawFile(fileName, &read));
+    QCOMPARE(read.names, results.names);
+    QCOMPARE(read.types, results.types);
+    QCOMPARE(read.complex, results.complex);
+    for(int i = 0; i < results.names.size(); ++i) {
+        QCOMPARE(read.real.at(i)->toVector(), results.real.at(i)->toVector());
+        QCOMPARE(read.imaginary.at(i)->toVector(), results.imaginary.at(i)->toVector());
+    }
+}
+
+/*!
+ * \brief Measures the overhead of the backend for small circuits.
+ *
+ * The stub simulates instantly, so this measures the time spent by the
+ * backend itself (thread dispatch, netlist and results handling). The
+ * figure is reported by QBENCHMARK instead of being compared against a
+ * wall-clock limit, which would depend on the load of the machine.
+ */
+void NgspiceSharedTest::latency()
+{
+    QBENCHMARK {
+        SimulationResults results = NgspiceShared::instance()->run(transientNetlist).result();
+        ChartScene scene;
+        NgspiceShared::addCurves(results, &scene);
+    }
+}
+
+QTEST_MAIN(NgspiceSharedTest)
+#include "ngspicesharedtest.moc"
@@ -0,0 +1,234 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+/*
+ * Stub of the ngspice shared library, used to test NgspiceShared without
+ * depending on an ngspice installation.
+ *
+ * Only ngSpice_Init(), ngSpice_Circ() and ngSpice_Command() are provided.
+ * The "run" command sends a single plot through the callbacks, as ngspice
+ * does:
+ *  - Transient analysis (.tran): time, out = 2 * time and
+ *    v1#branch = -time.
+ *  - AC analysis (.ac): frequency, and out = frequency + j * frequency.
+ *  - Circuits with a line starting with "error" fail, writing an error
+ *    message to stderr.
+ *  - Circuits with a line starting with "warning" write a warning that
+ *    mentions errors to stderr, but still run.
+ */
+
+#include <QtGlobal>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+// The following declarations mirror the ones in the sharedspice.h header of
+// ngspice.
+struct vecvalues
+{
+    char *name;
+    double creal;
+    double cimag;
+    bool is_scale;
+    bool is_complex;
+};
+
+struct vecvaluesall
+{
+    int veccount;
+    int vecindex;
+    vecvalues **vecsa;
+};
+
+struct vecinfo
+{
+    int number;
+    char *vecname;
+    bool is_real;
+    void *pdvec;
+    void *pdvecscale;
+};
+
+struct vecinfoall
+{
+    char *name;
+    char *title;
+    char *date;
+    char *type;
+    int veccount;
+    vecinfo **vecs;
+};
+
+typedef int (SendChar)(char *, int, void *);
+typedef int (SendStat)(char *, int, void *);
+typedef int (ControlledExit)(int, bool, bool, int, void *);
+typedef int (SendData)(vecvaluesall *, int, int, void *);
+typedef int (SendInitData)(vecinfoall *, int, void *);
+typedef int (BGThreadRunning)(bool, int, void *);
+
+//! \brief Number of points of each simulation
+static const int points = 10;
+
+static SendChar *sendChar = 0;
+static SendData *sendData = 0;
+static SendInitData *sendInitData = 0;
+static void *userData = 0;
+
+//! \brief Lines of the loaded circuit
+static std::vector<std::string> circuit;
+
+static bool startsWith(const std::string &line, const char *prefix)
+{
+    return line.compare(0, std::strlen(prefix), prefix) == 0;
+}
+
+static void message(const char *text)
+{
+    std::string line(text);
+    sendChar(&line[0], 0, userData);
+}
+
+//! \brief Sends a plot of \a names vectors, the first of them the scale.
+static int sendPlot(const std::vector<std::string> &names, bool complex)
+{
+    std::vector<std::string> vectorNames(names);
+    std::vector<vecinfo> infos(names.size());
+    std::vector<vecinfo*> infoPointers;
+    for(size_t i = 0; i < names.size(); ++i) {
+        infos[i].number = int(i);
+        infos[i].vecname = &vectorNames[i][0];
+        infos[i].is_real = !complex;
+        infos[i].pdvec = 0;
+        infos[i].pdvecscale = 0;
+        infoPointers.push_back(&infos[i]);
+    }
+
+    char plotName[] = "stub1";
+    char title[] = "Stub";
+    char date[] = "";
+    char type[] = "stub";
+
+    vecinfoall plot;
+    plot.name = plotName;
+    plot.title = title;
+    plot.date = date;
+    plot.type = type;
+    plot.veccount = int(names.size());
+    plot.vecs = &infoPointers[0];
+    sendInitData(&plot, 0, userData);
+
+    std::vector<vecvalues> values(names.size());
+    std::vector<vecvalues*> valuePointers;
+    for(size_t i = 0; i < names.size(); ++i) {
+        values[i].name = &vectorNames[i][0];
+        values[i].is_scale = (i == 0);
+        values[i].is_complex = complex;
+        valuePointers.push_back(&values[i]);
+    }
+
+    for(int p = 0; p < points; ++p) {
+        const double scale = p;
+        for(size_t i = 0; i < names.size(); ++i) {
+            values[i].creal = (i == 1) && !complex ? 2 * scale :
+                              (i == 2) ? -scale : scale;
+            values[i].cimag = complex && i > 0 ? scale : 0;
+        }
+
+        vecvaluesall point;
+        point.veccount = int(names.size());
+        point.vecindex = p;
+        point.vecsa = &valuePointers[0];
+        sendData(&point, int(names.size()), 0, userData);
+    }
+
+    return 0;
+}
+
+//! \brief Runs the loaded circuit.
+static int run()
+{
+    bool ac = false;
+    for(size_t i = 0; i < circuit.size(); ++i) {
+        if(startsWith(circuit[i], "error")) {
+            message("stderr Error: stub simulation failed");
+            return 1;
+        }
+        if(startsWith(circuit[i], "warning")) {
+            message("stderr Warning: relative error tolerance relaxed");
+        }
+        ac = ac || startsWith(circuit[i], ".ac");
+    }
+
+    std::vector<std::string> names;
+    if(ac) {
+        names.push_back("frequency");
+        names.push_back("out");
+    }
+    else {
+        names.push_back("time");
+        names.push_back("out");
+        names.push_back("v1#branch");
+    }
+
+    message("stdout Stub simulation started");
+    return sendPlot(names, ac);
+}
+
+extern "C" {
+
+Q_DECL_EXPORT int ngSpice_Init(SendChar *printfcn, SendStat *, ControlledExit *,
+                               SendData *datfcn, SendInitData *initfcn,
+                               BGThreadRunning *, void *userdata)
+{
+    sendChar = printfcn;
+    sendData = datfcn;
+    sendInitData = initfcn;
+    userData = userdata;
+    return 0;
+}
+
+Q_DECL_EXPORT int ngSpice_Circ(char **lines)
+{
+    circuit.clear();
+    for(int i = 0; lines[i]; ++i) {
+        circuit.push_back(lines[i]);
+    }
+
+    return circuit.empty() || circuit.back() != ".end";
+}
+
+Q_DECL_EXPORT int ngSpice_Command(char *command)
+{
+    if(!command) {
+        return 1;
+    }
+
+    const std::string text(command);
+    if(text == "run") {
+        return run();
+    }
+    if(text == "remcirc") {
+        circuit.clear();
+    }
+
+    return 0;
+}
+
+} // extern "C"
@@ -0,0 +1,152 @@
+/***************************************************************************
+ * Copyright (C) 2016 by Pablo Daniel Pareja Obregon                       *
+ *                                                                         *
+ * This is free software; you can redistribute it and/or modify            *
+ * it under the terms of the GNU General Public License as published by    *
+ * the Free Software Foundation; either version 2, or (at your option)     *
+ * any later version.                                                      *
+ *                                                                         *
+ * This software is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU General Public License for more details.                            *
+ *                                                                         *
+ * You should have received a copy of the GNU General Public License       *
+ * along with this package; see the file COPYING.  If not, write to        *
+ * the Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,   *
+ * Boston, MA 02110-1301, USA.                                             *
+ ***************************************************************************/
+
+#include "component.h"
+#include "library.h"
+#include "property.h"
+
+#include <QtTest>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+using namespace Caneda;
+
+//! \brief Number of instances created by each test.
+static const int Instances = 100000;
+
+/*!
+ * \brief Returns the number of bytes currently allocated in the heap, or -1
+ * if the heap statistics are not available.
+ */
+static qint64 allocatedBytes()
+{
+#if defined(__GLIBC__)
+#if __GLIBC_PREREQ(2, 33)
+    struct mallinfo2 info = mallinfo2();
+#else
+    struct mallinfo info = mallinfo();
+#endif
+    return qint64(info.uordblks) + qint64(info.hblkhd);
+#else
+    return -1;
+#endif
+}
+
+/*!
+ * \brief Measures the heap memory used per component instance, with 100k
+ * instances alive at once.
+ *
+ * The properties of each instance only hold the values overriding the
+ * library defaults (usually, just the label), and the display item is only
+ * created for visible properties. The results are reported as benchmark
+ * results (bytes allocated per instance), and the property state is
+ * checked against a budget well below the cost of a full copy of the
+ * library properties.
+ */
+class PropertyMemoryTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void propertyGroups_data();
+    void propertyGroups();
+    void components();
+};
+
+//! \brief Loads the passive components library.
+void PropertyMemoryTest::initTestCase()
+{
+    if(allocatedBytes() < 0) {
+        QSKIP("Heap statistics are not available on this platform");
+    }
+
+    QVERIFY(LibraryManager::instance()->load(QString(CANEDA_LIBRARIES_DIR) + "/passive"));
+}
+
+void PropertyMemoryTest::propertyGroups_data()
+{
+    QTest::addColumn<bool>("visible");
+    QTest::addColumn<int>("budget");
+
+    QTest::newRow("hidden label") << false << 1024;
+    QTest::newRow("visible label") << true << 2048;
+}
+
+/*!
+ * \brief Measures the property state of a resistor: the library defaults
+ * plus its own label, either hidden or visible (with a display item).
+ */
+void PropertyMemoryTest::propertyGroups()
+{
+    QFETCH(bool, visible);
+    QFETCH(int, budget);
+
+    ComponentDataPtr data = LibraryManager::instance()->componentData("Resistor", "Passive");
+    QVERIFY(data.constData());
+
+    QVector<PropertyGroup*> groups(Instances);
+
+    const qint64 before = allocatedBytes();
+    for(int i = 0; i < Instances; ++i) {
+        PropertyGroup *group = new PropertyGroup();
+        group->setDefaultProperties(data->properties);
+        group->addProperty("label", Property("label", QString("R%1").arg(i + 1),
+                                             QObject::tr("Label"), visible));
+        groups[i] = group;
+    }
+    const qint64 bytesPerInstance = (allocatedBytes() - before) / Instances;
+
+    QCOMPARE(groups.first()->display() != 0, visible);
+    qDeleteAll(groups);
+
+    QTest::setBenchmarkResult(bytesPerInstance, QTest::BytesAllocated);
+    QVERIFY2(bytesPerInstance <= budget,
+             qPrintable(QString("%1 bytes per instance").arg(bytesPerInstance)));
+}
+
+/*!
+ * \brief Measures complete resistor instances (item, ports and properties,
+ * with the default visible label).
+ */
+void PropertyMemoryTest::components()
+{
+    ComponentDataPtr data = LibraryManager::instance()->componentData("Resistor", "Passive");
+    QVERIFY(data.constData());
+
+    QVector<Component*> components(Instances);
+
+    const qint64 before = allocatedBytes();
+    for(int i = 0; i < Instances; ++i) {
+        Component *component = new Component();
+        component->setComponentData(data);
+        component->setLabel(component->labelPrefix() + QString::number(i + 1));
+        components[i] = component;
+    }
+    const qint64 bytesPerInstance = (allocatedBytes() - before) / Instances;
+
+    qDeleteAll(components);
+
+    QTest::setBenchmarkResult(bytesPerInstance, QTest::BytesAllocated);
+}
+
+QTEST_MAIN(PropertyMemoryTest)
+#include "propertymemorytest.moc"